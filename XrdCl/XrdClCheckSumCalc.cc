@@ -0,0 +1,728 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+#include "XrdCl/XrdClCheckSumCalc.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClConstants.hh"
+#include "XrdCks/XrdCks.hh"
+#include "XrdCks/XrdCksCalc.hh"
+#include "XrdCks/XrdCksData.hh"
+
+#include <cstdio>
+#include <pthread.h>
+
+//------------------------------------------------------------------------------
+// The accelerated kernels are compiled with the function level target
+// attributes, so that the library itself does not require any particular
+// CPU, and picked at run time
+//------------------------------------------------------------------------------
+#if ( defined(__x86_64__) || defined(__i386__) ) && \
+    ( defined(__clang__) || __GNUC__ > 4 ||        \
+      ( __GNUC__ == 4 && __GNUC_MINOR__ >= 9 ) )
+#define XRDCL_CKS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+  typedef uint32_t (*Kernel)( uint32_t crc, const uint8_t *data, size_t len );
+
+  //----------------------------------------------------------------------------
+  // Lookup tables and CPU capabilities, set up once
+  //----------------------------------------------------------------------------
+  uint32_t       sZCrc32Table[8][256];
+  uint32_t       sCrc32cTable[8][256];
+  uint32_t       sCksumTable[256];
+  uint32_t       sZCrc32X2n[32];
+  uint32_t       sCrc32cX2n[32];
+  bool           sHasSSE42  = false;
+  bool           sHasPCLMUL = false;
+  bool           sHasAVX2   = false;
+  pthread_once_t sInitOnce  = PTHREAD_ONCE_INIT;
+
+  //----------------------------------------------------------------------------
+  // Slicing-by-8 tables for a reflected polynomial
+  //----------------------------------------------------------------------------
+  void InitReflectedTable( uint32_t table[8][256], uint32_t poly )
+  {
+    for( uint32_t i = 0; i < 256; ++i )
+    {
+      uint32_t crc = i;
+      for( int j = 0; j < 8; ++j )
+        crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+      table[0][i] = crc;
+    }
+
+    for( uint32_t i = 0; i < 256; ++i )
+      for( int k = 1; k < 8; ++k )
+        table[k][i] = (table[k-1][i] >> 8) ^ table[0][table[k-1][i] & 0xff];
+  }
+
+  //----------------------------------------------------------------------------
+  // Multiply two polynomials modulo the reflected crc polynomial
+  //----------------------------------------------------------------------------
+  uint32_t MultModP( uint32_t a, uint32_t b, uint32_t poly )
+  {
+    uint32_t m = 1U << 31;
+    uint32_t p = 0;
+    while( 1 )
+    {
+      if( a & m )
+      {
+        p ^= b;
+        if( (a & (m - 1)) == 0 )
+          break;
+      }
+      m >>= 1;
+      b = (b & 1) ? (b >> 1) ^ poly : b >> 1;
+    }
+    return p;
+  }
+
+  //----------------------------------------------------------------------------
+  // Powers x^(2^k) modulo the reflected crc polynomial
+  //----------------------------------------------------------------------------
+  void InitX2nTable( uint32_t table[32], uint32_t poly )
+  {
+    uint32_t p = 1U << 30;
+    for( int k = 0; k < 32; ++k )
+    {
+      table[k] = p;
+      p = MultModP( p, p, poly );
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Multiply a reflected crc register by x^(8*length), ie. shift it over
+  // length zero bytes
+  //----------------------------------------------------------------------------
+  uint32_t ShiftCrc( uint32_t crc, uint64_t length, const uint32_t table[32],
+                     uint32_t poly )
+  {
+    uint32_t p = 1U << 31;
+    int      k = 3;
+    while( length )
+    {
+      if( length & 1 )
+        p = MultModP( table[k & 31], p, poly );
+      length >>= 1;
+      ++k;
+    }
+    return MultModP( p, crc, poly );
+  }
+
+  //----------------------------------------------------------------------------
+  // Reverse the bits of a word
+  //----------------------------------------------------------------------------
+  uint32_t Reflect( uint32_t value )
+  {
+    uint32_t result = 0;
+    for( int i = 0; i < 32; ++i, value >>= 1 )
+      result = (result << 1) | (value & 1);
+    return result;
+  }
+
+  //----------------------------------------------------------------------------
+  // Set up the tables and detect the CPU features
+  //----------------------------------------------------------------------------
+  void InitCheckSums()
+  {
+    InitReflectedTable( sZCrc32Table, 0xedb88320 );
+    InitReflectedTable( sCrc32cTable, 0x82f63b78 );
+    InitX2nTable( sZCrc32X2n, 0xedb88320 );
+    InitX2nTable( sCrc32cX2n, 0x82f63b78 );
+
+    for( uint32_t i = 0; i < 256; ++i )
+    {
+      uint32_t crc = i << 24;
+      for( int j = 0; j < 8; ++j )
+        crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+      sCksumTable[i] = crc;
+    }
+
+#ifdef XRDCL_CKS_X86
+    __builtin_cpu_init();
+    sHasSSE42  = __builtin_cpu_supports( "sse4.2" );
+    sHasPCLMUL = sHasSSE42 && __builtin_cpu_supports( "pclmul" );
+    sHasAVX2   = __builtin_cpu_supports( "avx2" );
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  // Read a little endian word
+  //----------------------------------------------------------------------------
+  inline uint32_t Load32( const uint8_t *p )
+  {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+  }
+
+  //----------------------------------------------------------------------------
+  // Portable slicing-by-8 reflected crc
+  //----------------------------------------------------------------------------
+  inline uint32_t Crc32Slice8( const uint32_t  table[8][256],
+                               uint32_t        crc,
+                               const uint8_t  *p,
+                               size_t          len )
+  {
+    while( len >= 8 )
+    {
+      uint32_t one = Load32( p ) ^ crc;
+      uint32_t two = Load32( p+4 );
+      crc = table[7][one & 0xff]         ^ table[6][(one >> 8) & 0xff] ^
+            table[5][(one >> 16) & 0xff] ^ table[4][one >> 24]         ^
+            table[3][two & 0xff]         ^ table[2][(two >> 8) & 0xff] ^
+            table[1][(two >> 16) & 0xff] ^ table[0][two >> 24];
+      p   += 8;
+      len -= 8;
+    }
+
+    while( len-- )
+      crc = table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return crc;
+  }
+
+  uint32_t ZCrc32Portable( uint32_t crc, const uint8_t *p, size_t len )
+  {
+    return Crc32Slice8( sZCrc32Table, crc, p, len );
+  }
+
+  uint32_t Crc32cPortable( uint32_t crc, const uint8_t *p, size_t len )
+  {
+    return Crc32Slice8( sCrc32cTable, crc, p, len );
+  }
+
+  //----------------------------------------------------------------------------
+  // Portable adler32, the sums are reduced every NMAX bytes so that they
+  // never overflow
+  //----------------------------------------------------------------------------
+  const uint32_t AdlerBase = 65521;
+  const size_t   AdlerNMax = 5552;
+
+  uint32_t Adler32Portable( uint32_t adler, const uint8_t *p, size_t len )
+  {
+    uint32_t s1 = adler & 0xffff;
+    uint32_t s2 = adler >> 16;
+    while( len )
+    {
+      size_t n = len < AdlerNMax ? len : AdlerNMax;
+      len -= n;
+      while( n >= 8 )
+      {
+        s1 += p[0]; s2 += s1; s1 += p[1]; s2 += s1;
+        s1 += p[2]; s2 += s1; s1 += p[3]; s2 += s1;
+        s1 += p[4]; s2 += s1; s1 += p[5]; s2 += s1;
+        s1 += p[6]; s2 += s1; s1 += p[7]; s2 += s1;
+        p += 8;
+        n -= 8;
+      }
+      while( n-- )
+      {
+        s1 += *p++;
+        s2 += s1;
+      }
+      s1 %= AdlerBase;
+      s2 %= AdlerBase;
+    }
+    return (s2 << 16) | s1;
+  }
+
+#ifdef XRDCL_CKS_X86
+  //----------------------------------------------------------------------------
+  // crc32c with the SSE4.2 crc32 instruction
+  //----------------------------------------------------------------------------
+  __attribute__((target("sse4.2")))
+  uint32_t Crc32cSSE42( uint32_t crc, const uint8_t *p, size_t len )
+  {
+    while( len && ((uintptr_t)p & 7) )
+    {
+      crc = _mm_crc32_u8( crc, *p++ );
+      --len;
+    }
+
+#ifdef __x86_64__
+    uint64_t crc64 = crc;
+    while( len >= 8 )
+    {
+      crc64 = _mm_crc32_u64( crc64, *(const uint64_t*)p );
+      p   += 8;
+      len -= 8;
+    }
+    crc = crc64;
+#endif
+
+    while( len >= 4 )
+    {
+      crc  = _mm_crc32_u32( crc, *(const uint32_t*)p );
+      p   += 4;
+      len -= 4;
+    }
+
+    while( len-- )
+      crc = _mm_crc32_u8( crc, *p++ );
+    return crc;
+  }
+
+  //----------------------------------------------------------------------------
+  // zlib crc32 folded with carry-less multiplication, see "Fast CRC
+  // Computation for Generic Polynomials Using PCLMULQDQ Instruction" by
+  // Intel. Blocks of 64 bytes are folded four lanes at a time, the rest
+  // goes through the tables.
+  //----------------------------------------------------------------------------
+  __attribute__((target("sse4.2,pclmul")))
+  uint32_t ZCrc32PCLMUL( uint32_t crc, const uint8_t *p, size_t len )
+  {
+    if( len < 64 )
+      return ZCrc32Portable( crc, p, len );
+
+    const __m128i k1k2 = _mm_set_epi64x( 0x01c6e41596LL, 0x0154442bd4LL );
+    const __m128i k3k4 = _mm_set_epi64x( 0x00ccaa009eLL, 0x01751997d0LL );
+    const __m128i k5k0 = _mm_set_epi64x( 0x0000000000LL, 0x0163cd6124LL );
+    const __m128i poly = _mm_set_epi64x( 0x01f7011641LL, 0x01db710641LL );
+    const __m128i mask = _mm_setr_epi32( ~0, 0, ~0, 0 );
+
+    size_t tail = len & 15;
+    len -= tail;
+
+    __m128i x1 = _mm_loadu_si128( (const __m128i*)(p + 0x00) );
+    __m128i x2 = _mm_loadu_si128( (const __m128i*)(p + 0x10) );
+    __m128i x3 = _mm_loadu_si128( (const __m128i*)(p + 0x20) );
+    __m128i x4 = _mm_loadu_si128( (const __m128i*)(p + 0x30) );
+    __m128i x0, x5, x6, x7, x8;
+    x1   = _mm_xor_si128( x1, _mm_cvtsi32_si128( crc ) );
+    p   += 64;
+    len -= 64;
+
+    //--------------------------------------------------------------------------
+    // Fold 512 bits at a time
+    //--------------------------------------------------------------------------
+    while( len >= 64 )
+    {
+      x5 = _mm_clmulepi64_si128( x1, k1k2, 0x00 );
+      x6 = _mm_clmulepi64_si128( x2, k1k2, 0x00 );
+      x7 = _mm_clmulepi64_si128( x3, k1k2, 0x00 );
+      x8 = _mm_clmulepi64_si128( x4, k1k2, 0x00 );
+      x1 = _mm_clmulepi64_si128( x1, k1k2, 0x11 );
+      x2 = _mm_clmulepi64_si128( x2, k1k2, 0x11 );
+      x3 = _mm_clmulepi64_si128( x3, k1k2, 0x11 );
+      x4 = _mm_clmulepi64_si128( x4, k1k2, 0x11 );
+      x1 = _mm_xor_si128( _mm_xor_si128( x1, x5 ),
+                          _mm_loadu_si128( (const __m128i*)(p + 0x00) ) );
+      x2 = _mm_xor_si128( _mm_xor_si128( x2, x6 ),
+                          _mm_loadu_si128( (const __m128i*)(p + 0x10) ) );
+      x3 = _mm_xor_si128( _mm_xor_si128( x3, x7 ),
+                          _mm_loadu_si128( (const __m128i*)(p + 0x20) ) );
+      x4 = _mm_xor_si128( _mm_xor_si128( x4, x8 ),
+                          _mm_loadu_si128( (const __m128i*)(p + 0x30) ) );
+      p   += 64;
+      len -= 64;
+    }
+
+    //--------------------------------------------------------------------------
+    // Fold the four lanes into one and then 128 bits at a time
+    //--------------------------------------------------------------------------
+    x5 = _mm_clmulepi64_si128( x1, k3k4, 0x00 );
+    x1 = _mm_clmulepi64_si128( x1, k3k4, 0x11 );
+    x1 = _mm_xor_si128( _mm_xor_si128( x1, x2 ), x5 );
+    x5 = _mm_clmulepi64_si128( x1, k3k4, 0x00 );
+    x1 = _mm_clmulepi64_si128( x1, k3k4, 0x11 );
+    x1 = _mm_xor_si128( _mm_xor_si128( x1, x3 ), x5 );
+    x5 = _mm_clmulepi64_si128( x1, k3k4, 0x00 );
+    x1 = _mm_clmulepi64_si128( x1, k3k4, 0x11 );
+    x1 = _mm_xor_si128( _mm_xor_si128( x1, x4 ), x5 );
+
+    while( len >= 16 )
+    {
+      x2 = _mm_loadu_si128( (const __m128i*)p );
+      x5 = _mm_clmulepi64_si128( x1, k3k4, 0x00 );
+      x1 = _mm_clmulepi64_si128( x1, k3k4, 0x11 );
+      x1 = _mm_xor_si128( _mm_xor_si128( x1, x2 ), x5 );
+      p   += 16;
+      len -= 16;
+    }
+
+    //--------------------------------------------------------------------------
+    // Fold 128 bits to 64 and do the Barrett reduction to 32
+    //--------------------------------------------------------------------------
+    x2 = _mm_clmulepi64_si128( x1, k3k4, 0x10 );
+    x1 = _mm_xor_si128( _mm_srli_si128( x1, 8 ), x2 );
+    x0 = k5k0;
+    x2 = _mm_srli_si128( x1, 4 );
+    x1 = _mm_and_si128( x1, mask );
+    x1 = _mm_clmulepi64_si128( x1, x0, 0x00 );
+    x1 = _mm_xor_si128( x1, x2 );
+
+    x2 = _mm_and_si128( x1, mask );
+    x2 = _mm_clmulepi64_si128( x2, poly, 0x10 );
+    x2 = _mm_and_si128( x2, mask );
+    x2 = _mm_clmulepi64_si128( x2, poly, 0x00 );
+    x1 = _mm_xor_si128( x1, x2 );
+    crc = _mm_extract_epi32( x1, 1 );
+
+    return ZCrc32Portable( crc, p, tail );
+  }
+
+  //----------------------------------------------------------------------------
+  // adler32 with AVX2, 32 bytes at a time: the byte sums go to s1 and the
+  // sums weighted by the distance from the end of the block go to s2,
+  // together with 32 times the s1 value before every block
+  //----------------------------------------------------------------------------
+  __attribute__((target("avx2")))
+  uint32_t Adler32AVX2( uint32_t adler, const uint8_t *p, size_t len )
+  {
+    uint32_t s1 = adler & 0xffff;
+    uint32_t s2 = adler >> 16;
+
+    const __m256i zero    = _mm256_setzero_si256();
+    const __m256i ones    = _mm256_set1_epi16( 1 );
+    const __m256i weights = _mm256_setr_epi8( 32, 31, 30, 29, 28, 27, 26, 25,
+                                              24, 23, 22, 21, 20, 19, 18, 17,
+                                              16, 15, 14, 13, 12, 11, 10,  9,
+                                               8,  7,  6,  5,  4,  3,  2,  1 );
+
+    while( len >= 32 )
+    {
+      size_t blocks = len / 32;
+      if( blocks > AdlerNMax / 32 )
+        blocks = AdlerNMax / 32;
+      len -= blocks * 32;
+      s2  += s1 * (blocks * 32);
+
+      __m256i vs1 = zero;
+      __m256i vs2 = zero;
+      __m256i vps = zero;
+      while( blocks-- )
+      {
+        __m256i bytes = _mm256_loadu_si256( (const __m256i*)p );
+        vps = _mm256_add_epi32( vps, vs1 );
+        vs1 = _mm256_add_epi32( vs1, _mm256_sad_epu8( bytes, zero ) );
+        vs2 = _mm256_add_epi32( vs2, _mm256_madd_epi16(
+                                  _mm256_maddubs_epi16( bytes, weights ),
+                                  ones ) );
+        p += 32;
+      }
+      vs2 = _mm256_add_epi32( vs2, _mm256_slli_epi32( vps, 5 ) );
+
+      uint32_t lanes1[8], lanes2[8];
+      _mm256_storeu_si256( (__m256i*)lanes1, vs1 );
+      _mm256_storeu_si256( (__m256i*)lanes2, vs2 );
+      uint64_t sum1 = s1, sum2 = s2;
+      for( int i = 0; i < 8; ++i )
+      {
+        sum1 += lanes1[i];
+        sum2 += lanes2[i];
+      }
+      s1 = sum1 % AdlerBase;
+      s2 = sum2 % AdlerBase;
+    }
+
+    return Adler32Portable( (s2 << 16) | s1, p, len );
+  }
+#endif
+
+  //----------------------------------------------------------------------------
+  // Format a 32 bit checksum the way XrdCks does
+  //----------------------------------------------------------------------------
+  std::string Format32( const std::string &type, uint32_t value )
+  {
+    char buff[16];
+    snprintf( buff, 16, "%08x", value );
+    return type + ":" + buff;
+  }
+
+  //----------------------------------------------------------------------------
+  // Reflected crc, the register is kept inverted
+  //----------------------------------------------------------------------------
+  class Crc32Calc: public XrdCl::CheckSumCalc
+  {
+    public:
+      Crc32Calc( const std::string &type, Kernel kernel, uint32_t poly,
+                 const uint32_t *x2n ):
+        CheckSumCalc( type ), pKernel( kernel ), pPoly( poly ), pX2n( x2n ),
+        pCrc( 0xffffffff ) {}
+
+      virtual void Update( const void *buffer, uint32_t length )
+      {
+        pCrc = pKernel( pCrc, (const uint8_t*)buffer, length );
+      }
+
+      virtual std::string GetCheckSum()
+      {
+        return Format32( pType, ~pCrc );
+      }
+
+      virtual bool IsCombinable() const
+      {
+        return true;
+      }
+
+      //------------------------------------------------------------------------
+      // The initial inversion of the other register cancels out with
+      // the inversion of ours shifted over the other data
+      //------------------------------------------------------------------------
+      virtual bool Combine( const XrdCl::CheckSumCalc &other,
+                            uint64_t                   length )
+      {
+        const Crc32Calc *o = dynamic_cast<const Crc32Calc*>( &other );
+        if( !o || o->pPoly != pPoly )
+          return false;
+        uint32_t crc = ShiftCrc( ~pCrc, length, pX2n, pPoly ) ^ ~o->pCrc;
+        pCrc = ~crc;
+        return true;
+      }
+
+    private:
+      Kernel          pKernel;
+      uint32_t        pPoly;
+      const uint32_t *pX2n;
+      uint32_t        pCrc;
+  };
+
+  //----------------------------------------------------------------------------
+  // Adler32
+  //----------------------------------------------------------------------------
+  class Adler32Calc: public XrdCl::CheckSumCalc
+  {
+    public:
+      Adler32Calc( Kernel kernel ):
+        CheckSumCalc( "adler32" ), pKernel( kernel ), pAdler( 1 ) {}
+
+      virtual void Update( const void *buffer, uint32_t length )
+      {
+        pAdler = pKernel( pAdler, (const uint8_t*)buffer, length );
+      }
+
+      virtual std::string GetCheckSum()
+      {
+        return Format32( pType, pAdler );
+      }
+
+      virtual bool IsCombinable() const
+      {
+        return true;
+      }
+
+      virtual bool Combine( const XrdCl::CheckSumCalc &other,
+                            uint64_t                   length )
+      {
+        const Adler32Calc *o = dynamic_cast<const Adler32Calc*>( &other );
+        if( !o )
+          return false;
+
+        uint32_t rem  = length % AdlerBase;
+        uint32_t sum1 = pAdler & 0xffff;
+        uint32_t sum2 = (uint32_t)(((uint64_t)rem * sum1) % AdlerBase);
+        sum1 += (o->pAdler & 0xffff) + AdlerBase - 1;
+        sum2 += (pAdler >> 16) + (o->pAdler >> 16) + AdlerBase - rem;
+        if( sum1 >= AdlerBase ) sum1 -= AdlerBase;
+        if( sum1 >= AdlerBase ) sum1 -= AdlerBase;
+        if( sum2 >= AdlerBase << 1 ) sum2 -= AdlerBase << 1;
+        if( sum2 >= AdlerBase ) sum2 -= AdlerBase;
+        pAdler = (sum2 << 16) | sum1;
+        return true;
+      }
+
+    private:
+      Kernel   pKernel;
+      uint32_t pAdler;
+  };
+
+  //----------------------------------------------------------------------------
+  // POSIX cksum crc - not reflected, the length of the data is appended
+  // before the final inversion
+  //----------------------------------------------------------------------------
+  class CksumCalc: public XrdCl::CheckSumCalc
+  {
+    public:
+      CksumCalc():
+        CheckSumCalc( "crc32" ), pCrc( 0 ), pLength( 0 ) {}
+
+      virtual void Update( const void *buffer, uint32_t length )
+      {
+        pLength += length;
+        Process( (const uint8_t*)buffer, length );
+      }
+
+      virtual std::string GetCheckSum()
+      {
+        uint8_t  buff[8];
+        size_t   n   = 0;
+        uint64_t len = pLength;
+        while( len )
+        {
+          buff[n++] = len & 0xff;
+          len >>= 8;
+        }
+        Process( buff, n );
+        return Format32( pType, ~pCrc );
+      }
+
+      virtual bool IsCombinable() const
+      {
+        return true;
+      }
+
+      //------------------------------------------------------------------------
+      // The register starts from zero so it's linear in the data, the
+      // shift is done with the bit-reversed zlib polynomial
+      //------------------------------------------------------------------------
+      virtual bool Combine( const XrdCl::CheckSumCalc &other,
+                            uint64_t                   length )
+      {
+        const CksumCalc *o = dynamic_cast<const CksumCalc*>( &other );
+        if( !o )
+          return false;
+        uint32_t crc = ShiftCrc( Reflect( pCrc ), length, sZCrc32X2n,
+                                 0xedb88320 );
+        pCrc     = Reflect( crc ) ^ o->pCrc;
+        pLength += o->pLength;
+        return true;
+      }
+
+    private:
+      void Process( const uint8_t *p, size_t len )
+      {
+        uint32_t crc = pCrc;
+        while( len-- )
+          crc = (crc << 8) ^ sCksumTable[(crc >> 24) ^ *p++];
+        pCrc = crc;
+      }
+
+      uint32_t pCrc;
+      uint64_t pLength;
+  };
+
+  //----------------------------------------------------------------------------
+  // Checksum computed by the XrdCks plug-in
+  //----------------------------------------------------------------------------
+  class XrdCksCalcWrapper: public XrdCl::CheckSumCalc
+  {
+    public:
+      XrdCksCalcWrapper( const std::string &type, XrdCksCalc *calc ):
+        CheckSumCalc( type ), pCalc( calc ) {}
+
+      virtual ~XrdCksCalcWrapper()
+      {
+        delete pCalc;
+      }
+
+      virtual void Update( const void *buffer, uint32_t length )
+      {
+        pCalc->Update( (const char*)buffer, length );
+      }
+
+      virtual std::string GetCheckSum()
+      {
+        int size = 0;
+        pCalc->Type( size );
+        XrdCksData ckSum;
+        ckSum.Set( pType.c_str() );
+        ckSum.Set( pCalc->Final(), size );
+
+        char cksBuffer[265];
+        ckSum.Get( cksBuffer, 256 );
+        return pType + ":" + cksBuffer;
+      }
+
+    private:
+      XrdCksCalc *pCalc;
+  };
+}
+
+namespace XrdCl
+{
+  //----------------------------------------------------------------------------
+  // Create a calculator
+  //----------------------------------------------------------------------------
+  CheckSumCalc *CheckSumCalc::Create( const std::string &type,
+                                      bool               accelerated )
+  {
+    pthread_once( &sInitOnce, InitCheckSums );
+
+    if( type == "adler32" )
+    {
+#ifdef XRDCL_CKS_X86
+      if( accelerated && sHasAVX2 )
+        return new Adler32Calc( Adler32AVX2 );
+#endif
+      return new Adler32Calc( Adler32Portable );
+    }
+
+    if( type == "zcrc32" )
+    {
+#ifdef XRDCL_CKS_X86
+      if( accelerated && sHasPCLMUL )
+        return new Crc32Calc( type, ZCrc32PCLMUL, 0xedb88320, sZCrc32X2n );
+#endif
+      return new Crc32Calc( type, ZCrc32Portable, 0xedb88320, sZCrc32X2n );
+    }
+
+    if( type == "crc32c" )
+    {
+#ifdef XRDCL_CKS_X86
+      if( accelerated && sHasSSE42 )
+        return new Crc32Calc( type, Crc32cSSE42, 0x82f63b78, sCrc32cX2n );
+#endif
+      return new Crc32Calc( type, Crc32cPortable, 0x82f63b78, sCrc32cX2n );
+    }
+
+    if( type == "crc32" )
+      return new CksumCalc();
+
+    //--------------------------------------------------------------------------
+    // Ask the checksum manager
+    //--------------------------------------------------------------------------
+    XrdCks *cksMan = DefaultEnv::GetCheckSumManager();
+    if( !cksMan )
+      return 0;
+
+    XrdCksCalc *calc = cksMan->Object( type.c_str() );
+    if( !calc )
+    {
+      DefaultEnv::GetLog()->Debug( UtilityMsg, "Checksum type %s is not "
+                                   "supported", type.c_str() );
+      return 0;
+    }
+    return new XrdCksCalcWrapper( type, calc );
+  }
+
+  //----------------------------------------------------------------------------
+  // Check if the checksum type is computed by the built-in kernels
+  //----------------------------------------------------------------------------
+  bool CheckSumCalc::IsBuiltIn( const std::string &type )
+  {
+    return type == "adler32" || type == "zcrc32" || type == "crc32c" ||
+           type == "crc32";
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the list of the instruction set extensions in use
+  //----------------------------------------------------------------------------
+  std::string CheckSumCalc::GetAcceleration()
+  {
+    pthread_once( &sInitOnce, InitCheckSums );
+    std::string result;
+    if( sHasSSE42 )  result += "sse4.2 ";
+    if( sHasPCLMUL ) result += "pclmul ";
+    if( sHasAVX2 )   result += "avx2 ";
+    if( !result.empty() )
+      result.erase( result.length()-1 );
+    return result;
+  }
+}
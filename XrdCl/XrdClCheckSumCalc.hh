@@ -0,0 +1,113 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+#ifndef __XRD_CL_CHECK_SUM_CALC_HH__
+#define __XRD_CL_CHECK_SUM_CALC_HH__
+
+#include <string>
+#include <stdint.h>
+
+namespace XrdCl
+{
+  //----------------------------------------------------------------------------
+  //! Streaming checksum calculator. The adler32, crc32 (POSIX cksum),
+  //! zcrc32 (zlib crc32) and crc32c checksums are computed by the built-in
+  //! kernels, which use the SSE4.2, PCLMUL and AVX2 instructions when the
+  //! CPU has them. Other checksum types are delegated to the XrdCks
+  //! checksum manager.
+  //----------------------------------------------------------------------------
+  class CheckSumCalc
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Destructor
+      //------------------------------------------------------------------------
+      virtual ~CheckSumCalc() {}
+
+      //------------------------------------------------------------------------
+      //! Process the next piece of data
+      //------------------------------------------------------------------------
+      virtual void Update( const void *buffer, uint32_t length ) = 0;
+
+      //------------------------------------------------------------------------
+      //! Finish the computation and get the checksum in the type:value
+      //! format, the calculator can't be updated afterwards
+      //------------------------------------------------------------------------
+      virtual std::string GetCheckSum() = 0;
+
+      //------------------------------------------------------------------------
+      //! Check if the partial checksums of this type can be combined
+      //------------------------------------------------------------------------
+      virtual bool IsCombinable() const
+      {
+        return false;
+      }
+
+      //------------------------------------------------------------------------
+      //! Append the data processed by another calculator of the same type,
+      //! as if it was passed to Update of this one. Neither of the
+      //! calculators may be finalized.
+      //!
+      //! @param other  the calculator that processed the following data
+      //! @param length number of bytes processed by the other calculator
+      //! @return       false if the checksums can't be combined
+      //------------------------------------------------------------------------
+      virtual bool Combine( const CheckSumCalc &other, uint64_t length )
+      {
+        (void)other; (void)length;
+        return false;
+      }
+
+      //------------------------------------------------------------------------
+      //! Get the checksum type
+      //------------------------------------------------------------------------
+      const std::string &GetType() const
+      {
+        return pType;
+      }
+
+      //------------------------------------------------------------------------
+      //! Create a calculator
+      //!
+      //! @param type        checksum type
+      //! @param accelerated use the SIMD kernels if the CPU supports them
+      //! @return            the calculator (to be deleted by the user) or 0
+      //!                    if the type is not supported
+      //------------------------------------------------------------------------
+      static CheckSumCalc *Create( const std::string &type,
+                                   bool               accelerated = true );
+
+      //------------------------------------------------------------------------
+      //! Check if the checksum type is computed by the built-in kernels
+      //------------------------------------------------------------------------
+      static bool IsBuiltIn( const std::string &type );
+
+      //------------------------------------------------------------------------
+      //! Get the list of the instruction set extensions used by the
+      //! accelerated kernels on this CPU, empty if none
+      //------------------------------------------------------------------------
+      static std::string GetAcceleration();
+
+    protected:
+      CheckSumCalc( const std::string &type ): pType( type ) {}
+
+      std::string pType;
+  };
+}
+
+#endif // __XRD_CL_CHECK_SUM_CALC_HH__
@@ -21,20 +21,167 @@
 #include "XrdCl/XrdClLog.hh"
 #include "XrdCl/XrdClDefaultEnv.hh"
 #include "XrdCl/XrdClFile.hh"
+#include "XrdCl/XrdClFileSystem.hh"
 #include "XrdCl/XrdClMonitor.hh"
 #include "XrdCl/XrdClUtils.hh"
+#include "XrdCl/XrdClCheckSumCalc.hh"
+#include "XrdCl/XrdClCopyTuner.hh"
+#include "XrdCl/XrdClPostMaster.hh"
+#include "XrdCl/XrdClTaskManager.hh"
+#include "XrdSys/XrdSysPthread.hh"
 
 #include <memory>
 #include <iostream>
+#include <algorithm>
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+#include <sstream>
+#include <cctype>
+#include <cstring>
+#include <cstdlib>
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/time.h>
 
 namespace
 {
+  //----------------------------------------------------------------------------
+  //! The ways of doing the local I/O
+  //!
+  //! Posix   - plain pread/pwrite through the page cache
+  //! Auto    - like Posix, with the sequential access hint for the source
+  //! FAdvise - like Posix, the page cache is told to drop the data after
+  //!           it's been read or written
+  //! Direct  - O_DIRECT for the aligned chunks, bypassing the page cache
+  //! MMap    - the source file is mapped and the chunks point directly to
+  //!           the mapping, saving the copy of the data to the user space;
+  //!           the destination works as Auto
+  //----------------------------------------------------------------------------
+  enum LocalIOEngine
+  {
+    EnginePosix,
+    EngineAuto,
+    EngineFAdvise,
+    EngineDirect,
+    EngineMMap
+  };
+
+  //----------------------------------------------------------------------------
+  //! Alignment of the buffers, offsets and lengths of the direct I/O
+  //----------------------------------------------------------------------------
+  const uint32_t DirectIOAlignment = 4096;
+
+  //----------------------------------------------------------------------------
+  //! Get the engine configured in the environment
+  //----------------------------------------------------------------------------
+  LocalIOEngine GetLocalIOEngine()
+  {
+    using namespace XrdCl;
+    std::string engine = DefaultCPLocalIOEngine;
+    DefaultEnv::GetEnv()->GetString( "CPLocalIOEngine", engine );
+
+    if( engine == "posix" )   return EnginePosix;
+    if( engine == "auto" )    return EngineAuto;
+    if( engine == "fadvise" ) return EngineFAdvise;
+    if( engine == "direct" )  return EngineDirect;
+    if( engine == "mmap" )    return EngineMMap;
+
+    DefaultEnv::GetLog()->Warning( UtilityMsg, "Unknown local I/O engine: "
+                                   "%s, using auto", engine.c_str() );
+    return EngineAuto;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Check if the chunk may be transferred with direct I/O
+  //----------------------------------------------------------------------------
+  bool IsAligned( uint64_t offset, uint32_t length, const void *buffer )
+  {
+    return offset % DirectIOAlignment == 0 &&
+           length % DirectIOAlignment == 0 &&
+           (uintptr_t)buffer % DirectIOAlignment == 0;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Open the file for direct I/O, -1 if it's not supported
+  //----------------------------------------------------------------------------
+  int OpenDirect( const std::string &path, int flags )
+  {
+#ifdef O_DIRECT
+    int fd = open( path.c_str(), flags | O_DIRECT );
+    if( fd == -1 )
+      XrdCl::DefaultEnv::GetLog()->Debug( XrdCl::UtilityMsg, "Unable to open "
+        "%s for direct I/O: %s", path.c_str(), strerror( errno ) );
+    return fd;
+#else
+    (void)path; (void)flags;
+    return -1;
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  //! Give the page cache a hint about the file region
+  //----------------------------------------------------------------------------
+  void Advise( int fd, uint64_t offset, uint64_t length, int advice )
+  {
+#ifdef POSIX_FADV_DONTNEED
+    posix_fadvise( fd, offset, length, advice );
+#else
+    (void)fd; (void)offset; (void)length; (void)advice;
+#endif
+  }
+
+#ifndef POSIX_FADV_DONTNEED
+#define POSIX_FADV_SEQUENTIAL 0
+#define POSIX_FADV_DONTNEED   0
+#endif
+
+  //----------------------------------------------------------------------------
+  //! Granularity of the holes left in the sparse local files
+  //----------------------------------------------------------------------------
+  const uint32_t SparseBlockSize = 4096;
+
+  //----------------------------------------------------------------------------
+  //! Check if the buffer holds only zeros. The words are or'ed together
+  //! in blocks of eight so that the compiler can vectorize the loop, it
+  //! returns at the first block holding data.
+  //----------------------------------------------------------------------------
+  bool IsZero( const char *buffer, uint32_t length )
+  {
+    const char *end = buffer + length;
+    while( buffer < end && (uintptr_t)buffer % sizeof( uint64_t ) )
+      if( *buffer++ )
+        return false;
+
+    const uint64_t *words  = (const uint64_t*)buffer;
+    size_t          nWords = (end - buffer) / sizeof( uint64_t );
+    size_t          i      = 0;
+    for( ; i + 8 <= nWords; i += 8 )
+    {
+      uint64_t acc = 0;
+      for( size_t j = 0; j < 8; ++j )
+        acc |= words[i+j];
+      if( acc )
+        return false;
+    }
+    for( ; i < nWords; ++i )
+      if( words[i] )
+        return false;
+
+    buffer += nWords * sizeof( uint64_t );
+    while( buffer < end )
+      if( *buffer++ )
+        return false;
+    return true;
+  }
+
   //----------------------------------------------------------------------------
   //! Abstract chunk source
   //----------------------------------------------------------------------------
@@ -57,22 +204,49 @@ namespace
       virtual uint64_t GetSize() = 0;
 
       //------------------------------------------------------------------------
-      //! Get a data chunk from the source
+      //! Get the modification time
+      //------------------------------------------------------------------------
+      virtual uint64_t GetModTime() = 0;
+
+      //------------------------------------------------------------------------
+      //! Read a data chunk from the source
+      //!
+      //! @param  ci      chunk information, the data is read to the buffer
+      //!                 of the chunk
+      //! @param  handler handler to be notified when the chunk has been read,
+      //!                 the response is a ChunkInfo object, it may be called
+      //!                 before the method returns
+      //! @return         status of the operation, the handler is not called
+      //!                 if it is an error
+      //------------------------------------------------------------------------
+      virtual XrdCl::XRootDStatus ReadChunk( const XrdCl::ChunkInfo &ci,
+                                             XrdCl::ResponseHandler *handler ) = 0;
+
+      //------------------------------------------------------------------------
+      //! Get the buffer holding the data of the chunk if the source has one
+      //! already, the chunk should then be read to it
       //!
-      //! @param  buffer buffer for the data
-      //! @param  ci     chunk information
-      //! @return        status of the operation
-      //!                suContinue - there are some chunks left
-      //!                suDone     - no chunks left
+      //! @return the buffer or 0 if the chunk needs a buffer from the pool
       //------------------------------------------------------------------------
-      virtual XrdCl::XRootDStatus GetChunk( XrdCl::Buffer    &buffer,
-                                            XrdCl::ChunkInfo &ci ) = 0;
+      virtual char *GetBuffer( uint64_t offset, uint32_t length )
+      {
+        (void)offset; (void)length;
+        return 0;
+      }
 
       //------------------------------------------------------------------------
       //! Get check sum
       //------------------------------------------------------------------------
       virtual XrdCl::XRootDStatus GetCheckSum( std::string &checkSum,
                                                std::string &checkSumType ) = 0;
+
+      //------------------------------------------------------------------------
+      //! Get the number of servers the data is read from
+      //------------------------------------------------------------------------
+      virtual uint16_t GetNumberOfSources()
+      {
+        return 1;
+      }
   };
 
   //----------------------------------------------------------------------------
@@ -85,7 +259,8 @@ namespace
       //! Constructor
       //------------------------------------------------------------------------
       Destination():
-        pPosc( false ), pForce( false ) {}
+        pPosc( false ), pForce( false ), pSparse( false ), pResume( false ),
+        pWritten( 0 ), pSkipped( 0 ) {}
 
       //------------------------------------------------------------------------
       //! Destructor
@@ -100,12 +275,37 @@ namespace
       //------------------------------------------------------------------------
       //! Put a data chunk at a destination
       //!
-      //! @param  buffer buffer containing the chunk data
-      //! @param  ci     chunk information
-      //! @return status of the operation
+      //! @param  ci      chunk information, the buffer of the chunk holds
+      //!                 the data
+      //! @param  handler handler to be notified when the chunk has been
+      //!                 written, it may be called before the method returns
+      //! @return         status of the operation, the handler is not called
+      //!                 if it is an error
+      //------------------------------------------------------------------------
+      virtual XrdCl::XRootDStatus PutChunk( const XrdCl::ChunkInfo &ci,
+                                            XrdCl::ResponseHandler *handler ) = 0;
+
+      //------------------------------------------------------------------------
+      //! Tell whether the chunks may be put in any order, otherwise they
+      //! are put in the order of their offsets
+      //------------------------------------------------------------------------
+      virtual bool AcceptsOutOfOrder() const = 0;
+
+      //------------------------------------------------------------------------
+      //! Finish the file when all the chunks have been written
+      //!
+      //! @param size the size of the file
+      //------------------------------------------------------------------------
+      virtual XrdCl::XRootDStatus Finalize( uint64_t size )
+      {
+        (void)size;
+        return XrdCl::XRootDStatus();
+      }
+
       //------------------------------------------------------------------------
-      virtual XrdCl::XRootDStatus PutChunk( const XrdCl::Buffer    &buffer,
-                                            const XrdCl::ChunkInfo &ci ) = 0;
+      //! Make the chunks written so far durable
+      //------------------------------------------------------------------------
+      virtual XrdCl::XRootDStatus Sync() = 0;
 
       //------------------------------------------------------------------------
       //! Get check sum
@@ -129,9 +329,29 @@ namespace
         pForce = force;
       }
 
+      //------------------------------------------------------------------------
+      //! Skip the zeros so that the file gets holes instead
+      //------------------------------------------------------------------------
+      void SetSparse( bool sparse )
+      {
+        pSparse = sparse;
+      }
+
+      //------------------------------------------------------------------------
+      //! Keep the content of the existing file, the copy continues
+      //------------------------------------------------------------------------
+      void SetResume( bool resume )
+      {
+        pResume = resume;
+      }
+
     protected:
-      bool pPosc;
-      bool pForce;
+      bool     pPosc;
+      bool     pForce;
+      bool     pSparse;
+      bool     pResume;
+      uint64_t pWritten;
+      uint64_t pSkipped;
   };
 
   //----------------------------------------------------------------------------
@@ -143,14 +363,19 @@ namespace
       //------------------------------------------------------------------------
       //! Constructor
       //------------------------------------------------------------------------
-      LocalSource( const XrdCl::URL *url ):
-        pPath( url->GetPath() ), pFD( -1 ), pSize( 0 ), pCurrentOffset( 0 ) {}
+      LocalSource( const XrdCl::URL *url, LocalIOEngine engine ):
+        pPath( url->GetPath() ), pFD( -1 ), pDirectFD( -1 ), pMap( 0 ),
+        pSize( 0 ), pModTime( 0 ), pEngine( engine ) {}
 
       //------------------------------------------------------------------------
       //! Destructor
       //------------------------------------------------------------------------
       ~LocalSource()
       {
+        if( pMap )
+          munmap( pMap, pSize );
+        if( pDirectFD != -1 )
+          close( pDirectFD );
         if( pFD != -1 )
           close( pFD );
       }
@@ -184,8 +409,35 @@ namespace
           close( fd );
           return XRootDStatus( stError, errOSError, errno );
         }
-        pFD   = fd;
-        pSize = st.st_size;
+        pFD      = fd;
+        pSize    = st.st_size;
+        pModTime = st.st_mtime;
+
+        //----------------------------------------------------------------------
+        // Set up the I/O engine, fall back to the page cache hints if
+        // the file can't be mapped or opened for direct I/O
+        //----------------------------------------------------------------------
+        if( pEngine == EngineMMap && pSize && pSize == (size_t)pSize )
+        {
+          void *map = mmap( 0, pSize, PROT_READ, MAP_SHARED, pFD, 0 );
+          if( map != MAP_FAILED )
+          {
+            pMap = (char*)map;
+            madvise( pMap, pSize, MADV_SEQUENTIAL );
+          }
+          else
+            log->Debug( UtilityMsg, "Unable to map %s: %s", pPath.c_str(),
+                        strerror( errno ) );
+        }
+        else if( pEngine == EngineDirect )
+          pDirectFD = OpenDirect( pPath, O_RDONLY );
+
+        if( ( pEngine == EngineMMap && !pMap ) ||
+            ( pEngine == EngineDirect && pDirectFD == -1 ) )
+          pEngine = EngineFAdvise;
+
+        if( pEngine == EngineAuto || pEngine == EngineFAdvise )
+          Advise( pFD, 0, 0, POSIX_FADV_SEQUENTIAL );
 
         return XRootDStatus();
       }
@@ -199,10 +451,19 @@ namespace
       }
 
       //------------------------------------------------------------------------
-      //! Get a data chunk from the source
+      //! Get the modification time
+      //------------------------------------------------------------------------
+      virtual uint64_t GetModTime()
+      {
+        return pModTime;
+      }
+
+      //------------------------------------------------------------------------
+      //! Read a data chunk from the source - the handler is called before
+      //! returning
       //------------------------------------------------------------------------
-      virtual XrdCl::XRootDStatus GetChunk( XrdCl::Buffer    &buffer,
-                                            XrdCl::ChunkInfo &ci )
+      virtual XrdCl::XRootDStatus ReadChunk( const XrdCl::ChunkInfo &ci,
+                                             XrdCl::ResponseHandler *handler )
       {
         using namespace XrdCl;
         Log *log = DefaultEnv::GetLog();
@@ -210,28 +471,63 @@ namespace
         if( pFD == -1 )
           return XRootDStatus( stError, errUninitialized );
 
-        const uint32_t toRead = 2*1024*1024;
-        if( buffer.GetSize() != toRead )
-          buffer.ReAllocate( toRead );
+        //----------------------------------------------------------------------
+        // The data is in the mapping already
+        //----------------------------------------------------------------------
+        uint32_t  bytesRead = 0;
+        char     *buffer    = (char*)ci.buffer;
+        if( pMap )
+        {
+          if( ci.offset < pSize )
+            bytesRead = std::min( (uint64_t)ci.length, pSize - ci.offset );
+          if( buffer != pMap + ci.offset )
+            memcpy( buffer, pMap + ci.offset, bytesRead );
+        }
 
-        int64_t bytesRead = read( pFD, buffer.GetBuffer(), toRead );
-        if( bytesRead == -1 )
+        //----------------------------------------------------------------------
+        // Read the data, only the aligned chunks can go around the page
+        // cache and if there's a short read we finish with the buffered I/O
+        //----------------------------------------------------------------------
+        int fd = pFD;
+        if( pDirectFD != -1 && IsAligned( ci.offset, ci.length, buffer ) )
+          fd = pDirectFD;
+
+        while( !pMap && bytesRead < ci.length )
         {
-          log->Debug( UtilityMsg, "Unable read from %s: %s",
-                                  pPath.c_str(), strerror( errno ) );
-          close( pFD );
-          pFD = -1;
-          return XRootDStatus( stError, errOSError, errno );
+          int64_t rd = pread( fd, buffer+bytesRead, ci.length-bytesRead,
+                              ci.offset+bytesRead );
+          if( rd == -1 )
+          {
+            if( errno == EINTR )
+              continue;
+            log->Debug( UtilityMsg, "Unable read from %s: %s",
+                                    pPath.c_str(), strerror( errno ) );
+            return XRootDStatus( stError, errOSError, errno );
+          }
+
+          if( rd == 0 )
+            break;
+          bytesRead += rd;
+          fd         = pFD;
         }
 
-        if( bytesRead == 0 )
-          return XRootDStatus( stOK, suDone );
+        if( pEngine == EngineFAdvise )
+          Advise( pFD, ci.offset, bytesRead, POSIX_FADV_DONTNEED );
 
-        ci.offset = pCurrentOffset;
-        ci.length = bytesRead;
-        pCurrentOffset += bytesRead;
+        AnyObject *obj = new AnyObject();
+        obj->Set( new ChunkInfo( ci.offset, bytesRead, ci.buffer ) );
+        handler->HandleResponse( new XRootDStatus(), obj );
+        return XRootDStatus();
+      }
 
-        return XRootDStatus( stOK, suContinue );
+      //------------------------------------------------------------------------
+      //! The chunks of a mapped file are read in place
+      //------------------------------------------------------------------------
+      virtual char *GetBuffer( uint64_t offset, uint32_t length )
+      {
+        if( !pMap || offset + length > pSize )
+          return 0;
+        return pMap + offset;
       }
 
       //------------------------------------------------------------------------
@@ -245,10 +541,13 @@ namespace
 
 
     private:
-      std::string pPath;
-      int         pFD;
-      uint64_t    pSize;
-      uint64_t    pCurrentOffset;
+      std::string    pPath;
+      int            pFD;
+      int            pDirectFD;
+      char          *pMap;
+      uint64_t       pSize;
+      uint64_t       pModTime;
+      LocalIOEngine  pEngine;
   };
 
   //----------------------------------------------------------------------------
@@ -261,7 +560,7 @@ namespace
       //! Constructor
       //------------------------------------------------------------------------
       XRootDSource( const XrdCl::URL *url ):
-        pUrl( url ), pFile( new XrdCl::File() ), pSize( 0 ), pCurrentOffset( 0 )
+        pUrl( url ), pFile( new XrdCl::File() ), pSize( 0 ), pModTime( 0 )
       {
       }
 
@@ -293,7 +592,8 @@ namespace
         if( !st.IsOK() )
           return st;
 
-        pSize = statInfo->GetSize();
+        pSize    = statInfo->GetSize();
+        pModTime = statInfo->GetModTime();
         delete statInfo;
 
         return XRootDStatus();
@@ -308,16 +608,18 @@ namespace
       }
 
       //------------------------------------------------------------------------
-      //! Get a data chunk from the source
-      //!
-      //! @param  buffer buffer for the data
-      //! @param  ci     chunk information
-      //! @return        status of the operation
-      //!                suContinue - there are some chunks left
-      //!                suDone     - no chunks left
+      //! Get the modification time
+      //------------------------------------------------------------------------
+      virtual uint64_t GetModTime()
+      {
+        return pModTime;
+      }
+
+      //------------------------------------------------------------------------
+      //! Read a data chunk from the source
       //------------------------------------------------------------------------
-      virtual XrdCl::XRootDStatus GetChunk( XrdCl::Buffer    &buffer,
-                                            XrdCl::ChunkInfo &ci )
+      virtual XrdCl::XRootDStatus ReadChunk( const XrdCl::ChunkInfo &ci,
+                                             XrdCl::ResponseHandler *handler )
       {
         using namespace XrdCl;
         Log *log = DefaultEnv::GetLog();
@@ -325,29 +627,12 @@ namespace
         if( !pFile->IsOpen() )
           return XRootDStatus( stError, errUninitialized );
 
-        if( pCurrentOffset == pSize )
-          return XRootDStatus( stOK, suDone );
-
-        const uint32_t toRead = 2*1024*1024;
-        if( buffer.GetSize() != toRead )
-          buffer.ReAllocate( toRead );
-
-        uint32_t bytesRead;
-        XRootDStatus st = pFile->Read( pCurrentOffset,     toRead,
-                                       buffer.GetBuffer(), bytesRead );
+        XRootDStatus st = pFile->Read( ci.offset, ci.length, ci.buffer,
+                                       handler );
         if( !st.IsOK() )
-        {
           log->Debug( UtilityMsg, "Unable read from %s: %s",
                                   pUrl->GetURL().c_str(), st.ToStr().c_str() );
-          pFile->Close();
-          return st;
-        }
-
-        ci.offset = pCurrentOffset;
-        ci.length = bytesRead;
-        pCurrentOffset += bytesRead;
-
-        return XRootDStatus( stOK, suContinue );
+        return st;
       }
 
       //------------------------------------------------------------------------
@@ -365,34 +650,247 @@ namespace
       const XrdCl::URL *pUrl;
       XrdCl::File      *pFile;
       uint64_t          pSize;
-      uint64_t          pCurrentOffset;
+      uint64_t          pModTime;
   };
 
   //----------------------------------------------------------------------------
-  //! Local destination
+  //! XRootD source reading the chunks from many replicas of the file at
+  //! the same time. Nothing is assigned up front: every chunk goes to
+  //! the replica with the fewest reads outstanding, so the fast servers
+  //! end up serving more of the file than the slow ones. A replica failing
+  //! a read is dropped and the chunk is read from another one. A chunk
+  //! held by a replica for longer than CPStallTimeout is read once more
+  //! from an idle replica and the first copy to arrive is used, so each
+  //! attempt reads to a buffer of its own.
   //----------------------------------------------------------------------------
-  class LocalDestination: public Destination
+  class XRootDMultiSource: public Source
   {
+    private:
+      //------------------------------------------------------------------------
+      //! Replica of the file
+      //------------------------------------------------------------------------
+      struct Replica
+      {
+        Replica( const XrdCl::URL &u ):
+          url( u ), file( new XrdCl::File() ), outstanding( 0 ),
+          attempts( 0 ), failed( false ) {}
+        XrdCl::URL   url;
+        XrdCl::File *file;
+        uint32_t     outstanding;
+        uint32_t     attempts;
+        bool         failed;
+      };
+
+      //------------------------------------------------------------------------
+      //! Chunk being read, possibly from two replicas at the same time. It
+      //! lives until both of the attempts have come back, the source waits
+      //! for the one coming back last before closing the replicas.
+      //------------------------------------------------------------------------
+      struct PendingRead
+      {
+        PendingRead( const XrdCl::ChunkInfo &c, XrdCl::ResponseHandler *h ):
+          chunk( c ), handler( h ), inFlight( 0 ), reissued( false ),
+          done( false ), refCount( 1 )
+        {
+          buffers[0] = buffers[1] = 0;
+          replicas[0] = replicas[1] = 0;
+          active[0] = active[1] = false;
+        }
+
+        ~PendingRead()
+        {
+          delete [] buffers[0];
+          delete [] buffers[1];
+        }
+
+        void Ref()
+        {
+          XrdSysMutexHelper scopedLock( mutex );
+          ++refCount;
+        }
+
+        void UnRef()
+        {
+          mutex.Lock();
+          bool last = !--refCount;
+          mutex.UnLock();
+          if( last )
+            delete this;
+        }
+
+        XrdCl::ChunkInfo        chunk;
+        XrdCl::ResponseHandler *handler;
+        char                   *buffers[2];
+        Replica                *replicas[2];
+        bool                    active[2];
+        uint32_t                inFlight;
+        timeval                 sent;
+        bool                    reissued;
+        bool                    done;
+        uint32_t                refCount;
+        XrdSysMutex             mutex;
+      };
+
+      //------------------------------------------------------------------------
+      //! Hand the first response to the job's handler or retry the read at
+      //! another replica
+      //------------------------------------------------------------------------
+      class ReplicaReadHandler: public XrdCl::ResponseHandler
+      {
+        public:
+          ReplicaReadHandler( XRootDMultiSource *source,
+                              PendingRead       *read,
+                              int                slot ):
+            pSource( source ), pRead( read ), pSlot( slot ) {}
+
+          virtual void HandleResponse( XrdCl::XRootDStatus *status,
+                                       XrdCl::AnyObject    *response )
+          {
+            using namespace XrdCl;
+            Replica *replica = pRead->replicas[pSlot];
+            bool     ok      = status->IsOK();
+            if( ok )
+            {
+              ChunkInfo *chunk = 0;
+              if( response )
+                response->Get( chunk );
+              ok = chunk && chunk->length == pRead->chunk.length;
+            }
+
+            //------------------------------------------------------------------
+            // The other attempt has already been handed to the job
+            //------------------------------------------------------------------
+            pRead->mutex.Lock();
+            --pRead->inFlight;
+            bool late  = pRead->done;
+            bool other = pRead->inFlight;
+            if( !late )
+              pRead->active[pSlot] = false;
+            if( ok )
+              pRead->done = true;
+            pRead->mutex.UnLock();
+
+            if( late )
+            {
+              delete status;
+              delete response;
+              pSource->AttemptDone( replica );
+              pRead->UnRef();
+              delete this;
+              return;
+            }
+
+            bool last = pSource->ReadDone( replica, ok, *status );
+            if( ok )
+            {
+              memcpy( pRead->chunk.buffer, pRead->buffers[pSlot],
+                      pRead->chunk.length );
+              delete response;
+              response = new AnyObject();
+              response->Set( new ChunkInfo( pRead->chunk ) );
+              pSource->Finish( pRead );
+              pRead->handler->HandleResponse( status, response );
+            }
+            else if( other ||
+                     ( !last && pSource->Send( pRead, pSlot ).IsOK() ) )
+            {
+              delete status;
+              delete response;
+            }
+            else
+            {
+              pRead->mutex.Lock();
+              pRead->done = true;
+              pRead->mutex.UnLock();
+              pSource->Finish( pRead );
+              pRead->handler->HandleResponse( status, response );
+            }
+            pSource->AttemptDone( replica );
+            pRead->UnRef();
+            delete this;
+          }
+
+        private:
+          XRootDMultiSource *pSource;
+          PendingRead       *pRead;
+          int                pSlot;
+      };
+
+      //------------------------------------------------------------------------
+      //! Look for the stalled reads periodically, the source may go away
+      //! before the task manager gets rid of the task
+      //------------------------------------------------------------------------
+      class StallTask: public XrdCl::Task
+      {
+        public:
+          StallTask( XRootDMultiSource *source ): pSource( source )
+          {
+            SetName( "XRootDMultiSource stall detector" );
+          }
+
+          virtual time_t Run( time_t now )
+          {
+            XrdSysMutexHelper scopedLock( pMutex );
+            if( !pSource )
+              return 0;
+            pSource->ReissueStalled();
+            return now+1;
+          }
+
+          void Detach()
+          {
+            XrdSysMutexHelper scopedLock( pMutex );
+            pSource = 0;
+          }
+
+        private:
+          XRootDMultiSource *pSource;
+          XrdSysMutex        pMutex;
+      };
+
     public:
       //------------------------------------------------------------------------
       //! Constructor
       //------------------------------------------------------------------------
-      LocalDestination( const XrdCl::URL *url ):
-        pPath( url->GetPath() ), pFD( -1 )
+      XRootDMultiSource( const XrdCl::URL *url, uint16_t sourceLimit ):
+        pUrl( url ), pSourceLimit( sourceLimit ), pSize( 0 ), pModTime( 0 ),
+        pStallTimeout( 0 ), pStallTask( 0 )
       {
       }
 
       //------------------------------------------------------------------------
       //! Destructor
       //------------------------------------------------------------------------
-      virtual ~LocalDestination()
+      virtual ~XRootDMultiSource()
       {
-        if( pFD != -1 )
-          close( pFD );
+        using namespace XrdCl;
+        if( pStallTask )
+          pStallTask->Detach();
+
+        //----------------------------------------------------------------------
+        // The attempts that lost the race still hold their files
+        //----------------------------------------------------------------------
+        pAttemptCond.Lock();
+        for( size_t i = 0; i < pReplicas.size(); ++i )
+          while( pReplicas[i]->attempts )
+            pAttemptCond.Wait();
+        pAttemptCond.UnLock();
+
+        Log *log = DefaultEnv::GetLog();
+        for( size_t i = 0; i < pReplicas.size(); ++i )
+        {
+          XRootDStatus st = pReplicas[i]->file->Close();
+          if( !st.IsOK() )
+            log->Warning( UtilityMsg, "Unable to close %s: %s",
+                          pReplicas[i]->url.GetURL().c_str(),
+                          st.ToStr().c_str() );
+          delete pReplicas[i]->file;
+          delete pReplicas[i];
+        }
       }
 
       //------------------------------------------------------------------------
-      //! Initialize the source
+      //! Initialize the source - locate the replicas and open them
       //------------------------------------------------------------------------
       virtual XrdCl::XRootDStatus Initialize()
       {
@@ -400,54 +898,105 @@ namespace
         Log *log = DefaultEnv::GetLog();
 
         //----------------------------------------------------------------------
-        // Open the file for reading and get it's size
+        // Find the servers holding the file
         //----------------------------------------------------------------------
-        log->Debug( UtilityMsg, "Openning %s for writing", pPath.c_str() );
+        std::vector<URL> urls;
+        FileSystem       fs( *pUrl );
+        LocationInfo    *locations = 0;
+        XRootDStatus     st = fs.DeepLocate( pUrl->GetPath(), OpenFlags::None,
+                                             locations );
+        if( st.IsOK() )
+        {
+          LocationInfo::Iterator it;
+          for( it = locations->Begin(); it != locations->End(); ++it )
+          {
+            if( it->GetType() != LocationInfo::ServerOnline ||
+                urls.size() >= pSourceLimit )
+              continue;
+            URL server( it->GetAddress() );
+            URL replica( *pUrl );
+            replica.SetHostName( server.GetHostName() );
+            replica.SetPort( server.GetPort() );
+            urls.push_back( replica );
+          }
+          delete locations;
+        }
+        else
+          log->Debug( UtilityMsg, "Unable to locate the replicas of %s: %s",
+                      pUrl->GetURL().c_str(), st.ToStr().c_str() );
 
-        int flags = O_WRONLY|O_CREAT|O_TRUNC;
-        if( !pForce )
-          flags |= O_EXCL;
+        //----------------------------------------------------------------------
+        // Open the replicas, the ones that differ from the first one in
+        // size are not used
+        //----------------------------------------------------------------------
+        XRootDStatus error;
+        for( size_t i = 0; i < urls.size(); ++i )
+        {
+          st = AddReplica( urls[i] );
+          if( !st.IsOK() && error.IsOK() )
+            error = st;
+        }
 
-        int fd = open( pPath.c_str(), flags, 0644 );
-        if( fd == -1 )
+        if( pReplicas.empty() )
         {
-          log->Debug( UtilityMsg, "Unable to open %s: %s",
-                                  pPath.c_str(), strerror( errno ) );
-          return XRootDStatus( stError, errOSError, errno );
+          st = AddReplica( *pUrl );
+          if( !st.IsOK() )
+            return error.IsOK() ? st : error;
         }
 
-        pFD   = fd;
+        log->Debug( UtilityMsg, "Reading %s from %d sources",
+                    pUrl->GetURL().c_str(), pReplicas.size() );
+
+        //----------------------------------------------------------------------
+        // Watch for the stalled reads if there is somewhere else to go
+        //----------------------------------------------------------------------
+        int stallTimeout = DefaultCPStallTimeout;
+        DefaultEnv::GetEnv()->GetInt( "CPStallTimeout", stallTimeout );
+        if( pReplicas.size() > 1 && stallTimeout > 0 )
+        {
+          pStallTimeout = stallTimeout;
+          pStallTask    = new StallTask( this );
+          TaskManager *taskMgr = DefaultEnv::GetPostMaster()->GetTaskManager();
+          taskMgr->RegisterTask( pStallTask, time(0)+1 );
+        }
         return XRootDStatus();
       }
 
       //------------------------------------------------------------------------
-      //! Put a data chunk at a destination
-      //!
-      //! @param  buffer buffer containing the chunk data
-      //! @param  ci     chunk information
-      //! @return status of the operation
+      //! Get size
       //------------------------------------------------------------------------
-      virtual XrdCl::XRootDStatus PutChunk( const XrdCl::Buffer    &buffer,
-                                            const XrdCl::ChunkInfo &ci )
+      virtual uint64_t GetSize()
       {
-        using namespace XrdCl;
-        Log *log = DefaultEnv::GetLog();
+        return pSize;
+      }
 
-        if( pFD == -1 )
-          return XRootDStatus( stError, errUninitialized );
+      //------------------------------------------------------------------------
+      //! Get the modification time
+      //------------------------------------------------------------------------
+      virtual uint64_t GetModTime()
+      {
+        return pModTime;
+      }
+
+      //------------------------------------------------------------------------
+      //! Read a data chunk from the least busy replica
+      //------------------------------------------------------------------------
+      virtual XrdCl::XRootDStatus ReadChunk( const XrdCl::ChunkInfo &ci,
+                                             XrdCl::ResponseHandler *handler )
+      {
+        PendingRead *read = new PendingRead( ci, handler );
+        pMutex.Lock();
+        pReads.insert( read );
+        pMutex.UnLock();
 
-        int64_t wr = pwrite( pFD, buffer.GetBuffer(), ci.length, ci.offset );
-        if( wr == -1 || wr != ci.length )
+        XrdCl::XRootDStatus st = Send( read, 0 );
+        if( !st.IsOK() )
         {
-          log->Debug( UtilityMsg, "Unable write to %s: %s",
-                                  pPath.c_str(), strerror( errno ) );
-          close( pFD );
-          pFD = -1;
-          if( pPosc )
-            unlink( pPath.c_str() );
-          return XRootDStatus( stError, errOSError, errno );
+          XrdSysMutexHelper scopedLock( pMutex );
+          pReads.erase( read );
         }
-        return XRootDStatus();
+        read->UnRef();
+        return st;
       }
 
       //------------------------------------------------------------------------
@@ -456,90 +1005,1368 @@ namespace
       virtual XrdCl::XRootDStatus GetCheckSum( std::string &checkSum,
                                                std::string &checkSumType )
       {
-        return XrdCl::Utils::GetLocalCheckSum( checkSum, checkSumType, pPath );
+        using namespace XrdCl;
+        Replica *replica = 0;
+        {
+          XrdSysMutexHelper scopedLock( pMutex );
+          for( size_t i = 0; i < pReplicas.size() && !replica; ++i )
+            if( !pReplicas[i]->failed )
+              replica = pReplicas[i];
+        }
+        if( !replica )
+          return XRootDStatus( stError, errUninitialized );
+        return Utils::GetRemoteCheckSum( checkSum, checkSumType,
+                                         replica->file->GetDataServer(),
+                                         replica->url.GetPath() );
       }
 
-    private:
-      std::string pPath;
-      int         pFD;
-  };
-
-  //----------------------------------------------------------------------------
-  //! XRootD destination
-  //----------------------------------------------------------------------------
-  class XRootDDestination: public Destination
-  {
-    public:
       //------------------------------------------------------------------------
-      //! Constructor
+      //! Get the number of replicas being read
       //------------------------------------------------------------------------
-      XRootDDestination( const XrdCl::URL *url ):
-        pUrl( url ), pFile( new XrdCl::File() )
+      virtual uint16_t GetNumberOfSources()
       {
+        return pReplicas.size();
       }
 
       //------------------------------------------------------------------------
-      //! Destructor
+      //! Send the read to the replica with the fewest reads outstanding
+      //!
+      //! @param read the chunk
+      //! @param slot the attempt, 0 for the original read and 1 for
+      //!             the one sent when the original stalls
       //------------------------------------------------------------------------
-      virtual ~XRootDDestination()
+      XrdCl::XRootDStatus Send( PendingRead *read, int slot )
       {
-        delete pFile;
+        using namespace XrdCl;
+        XRootDStatus st( stError, errUninitialized );
+        while( 1 )
+        {
+          Replica *replica = 0;
+          pMutex.Lock();
+          for( size_t i = 0; i < pReplicas.size(); ++i )
+          {
+            if( pReplicas[i]->failed )
+              continue;
+            if( !replica || pReplicas[i]->outstanding < replica->outstanding )
+              replica = pReplicas[i];
+          }
+          if( replica )
+            ++replica->outstanding;
+          pMutex.UnLock();
+
+          if( !replica )
+            return st;
+
+          st = SendTo( read, slot, replica );
+          if( st.IsOK() )
+            return st;
+          ReadDone( replica, false, st );
+        }
       }
 
       //------------------------------------------------------------------------
-      //! Initialize the source
+      //! Account for a read that has finished
+      //!
+      //! @return true if the outcome should be handed to the job, false
+      //!         if the read should be retried at another replica
       //------------------------------------------------------------------------
-      virtual XrdCl::XRootDStatus Initialize()
+      bool ReadDone( Replica *replica, bool ok, const XrdCl::XRootDStatus &st )
       {
         using namespace XrdCl;
-        Log *log = DefaultEnv::GetLog();
-        log->Debug( UtilityMsg, "Opening %s for writing",
-                                pUrl->GetURL().c_str() );
+        XrdSysMutexHelper scopedLock( pMutex );
+        --replica->outstanding;
+        if( ok )
+          return true;
 
-        uint16_t flags = OpenFlags::Update;
-        if( pForce )
-          flags |= OpenFlags::Delete;
-        else
-          flags |= OpenFlags::New;
-
-        if( pPosc )
-          flags |= OpenFlags::POSC;
+        if( !replica->failed )
+        {
+          DefaultEnv::GetLog()->Warning( UtilityMsg, "Dropping the source %s: "
+                                         "%s", replica->url.GetURL().c_str(),
+                                         st.ToStr().c_str() );
+          replica->failed = true;
+        }
 
-        return pFile->Open( pUrl->GetURL(), flags, Access::UR|Access::UW);
+        for( size_t i = 0; i < pReplicas.size(); ++i )
+          if( !pReplicas[i]->failed )
+            return false;
+        return true;
       }
 
       //------------------------------------------------------------------------
-      //! Put a data chunk at a destination
-      //!
-      //! @param  buffer buffer containing the chunk data
-      //! @param  ci     chunk information
-      //! @return status of the operation
+      //! An attempt has come back from the replica, nothing of the source
+      //! may be touched afterwards since it may be gone already
       //------------------------------------------------------------------------
-      virtual XrdCl::XRootDStatus PutChunk( const XrdCl::Buffer    &buffer,
-                                            const XrdCl::ChunkInfo &ci )
+      void AttemptDone( Replica *replica )
       {
-        using namespace XrdCl;
-        if( !pFile->IsOpen() )
-          return XRootDStatus( stError, errUninitialized );
-
-        return pFile->Write( ci.offset, ci.length, buffer.GetBuffer() );
+        XrdSysCondVarHelper scopedLock( pAttemptCond );
+        --replica->attempts;
+        pAttemptCond.Broadcast();
       }
 
       //------------------------------------------------------------------------
-      //! Get check sum
+      //! Forget about a chunk that is about to be handed to the job, the
+      //! attempt still in the fly is not counted against its replica
+      //! anymore
       //------------------------------------------------------------------------
-      virtual XrdCl::XRootDStatus GetCheckSum( std::string &checkSum,
-                                               std::string &checkSumType )
+      void Finish( PendingRead *read )
       {
-        return XrdCl::Utils::GetRemoteCheckSum( checkSum, checkSumType,
-                                                pFile->GetDataServer(),
-                                                pUrl->GetPath() );
+        XrdSysMutexHelper scopedLock( pMutex );
+        pReads.erase( read );
+        XrdSysMutexHelper readLock( read->mutex );
+        for( int i = 0; i < 2; ++i )
+        {
+          if( !read->active[i] )
+            continue;
+          --read->replicas[i]->outstanding;
+          read->active[i] = false;
+        }
       }
 
-    private:
-      const XrdCl::URL *pUrl;
-      XrdCl::File      *pFile;
-  };
+      //------------------------------------------------------------------------
+      //! Read the chunks that have been outstanding for too long once more
+      //! from the idle replicas
+      //------------------------------------------------------------------------
+      void ReissueStalled()
+      {
+        using namespace XrdCl;
+        timeval now;
+        gettimeofday( &now, 0 );
+
+        std::vector<std::pair<PendingRead*, Replica*> > stalled;
+        pMutex.Lock();
+        std::set<PendingRead*>::iterator it;
+        for( it = pReads.begin(); it != pReads.end(); ++it )
+        {
+          PendingRead *read = *it;
+          XrdSysMutexHelper readLock( read->mutex );
+          if( read->done || read->reissued || read->inFlight != 1 ||
+              Utils::GetElapsedMicroSecs( read->sent, now ) <
+                pStallTimeout*1000000 )
+            continue;
+
+          Replica *idle = 0;
+          for( size_t i = 0; i < pReplicas.size() && !idle; ++i )
+            if( !pReplicas[i]->failed && !pReplicas[i]->outstanding &&
+                pReplicas[i] != read->replicas[0] )
+              idle = pReplicas[i];
+          if( !idle )
+            continue;
+
+          read->reissued = true;
+          ++read->refCount;
+          ++idle->outstanding;
+          stalled.push_back( std::make_pair( read, idle ) );
+        }
+        pMutex.UnLock();
+
+        Log *log = DefaultEnv::GetLog();
+        for( size_t i = 0; i < stalled.size(); ++i )
+        {
+          PendingRead *read    = stalled[i].first;
+          Replica     *replica = stalled[i].second;
+          log->Debug( UtilityMsg, "Reading the chunk at %lld of %s from %s, "
+                      "%s has been holding it for too long",
+                      (long long)read->chunk.offset, pUrl->GetURL().c_str(),
+                      replica->url.GetHostId().c_str(),
+                      read->replicas[0]->url.GetHostId().c_str() );
+          XRootDStatus st = SendTo( read, 1, replica );
+          if( !st.IsOK() )
+            ReadDone( replica, false, st );
+          read->UnRef();
+        }
+      }
+
+    private:
+      //------------------------------------------------------------------------
+      // Open a replica
+      //------------------------------------------------------------------------
+      XrdCl::XRootDStatus AddReplica( const XrdCl::URL &url )
+      {
+        using namespace XrdCl;
+        Log *log = DefaultEnv::GetLog();
+        log->Debug( UtilityMsg, "Opening %s for reading",
+                                url.GetURL().c_str() );
+
+        std::auto_ptr<Replica> replica( new Replica( url ) );
+        XRootDStatus st = replica->file->Open( url.GetURL(), OpenFlags::Read,
+                                               0 );
+        StatInfo *statInfo = 0;
+        if( st.IsOK() )
+          st = replica->file->Stat( false, statInfo );
+
+        if( !st.IsOK() )
+        {
+          log->Debug( UtilityMsg, "Unable to open %s: %s",
+                      url.GetURL().c_str(), st.ToStr().c_str() );
+          delete replica->file;
+          return st;
+        }
+
+        uint64_t size    = statInfo->GetSize();
+        uint64_t modTime = statInfo->GetModTime();
+        delete statInfo;
+        if( !pReplicas.empty() && size != pSize )
+        {
+          log->Warning( UtilityMsg, "The size of %s differs from the one of "
+                        "the other replicas, not using it",
+                        url.GetURL().c_str() );
+          replica->file->Close();
+          delete replica->file;
+          return XRootDStatus( stError, errDataError );
+        }
+
+        if( pReplicas.empty() )
+          pModTime = modTime;
+        pSize = size;
+        pReplicas.push_back( replica.release() );
+        return XRootDStatus();
+      }
+
+      //------------------------------------------------------------------------
+      // Send an attempt to read the chunk to the given replica, its
+      // outstanding reads already count the attempt
+      //------------------------------------------------------------------------
+      XrdCl::XRootDStatus SendTo( PendingRead *read, int slot,
+                                  Replica *replica )
+      {
+        using namespace XrdCl;
+        read->mutex.Lock();
+        if( read->done )
+        {
+          read->mutex.UnLock();
+          XrdSysMutexHelper scopedLock( pMutex );
+          --replica->outstanding;
+          return XRootDStatus();
+        }
+        if( !read->buffers[slot] )
+          read->buffers[slot] = new char[read->chunk.length];
+        read->replicas[slot] = replica;
+        read->active[slot]   = true;
+        ++read->inFlight;
+        ++read->refCount;
+        if( slot == 0 )
+          gettimeofday( &read->sent, 0 );
+        read->mutex.UnLock();
+
+        pAttemptCond.Lock();
+        ++replica->attempts;
+        pAttemptCond.UnLock();
+
+        ReplicaReadHandler *h = new ReplicaReadHandler( this, read, slot );
+        XRootDStatus st = replica->file->Read( read->chunk.offset,
+                                               read->chunk.length,
+                                               read->buffers[slot], h );
+        if( st.IsOK() )
+          return st;
+
+        delete h;
+        AttemptDone( replica );
+        read->mutex.Lock();
+        --read->inFlight;
+        --read->refCount;
+        read->active[slot] = false;
+        read->mutex.UnLock();
+        return st;
+      }
+
+      const XrdCl::URL       *pUrl;
+      uint16_t                pSourceLimit;
+      uint64_t                pSize;
+      uint64_t                pModTime;
+      uint64_t                pStallTimeout;
+      StallTask              *pStallTask;
+      std::vector<Replica*>   pReplicas;
+      std::set<PendingRead*>  pReads;
+      XrdSysMutex             pMutex;
+      XrdSysCondVar           pAttemptCond;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Local destination
+  //----------------------------------------------------------------------------
+  class LocalDestination: public Destination
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Constructor
+      //------------------------------------------------------------------------
+      LocalDestination( const XrdCl::URL *url, LocalIOEngine engine ):
+        pPath( url->GetPath() ), pFD( -1 ), pDirectFD( -1 ), pEngine( engine )
+      {
+        if( pEngine == EngineMMap )
+          pEngine = EngineAuto;
+      }
+
+      //------------------------------------------------------------------------
+      //! Destructor
+      //------------------------------------------------------------------------
+      virtual ~LocalDestination()
+      {
+        if( pDirectFD != -1 )
+          close( pDirectFD );
+        if( pFD != -1 )
+          close( pFD );
+      }
+
+      //------------------------------------------------------------------------
+      //! Initialize the source
+      //------------------------------------------------------------------------
+      virtual XrdCl::XRootDStatus Initialize()
+      {
+        using namespace XrdCl;
+        Log *log = DefaultEnv::GetLog();
+
+        //----------------------------------------------------------------------
+        // Open the file for reading and get it's size
+        //----------------------------------------------------------------------
+        log->Debug( UtilityMsg, "Openning %s for writing", pPath.c_str() );
+
+        int flags = O_WRONLY|O_CREAT;
+        if( !pResume )
+          flags |= pForce ? O_TRUNC : O_EXCL;
+
+        int fd = open( pPath.c_str(), flags, 0644 );
+        if( fd == -1 )
+        {
+          log->Debug( UtilityMsg, "Unable to open %s: %s",
+                                  pPath.c_str(), strerror( errno ) );
+          return XRootDStatus( stError, errOSError, errno );
+        }
+
+        pFD   = fd;
+
+        if( pEngine == EngineDirect )
+        {
+          pDirectFD = OpenDirect( pPath, O_WRONLY );
+          if( pDirectFD == -1 )
+            pEngine = EngineFAdvise;
+        }
+        return XRootDStatus();
+      }
+
+      //------------------------------------------------------------------------
+      //! Put a data chunk at a destination - the handler is called before
+      //! returning
+      //------------------------------------------------------------------------
+      virtual XrdCl::XRootDStatus PutChunk( const XrdCl::ChunkInfo &ci,
+                                            XrdCl::ResponseHandler *handler )
+      {
+        using namespace XrdCl;
+        if( pFD == -1 )
+          return XRootDStatus( stError, errUninitialized );
+
+        const char *buffer = (const char*)ci.buffer;
+        if( !pSparse )
+        {
+          XRootDStatus st = WriteRegion( buffer, ci.offset, ci.length );
+          if( !st.IsOK() )
+            return st;
+          handler->HandleResponse( new XRootDStatus(), 0 );
+          return XRootDStatus();
+        }
+
+        //----------------------------------------------------------------------
+        // Write the runs of the blocks holding data and skip the zero ones,
+        // the file has been truncated so the skipped blocks read as zeros
+        //----------------------------------------------------------------------
+        uint32_t pos = 0;
+        while( pos < ci.length )
+        {
+          uint32_t start = pos;
+          uint32_t block = 0;
+          for( ; pos < ci.length; pos += block )
+          {
+            block = BlockLength( ci.offset + pos, ci.length - pos );
+            if( IsZero( buffer + pos, block ) )
+              break;
+          }
+
+          if( pos > start )
+          {
+            XRootDStatus st = WriteRegion( buffer + start, ci.offset + start,
+                                           pos - start );
+            if( !st.IsOK() )
+              return st;
+          }
+
+          for( ; pos < ci.length; pos += block )
+          {
+            block = BlockLength( ci.offset + pos, ci.length - pos );
+            if( !IsZero( buffer + pos, block ) )
+              break;
+            pSkipped += block;
+          }
+        }
+
+        handler->HandleResponse( new XRootDStatus(), 0 );
+        return XRootDStatus();
+      }
+
+      //------------------------------------------------------------------------
+      //! Extend the file over the trailing hole
+      //------------------------------------------------------------------------
+      virtual XrdCl::XRootDStatus Finalize( uint64_t size )
+      {
+        using namespace XrdCl;
+        if( pFD == -1 )
+          return XRootDStatus( stError, errUninitialized );
+
+        if( pSkipped )
+          DefaultEnv::GetLog()->Debug( UtilityMsg, "Skipped %llu zero bytes "
+                                       "of %s", (unsigned long long)pSkipped,
+                                       pPath.c_str() );
+
+        if( pWritten >= size )
+          return XRootDStatus();
+
+        if( ftruncate( pFD, size ) == -1 )
+        {
+          DefaultEnv::GetLog()->Debug( UtilityMsg, "Unable to truncate %s: "
+                                       "%s", pPath.c_str(), strerror( errno ) );
+          return XRootDStatus( stError, errOSError, errno );
+        }
+        return XRootDStatus();
+      }
+
+      //------------------------------------------------------------------------
+      //! Flush the written data to the disk, the direct writes go to the
+      //! same file
+      //------------------------------------------------------------------------
+      virtual XrdCl::XRootDStatus Sync()
+      {
+        using namespace XrdCl;
+        if( pFD == -1 )
+          return XRootDStatus( stError, errUninitialized );
+
+        if( fsync( pFD ) == -1 )
+        {
+          DefaultEnv::GetLog()->Debug( UtilityMsg, "Unable to sync %s: %s",
+                                       pPath.c_str(), strerror( errno ) );
+          return XRootDStatus( stError, errOSError, errno );
+        }
+        return XRootDStatus();
+      }
+
+      //------------------------------------------------------------------------
+      //! Local files may be written at any offset
+      //------------------------------------------------------------------------
+      virtual bool AcceptsOutOfOrder() const
+      {
+        return true;
+      }
+
+      //------------------------------------------------------------------------
+      //! Get check sum
+      //------------------------------------------------------------------------
+      virtual XrdCl::XRootDStatus GetCheckSum( std::string &checkSum,
+                                               std::string &checkSumType )
+      {
+        return XrdCl::Utils::GetLocalCheckSum( checkSum, checkSumType, pPath );
+      }
+
+    private:
+      //------------------------------------------------------------------------
+      // Length of the part of the block at the given offset, up to the
+      // end of the chunk
+      //------------------------------------------------------------------------
+      static uint32_t BlockLength( uint64_t offset, uint32_t left )
+      {
+        return std::min( SparseBlockSize - (uint32_t)(offset % SparseBlockSize),
+                         left );
+      }
+
+      //------------------------------------------------------------------------
+      // Write the region of the chunk, closes the file on failure
+      //------------------------------------------------------------------------
+      XrdCl::XRootDStatus WriteRegion( const char *buffer, uint64_t offset,
+                                       uint32_t length )
+      {
+        using namespace XrdCl;
+        Log *log = DefaultEnv::GetLog();
+
+        int fd = pFD;
+        if( pDirectFD != -1 && IsAligned( offset, length, buffer ) )
+          fd = pDirectFD;
+
+        int64_t wr = pwrite( fd, buffer, length, offset );
+        if( wr == -1 || wr != length )
+        {
+          log->Debug( UtilityMsg, "Unable write to %s: %s",
+                                  pPath.c_str(), strerror( errno ) );
+          if( pDirectFD != -1 )
+            close( pDirectFD );
+          close( pFD );
+          pFD       = -1;
+          pDirectFD = -1;
+          if( pPosc )
+            unlink( pPath.c_str() );
+          return XRootDStatus( stError, errOSError, errno );
+        }
+
+        //----------------------------------------------------------------------
+        // Dropping the dirty pages starts the write-back, they go away
+        // when they are clean
+        //----------------------------------------------------------------------
+        if( pEngine == EngineFAdvise )
+          Advise( pFD, offset, length, POSIX_FADV_DONTNEED );
+
+        pWritten = std::max( pWritten, offset + length );
+        return XRootDStatus();
+      }
+
+      std::string    pPath;
+      int            pFD;
+      int            pDirectFD;
+      LocalIOEngine  pEngine;
+  };
+
+  //----------------------------------------------------------------------------
+  //! XRootD destination
+  //----------------------------------------------------------------------------
+  class XRootDDestination: public Destination
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Constructor
+      //------------------------------------------------------------------------
+      XRootDDestination( const XrdCl::URL *url ):
+        pUrl( url ), pFile( new XrdCl::File() )
+      {
+      }
+
+      //------------------------------------------------------------------------
+      //! Destructor
+      //------------------------------------------------------------------------
+      virtual ~XRootDDestination()
+      {
+        delete pFile;
+      }
+
+      //------------------------------------------------------------------------
+      //! Initialize the source
+      //------------------------------------------------------------------------
+      virtual XrdCl::XRootDStatus Initialize()
+      {
+        using namespace XrdCl;
+        Log *log = DefaultEnv::GetLog();
+        log->Debug( UtilityMsg, "Opening %s for writing",
+                                pUrl->GetURL().c_str() );
+
+        //----------------------------------------------------------------------
+        // A resumed file is opened as it is, and not deleted on failure
+        // so that it can be resumed again
+        //----------------------------------------------------------------------
+        uint16_t flags = OpenFlags::Update;
+        if( !pResume )
+        {
+          if( pForce )
+            flags |= OpenFlags::Delete;
+          else
+            flags |= OpenFlags::New;
+
+          if( pPosc )
+            flags |= OpenFlags::POSC;
+        }
+
+        return pFile->Open( pUrl->GetURL(), flags, Access::UR|Access::UW);
+      }
+
+      //------------------------------------------------------------------------
+      //! Put a data chunk at a destination
+      //------------------------------------------------------------------------
+      virtual XrdCl::XRootDStatus PutChunk( const XrdCl::ChunkInfo &ci,
+                                            XrdCl::ResponseHandler *handler )
+      {
+        using namespace XrdCl;
+        if( !pFile->IsOpen() )
+          return XRootDStatus( stError, errUninitialized );
+
+        //----------------------------------------------------------------------
+        // The zero chunks are not sent at all, they become holes when
+        // the file grows past them
+        //----------------------------------------------------------------------
+        if( pSparse && IsZero( (const char*)ci.buffer, ci.length ) )
+        {
+          pSkipped += ci.length;
+          handler->HandleResponse( new XRootDStatus(), 0 );
+          return XRootDStatus();
+        }
+
+        pWritten = std::max( pWritten, ci.offset + ci.length );
+        return pFile->Write( ci.offset, ci.length, ci.buffer, handler );
+      }
+
+      //------------------------------------------------------------------------
+      //! Extend the file over the trailing hole
+      //------------------------------------------------------------------------
+      virtual XrdCl::XRootDStatus Finalize( uint64_t size )
+      {
+        using namespace XrdCl;
+        if( pSkipped )
+          DefaultEnv::GetLog()->Debug( UtilityMsg, "Skipped %llu zero bytes "
+                                       "of %s", (unsigned long long)pSkipped,
+                                       pUrl->GetURL().c_str() );
+
+        if( pWritten >= size )
+          return XRootDStatus();
+        return pFile->Truncate( size );
+      }
+
+      //------------------------------------------------------------------------
+      //! Make the server flush the written data
+      //------------------------------------------------------------------------
+      virtual XrdCl::XRootDStatus Sync()
+      {
+        using namespace XrdCl;
+        if( !pFile->IsOpen() )
+          return XRootDStatus( stError, errUninitialized );
+        return pFile->Sync();
+      }
+
+      //------------------------------------------------------------------------
+      //! The writes are sent in order so that the servers that allocate
+      //! the space as the file grows (and the POSC files) are not left
+      //! with holes - unless the zero chunks are skipped on purpose
+      //------------------------------------------------------------------------
+      virtual bool AcceptsOutOfOrder() const
+      {
+        return false;
+      }
+
+      //------------------------------------------------------------------------
+      //! Get check sum
+      //------------------------------------------------------------------------
+      virtual XrdCl::XRootDStatus GetCheckSum( std::string &checkSum,
+                                               std::string &checkSumType )
+      {
+        return XrdCl::Utils::GetRemoteCheckSum( checkSum, checkSumType,
+                                                pFile->GetDataServer(),
+                                                pUrl->GetPath() );
+      }
+
+    private:
+      const XrdCl::URL *pUrl;
+      XrdCl::File      *pFile;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Amount of data written to the destination after which it is synced
+  //! and the journal records of the chunks are committed
+  //----------------------------------------------------------------------------
+  const uint64_t JournalCommitSize = 64*1024*1024;
+
+  //----------------------------------------------------------------------------
+  //! Journal of the chunks written to the destination, so that an
+  //! interrupted copy can be continued. It's a text file: the journal tag,
+  //! the source URL, its size and modification time, followed by
+  //! the offsets and lengths of the chunks, a line each. The records are
+  //! kept in memory until the destination has been synced, so that the
+  //! journal never lists data that might have been lost. The ranges loaded
+  //! from an earlier journal are not updated by the chunks recorded later.
+  //----------------------------------------------------------------------------
+  class CopyJournal
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Constructor
+      //------------------------------------------------------------------------
+      CopyJournal( const std::string &path ): pPath( path ), pFD( -1 ),
+        pDone( 0 ), pPendingSize( 0 ) {}
+
+      //------------------------------------------------------------------------
+      //! Destructor
+      //------------------------------------------------------------------------
+      ~CopyJournal()
+      {
+        if( pFD != -1 )
+          close( pFD );
+      }
+
+      //------------------------------------------------------------------------
+      //! Load the ranges copied before, if the journal is about the same
+      //! version of the same source
+      //!
+      //! @return false if there is no such journal
+      //------------------------------------------------------------------------
+      bool Load( const std::string &source, uint64_t size, uint64_t modTime )
+      {
+        std::string data;
+        int fd = open( pPath.c_str(), O_RDONLY );
+        if( fd == -1 )
+          return false;
+        char    buffer[4096];
+        ssize_t rd;
+        while( (rd = read( fd, buffer, sizeof( buffer ) )) > 0 )
+          data.append( buffer, rd );
+        close( fd );
+
+        std::istringstream i( data );
+        std::string        tag, src, line;
+        uint64_t           jSize = 0, jModTime = 0;
+        std::getline( i, tag );
+        std::getline( i, src );
+        std::getline( i, line );
+        std::istringstream header( line );
+        if( tag != JournalTag || src != source ||
+            !(header >> jSize >> jModTime) || jSize != size ||
+            jModTime != modTime )
+          return false;
+
+        //----------------------------------------------------------------------
+        // The line cut short by a crash is not taken into account
+        //----------------------------------------------------------------------
+        while( std::getline( i, line ) && !i.eof() )
+        {
+          std::istringstream record( line );
+          uint64_t offset, length;
+          if( !(record >> offset >> length) || offset + length > size )
+            break;
+          AddRange( offset, offset + length );
+        }
+        return true;
+      }
+
+      //------------------------------------------------------------------------
+      //! Open the journal for recording, a new one is started unless
+      //! continuing
+      //------------------------------------------------------------------------
+      XrdCl::XRootDStatus Open( bool resume, const std::string &source,
+                                uint64_t size, uint64_t modTime )
+      {
+        using namespace XrdCl;
+        int flags = O_WRONLY|O_CREAT|O_APPEND;
+        if( !resume )
+        {
+          flags |= O_TRUNC;
+          pRanges.clear();
+          pDone = 0;
+        }
+
+        pFD = open( pPath.c_str(), flags, 0644 );
+        if( pFD == -1 )
+          return XRootDStatus( stError, errOSError, errno );
+
+        if( resume )
+          return XRootDStatus();
+
+        std::ostringstream o;
+        o << JournalTag << "\n" << source << "\n" << size << " " << modTime;
+        o << "\n";
+        return Append( o.str() );
+      }
+
+      //------------------------------------------------------------------------
+      //! Record a chunk that has been written, the record is kept until
+      //! the next commit
+      //------------------------------------------------------------------------
+      void Add( uint64_t offset, uint32_t length )
+      {
+        std::ostringstream o;
+        o << offset << " " << length << "\n";
+        pPending     += o.str();
+        pPendingSize += length;
+      }
+
+      //------------------------------------------------------------------------
+      //! Get the size of the chunks recorded since the last commit
+      //------------------------------------------------------------------------
+      uint64_t GetPendingSize() const
+      {
+        return pPendingSize;
+      }
+
+      //------------------------------------------------------------------------
+      //! Sync the destination and write down the records kept so far, they
+      //! are dropped if the destination cannot be synced
+      //------------------------------------------------------------------------
+      XrdCl::XRootDStatus Commit( Destination *dest )
+      {
+        using namespace XrdCl;
+        if( pPending.empty() )
+          return XRootDStatus();
+
+        std::string records;
+        records.swap( pPending );
+        pPendingSize = 0;
+
+        XRootDStatus st = dest->Sync();
+        if( !st.IsOK() )
+          return st;
+
+        st = Append( records );
+        if( !st.IsOK() )
+          return st;
+        if( fsync( pFD ) == -1 )
+          return XRootDStatus( stError, errOSError, errno );
+        return XRootDStatus();
+      }
+
+      //------------------------------------------------------------------------
+      //! Find the next range to be copied
+      //!
+      //! @param offset the offset to start from, moved past the ranges
+      //!               copied before
+      //! @param length the maximum length, cut at the next range copied
+      //!               before
+      //------------------------------------------------------------------------
+      void NextMissing( uint64_t &offset, uint32_t &length ) const
+      {
+        offset = SkipDone( offset );
+        std::map<uint64_t, uint64_t>::const_iterator it;
+        it = pRanges.upper_bound( offset );
+        if( it != pRanges.end() && it->first - offset < length )
+          length = it->first - offset;
+      }
+
+      //------------------------------------------------------------------------
+      //! Move the offset past the range copied before if it's in one
+      //------------------------------------------------------------------------
+      uint64_t SkipDone( uint64_t offset ) const
+      {
+        std::map<uint64_t, uint64_t>::const_iterator it;
+        it = pRanges.upper_bound( offset );
+        if( it == pRanges.begin() )
+          return offset;
+        --it;
+        return std::max( offset, it->second );
+      }
+
+      //------------------------------------------------------------------------
+      //! Get the number of bytes copied before
+      //------------------------------------------------------------------------
+      uint64_t GetDone() const
+      {
+        return pDone;
+      }
+
+      //------------------------------------------------------------------------
+      //! Remove the journal
+      //------------------------------------------------------------------------
+      void Remove()
+      {
+        if( pFD != -1 )
+          close( pFD );
+        pFD = -1;
+        unlink( pPath.c_str() );
+      }
+
+      //------------------------------------------------------------------------
+      //! Get the path to the journal
+      //------------------------------------------------------------------------
+      const std::string &GetPath() const
+      {
+        return pPath;
+      }
+
+    private:
+      static const char * const JournalTag;
+
+      //------------------------------------------------------------------------
+      // Merge the range with the ones loaded already
+      //------------------------------------------------------------------------
+      void AddRange( uint64_t start, uint64_t end )
+      {
+        std::map<uint64_t, uint64_t>::iterator it = pRanges.upper_bound( start );
+        if( it != pRanges.begin() )
+        {
+          std::map<uint64_t, uint64_t>::iterator prev = it; --prev;
+          if( prev->second >= start )
+          {
+            start = prev->first;
+            end   = std::max( end, prev->second );
+            pDone -= prev->second - prev->first;
+            pRanges.erase( prev );
+          }
+        }
+        while( it != pRanges.end() && it->first <= end )
+        {
+          end    = std::max( end, it->second );
+          pDone -= it->second - it->first;
+          pRanges.erase( it++ );
+        }
+        pRanges[start] = end;
+        pDone += end - start;
+      }
+
+      //------------------------------------------------------------------------
+      // Write the whole record
+      //------------------------------------------------------------------------
+      XrdCl::XRootDStatus Append( const std::string &record )
+      {
+        using namespace XrdCl;
+        if( pFD == -1 )
+          return XRootDStatus( stError, errUninitialized );
+        if( write( pFD, record.data(), record.size() ) !=
+            (ssize_t)record.size() )
+          return XRootDStatus( stError, errOSError, errno );
+        return XRootDStatus();
+      }
+
+      std::string                  pPath;
+      int                          pFD;
+      std::map<uint64_t, uint64_t> pRanges;
+      uint64_t                     pDone;
+      std::string                  pPending;
+      uint64_t                     pPendingSize;
+  };
+
+  const char * const CopyJournal::JournalTag = "xrdcl-copy-journal 1";
+
+  //----------------------------------------------------------------------------
+  //! Get the path to the journal of the copy to the destination: the
+  //! directory given by CPJournalDir or next to a local destination,
+  //! empty if there is no place for it
+  //----------------------------------------------------------------------------
+  std::string GetJournalPath( const XrdCl::URL &destination )
+  {
+    using namespace XrdCl;
+    std::string dir = DefaultCPJournalDir;
+    DefaultEnv::GetEnv()->GetString( "CPJournalDir", dir );
+
+    if( dir.empty() )
+    {
+      if( destination.GetProtocol() != "file" )
+        return "";
+      return destination.GetPath() + ".xrdcl-journal";
+    }
+
+    std::string name = destination.GetHostId() + destination.GetPath();
+    for( size_t i = 0; i < name.length(); ++i )
+      if( !isalnum( name[i] ) && name[i] != '.' && name[i] != '-' )
+        name[i] = '_';
+    return dir + "/" + name + ".xrdcl-journal";
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the size of the file, local or remote
+  //----------------------------------------------------------------------------
+  XrdCl::XRootDStatus GetFileSize( const XrdCl::URL &url, uint64_t &size )
+  {
+    using namespace XrdCl;
+    if( url.GetProtocol() == "file" )
+    {
+      struct stat st;
+      if( stat( url.GetPath().c_str(), &st ) == -1 )
+        return XRootDStatus( stError, errOSError, errno );
+      size = st.st_size;
+      return XRootDStatus();
+    }
+
+    FileSystem    fs( url );
+    StatInfo     *info = 0;
+    XRootDStatus  st   = fs.Stat( url.GetPath(), info );
+    if( !st.IsOK() )
+      return st;
+    size = info->GetSize();
+    delete info;
+    return XRootDStatus();
+  }
+
+  //----------------------------------------------------------------------------
+  //! Completion of a chunk operation
+  //----------------------------------------------------------------------------
+  struct CopyEvent
+  {
+    enum Type
+    {
+      Read,
+      Write,
+      CheckSum
+    };
+
+    Type                type;
+    XrdCl::XRootDStatus status;
+    XrdCl::ChunkInfo    chunk;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Queue of the completed chunk operations, filled by the response
+  //! handlers and drained by the copy job
+  //----------------------------------------------------------------------------
+  class CopyEvents
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Queue an event
+      //------------------------------------------------------------------------
+      void Post( CopyEvent::Type            type,
+                 const XrdCl::XRootDStatus &status,
+                 const XrdCl::ChunkInfo    &chunk )
+      {
+        CopyEvent ev;
+        ev.type   = type;
+        ev.status = status;
+        ev.chunk  = chunk;
+
+        pCond.Lock();
+        pEvents.push_back( ev );
+        pCond.Signal();
+        pCond.UnLock();
+      }
+
+      //------------------------------------------------------------------------
+      //! Wait for an event and take it off the queue
+      //------------------------------------------------------------------------
+      CopyEvent Wait()
+      {
+        pCond.Lock();
+        while( pEvents.empty() )
+          pCond.Wait();
+        CopyEvent ev = pEvents.front();
+        pEvents.pop_front();
+        pCond.UnLock();
+        return ev;
+      }
+
+    private:
+      XrdSysCondVar        pCond;
+      std::list<CopyEvent> pEvents;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Notify the copy job about a chunk that has been read, a short read is
+  //! reported as an error since the size of the source is known up front
+  //----------------------------------------------------------------------------
+  class ChunkReadHandler: public XrdCl::ResponseHandler
+  {
+    public:
+      ChunkReadHandler( CopyEvents *events, const XrdCl::ChunkInfo &chunk ):
+        pEvents( events ), pChunk( chunk ) {}
+
+      virtual void HandleResponse( XrdCl::XRootDStatus *status,
+                                   XrdCl::AnyObject    *response )
+      {
+        using namespace XrdCl;
+        XRootDStatus st = *status;
+        if( st.IsOK() )
+        {
+          ChunkInfo *chunk = 0;
+          if( response )
+            response->Get( chunk );
+          if( !chunk || chunk->length != pChunk.length )
+            st = XRootDStatus( stError, errDataError );
+        }
+        pEvents->Post( CopyEvent::Read, st, pChunk );
+        delete status;
+        delete response;
+        delete this;
+      }
+
+    private:
+      CopyEvents       *pEvents;
+      XrdCl::ChunkInfo  pChunk;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Notify the copy job about a chunk that has been written
+  //----------------------------------------------------------------------------
+  class ChunkWriteHandler: public XrdCl::ResponseHandler
+  {
+    public:
+      ChunkWriteHandler( CopyEvents *events, const XrdCl::ChunkInfo &chunk ):
+        pEvents( events ), pChunk( chunk ) {}
+
+      virtual void HandleResponse( XrdCl::XRootDStatus *status,
+                                   XrdCl::AnyObject    *response )
+      {
+        pEvents->Post( CopyEvent::Write, *status, pChunk );
+        delete status;
+        delete response;
+        delete this;
+      }
+
+    private:
+      CopyEvents       *pEvents;
+      XrdCl::ChunkInfo  pChunk;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Read a chunk from the source
+  //----------------------------------------------------------------------------
+  XrdCl::XRootDStatus ReadChunk( Source                 *src,
+                                 CopyEvents             *events,
+                                 const XrdCl::ChunkInfo &chunk )
+  {
+    ChunkReadHandler *handler = new ChunkReadHandler( events, chunk );
+    XrdCl::XRootDStatus st = src->ReadChunk( chunk, handler );
+    if( !st.IsOK() )
+      delete handler;
+    return st;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Write a chunk to the destination
+  //----------------------------------------------------------------------------
+  XrdCl::XRootDStatus PutChunk( Destination            *dest,
+                                CopyEvents             *events,
+                                const XrdCl::ChunkInfo &chunk )
+  {
+    ChunkWriteHandler *handler = new ChunkWriteHandler( events, chunk );
+    XrdCl::XRootDStatus st = dest->PutChunk( chunk, handler );
+    if( !st.IsOK() )
+      delete handler;
+    return st;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Pool of the chunk buffers. A buffer is reference counted since it may
+  //! be written and checksummed at the same time, when it's released its
+  //! bytes go back to the budget of the copy process. The buffers are
+  //! aligned for direct I/O, the ones provided by the source are only
+  //! counted. When the chunk size changes the buffers of the old size
+  //! are freed as they come back.
+  //----------------------------------------------------------------------------
+  class ChunkPool
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Constructor
+      //------------------------------------------------------------------------
+      ChunkPool( uint32_t chunkSize, XrdCl::CopyBudget *budget ):
+        pChunkSize( chunkSize ), pBudget( budget ) {}
+
+      //------------------------------------------------------------------------
+      //! Destructor
+      //------------------------------------------------------------------------
+      ~ChunkPool()
+      {
+        std::map<char*, uint32_t>::iterator it;
+        for( it = pBuffers.begin(); it != pBuffers.end(); ++it )
+          free( it->first );
+      }
+
+      //------------------------------------------------------------------------
+      //! Set the size of the buffers allocated from now on
+      //------------------------------------------------------------------------
+      void SetChunkSize( uint32_t chunkSize )
+      {
+        if( chunkSize == pChunkSize )
+          return;
+        pChunkSize = chunkSize;
+        for( size_t i = 0; i < pFree.size(); ++i )
+          Free( pFree[i] );
+        pFree.clear();
+      }
+
+      //------------------------------------------------------------------------
+      //! Get a buffer for the chunk of the given length, the caller holds
+      //! the first reference
+      //!
+      //! @param  wait     wait for the budget if necessary
+      //! @param  external the buffer provided by the source, if any
+      //! @return          the buffer or 0 if the budget is exhausted or
+      //!                  the memory can't be allocated
+      //------------------------------------------------------------------------
+      char *Get( uint32_t length, bool wait, char *external = 0 )
+      {
+        if( pBudget && !pBudget->Acquire( length, wait ) )
+          return 0;
+
+        char *buffer = 0;
+        if( external )
+        {
+          buffer = external;
+          pExternal.insert( buffer );
+        }
+        else if( pFree.empty() || length > pChunkSize )
+        {
+          void    *mem  = 0;
+          uint32_t size = std::max( length, pChunkSize );
+          if( posix_memalign( &mem, DirectIOAlignment, size ) )
+          {
+            if( pBudget )
+              pBudget->Release( length );
+            return 0;
+          }
+          buffer = (char*)mem;
+          pBuffers[buffer] = size;
+        }
+        else
+        {
+          buffer = pFree.back();
+          pFree.pop_back();
+        }
+        pRefs[buffer] = 1;
+        return buffer;
+      }
+
+      //------------------------------------------------------------------------
+      //! Get a reference to the chunk's buffer
+      //------------------------------------------------------------------------
+      void Ref( const XrdCl::ChunkInfo &chunk )
+      {
+        ++pRefs[(char*)chunk.buffer];
+      }
+
+      //------------------------------------------------------------------------
+      //! Release a reference to the chunk's buffer
+      //------------------------------------------------------------------------
+      void UnRef( const XrdCl::ChunkInfo &chunk )
+      {
+        std::map<char*, uint32_t>::iterator it;
+        it = pRefs.find( (char*)chunk.buffer );
+        if( --it->second )
+          return;
+        pRefs.erase( it );
+        if( !pExternal.erase( (char*)chunk.buffer ) )
+        {
+          if( pBuffers[(char*)chunk.buffer] == pChunkSize )
+            pFree.push_back( (char*)chunk.buffer );
+          else
+            Free( (char*)chunk.buffer );
+        }
+        if( pBudget )
+          pBudget->Release( chunk.length );
+      }
+
+      //------------------------------------------------------------------------
+      //! Get the number of buffers in use
+      //------------------------------------------------------------------------
+      uint32_t GetUsed() const
+      {
+        return pRefs.size();
+      }
+
+    private:
+      void Free( char *buffer )
+      {
+        pBuffers.erase( buffer );
+        free( buffer );
+      }
+
+      uint32_t                   pChunkSize;
+      XrdCl::CopyBudget         *pBudget;
+      std::map<char*, uint32_t>  pBuffers;
+      std::vector<char*>         pFree;
+      std::map<char*, uint32_t>  pRefs;
+      std::set<char*>            pExternal;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Compute the checksum of the chunks passing through the copy job on
+  //! a helper thread, the chunks need to be submitted in order
+  //----------------------------------------------------------------------------
+  class CheckSumHelper
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Constructor
+      //------------------------------------------------------------------------
+      CheckSumHelper( XrdCl::CheckSumCalc *calc, CopyEvents *events ):
+        pCalc( calc ), pEvents( events ), pRunning( false ), pStop( false ) {}
+
+      //------------------------------------------------------------------------
+      //! Destructor
+      //------------------------------------------------------------------------
+      ~CheckSumHelper()
+      {
+        Stop();
+        delete pCalc;
+      }
+
+      //------------------------------------------------------------------------
+      //! Start the helper thread, if it fails the checksum is computed
+      //! by the caller
+      //------------------------------------------------------------------------
+      void Start();
+
+      //------------------------------------------------------------------------
+      //! Stop the helper thread after processing the queued chunks
+      //------------------------------------------------------------------------
+      void Stop()
+      {
+        if( !pRunning )
+          return;
+        pCond.Lock();
+        pStop = true;
+        pCond.Signal();
+        pCond.UnLock();
+        pthread_join( pThread, 0 );
+        pRunning = false;
+      }
+
+      //------------------------------------------------------------------------
+      //! Queue the chunk, a CheckSum event is posted when it's done
+      //------------------------------------------------------------------------
+      void Submit( const XrdCl::ChunkInfo &chunk )
+      {
+        if( !pRunning )
+        {
+          Update( chunk );
+          return;
+        }
+        pCond.Lock();
+        pQueue.push_back( chunk );
+        pCond.Signal();
+        pCond.UnLock();
+      }
+
+      //------------------------------------------------------------------------
+      //! Get the checksum in the type:value format
+      //------------------------------------------------------------------------
+      std::string GetCheckSum()
+      {
+        return pCalc->GetCheckSum();
+      }
+
+      //------------------------------------------------------------------------
+      //! Process the queue - loop of the helper thread
+      //------------------------------------------------------------------------
+      void Run()
+      {
+        while( 1 )
+        {
+          pCond.Lock();
+          while( pQueue.empty() && !pStop )
+            pCond.Wait();
+          if( pQueue.empty() )
+          {
+            pCond.UnLock();
+            return;
+          }
+          XrdCl::ChunkInfo chunk = pQueue.front();
+          pQueue.pop_front();
+          pCond.UnLock();
+          Update( chunk );
+        }
+      }
+
+    private:
+      void Update( const XrdCl::ChunkInfo &chunk )
+      {
+        pCalc->Update( chunk.buffer, chunk.length );
+        pEvents->Post( CopyEvent::CheckSum, XrdCl::XRootDStatus(), chunk );
+      }
+
+      XrdCl::CheckSumCalc         *pCalc;
+      CopyEvents                  *pEvents;
+      XrdSysCondVar                pCond;
+      std::list<XrdCl::ChunkInfo>  pQueue;
+      pthread_t                    pThread;
+      bool                         pRunning;
+      bool                         pStop;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Checksum helper thread
+  //----------------------------------------------------------------------------
+  void *RunCheckSumHelper( void *arg )
+  {
+    ((CheckSumHelper*)arg)->Run();
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  //! Start the helper thread
+  //----------------------------------------------------------------------------
+  void CheckSumHelper::Start()
+  {
+    pStop    = false;
+    pRunning = pthread_create( &pThread, 0, RunCheckSumHelper, this ) == 0;
+    if( !pRunning )
+      XrdCl::DefaultEnv::GetLog()->Debug( XrdCl::UtilityMsg, "Unable to "
+        "start the checksum thread, computing the checksum inline" );
+  }
 }
 
 namespace XrdCl
@@ -547,7 +2374,8 @@ namespace XrdCl
   //----------------------------------------------------------------------------
   // Constructor
   //----------------------------------------------------------------------------
-  ClassicCopyJob::ClassicCopyJob( const URL *source, const URL *destination )
+  ClassicCopyJob::ClassicCopyJob( const URL *source, const URL *destination ):
+    pNumberOfSources( 1 )
   {
     pSource      = source;
     pDestination = destination;
@@ -568,20 +2396,82 @@ namespace XrdCl
     //--------------------------------------------------------------------------
     // Initialize the source and the destination
     //--------------------------------------------------------------------------
+    LocalIOEngine         engine = GetLocalIOEngine();
     std::auto_ptr<Source> src;
     if( pSource->GetProtocol() == "file" )
-      src.reset( new LocalSource( pSource ) );
+      src.reset( new LocalSource( pSource, engine ) );
+    else if( pSourceLimit > 1 )
+      src.reset( new XRootDMultiSource( pSource, pSourceLimit ) );
     else
       src.reset( new XRootDSource( pSource ) );
 
     XRootDStatus st = src->Initialize();
     if( !st.IsOK() ) return st;
+    pNumberOfSources = src->GetNumberOfSources();
+
+    //--------------------------------------------------------------------------
+    // Find out if we continue an interrupted copy: the journal must be
+    // about the same source file and the destination must not be bigger
+    //--------------------------------------------------------------------------
+    Env                         *env      = DefaultEnv::GetEnv();
+    int                          resume   = pResume;
+    bool                         resuming = false;
+    std::auto_ptr<CopyJournal>   journal;
+    if( !resume )
+      env->GetInt( "CPResume", resume );
+
+    //--------------------------------------------------------------------------
+    // A POSC file is deleted when the copy fails, there would be nothing to
+    // continue
+    //--------------------------------------------------------------------------
+    if( resume && pPosc )
+    {
+      log->Warning( UtilityMsg, "The copy to %s cannot be resumed with POSC "
+                    "enabled, not keeping a journal",
+                    pDestination->GetURL().c_str() );
+      resume = 0;
+    }
+
+    if( resume )
+    {
+      std::string path = GetJournalPath( *pDestination );
+      if( path.empty() )
+        log->Warning( UtilityMsg, "Unable to keep the journal of the copy "
+                      "to %s, set CPJournalDir to resume it",
+                      pDestination->GetURL().c_str() );
+      else
+        journal.reset( new CopyJournal( path ) );
+    }
+
+    if( journal.get() &&
+        journal->Load( pSource->GetURL(), src->GetSize(), src->GetModTime() ) )
+    {
+      uint64_t destSize = 0;
+      st = GetFileSize( *pDestination, destSize );
+      if( st.IsOK() && destSize <= src->GetSize() )
+      {
+        resuming = true;
+        log->Info( UtilityMsg, "Resuming the copy to %s, %llu bytes of %llu "
+                   "copied already", pDestination->GetURL().c_str(),
+                   (unsigned long long)journal->GetDone(),
+                   (unsigned long long)src->GetSize() );
+      }
+      else
+        log->Info( UtilityMsg, "Unable to resume the copy to %s, the "
+                   "destination does not match the journal",
+                   pDestination->GetURL().c_str() );
+    }
 
     std::auto_ptr<Destination> dest;
     URL newDestUrl( *pDestination );
 
     if( pDestination->GetProtocol() == "file" )
-      dest.reset( new LocalDestination( pDestination ) );
+    {
+      int sparse = DefaultCPSparseLocal;
+      env->GetInt( "CPSparseLocal", sparse );
+      dest.reset( new LocalDestination( pDestination, engine ) );
+      dest->SetSparse( sparse );
+    }
     //--------------------------------------------------------------------------
     // For xrootd destination build the oss.asize hint
     //--------------------------------------------------------------------------
@@ -589,37 +2479,347 @@ namespace XrdCl
     {
       std::ostringstream o; o << src->GetSize();
       newDestUrl.GetParams()["oss.asize"] = o.str();
+      int sparse = DefaultCPSparseRemote;
+      env->GetInt( "CPSparseRemote", sparse );
       dest.reset( new XRootDDestination( &newDestUrl ) );
+      dest->SetSparse( sparse );
     }
 
     dest->SetForce( pForce );
     dest->SetPOSC( pPosc );
+    dest->SetResume( resuming );
     st = dest->Initialize();
     if( !st.IsOK() ) return st;
 
+    if( journal.get() )
+    {
+      st = journal->Open( resuming, pSource->GetURL(), src->GetSize(),
+                          src->GetModTime() );
+      if( !st.IsOK() )
+      {
+        log->Warning( UtilityMsg, "Unable to open the copy journal %s: %s",
+                      journal->GetPath().c_str(), st.ToStr().c_str() );
+        journal.reset();
+        resuming = false;
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    // Copy the chunks - keep up to parallelChunks chunks in the fly, being
+    // either read, written or waiting for the preceding ones to be written
+    // if the destination needs the data in order
+    //--------------------------------------------------------------------------
+    uint32_t chunkSize      = pChunkSize;
+    uint16_t parallelChunks = pParallelChunks;
+    if( !chunkSize )
+    {
+      int val = DefaultCPChunkSize;
+      env->GetInt( "CPChunkSize", val );
+      chunkSize = val > 0 ? val : DefaultCPChunkSize;
+    }
+    if( !parallelChunks )
+    {
+      int val = DefaultCPParallelChunks;
+      env->GetInt( "CPParallelChunks", val );
+      parallelChunks = val > 0 ? val : 1;
+    }
+
+    //--------------------------------------------------------------------------
+    // Every source needs a couple of chunks to keep busy
+    //--------------------------------------------------------------------------
+    if( pNumberOfSources > 1 && parallelChunks < 2*pNumberOfSources )
+      parallelChunks = 2*pNumberOfSources;
+
+    //--------------------------------------------------------------------------
+    // The chunk size and the number of chunks in the fly follow the
+    // throughput within the configured bounds, unless disabled or set
+    // explicitly for the job
+    //--------------------------------------------------------------------------
+    int adaptive     = DefaultCPAdaptive;
+    int minChunk     = DefaultCPMinChunkSize;
+    int maxChunk     = DefaultCPMaxChunkSize;
+    int minParallel  = DefaultCPMinParallelChunks;
+    int maxParallel  = DefaultCPMaxParallelChunks;
+    env->GetInt( "CPAdaptive",          adaptive );
+    env->GetInt( "CPMinChunkSize",      minChunk );
+    env->GetInt( "CPMaxChunkSize",      maxChunk );
+    env->GetInt( "CPMinParallelChunks", minParallel );
+    env->GetInt( "CPMaxParallelChunks", maxParallel );
+    if( pChunkSize || pParallelChunks )
+      adaptive = 0;
+    if( minChunk <= 0 )    minChunk    = DefaultCPMinChunkSize;
+    if( maxChunk <= 0 )    maxChunk    = DefaultCPMaxChunkSize;
+    if( minParallel <= 0 ) minParallel = DefaultCPMinParallelChunks;
+    if( maxParallel <= 0 ) maxParallel = DefaultCPMaxParallelChunks;
+    if( pNumberOfSources > 1 && minParallel < 2*pNumberOfSources )
+      minParallel = 2*pNumberOfSources;
+
+    CopyTuner tuner( adaptive, chunkSize, parallelChunks, minChunk, maxChunk,
+                     minParallel, std::min( maxParallel, 65535 ) );
+    chunkSize      = tuner.GetChunkSize();
+    parallelChunks = tuner.GetParallelChunks();
+
+    if( adaptive )
+      log->Debug( UtilityMsg, "Copying in chunks of %d bytes, %d in parallel, "
+                  "adjusted between %d and %d bytes, %d and %d chunks",
+                  chunkSize, parallelChunks, minChunk, maxChunk, minParallel,
+                  maxParallel );
+    else
+      log->Debug( UtilityMsg, "Copying in chunks of %d bytes, %d in parallel",
+                  chunkSize, parallelChunks );
+
+    //--------------------------------------------------------------------------
+    // If we need the checksum of a local source compute it on the fly, the
+    // checksums of the remote files come from the servers. The destination
+    // is always checked against what has been stored, so a local one is
+    // read back after the transfer. A resumed copy does not see all the
+    // data, the local source is read afterwards too.
+    //--------------------------------------------------------------------------
+    CopyEvents                     events;
+    std::auto_ptr<CheckSumHelper>  cksHelper;
+    bool                           localSrcCks = false;
+    if( !pCheckSumType.empty() && !resuming )
+    {
+      localSrcCks = pSource->GetProtocol() == "file" && pCheckSumPreset.empty();
+      CheckSumCalc *calc = 0;
+      if( localSrcCks )
+        calc = CheckSumCalc::Create( pCheckSumType );
+
+      if( calc )
+      {
+        cksHelper.reset( new CheckSumHelper( calc, &events ) );
+        cksHelper->Start();
+      }
+      else
+        localSrcCks = false;
+    }
+
     //--------------------------------------------------------------------------
-    // Copy the chunks
+    // Copy the chunks - keep up to parallelChunks buffers in use. A chunk
+    // is released when it's been written and checksummed, both are done in
+    // order of the offsets if necessary.
     //--------------------------------------------------------------------------
-    Buffer    buff;
-    ChunkInfo chunkInfo;
-    uint64_t  size      = src->GetSize();
-    uint64_t  processed = 0;
+    ChunkPool                      pool( chunkSize, pBudget );
+    std::map<uint64_t, ChunkInfo>  pending;
+    bool                           ordered   = !dest->AcceptsOutOfOrder();
+    uint64_t                       size      = src->GetSize();
+    uint64_t                       processed = 0;
+    uint64_t                       nextRead  = 0;
+    uint64_t                       nextInOrder = 0;
+    XRootDStatus                   error;
+
+    if( resuming )
+    {
+      processed   = journal->GetDone();
+      nextInOrder = journal->SkipDone( 0 );
+    }
+
     while( 1 )
     {
-      st = src->GetChunk( buff, chunkInfo );
-      if( !st.IsOK() )
-        return st;
+      //------------------------------------------------------------------------
+      // Send the reads, reserving the bytes within the budget of the copy
+      // process - we can only wait if we don't hold anything ourselves
+      //------------------------------------------------------------------------
+      chunkSize      = tuner.GetChunkSize();
+      parallelChunks = tuner.GetParallelChunks();
+      pool.SetChunkSize( chunkSize );
+
+      while( error.IsOK() && nextRead < size &&
+             pool.GetUsed() < parallelChunks )
+      {
+        uint32_t length = std::min( (uint64_t)chunkSize, size - nextRead );
+        if( resuming )
+        {
+          journal->NextMissing( nextRead, length );
+          if( nextRead >= size )
+            break;
+          length = std::min( (uint64_t)length, size - nextRead );
+        }
+        char    *buffer = pool.Get( length, pool.GetUsed() == 0,
+                                    src->GetBuffer( nextRead, length ) );
+        if( !buffer )
+        {
+          if( !pool.GetUsed() )
+            error = XRootDStatus( stError, errOSError, ENOMEM );
+          else
+            tuner.BudgetExhausted();
+          break;
+        }
+
+        ChunkInfo chunk( nextRead, length, buffer );
+        tuner.ChunkSent( chunk.offset );
+        st = ReadChunk( src.get(), &events, chunk );
+        if( !st.IsOK() )
+        {
+          pool.UnRef( chunk );
+          error = st;
+          break;
+        }
+        nextRead += chunk.length;
+      }
+
+      //------------------------------------------------------------------------
+      // On errors nothing waits for the chunks that are out of order, and
+      // we just wait for the outstanding operations to return so that the
+      // buffers can be freed
+      //------------------------------------------------------------------------
+      if( !error.IsOK() )
+      {
+        std::map<uint64_t, ChunkInfo>::iterator it;
+        for( it = pending.begin(); it != pending.end(); ++it )
+          pool.UnRef( it->second );
+        pending.clear();
+      }
 
-      if( st.IsOK() && st.code == suDone )
+      if( !pool.GetUsed() )
         break;
 
-      st = dest->PutChunk( buff, chunkInfo );
+      CopyEvent ev = events.Wait();
 
-      if( !st.IsOK() )
-        return st;
+      //------------------------------------------------------------------------
+      // A chunk has been checksummed
+      //------------------------------------------------------------------------
+      if( ev.type == CopyEvent::CheckSum )
+      {
+        pool.UnRef( ev.chunk );
+        continue;
+      }
+
+      //------------------------------------------------------------------------
+      // A chunk has been written
+      //------------------------------------------------------------------------
+      if( ev.type == CopyEvent::Write )
+      {
+        pool.UnRef( ev.chunk );
+        if( !ev.status.IsOK() )
+        {
+          log->Debug( UtilityMsg, "Unable to write to %s: %s",
+                      pDestination->GetURL().c_str(),
+                      ev.status.ToStr().c_str() );
+          if( error.IsOK() )
+            error = ev.status;
+          continue;
+        }
+
+        processed += ev.chunk.length;
+        tuner.ChunkDone( ev.chunk.offset, ev.chunk.length );
+        if( journal.get() )
+        {
+          journal->Add( ev.chunk.offset, ev.chunk.length );
+          if( journal->GetPendingSize() >= JournalCommitSize )
+          {
+            st = journal->Commit( dest.get() );
+            if( !st.IsOK() )
+              log->Warning( UtilityMsg, "Unable to commit the copy journal "
+                            "%s: %s", journal->GetPath().c_str(),
+                            st.ToStr().c_str() );
+          }
+        }
+        if( progress && error.IsOK() )
+          progress->JobProgress( pJobNum, processed, size );
+        continue;
+      }
+
+      //------------------------------------------------------------------------
+      // A chunk has been read
+      //------------------------------------------------------------------------
+      if( !ev.status.IsOK() )
+      {
+        log->Debug( UtilityMsg, "Unable to read from %s: %s",
+                    pSource->GetURL().c_str(), ev.status.ToStr().c_str() );
+        if( error.IsOK() )
+          error = ev.status;
+      }
+
+      if( error.IsOK() && !ordered )
+      {
+        pool.Ref( ev.chunk );
+        st = PutChunk( dest.get(), &events, ev.chunk );
+        if( !st.IsOK() )
+        {
+          pool.UnRef( ev.chunk );
+          error = st;
+        }
+      }
+
+      if( error.IsOK() && ( ordered || cksHelper.get() ) )
+      {
+        pool.Ref( ev.chunk );
+        pending[ev.chunk.offset] = ev.chunk;
+      }
+      pool.UnRef( ev.chunk );
+
+      //------------------------------------------------------------------------
+      // Write and checksum the chunks that are in order
+      //------------------------------------------------------------------------
+      while( error.IsOK() && !pending.empty() &&
+             pending.begin()->first == nextInOrder )
+      {
+        ChunkInfo chunk = pending.begin()->second;
+        pending.erase( pending.begin() );
+        nextInOrder += chunk.length;
+        if( resuming )
+          nextInOrder = journal->SkipDone( nextInOrder );
+
+        if( ordered )
+        {
+          pool.Ref( chunk );
+          st = PutChunk( dest.get(), &events, chunk );
+          if( !st.IsOK() )
+          {
+            pool.UnRef( chunk );
+            error = st;
+          }
+        }
+
+        if( error.IsOK() && cksHelper.get() )
+        {
+          pool.Ref( chunk );
+          cksHelper->Submit( chunk );
+        }
+        pool.UnRef( chunk );
+      }
+    }
+
+    if( !error.IsOK() )
+    {
+      if( journal.get() )
+      {
+        st = journal->Commit( dest.get() );
+        if( !st.IsOK() )
+          log->Warning( UtilityMsg, "Unable to commit the copy journal %s: "
+                        "%s", journal->GetPath().c_str(),
+                        st.ToStr().c_str() );
+        log->Info( UtilityMsg, "The copy to %s can be resumed, the journal "
+                   "is kept in %s", pDestination->GetURL().c_str(),
+                   journal->GetPath().c_str() );
+      }
+      return error;
+    }
 
-      processed += chunkInfo.length;
-      if( progress ) progress->JobProgress( processed, size );
+    st = dest->Finalize( size );
+    if( !st.IsOK() )
+      return st;
+
+    //--------------------------------------------------------------------------
+    // All the data is there, a failing checksum means starting over
+    //--------------------------------------------------------------------------
+    if( journal.get() )
+      journal->Remove();
+
+    log->Info( UtilityMsg, "Copied %s in chunks of %d bytes, %d in parallel: "
+               "%.2f MB/s, shortest chunk round trip %.3f ms",
+               pDestination->GetURL().c_str(), tuner.GetChunkSize(),
+               tuner.GetParallelChunks(), tuner.GetThroughput() / 1048576,
+               (double)tuner.GetMinRoundTrip() / 1000 );
+
+    std::string streamedCheckSum;
+    if( cksHelper.get() )
+    {
+      cksHelper->Stop();
+      streamedCheckSum = cksHelper->GetCheckSum();
+      log->Dump( UtilityMsg, "Checksum computed on the fly: %s",
+                 streamedCheckSum.c_str() );
     }
 
     //--------------------------------------------------------------------------
@@ -641,6 +2841,10 @@ namespace XrdCl
         sourceCheckSum  = pCheckSumType + ":";
         sourceCheckSum += pCheckSumPreset;
       }
+      else if( localSrcCks )
+      {
+        sourceCheckSum = streamedCheckSum;
+      }
       else
       {
         st = src->GetCheckSum( sourceCheckSum, pCheckSumType );
@@ -39,6 +39,16 @@ namespace XrdCl
       //------------------------------------------------------------------------
       virtual XRootDStatus Run( CopyProgressHandler *progress = 0 );
 
+      //------------------------------------------------------------------------
+      //! Get the number of servers the data has been read from
+      //------------------------------------------------------------------------
+      virtual uint16_t GetNumberOfSources()
+      {
+        return pNumberOfSources;
+      }
+
+    private:
+      uint16_t pNumberOfSources;
   };
 }
 
@@ -48,10 +48,46 @@ namespace XrdCl
   const int DefaultStreamErrorWindow    = 1800;
   const int DefaultRunForkHandler       = 0;
   const int DefaultRedirectLimit        = 16;
+  const int DefaultMaxReadVSegments     = 1024;
+  const int DefaultMaxReadVSize         = 8*1024*1024;
+  const int DefaultPrefetchMaxSize      = 64*1024*1024;
+  const int DefaultReadHedging          = 0;
+  const int DefaultReadHedgeMinDelay    = 50;
+  const int DefaultReadHedgeMaxDelay    = 5000;
+  const int DefaultReadHedgeMaxInFlight = 16;
+  const int DefaultCPChunkSize          = 8*1024*1024;
+  const int DefaultCPParallelChunks     = 4;
+  const int DefaultCPParallelJobs       = 1;
+  const int DefaultCPMaxInFlightBytes   = 512*1024*1024;
+  const int DefaultCPAdaptive           = 1;
+  const int DefaultCPMinChunkSize       = 256*1024;
+  const int DefaultCPMaxChunkSize       = 32*1024*1024;
+  const int DefaultCPMinParallelChunks  = 2;
+  const int DefaultCPMaxParallelChunks  = 16;
+  const int DefaultCPSparseLocal        = 1;
+  const int DefaultCPSparseRemote       = 0;
+  const int DefaultCPResume             = 0;
+  const int DefaultCheckSumThreads      = 0;
+  const int DefaultCPTPCTimeout         = 1800;
+  const int DefaultCPStallTimeout       = 10;
+  const int DefaultParallelDirLists     = 8;
+  const int DefaultDirListStatQuota     = 1024;
+  const int DefaultMetadataCacheTTL     = 0;
+  const int DefaultMetadataNegCacheTTL  = 5;
+  const int DefaultMetadataCacheSize    = 10000;
+  const int DefaultRedirectCacheTTL     = 0;
+  const int DefaultRedirectCacheSize    = 10000;
+  const int DefaultBatchWindow          = 256;
+  const int DefaultParallelLocates      = 16;
+  const int DefaultFileHandleLinger     = 0;
+  const int DefaultFileHandleCacheSize  = 1000;
 
   const char * const DefaultPollerPreference   = "libevent,built-in";
   const char * const DefaultClientMonitor      = "";
   const char * const DefaultClientMonitorParam = "";
+  const char * const DefaultPrefetchProfileDir = "";
+  const char * const DefaultCPLocalIOEngine    = "auto";
+  const char * const DefaultCPJournalDir       = "";
 }
 
 #endif // __XRD_CL_CONSTANTS_HH__
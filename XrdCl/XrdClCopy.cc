@@ -25,6 +25,9 @@
 
 #include <iostream>
 #include <iomanip>
+#include <map>
+#include <cstring>
+#include <cstdlib>
 
 //------------------------------------------------------------------------------
 // Progress notifier
@@ -36,7 +39,7 @@ class ProgressDisplay: public XrdCl::CopyProgressHandler
     //! Constructor
     //--------------------------------------------------------------------------
     ProgressDisplay():
-      pAllJobs( 0 ), pCurrentJob( 0 )
+      pAllJobs( 0 ), pJobsDone( 0 )
     {
     }
 
@@ -48,33 +51,57 @@ class ProgressDisplay: public XrdCl::CopyProgressHandler
                            const XrdCl::URL */*source*/,
                            const XrdCl::URL */*destination*/ )
     {
-      pAllJobs    = jobTotal;
-      pCurrentJob = jobNum;
+      pAllJobs         = jobTotal;
+      pRunning[jobNum] = std::make_pair( 0, 0 );
     }
 
     //--------------------------------------------------------------------------
     //! End job
     //--------------------------------------------------------------------------
-    virtual void EndJob( const XrdCl::XRootDStatus &/*status*/ )
+    virtual void EndJob( uint16_t                   jobNum,
+                         const XrdCl::XRootDStatus &/*status*/ )
     {
-      std::cout << std::endl;
+      pRunning.erase( jobNum );
+      ++pJobsDone;
+      if( pRunning.empty() )
+        std::cout << std::endl;
     }
 
     //--------------------------------------------------------------------------
-    //! Job progress
+    //! Job progress - the bar shows all the jobs that are running
     //--------------------------------------------------------------------------
-    virtual void JobProgress( uint64_t bytesProcessed,
+    virtual void JobProgress( uint16_t jobNum,
+                              uint64_t bytesProcessed,
                               uint64_t bytesTotal )
     {
+      pRunning[jobNum] = std::make_pair( bytesProcessed, bytesTotal );
+
+      uint64_t processed = 0;
+      uint64_t total     = 0;
+      JobMap::iterator it;
+      for( it = pRunning.begin(); it != pRunning.end(); ++it )
+      {
+        processed += it->second.first;
+        total     += it->second.second;
+      }
+      if( !total )
+        return;
+
       std::string bar;
-      int prog = (int)((double)bytesProcessed/bytesTotal*50);
-      int proc = (int)((double)bytesProcessed/bytesTotal*100);
+      int prog = (int)((double)processed/total*50);
+      int proc = (int)((double)processed/total*100);
       bar.append( prog, '=' );
       if( prog < 50 )
         bar += ">";
 
       std::cout << "\r";
-      std::cout << "[" << pCurrentJob << "/" << pAllJobs << "] ";
+      if( pRunning.size() == 1 )
+        std::cout << "[" << jobNum << "/" << pAllJobs << "] ";
+      else
+      {
+        std::cout << "[" << pJobsDone << "/" << pAllJobs << ", ";
+        std::cout << pRunning.size() << " running] ";
+      }
       std::cout << "[" << std::setw(50) << std::left;
       std::cout << bar;
       std::cout << "] ";
@@ -82,10 +109,41 @@ class ProgressDisplay: public XrdCl::CopyProgressHandler
       std::cout << std::flush;
     }
   private:
+    typedef std::map<uint16_t, std::pair<uint64_t, uint64_t> > JobMap;
     uint16_t pAllJobs;
-    uint16_t pCurrentJob;
+    uint16_t pJobsDone;
+    JobMap   pRunning;
 };
 
+//------------------------------------------------------------------------------
+// Take the --parallel option off the command line, XrdCpConfig does not
+// know about it. Returns false if the value is invalid.
+//------------------------------------------------------------------------------
+bool GetParallel( int &argc, char **argv, uint16_t &parallel )
+{
+  for( int i = 1; i < argc; ++i )
+  {
+    if( strcmp( argv[i], "--parallel" ) && strcmp( argv[i], "-parallel" ) )
+      continue;
+
+    if( i+1 >= argc )
+      return false;
+
+    char *end;
+    long  val = strtol( argv[i+1], &end, 10 );
+    if( *end || val < 1 || val > 65535 )
+      return false;
+    parallel = val;
+
+    for( int j = i+2; j < argc; ++j )
+      argv[j-2] = argv[j];
+    argc -= 2;
+    argv[argc] = 0;
+    --i;
+  }
+  return true;
+}
+
 //------------------------------------------------------------------------------
 // Let the show begin
 //------------------------------------------------------------------------------
@@ -96,6 +154,13 @@ int main( int argc, char **argv )
   //----------------------------------------------------------------------------
   // Configure the copy command, if it returns then everything went well, ugly
   //----------------------------------------------------------------------------
+  uint16_t parallel = 1;
+  if( !GetParallel( argc, argv, parallel ) )
+  {
+    std::cerr << "Invalid number of parallel jobs" << std::endl;
+    return 2;
+  }
+
   XrdCpConfig config( argv[0] );
   config.Config( argc, argv, 0 );
 
@@ -145,6 +210,11 @@ int main( int argc, char **argv )
     process.SetForce( true );
   if( config.Want( XrdCpConfig::DoTpc ) )
     process.SetThirdPartyCopy( true );
+  if( config.Want( XrdCpConfig::DoRecurse ) )
+    process.SetRecursive( true );
+  if( config.Want( XrdCpConfig::DoSources ) )
+    process.SetSourceLimit( config.nSrcs );
+  process.SetParallelJobs( parallel );
   if( config.Want( XrdCpConfig::DoCksum ) )
   {
     std::vector<std::string> ckSumParams;
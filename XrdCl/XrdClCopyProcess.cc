@@ -23,12 +23,245 @@
 #include "XrdCl/XrdClClassicCopyJob.hh"
 #include "XrdCl/XrdClThirdPartyCopyJob.hh"
 #include "XrdCl/XrdClFileSystem.hh"
+#include "XrdCl/XrdClDirTreeWalker.hh"
 #include "XrdCl/XrdClMonitor.hh"
 
+#include <vector>
+#include <cstring>
+#include <errno.h>
 #include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <pthread.h>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Serialize the notifications of the jobs running in parallel
+  //----------------------------------------------------------------------------
+  class SerialProgressHandler: public XrdCl::CopyProgressHandler
+  {
+    public:
+      SerialProgressHandler( XrdCl::CopyProgressHandler *handler ):
+        pHandler( handler ) {}
+
+      virtual void BeginJob( uint16_t          jobNum,
+                             uint16_t          jobTotal,
+                             const XrdCl::URL *source,
+                             const XrdCl::URL *destination )
+      {
+        XrdSysMutexHelper scopedLock( pMutex );
+        pHandler->BeginJob( jobNum, jobTotal, source, destination );
+      }
+
+      virtual void EndJob( uint16_t                   jobNum,
+                           const XrdCl::XRootDStatus &status )
+      {
+        XrdSysMutexHelper scopedLock( pMutex );
+        pHandler->EndJob( jobNum, status );
+      }
+
+      virtual void JobProgress( uint16_t jobNum,
+                                uint64_t bytesProcessed,
+                                uint64_t bytesTotal )
+      {
+        XrdSysMutexHelper scopedLock( pMutex );
+        pHandler->JobProgress( jobNum, bytesProcessed, bytesTotal );
+      }
+
+    private:
+      XrdSysMutex                 pMutex;
+      XrdCl::CopyProgressHandler *pHandler;
+  };
+
+  //----------------------------------------------------------------------------
+  // Arguments of a copy worker thread
+  //----------------------------------------------------------------------------
+  struct CopyWorkerArgs
+  {
+    XrdCl::CopyProcess         *process;
+    XrdCl::CopyProgressHandler *handler;
+  };
+
+  //----------------------------------------------------------------------------
+  // Copy worker thread
+  //----------------------------------------------------------------------------
+  void *RunCopyWorker( void *arg )
+  {
+    CopyWorkerArgs *args = (CopyWorkerArgs*)arg;
+    args->process->RunJobs( args->handler );
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  // Tree lister thread
+  //----------------------------------------------------------------------------
+  void *RunTreeLister( void *arg )
+  {
+    ((XrdCl::CopyProcess*)arg)->ListTrees();
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  // Strip the trailing slashes
+  //----------------------------------------------------------------------------
+  std::string StripSlashes( const std::string &path )
+  {
+    size_t end = path.find_last_not_of( '/' );
+    if( end == std::string::npos )
+      return "";
+    return path.substr( 0, end+1 );
+  }
+
+  //----------------------------------------------------------------------------
+  // Check if the url points to a directory
+  //----------------------------------------------------------------------------
+  XrdCl::XRootDStatus IsDirectory( const XrdCl::URL &url, bool &isDir )
+  {
+    using namespace XrdCl;
+    if( url.GetProtocol() == "file" )
+    {
+      struct stat st;
+      if( ::stat( url.GetPath().c_str(), &st ) != 0 )
+        return XRootDStatus( stError, errOSError, errno );
+      isDir = S_ISDIR( st.st_mode );
+      return XRootDStatus();
+    }
+
+    FileSystem   fs( url );
+    StatInfo    *statInfo = 0;
+    XRootDStatus st       = fs.Stat( url.GetPath(), statInfo );
+    if( !st.IsOK() )
+      return st;
+    isDir = statInfo->TestFlags( StatInfo::IsDir );
+    delete statInfo;
+    return XRootDStatus();
+  }
+
+  //----------------------------------------------------------------------------
+  // Create a destination directory, it's fine if it exists
+  //----------------------------------------------------------------------------
+  XrdCl::XRootDStatus MakeDirectory( const XrdCl::URL &url )
+  {
+    using namespace XrdCl;
+    if( url.GetProtocol() == "file" )
+    {
+      if( ::mkdir( url.GetPath().c_str(), 0755 ) != 0 && errno != EEXIST )
+        return XRootDStatus( stError, errOSError, errno );
+      return XRootDStatus();
+    }
+
+    FileSystem fs( url );
+    return fs.MkDir( url.GetPath(), MkDirFlags::MakePath,
+                     Access::UR|Access::UW|Access::UX|Access::GR|Access::GX|
+                     Access::OR|Access::OX );
+  }
+
+  //----------------------------------------------------------------------------
+  // Create the destination directories and the copy jobs for the entries
+  // of a source tree
+  //----------------------------------------------------------------------------
+  class TreeJobCreator: public XrdCl::DirTreeHandler
+  {
+    public:
+      TreeJobCreator( XrdCl::CopyProcess *process,
+                      const XrdCl::URL   *source,
+                      const XrdCl::URL   *destination ):
+        pProcess( process ),
+        pSourcePath( StripSlashes( source->GetPath() ) ),
+        pDestination( destination ) {}
+
+      virtual void HandleDirectory( const XrdCl::URL &url )
+      {
+        using namespace XrdCl;
+        URL          dst = GetDestination( url );
+        XRootDStatus st  = MakeDirectory( dst );
+        if( !st.IsOK() )
+          DefaultEnv::GetLog()->Debug( UtilityMsg, "CopyProcess: unable to "
+                                       "create %s: %s", dst.GetURL().c_str(),
+                                       st.ToStr().c_str() );
+      }
+
+      virtual void HandleFile( const XrdCl::URL      &url,
+                               const XrdCl::StatInfo &info )
+      {
+        using namespace XrdCl;
+        (void)info;
+        pProcess->AddJob( new URL( url ), new URL( GetDestination( url ) ) );
+      }
+
+      virtual void HandleError( const XrdCl::URL          &url,
+                                const XrdCl::XRootDStatus &status )
+      {
+        using namespace XrdCl;
+        DefaultEnv::GetLog()->Error( UtilityMsg, "CopyProcess: unable to list "
+                                     "%s completely: %s",
+                                     url.GetURL().c_str(),
+                                     status.ToStr().c_str() );
+        if( !pStatus.IsOK() )
+          return;
+        if( status.IsOK() )
+          pStatus = XRootDStatus( stError, errNotFound, 0,
+                                  "Unable to stat all the entries of " +
+                                  url.GetPath() );
+        else
+          pStatus = status;
+      }
+
+      const XrdCl::XRootDStatus &GetStatus() const
+      {
+        return pStatus;
+      }
+
+    private:
+      XrdCl::URL GetDestination( const XrdCl::URL &url )
+      {
+        XrdCl::URL dst( *pDestination );
+        dst.SetPath( dst.GetPath() +
+                     url.GetPath().substr( pSourcePath.length() ) );
+        return dst;
+      }
+
+      XrdCl::CopyProcess  *pProcess;
+      std::string          pSourcePath;
+      const XrdCl::URL    *pDestination;
+      XrdCl::XRootDStatus  pStatus;
+  };
+}
 
 namespace XrdCl
 {
+  //----------------------------------------------------------------------------
+  // Reserve the bytes
+  //----------------------------------------------------------------------------
+  bool CopyBudget::Acquire( uint64_t bytes, bool wait )
+  {
+    pCond.Lock();
+    while( pUsed && pUsed + bytes > pLimit )
+    {
+      if( !wait )
+      {
+        pCond.UnLock();
+        return false;
+      }
+      pCond.Wait();
+    }
+    pUsed += bytes;
+    pCond.UnLock();
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Release the bytes
+  //----------------------------------------------------------------------------
+  void CopyBudget::Release( uint64_t bytes )
+  {
+    pCond.Lock();
+    pUsed -= bytes;
+    pCond.Broadcast();
+    pCond.UnLock();
+  }
+
   //----------------------------------------------------------------------------
   // Destructor
   //----------------------------------------------------------------------------
@@ -140,23 +373,40 @@ namespace XrdCl
       return Status( stError, errInvalidArgs );
     }
 
+    //--------------------------------------------------------------------------
+    // Set aside the remote directories, their content is listed when
+    // the jobs run
+    //--------------------------------------------------------------------------
+    std::list<URL*>           files;
+    std::list<URL*>::iterator it;
+    for( it = pSource.begin(); it != pSource.end(); ++it )
+    {
+      if( pRecursive && (*it)->GetProtocol() == "root" )
+      {
+        bool isDir = false;
+        XRootDStatus st = IsDirectory( **it, isDir );
+        if( st.IsOK() && isDir )
+        {
+          st = AddTree( *it );
+          if( !st.IsOK() )
+            return st;
+          continue;
+        }
+      }
+      files.push_back( *it );
+    }
+
+    if( files.empty() )
+      return XRootDStatus();
+
     //--------------------------------------------------------------------------
     // We just have one job to do
     //--------------------------------------------------------------------------
-    if( pSource.size() == 1 )
+    if( files.size() == 1 && pTrees.empty() )
     {
-      CopyJob *job = 0;
-      if( pThirdParty )
-        job = new ThirdPartyCopyJob( pSource.front(), pDestination );
-      else
-        job = new ClassicCopyJob( pSource.front(), pDestination );
+      CopyJob *job = CreateJob( files.front(), pDestination );
       pJobs.push_back( job );
-      job->SetForce( pForce );
-      job->SetPosc( pPosc );
-
-      job->EnableCheckSumPrint( pCheckSumPrint );
-      if( !pCheckSumType.empty() )
-        job->EnableCheckSumVerification( pCheckSumType, pCheckSumPreset );
+      job->SetJobNumber( pJobs.size() );
     }
     //--------------------------------------------------------------------------
     // Many jobs
@@ -166,15 +416,13 @@ namespace XrdCl
       //------------------------------------------------------------------------
       // Check if the remote path exist and is a directory
       //------------------------------------------------------------------------
-      FileSystem fs( *pDestination );
-      StatInfo *statInfo = 0;
-      XRootDStatus st = fs.Stat( pDestination->GetPath(), statInfo );
+      bool isDir = false;
+      XRootDStatus st = IsDirectory( *pDestination, isDir );
       if( !st.IsOK() )
         return st;
 
-      if( !statInfo->TestFlags( StatInfo::IsDir ) )
+      if( !isDir )
       {
-        delete statInfo;
         log->Debug( UtilityMsg, "CopyProcess: destination for recursive copy "
                                 "is not a directory." );
 
@@ -184,8 +432,7 @@ namespace XrdCl
       //------------------------------------------------------------------------
       // Loop through the sources and create the destination paths
       //------------------------------------------------------------------------
-      std::list<URL*>::iterator it;
-      for( it = pSource.begin(); it != pSource.end(); ++it )
+      for( it = files.begin(); it != files.end(); ++it )
       {
         std::string pathSuffix = (*it)->GetPath();
         pathSuffix = pathSuffix.substr( pRootOffset,
@@ -194,18 +441,9 @@ namespace XrdCl
         dst->SetPath( dst->GetPath() + pathSuffix );
         pDestinations.push_back( dst );
 
-        CopyJob *job = 0;
-        if( pThirdParty )
-          job = new ThirdPartyCopyJob( pSource.front(), pDestination );
-        else
-          job = new ClassicCopyJob( *it, dst );
+        CopyJob *job = CreateJob( *it, dst );
         pJobs.push_back( job );
-        job->SetForce( pForce );
-        job->SetPosc( pPosc );
-
-        job->EnableCheckSumPrint( pCheckSumPrint );
-        if( !pCheckSumType.empty() )
-          job->EnableCheckSumVerification( pCheckSumType, pCheckSumPreset );
+        job->SetJobNumber( pJobs.size() );
       }
     }
 
@@ -217,58 +455,313 @@ namespace XrdCl
   //----------------------------------------------------------------------------
   XRootDStatus CopyProcess::Run()
   {
+    Log *log = DefaultEnv::GetLog();
+    Env *env = DefaultEnv::GetEnv();
+
+    uint16_t parallelJobs = pParallelJobs;
+    uint64_t maxInFlight  = pMaxInFlight;
+    if( !parallelJobs )
+    {
+      int val = DefaultCPParallelJobs;
+      env->GetInt( "CPParallelJobs", val );
+      parallelJobs = val > 0 ? val : 1;
+    }
+    if( !maxInFlight )
+    {
+      int val = DefaultCPMaxInFlightBytes;
+      env->GetInt( "CPMaxInFlightBytes", val );
+      maxInFlight = val > 0 ? val : 0;
+    }
+    if( parallelJobs > pJobs.size() && pTrees.empty() )
+      parallelJobs = pJobs.size();
+
+    //--------------------------------------------------------------------------
+    // Hand the budget to the jobs
+    //--------------------------------------------------------------------------
+    CopyBudget budget( maxInFlight );
+    pBudget = maxInFlight ? &budget : 0;
     std::list<CopyJob *>::iterator it;
-    uint16_t currentJob = 1;
-    uint16_t totalJobs  = pJobs.size();
+    for( it = pJobs.begin(); it != pJobs.end(); ++it )
+      (*it)->SetBudget( pBudget );
 
-    Monitor *mon = DefaultEnv::GetMonitor();
-    timeval bTOD;
+    pResult     = XRootDStatus();
+    pListResult = XRootDStatus();
+    pNextJob    = pJobs.begin();
+    pJobCount   = pJobs.size();
+    pListing    = !pTrees.empty();
+
+    if( pListing )
+      log->Debug( UtilityMsg, "CopyProcess: copying %d directory trees, %d "
+                  "jobs in parallel", pTrees.size(), parallelJobs );
+    else if( parallelJobs > 1 )
+      log->Debug( UtilityMsg, "CopyProcess: running %d jobs, %d in parallel",
+                  pJobs.size(), parallelJobs );
+
+    //--------------------------------------------------------------------------
+    // List the trees while the jobs are running
+    //--------------------------------------------------------------------------
+    pthread_t lister;
+    bool      listerRunning = false;
+    if( pListing )
+    {
+      int ret = pthread_create( &lister, 0, RunTreeLister, this );
+      if( ret != 0 )
+      {
+        log->Error( UtilityMsg, "CopyProcess: unable to spawn the lister "
+                    "thread: %s", strerror( ret ) );
+        ListTrees();
+      }
+      else
+        listerRunning = true;
+    }
+
+    //--------------------------------------------------------------------------
+    // Run the jobs in this thread or in the workers
+    //--------------------------------------------------------------------------
+    if( parallelJobs <= 1 )
+      RunJobs( pProgressHandler );
+    else
+    {
+      SerialProgressHandler serialHandler( pProgressHandler );
+      CopyWorkerArgs        args;
+      args.process = this;
+      args.handler = pProgressHandler ? &serialHandler : 0;
+
+      std::vector<pthread_t> workers;
+      for( uint16_t i = 0; i < parallelJobs; ++i )
+      {
+        pthread_t worker;
+        int       ret = pthread_create( &worker, 0, RunCopyWorker, &args );
+        if( ret != 0 )
+        {
+          log->Error( UtilityMsg, "CopyProcess: unable to spawn a worker "
+                      "thread: %s", strerror( ret ) );
+          break;
+        }
+        workers.push_back( worker );
+      }
+
+      if( workers.empty() )
+        RunJobs( args.handler );
+
+      for( size_t i = 0; i < workers.size(); ++i )
+        pthread_join( workers[i], 0 );
+    }
+
+    if( listerRunning )
+      pthread_join( lister, 0 );
 
     for( it = pJobs.begin(); it != pJobs.end(); ++it )
+      (*it)->SetBudget( 0 );
+    pBudget = 0;
+
+    if( pResult.IsOK() )
+      return pListResult;
+    return pResult;
+  }
+
+  //----------------------------------------------------------------------------
+  // Run the jobs one after another
+  //----------------------------------------------------------------------------
+  void CopyProcess::RunJobs( CopyProgressHandler *handler )
+  {
+    while( 1 )
     {
       //------------------------------------------------------------------------
-      // Report beginning of the copy
+      // Wait for the lister if it may still come up with new jobs
       //------------------------------------------------------------------------
-      if( pProgressHandler )
-        pProgressHandler->BeginJob( currentJob, totalJobs,
-                                    (*it)->GetSource(),
-                                    (*it)->GetDestination() );
+      pJobCond.Lock();
+      while( pResult.IsOK() && pNextJob == pJobs.end() && pListing )
+        pJobCond.Wait();
 
-      if( mon )
+      if( !pResult.IsOK() || pNextJob == pJobs.end() )
       {
-        Monitor::CopyBInfo i;
-        i.transfer.origin = (*it)->GetSource();
-        i.transfer.target = (*it)->GetDestination();
-        mon->Event( Monitor::EvCopyBeg, &i );
+        pJobCond.UnLock();
+        return;
       }
+      CopyJob *job = *pNextJob;
+      ++pNextJob;
+      pJobCond.UnLock();
 
-      gettimeofday( &bTOD, 0 );
+      XRootDStatus st = RunJob( job, handler );
+      if( !st.IsOK() )
+      {
+        XrdSysCondVarHelper scopedLock( pJobCond );
+        if( pResult.IsOK() )
+          pResult = st;
+        pJobCond.Broadcast();
+      }
+    }
+  }
 
-      //------------------------------------------------------------------------
-      // Do the copy
-      //------------------------------------------------------------------------
-      XRootDStatus st = (*it)->Run( pProgressHandler );
+  //----------------------------------------------------------------------------
+  // List the source trees
+  //----------------------------------------------------------------------------
+  void CopyProcess::ListTrees()
+  {
+    std::list<Tree>::iterator it;
+    for( it = pTrees.begin(); it != pTrees.end(); ++it )
+    {
+      TreeJobCreator creator( this, it->first, it->second );
+      DirTreeWalker  walker( pParallelDirLists );
+      XRootDStatus   st = walker.Walk( *it->first, &creator );
+      if( st.IsOK() )
+        st = creator.GetStatus();
 
-      //------------------------------------------------------------------------
-      // Report end of the copy
-      //------------------------------------------------------------------------
-      if( mon )
+      if( !st.IsOK() )
       {
-        Monitor::CopyEInfo i;
-        i.transfer.origin = (*it)->GetSource();
-        i.transfer.target = (*it)->GetDestination();
-        i.sources         = (*it)->GetNumberOfSources();
-        i.bTOD            = bTOD;
-        gettimeofday( &i.eTOD, 0 );
-        i.status          = &st;
-        mon->Event( Monitor::EvCopyEnd, &i );
+        XrdSysCondVarHelper scopedLock( pJobCond );
+        if( pListResult.IsOK() )
+          pListResult = st;
       }
+    }
+
+    XrdSysCondVarHelper scopedLock( pJobCond );
+    pListing = false;
+    pJobCond.Broadcast();
+  }
+
+  //----------------------------------------------------------------------------
+  // Queue a job
+  //----------------------------------------------------------------------------
+  void CopyProcess::AddJob( URL *source, URL *destination )
+  {
+    XrdSysCondVarHelper scopedLock( pJobCond );
+    pSource.push_back( source );
+    pDestinations.push_back( destination );
+
+    //--------------------------------------------------------------------------
+    // The jobs that would never run are not worth creating
+    //--------------------------------------------------------------------------
+    if( !pResult.IsOK() )
+      return;
+
+    CopyJob *job = CreateJob( source, destination );
+    job->SetJobNumber( ++pJobCount );
+    job->SetBudget( pBudget );
+    pJobs.push_back( job );
+    if( pNextJob == pJobs.end() )
+      --pNextJob;
+    pJobCond.Broadcast();
+  }
 
-      if( pProgressHandler )
-        pProgressHandler->EndJob( st );
-      if( !st.IsOK() ) return st;
-      ++currentJob;
+  //----------------------------------------------------------------------------
+  // Run a copy job
+  //----------------------------------------------------------------------------
+  XRootDStatus CopyProcess::RunJob( CopyJob *job, CopyProgressHandler *handler )
+  {
+    Monitor *mon = DefaultEnv::GetMonitor();
+    timeval bTOD;
+
+    //--------------------------------------------------------------------------
+    // Report beginning of the copy
+    //--------------------------------------------------------------------------
+    if( handler )
+    {
+      pJobCond.Lock();
+      uint16_t jobTotal = pJobCount;
+      pJobCond.UnLock();
+      handler->BeginJob( job->GetJobNumber(), jobTotal,
+                         job->GetSource(), job->GetDestination() );
     }
+
+    if( mon )
+    {
+      Monitor::CopyBInfo i;
+      i.transfer.origin = job->GetSource();
+      i.transfer.target = job->GetDestination();
+      mon->Event( Monitor::EvCopyBeg, &i );
+    }
+
+    gettimeofday( &bTOD, 0 );
+
+    //--------------------------------------------------------------------------
+    // Do the copy
+    //--------------------------------------------------------------------------
+    XRootDStatus st = job->Run( handler );
+
+    //--------------------------------------------------------------------------
+    // Report end of the copy
+    //--------------------------------------------------------------------------
+    if( mon )
+    {
+      Monitor::CopyEInfo i;
+      i.transfer.origin = job->GetSource();
+      i.transfer.target = job->GetDestination();
+      i.sources         = job->GetNumberOfSources();
+      i.bTOD            = bTOD;
+      gettimeofday( &i.eTOD, 0 );
+      i.status          = &st;
+      mon->Event( Monitor::EvCopyEnd, &i );
+    }
+
+    if( handler )
+      handler->EndJob( job->GetJobNumber(), st );
+    return st;
+  }
+
+  //----------------------------------------------------------------------------
+  // Create a copy job with the settings of the process
+  //----------------------------------------------------------------------------
+  CopyJob *CopyProcess::CreateJob( URL *source, URL *destination )
+  {
+    CopyJob *job = 0;
+    if( pThirdParty )
+      job = new ThirdPartyCopyJob( source, destination );
+    else
+      job = new ClassicCopyJob( source, destination );
+    job->SetForce( pForce );
+    job->SetPosc( pPosc );
+    job->SetResume( pResume );
+    job->SetChunkSize( pChunkSize );
+    job->SetParallelChunks( pParallelChunks );
+    job->SetSourceLimit( pSourceLimit );
+
+    job->EnableCheckSumPrint( pCheckSumPrint );
+    if( !pCheckSumType.empty() )
+      job->EnableCheckSumVerification( pCheckSumType, pCheckSumPreset );
+    return job;
+  }
+
+  //----------------------------------------------------------------------------
+  // Set aside a source directory tree and create its destination
+  //----------------------------------------------------------------------------
+  XRootDStatus CopyProcess::AddTree( URL *source )
+  {
+    Log *log = DefaultEnv::GetLog();
+
+    bool isDir = false;
+    XRootDStatus st = IsDirectory( *pDestination, isDir );
+    if( !st.IsOK() )
+      return st;
+
+    if( !isDir )
+    {
+      log->Debug( UtilityMsg, "CopyProcess: destination for recursive copy "
+                              "is not a directory." );
+      return Status( stError, errInvalidArgs, EINVAL );
+    }
+
+    //--------------------------------------------------------------------------
+    // The tree goes into the destination directory under its own name
+    //--------------------------------------------------------------------------
+    std::string srcPath = StripSlashes( source->GetPath() );
+    std::string name    = srcPath.substr( srcPath.rfind( '/' ) + 1 );
+    URL *dst = new URL( *pDestination );
+    dst->SetPath( StripSlashes( dst->GetPath() ) + "/" + name );
+    pDestinations.push_back( dst );
+
+    st = MakeDirectory( *dst );
+    if( !st.IsOK() )
+    {
+      log->Debug( UtilityMsg, "CopyProcess: unable to create %s: %s",
+                  dst->GetURL().c_str(), st.ToStr().c_str() );
+      return st;
+    }
+
+    log->Debug( UtilityMsg, "CopyProcess: copying tree %s into %s",
+                source->GetURL().c_str(), dst->GetURL().c_str() );
+    pTrees.push_back( Tree( source, dst ) );
     return XRootDStatus();
   }
 }
@@ -21,12 +21,17 @@
 
 #include "XrdCl/XrdClURL.hh"
 #include "XrdCl/XrdClXRootDResponses.hh"
+#include "XrdSys/XrdSysPthread.hh"
 #include <stdint.h>
+#include <list>
+#include <utility>
 
 namespace XrdCl
 {
   //----------------------------------------------------------------------------
-  //! Interface for copy progress notification
+  //! Interface for copy progress notification. When the jobs run in
+  //! parallel the notifications concerning different jobs are interleaved
+  //! but never delivered concurrently.
   //----------------------------------------------------------------------------
   class CopyProgressHandler
   {
@@ -37,7 +42,9 @@ namespace XrdCl
       //! Notify when a new job is about to start
       //!
       //! @param jobNum         the job number of the copy job concerned
-      //! @param jobTotal       total number of jobs being processed
+      //! @param jobTotal       total number of jobs being processed, when
+      //!                       directory trees are being copied it is the
+      //!                       number of jobs created so far
       //! @param source         the source url of the current job
       //! @param destination    the destination url of the current job
       //------------------------------------------------------------------------
@@ -47,23 +54,65 @@ namespace XrdCl
                              const URL *destination ) = 0;
 
       //------------------------------------------------------------------------
-      //! Notify when the previous job has finished
+      //! Notify when a job has finished
       //!
+      //! @param jobNum the job number of the copy job concerned
       //! @param status status of the job
       //------------------------------------------------------------------------
-      virtual void EndJob( const XRootDStatus &status ) = 0;
+      virtual void EndJob( uint16_t            jobNum,
+                           const XRootDStatus &status ) = 0;
 
       //------------------------------------------------------------------------
-      //! Notify about the progress of the current job
+      //! Notify about the progress of a job
       //!
-      //! @param bytesProcessed bytes processed by the current job
-      //! @param bytesTotal     total number of bytes to be processed by the 
-      //!                       current job
+      //! @param jobNum         the job number of the copy job concerned
+      //! @param bytesProcessed bytes processed by the job
+      //! @param bytesTotal     total number of bytes to be processed by the
+      //!                       job
       //------------------------------------------------------------------------
-      virtual void JobProgress( uint64_t bytesProcessed,
+      virtual void JobProgress( uint16_t jobNum,
+                                uint64_t bytesProcessed,
                                 uint64_t bytesTotal ) = 0;
   };
 
+  //----------------------------------------------------------------------------
+  //! Limit on the number of bytes held in the buffers of all the jobs of
+  //! a copy process
+  //----------------------------------------------------------------------------
+  class CopyBudget
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Constructor
+      //!
+      //! @param limit maximum number of bytes in the fly
+      //------------------------------------------------------------------------
+      CopyBudget( uint64_t limit ):
+        pLimit( limit ), pUsed( 0 ) {}
+
+      //------------------------------------------------------------------------
+      //! Reserve the given number of bytes. A request bigger than the limit
+      //! is granted when nothing else is reserved. A job should only wait
+      //! when it does not hold any reservation itself, otherwise the jobs
+      //! may end up waiting for each other.
+      //!
+      //! @param bytes number of bytes to be reserved
+      //! @param wait  wait for the bytes to become available
+      //! @return      true if the bytes have been reserved
+      //------------------------------------------------------------------------
+      bool Acquire( uint64_t bytes, bool wait );
+
+      //------------------------------------------------------------------------
+      //! Release the reserved bytes
+      //------------------------------------------------------------------------
+      void Release( uint64_t bytes );
+
+    private:
+      XrdSysCondVar pCond;
+      uint64_t      pLimit;
+      uint64_t      pUsed;
+  };
+
   //----------------------------------------------------------------------------
   //! Copy job
   //----------------------------------------------------------------------------
@@ -74,7 +123,9 @@ namespace XrdCl
       //! Constructor
       //------------------------------------------------------------------------
       CopyJob():
-        pSource( 0 ), pDestination( 0 ), pForce( 0 ), pPosc( 0 ) {}
+        pSource( 0 ), pDestination( 0 ), pForce( 0 ), pPosc( 0 ),
+        pChunkSize( 0 ), pParallelChunks( 0 ), pJobNum( 0 ), pBudget( 0 ),
+        pSourceLimit( 1 ), pResume( false ) {}
 
       //------------------------------------------------------------------------
       //! Virtual destructor
@@ -139,6 +190,71 @@ namespace XrdCl
         pPosc = posc;
       }
 
+      //------------------------------------------------------------------------
+      //! Continue the copy interrupted earlier, the ranges copied already
+      //! are recorded in a journal; false means the CPResume environment
+      //! default. Ignored with POSC, a failed copy leaves nothing to
+      //! continue.
+      //------------------------------------------------------------------------
+      void SetResume( bool resume )
+      {
+        pResume = resume;
+      }
+
+      //------------------------------------------------------------------------
+      //! Set the size of the chunks the data is transferred in, 0 means
+      //! the CPChunkSize environment default adjusted to the throughput
+      //! if CPAdaptive is set
+      //------------------------------------------------------------------------
+      void SetChunkSize( uint32_t chunkSize )
+      {
+        pChunkSize = chunkSize;
+      }
+
+      //------------------------------------------------------------------------
+      //! Set the number of chunks that may be in the fly at the same time,
+      //! 0 means the CPParallelChunks environment default adjusted to
+      //! the throughput if CPAdaptive is set
+      //------------------------------------------------------------------------
+      void SetParallelChunks( uint16_t parallelChunks )
+      {
+        pParallelChunks = parallelChunks;
+      }
+
+      //------------------------------------------------------------------------
+      //! Set the job number used in the progress notifications
+      //------------------------------------------------------------------------
+      void SetJobNumber( uint16_t jobNum )
+      {
+        pJobNum = jobNum;
+      }
+
+      //------------------------------------------------------------------------
+      //! Get the job number
+      //------------------------------------------------------------------------
+      uint16_t GetJobNumber() const
+      {
+        return pJobNum;
+      }
+
+      //------------------------------------------------------------------------
+      //! Set the budget the job's buffers are to be reserved from, none
+      //! if 0
+      //------------------------------------------------------------------------
+      void SetBudget( CopyBudget *budget )
+      {
+        pBudget = budget;
+      }
+
+      //------------------------------------------------------------------------
+      //! Set the maximum number of replicas the data may be read from at
+      //! the same time
+      //------------------------------------------------------------------------
+      void SetSourceLimit( uint16_t sourceLimit )
+      {
+        pSourceLimit = sourceLimit;
+      }
+
       //------------------------------------------------------------------------
       //! Get the actual number of source
       //------------------------------------------------------------------------
@@ -173,6 +289,12 @@ namespace XrdCl
       bool         pCheckSumPrint;
       std::string  pCheckSumType;
       std::string  pCheckSumPreset;
+      uint32_t     pChunkSize;
+      uint16_t     pParallelChunks;
+      uint16_t     pJobNum;
+      CopyBudget  *pBudget;
+      uint16_t     pSourceLimit;
+      bool         pResume;
   };
 
   //----------------------------------------------------------------------------
@@ -187,13 +309,22 @@ namespace XrdCl
       CopyProcess():
         pDestination( 0 ),
         pRecursive( false ),
+        pListing( false ),
         pThirdParty( false ),
         pForce( false ),
         pPosc( false ),
+        pResume( false ),
         pSourceLimit( 1 ),
         pRootOffset( 0 ),
         pProgressHandler( 0 ),
-        pCheckSumPrint( false )
+        pCheckSumPrint( false ),
+        pChunkSize( 0 ),
+        pParallelChunks( 0 ),
+        pParallelJobs( 0 ),
+        pParallelDirLists( 0 ),
+        pMaxInFlight( 0 ),
+        pBudget( 0 ),
+        pJobCount( 0 )
       {}
 
       //------------------------------------------------------------------------
@@ -222,7 +353,9 @@ namespace XrdCl
       bool SetDestination( const URL &destination );
 
       //------------------------------------------------------------------------
-      //! Perform a recursive copy
+      //! Perform a recursive copy: the remote sources being directories
+      //! are copied with all their content into the destination directory,
+      //! the files are copied while the trees are still being listed
       //------------------------------------------------------------------------
       void SetRecursive( bool recursive )
       {
@@ -230,7 +363,8 @@ namespace XrdCl
       }
 
       //------------------------------------------------------------------------
-      //! Limit number of possibly chunk sources per job
+      //! Limit the number of replicas every job may read the data from
+      //! at the same time
       //------------------------------------------------------------------------
       void SetSourceLimit( uint16_t sourceLimit )
       {
@@ -258,6 +392,14 @@ namespace XrdCl
         pForce = force;
       }
 
+      //------------------------------------------------------------------------
+      //! Continue the interrupted copies from where they stopped
+      //------------------------------------------------------------------------
+      void SetResume( bool resume )
+      {
+        pResume = resume;
+      }
+
       //------------------------------------------------------------------------
       //! Persistify on successfull close
       //------------------------------------------------------------------------
@@ -295,31 +437,117 @@ namespace XrdCl
         pCheckSumPrint = print;
       }
 
+      //------------------------------------------------------------------------
+      //! Set the size of the chunks the data is transferred in, 0 means
+      //! the CPChunkSize environment default adjusted to the throughput
+      //! if CPAdaptive is set
+      //------------------------------------------------------------------------
+      void SetChunkSize( uint32_t chunkSize )
+      {
+        pChunkSize = chunkSize;
+      }
+
+      //------------------------------------------------------------------------
+      //! Set the number of chunks of every job that may be in the fly at
+      //! the same time, 0 means the CPParallelChunks environment default
+      //! adjusted to the throughput if CPAdaptive is set
+      //------------------------------------------------------------------------
+      void SetParallelChunks( uint16_t parallelChunks )
+      {
+        pParallelChunks = parallelChunks;
+      }
+
+      //------------------------------------------------------------------------
+      //! Set the number of jobs that may run at the same time, 0 means the
+      //! CPParallelJobs environment default
+      //------------------------------------------------------------------------
+      void SetParallelJobs( uint16_t parallelJobs )
+      {
+        pParallelJobs = parallelJobs;
+      }
+
+      //------------------------------------------------------------------------
+      //! Set the number of directories listed at the same time during
+      //! a recursive copy, 0 means the ParallelDirLists environment default
+      //------------------------------------------------------------------------
+      void SetParallelDirLists( uint16_t parallelDirLists )
+      {
+        pParallelDirLists = parallelDirLists;
+      }
+
+      //------------------------------------------------------------------------
+      //! Set the maximum number of bytes held in the buffers of all the
+      //! jobs, 0 means the CPMaxInFlightBytes environment default
+      //------------------------------------------------------------------------
+      void SetMaxInFlightBytes( uint64_t maxInFlight )
+      {
+        pMaxInFlight = maxInFlight;
+      }
+
       //------------------------------------------------------------------------
       // Prepare the copy jobs
       //------------------------------------------------------------------------
       XRootDStatus Prepare();
 
       //------------------------------------------------------------------------
-      //! Run the copy jobs
+      //! Run the copy jobs, the first error is returned and no new jobs
+      //! are started after a failure
       //------------------------------------------------------------------------
       XRootDStatus Run();
 
+      //------------------------------------------------------------------------
+      //! Run the jobs one after another until there is none left or one
+      //! fails - loop of a worker thread
+      //------------------------------------------------------------------------
+      void RunJobs( CopyProgressHandler *handler );
+
+      //------------------------------------------------------------------------
+      //! List the source directory trees and queue a job for every file
+      //! found - loop of the lister thread
+      //------------------------------------------------------------------------
+      void ListTrees();
+
+      //------------------------------------------------------------------------
+      //! Queue a job copying the source to the destination, the process
+      //! takes over the urls
+      //------------------------------------------------------------------------
+      void AddJob( URL *source, URL *destination );
+
     private:
+      typedef std::pair<URL*, URL*> Tree;
+
+      XRootDStatus RunJob( CopyJob *job, CopyProgressHandler *handler );
+      CopyJob *CreateJob( URL *source, URL *destination );
+      XRootDStatus AddTree( URL *source );
+
       std::list<URL*>      pSource;
       std::list<URL*>      pDestinations;
       std::list<CopyJob*>  pJobs;
+      std::list<Tree>      pTrees;
       URL                 *pDestination;
       bool                 pRecursive;
+      bool                 pListing;
       bool                 pThirdParty;
       bool                 pForce;
       bool                 pPosc;
+      bool                 pResume;
       uint16_t             pSourceLimit;
       uint16_t             pRootOffset;
       CopyProgressHandler *pProgressHandler;
       std::string          pCheckSumType;
       std::string          pCheckSumPreset;
       bool                 pCheckSumPrint;
+      uint32_t             pChunkSize;
+      uint16_t             pParallelChunks;
+      uint16_t             pParallelJobs;
+      uint16_t             pParallelDirLists;
+      uint64_t             pMaxInFlight;
+      CopyBudget          *pBudget;
+      XrdSysCondVar        pJobCond;
+      std::list<CopyJob*>::iterator pNextJob;
+      uint16_t             pJobCount;
+      XRootDStatus         pResult;
+      XRootDStatus         pListResult;
   };
 }
 
@@ -0,0 +1,169 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+#include "XrdCl/XrdClCopyTuner.hh"
+#include "XrdCl/XrdClUtils.hh"
+
+#include <algorithm>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Alignment of the chunk sizes
+  //----------------------------------------------------------------------------
+  const uint64_t ChunkAlignment = 4096;
+}
+
+namespace XrdCl
+{
+  //----------------------------------------------------------------------------
+  // Constructor
+  //----------------------------------------------------------------------------
+  CopyTuner::CopyTuner( bool adaptive, uint32_t chunkSize,
+                        uint16_t parallelChunks,
+                        uint32_t minChunkSize, uint32_t maxChunkSize,
+                        uint16_t minParallelChunks,
+                        uint16_t maxParallelChunks ):
+    pAdaptive( adaptive ),
+    pMinChunkSize( Align( minChunkSize ) ),
+    pMaxChunkSize( std::max( (uint32_t)Align( maxChunkSize ),
+                             pMinChunkSize ) ),
+    pMinParallel( std::max( minParallelChunks, (uint16_t)1 ) ),
+    pMaxParallel( std::max( maxParallelChunks, pMinParallel ) ),
+    pBaseParallel( std::min( std::max( parallelChunks, pMinParallel ),
+                             pMaxParallel ) ),
+    pChunkSize( std::min( std::max( (uint32_t)Align( chunkSize ),
+                                    pMinChunkSize ),
+                          pMaxChunkSize ) ),
+    pParallel( pBaseParallel ),
+    pMinRoundTrip( 0 ),
+    pIntervalBytes( 0 ),
+    pTotalBytes( 0 ),
+    pShrunk( false )
+  {
+    if( !pAdaptive )
+    {
+      pChunkSize = chunkSize;
+      pParallel  = parallelChunks;
+    }
+    pCeiling = (uint64_t)pMaxChunkSize * pMaxParallel;
+    gettimeofday( &pStart, 0 );
+    pIntervalStart = pStart;
+  }
+
+  //----------------------------------------------------------------------------
+  // A chunk has been sent
+  //----------------------------------------------------------------------------
+  void CopyTuner::ChunkSent( uint64_t offset )
+  {
+    gettimeofday( &pSent[offset], 0 );
+  }
+
+  //----------------------------------------------------------------------------
+  // A chunk has been written
+  //----------------------------------------------------------------------------
+  void CopyTuner::ChunkDone( uint64_t offset, uint32_t length )
+  {
+    timeval now;
+    gettimeofday( &now, 0 );
+
+    std::map<uint64_t, timeval>::iterator it = pSent.find( offset );
+    if( it != pSent.end() )
+    {
+      uint64_t rt = Utils::GetElapsedMicroSecs( it->second, now );
+      if( !pMinRoundTrip || rt < pMinRoundTrip )
+        pMinRoundTrip = rt ? rt : 1;
+      pSent.erase( it );
+    }
+
+    pIntervalBytes += length;
+    pTotalBytes    += length;
+
+    //--------------------------------------------------------------------------
+    // Measure over a couple of round trips at least
+    //--------------------------------------------------------------------------
+    uint64_t elapsed = Utils::GetElapsedMicroSecs( pIntervalStart, now );
+    if( !pAdaptive ||
+        elapsed < std::max( 2*pMinRoundTrip, (uint64_t)50000 ) )
+      return;
+
+    double   throughput = (double)pIntervalBytes * 1000000 / elapsed;
+    uint64_t inFlight   = (uint64_t)(2 * throughput * pMinRoundTrip /
+                                     1000000);
+    pCeiling = std::min( pCeiling + pChunkSize,
+                         (uint64_t)pMaxChunkSize * pMaxParallel );
+    Resize( inFlight );
+
+    pIntervalStart = now;
+    pIntervalBytes = 0;
+    pShrunk        = false;
+  }
+
+  //----------------------------------------------------------------------------
+  // The copy budget could not be reserved
+  //----------------------------------------------------------------------------
+  void CopyTuner::BudgetExhausted()
+  {
+    if( !pAdaptive || pShrunk )
+      return;
+    pShrunk = true;
+    uint64_t inFlight = (uint64_t)pChunkSize * pParallel;
+    pCeiling = std::max( inFlight / 2,
+                         (uint64_t)pMinChunkSize * pMinParallel );
+    Resize( pCeiling );
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the average throughput in bytes per second
+  //----------------------------------------------------------------------------
+  double CopyTuner::GetThroughput() const
+  {
+    timeval now;
+    gettimeofday( &now, 0 );
+    uint64_t elapsed = Utils::GetElapsedMicroSecs( pStart, now );
+    return elapsed ? (double)pTotalBytes * 1000000 / elapsed : 0;
+  }
+
+  //----------------------------------------------------------------------------
+  // Split the bytes in the fly into chunks
+  //----------------------------------------------------------------------------
+  void CopyTuner::Resize( uint64_t inFlight )
+  {
+    inFlight = std::min( inFlight, pCeiling );
+    inFlight = std::max( inFlight, (uint64_t)pMinChunkSize * pMinParallel );
+
+    uint64_t chunk = Align( inFlight / pBaseParallel );
+    chunk = std::min( std::max( chunk, (uint64_t)pMinChunkSize ),
+                      (uint64_t)pMaxChunkSize );
+    uint64_t parallel = (inFlight + chunk - 1) / chunk;
+    parallel = std::min( std::max( parallel, (uint64_t)pMinParallel ),
+                         (uint64_t)pMaxParallel );
+
+    pChunkSize = chunk;
+    pParallel  = parallel;
+  }
+
+  //----------------------------------------------------------------------------
+  // Round the size up to the alignment
+  //----------------------------------------------------------------------------
+  uint64_t CopyTuner::Align( uint64_t size )
+  {
+    size = (size + ChunkAlignment - 1) / ChunkAlignment;
+    return (size ? size : 1) * ChunkAlignment;
+  }
+}
@@ -0,0 +1,123 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+#ifndef __XRD_CL_COPY_TUNER_HH__
+#define __XRD_CL_COPY_TUNER_HH__
+
+#include <map>
+#include <stdint.h>
+#include <sys/time.h>
+
+namespace XrdCl
+{
+  //----------------------------------------------------------------------------
+  //! Adjust the chunk size and the number of chunks in the fly to what
+  //! the transfer achieves, the way a congestion controller does. The
+  //! bytes in the fly follow twice the bandwidth-delay product, estimated
+  //! as the throughput times the shortest round trip of a chunk, from
+  //! the read request to the completed write. The chunks grow first and
+  //! then their number. Running out of the copy budget halves the bytes
+  //! allowed in the fly, the allowance then grows back by a chunk with
+  //! every adjustment. When not adaptive the initial parameters are kept.
+  //! The chunk sizes are multiples of 4k so that they suit direct I/O.
+  //----------------------------------------------------------------------------
+  class CopyTuner
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Constructor
+      //!
+      //! @param adaptive       adjust the parameters
+      //! @param chunkSize      initial chunk size
+      //! @param parallelChunks initial number of chunks in the fly, the
+      //!                       chunks grow until the number of them is
+      //!                       needed to go further
+      //------------------------------------------------------------------------
+      CopyTuner( bool adaptive, uint32_t chunkSize, uint16_t parallelChunks,
+                 uint32_t minChunkSize, uint32_t maxChunkSize,
+                 uint16_t minParallelChunks, uint16_t maxParallelChunks );
+
+      //------------------------------------------------------------------------
+      //! A chunk has been sent
+      //------------------------------------------------------------------------
+      void ChunkSent( uint64_t offset );
+
+      //------------------------------------------------------------------------
+      //! A chunk has been written, adjust the parameters if it's time
+      //------------------------------------------------------------------------
+      void ChunkDone( uint64_t offset, uint32_t length );
+
+      //------------------------------------------------------------------------
+      //! The copy budget could not be reserved, backs off once per
+      //! adjustment interval
+      //------------------------------------------------------------------------
+      void BudgetExhausted();
+
+      //------------------------------------------------------------------------
+      //! Get the chunk size
+      //------------------------------------------------------------------------
+      uint32_t GetChunkSize() const
+      {
+        return pChunkSize;
+      }
+
+      //------------------------------------------------------------------------
+      //! Get the number of chunks in the fly
+      //------------------------------------------------------------------------
+      uint16_t GetParallelChunks() const
+      {
+        return pParallel;
+      }
+
+      //------------------------------------------------------------------------
+      //! Get the shortest round trip of a chunk in microseconds
+      //------------------------------------------------------------------------
+      uint64_t GetMinRoundTrip() const
+      {
+        return pMinRoundTrip;
+      }
+
+      //------------------------------------------------------------------------
+      //! Get the average throughput in bytes per second
+      //------------------------------------------------------------------------
+      double GetThroughput() const;
+
+    private:
+      void Resize( uint64_t inFlight );
+      static uint64_t Align( uint64_t size );
+
+      bool                        pAdaptive;
+      uint32_t                    pMinChunkSize;
+      uint32_t                    pMaxChunkSize;
+      uint16_t                    pMinParallel;
+      uint16_t                    pMaxParallel;
+      uint16_t                    pBaseParallel;
+      uint32_t                    pChunkSize;
+      uint16_t                    pParallel;
+      uint64_t                    pCeiling;
+      uint64_t                    pMinRoundTrip;
+      uint64_t                    pIntervalBytes;
+      uint64_t                    pTotalBytes;
+      timeval                     pStart;
+      timeval                     pIntervalStart;
+      std::map<uint64_t, timeval> pSent;
+      bool                        pShrunk;
+  };
+}
+
+#endif // __XRD_CL_COPY_TUNER_HH__
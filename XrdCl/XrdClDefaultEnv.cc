@@ -23,6 +23,9 @@
 #include "XrdCl/XrdClForkHandler.hh"
 #include "XrdCl/XrdClUtils.hh"
 #include "XrdCl/XrdClMonitor.hh"
+#include "XrdCl/XrdClReadHedger.hh"
+#include "XrdCl/XrdClRedirectCache.hh"
+#include "XrdCl/XrdClFileHandleCache.hh"
 #include "XrdSys/XrdSysPlugin.hh"
 #include "XrdSys/XrdSysUtils.hh"
 #include "XrdSys/XrdSysLogger.hh"
@@ -133,6 +136,10 @@ namespace XrdCl
   bool            DefaultEnv::sMonitorInitialized = false;
   XrdCks         *DefaultEnv::sCheckSumManager    = 0;
   bool            DefaultEnv::sCheckSumManagerInitialized = false;
+  ReadHedger     *DefaultEnv::sReadHedger         = 0;
+  bool            DefaultEnv::sFinalized          = false;
+  RedirectCache  *DefaultEnv::sRedirectCache      = 0;
+  FileHandleCache *DefaultEnv::sFileHandleCache   = 0;
 
   //----------------------------------------------------------------------------
   // Constructor
@@ -147,9 +154,45 @@ namespace XrdCl
     PutInt( "StreamErrorWindow",     DefaultStreamErrorWindow    );
     PutInt( "RunForkHandler",        DefaultRunForkHandler       );
     PutInt( "RedirectLimit",         DefaultRedirectLimit       );
+    PutInt( "MaxReadVSegments",      DefaultMaxReadVSegments     );
+    PutInt( "MaxReadVSize",          DefaultMaxReadVSize         );
+    PutInt( "PrefetchMaxSize",       DefaultPrefetchMaxSize      );
+    PutInt( "ReadHedging",           DefaultReadHedging          );
+    PutInt( "ReadHedgeMinDelay",     DefaultReadHedgeMinDelay    );
+    PutInt( "ReadHedgeMaxDelay",     DefaultReadHedgeMaxDelay    );
+    PutInt( "ReadHedgeMaxInFlight",  DefaultReadHedgeMaxInFlight );
+    PutInt( "CPChunkSize",           DefaultCPChunkSize          );
+    PutInt( "CPParallelChunks",      DefaultCPParallelChunks     );
+    PutInt( "CPParallelJobs",        DefaultCPParallelJobs       );
+    PutInt( "CPMaxInFlightBytes",    DefaultCPMaxInFlightBytes   );
+    PutInt( "CPAdaptive",            DefaultCPAdaptive           );
+    PutInt( "CPMinChunkSize",        DefaultCPMinChunkSize       );
+    PutInt( "CPMaxChunkSize",        DefaultCPMaxChunkSize       );
+    PutInt( "CPMinParallelChunks",   DefaultCPMinParallelChunks  );
+    PutInt( "CPMaxParallelChunks",   DefaultCPMaxParallelChunks  );
+    PutInt( "CPSparseLocal",         DefaultCPSparseLocal        );
+    PutInt( "CPSparseRemote",        DefaultCPSparseRemote       );
+    PutInt( "CPResume",              DefaultCPResume             );
+    PutInt( "CheckSumThreads",       DefaultCheckSumThreads      );
+    PutInt( "CPTPCTimeout",          DefaultCPTPCTimeout         );
+    PutInt( "CPStallTimeout",        DefaultCPStallTimeout       );
+    PutInt( "ParallelDirLists",      DefaultParallelDirLists     );
+    PutInt( "DirListStatQuota",      DefaultDirListStatQuota     );
+    PutInt( "MetadataCacheTTL",      DefaultMetadataCacheTTL     );
+    PutInt( "MetadataNegCacheTTL",   DefaultMetadataNegCacheTTL  );
+    PutInt( "MetadataCacheSize",     DefaultMetadataCacheSize    );
+    PutInt( "RedirectCacheTTL",      DefaultRedirectCacheTTL     );
+    PutInt( "RedirectCacheSize",     DefaultRedirectCacheSize    );
+    PutInt( "BatchWindow",           DefaultBatchWindow          );
+    PutInt( "ParallelLocates",       DefaultParallelLocates      );
+    PutInt( "FileHandleLinger",      DefaultFileHandleLinger     );
+    PutInt( "FileHandleCacheSize",   DefaultFileHandleCacheSize  );
     PutString( "PollerPreference",   DefaultPollerPreference     );
     PutString( "ClientMonitor",      DefaultClientMonitor        );
     PutString( "ClientMonitorParam", DefaultClientMonitorParam   );
+    PutString( "PrefetchProfileDir", DefaultPrefetchProfileDir   );
+    PutString( "CPLocalIOEngine",    DefaultCPLocalIOEngine      );
+    PutString( "CPJournalDir",       DefaultCPJournalDir         );
 
     ImportInt(    "ConnectionWindow",     "XRD_CONNECTIONWINDOW"     );
     ImportInt(    "ConnectionRetry",      "XRD_CONNECTIONRETRY"      );
@@ -159,9 +202,45 @@ namespace XrdCl
     ImportInt(    "StreamErrorWindow",    "XRD_STREAMERRORWINDOW"    );
     ImportInt(    "RunForkHandler",       "XRD_RUNFORKHANDLER"       );
     ImportInt(    "RedirectLimit",        "XRD_REDIRECTLIMIT"        );
+    ImportInt(    "MaxReadVSegments",     "XRD_MAXREADVSEGMENTS"     );
+    ImportInt(    "MaxReadVSize",         "XRD_MAXREADVSIZE"         );
+    ImportInt(    "PrefetchMaxSize",      "XRD_PREFETCHMAXSIZE"      );
+    ImportInt(    "ReadHedging",          "XRD_READHEDGING"          );
+    ImportInt(    "ReadHedgeMinDelay",    "XRD_READHEDGEMINDELAY"    );
+    ImportInt(    "ReadHedgeMaxDelay",    "XRD_READHEDGEMAXDELAY"    );
+    ImportInt(    "ReadHedgeMaxInFlight", "XRD_READHEDGEMAXINFLIGHT" );
+    ImportInt(    "CPChunkSize",          "XRD_CPCHUNKSIZE"          );
+    ImportInt(    "CPParallelChunks",     "XRD_CPPARALLELCHUNKS"     );
+    ImportInt(    "CPParallelJobs",       "XRD_CPPARALLELJOBS"       );
+    ImportInt(    "CPMaxInFlightBytes",   "XRD_CPMAXINFLIGHTBYTES"   );
+    ImportInt(    "CPAdaptive",           "XRD_CPADAPTIVE"           );
+    ImportInt(    "CPMinChunkSize",       "XRD_CPMINCHUNKSIZE"       );
+    ImportInt(    "CPMaxChunkSize",       "XRD_CPMAXCHUNKSIZE"       );
+    ImportInt(    "CPMinParallelChunks",  "XRD_CPMINPARALLELCHUNKS"  );
+    ImportInt(    "CPMaxParallelChunks",  "XRD_CPMAXPARALLELCHUNKS"  );
+    ImportInt(    "CPSparseLocal",        "XRD_CPSPARSELOCAL"        );
+    ImportInt(    "CPSparseRemote",       "XRD_CPSPARSEREMOTE"       );
+    ImportInt(    "CPResume",             "XRD_CPRESUME"             );
+    ImportInt(    "CheckSumThreads",      "XRD_CHECKSUMTHREADS"      );
+    ImportInt(    "CPTPCTimeout",         "XRD_CPTPCTIMEOUT"         );
+    ImportInt(    "CPStallTimeout",       "XRD_CPSTALLTIMEOUT"       );
+    ImportInt(    "ParallelDirLists",     "XRD_PARALLELDIRLISTS"     );
+    ImportInt(    "DirListStatQuota",     "XRD_DIRLISTSTATQUOTA"     );
+    ImportInt(    "MetadataCacheTTL",     "XRD_METADATACACHETTL"     );
+    ImportInt(    "MetadataNegCacheTTL",  "XRD_METADATANEGCACHETTL"  );
+    ImportInt(    "MetadataCacheSize",    "XRD_METADATACACHESIZE"    );
+    ImportInt(    "RedirectCacheTTL",     "XRD_REDIRECTCACHETTL"     );
+    ImportInt(    "RedirectCacheSize",    "XRD_REDIRECTCACHESIZE"    );
+    ImportInt(    "BatchWindow",          "XRD_BATCHWINDOW"          );
+    ImportInt(    "ParallelLocates",      "XRD_PARALLELLOCATES"      );
+    ImportInt(    "FileHandleLinger",     "XRD_FILEHANDLELINGER"     );
+    ImportInt(    "FileHandleCacheSize",  "XRD_FILEHANDLECACHESIZE"  );
     ImportString( "PollerPreference",     "XRD_POLLERPREFERENCE"     );
     ImportString( "ClientMonitor",        "XRD_CLIENTMONITOR"        );
     ImportString( "ClientMonitorParam",   "XRD_CLIENTMONITORPARAM"   );
+    ImportString( "PrefetchProfileDir",   "XRD_PREFETCHPROFILEDIR"   );
+    ImportString( "CPLocalIOEngine",      "XRD_CPLOCALIOENGINE"      );
+    ImportString( "CPJournalDir",         "XRD_CPJOURNALDIR"         );
   }
 
   //----------------------------------------------------------------------------
@@ -293,6 +372,77 @@ namespace XrdCl
     return sMonitor;
   }
 
+  //----------------------------------------------------------------------------
+  // Get the read hedger, none is created once the environment has been
+  // finalized
+  //----------------------------------------------------------------------------
+  ReadHedger *DefaultEnv::GetReadHedger()
+  {
+    if( unlikely(!sReadHedger) )
+    {
+      XrdSysMutexHelper scopedLock( sInitMutex );
+      if( sReadHedger || sFinalized )
+        return sReadHedger;
+      sReadHedger = new ReadHedger();
+      sReadHedger->Start();
+      sForkHandler->RegisterReadHedger( sReadHedger );
+    }
+    return sReadHedger;
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the redirect cache, the environment is checked until the cache
+  // is enabled
+  //----------------------------------------------------------------------------
+  RedirectCache *DefaultEnv::GetRedirectCache()
+  {
+    if( sRedirectCache )
+      return sRedirectCache;
+
+    int ttl        = DefaultRedirectCacheTTL;
+    int maxEntries = DefaultRedirectCacheSize;
+    GetEnv()->GetInt( "RedirectCacheTTL",  ttl );
+    GetEnv()->GetInt( "RedirectCacheSize", maxEntries );
+    if( ttl <= 0 )
+      return 0;
+
+    XrdSysMutexHelper scopedLock( sInitMutex );
+    if( !sRedirectCache )
+      sRedirectCache = new RedirectCache( ttl,
+                                          maxEntries > 0 ? maxEntries : 1 );
+    return sRedirectCache;
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the file handle cache, the environment is checked every time so
+  // that keeping the handles may be switched off, the linger time is set
+  // when the cache is created
+  //----------------------------------------------------------------------------
+  FileHandleCache *DefaultEnv::GetFileHandleCache()
+  {
+    int linger = DefaultFileHandleLinger;
+    GetEnv()->GetInt( "FileHandleLinger", linger );
+    if( linger <= 0 )
+      return 0;
+    if( sFileHandleCache )
+      return sFileHandleCache;
+
+    int maxHandles = DefaultFileHandleCacheSize;
+    GetEnv()->GetInt( "FileHandleCacheSize", maxHandles );
+    PostMaster *postMaster = GetPostMaster();
+    if( !postMaster )
+      return 0;
+
+    XrdSysMutexHelper scopedLock( sInitMutex );
+    if( !sFileHandleCache )
+    {
+      sFileHandleCache = new FileHandleCache( linger,
+                                              maxHandles > 0 ? maxHandles : 1 );
+      sFileHandleCache->Start( postMaster->GetTaskManager() );
+    }
+    return sFileHandleCache;
+  }
+
   //----------------------------------------------------------------------------
   //! Get checksum manager
   //----------------------------------------------------------------------------
@@ -368,6 +518,27 @@ namespace XrdCl
   //----------------------------------------------------------------------------
   void DefaultEnv::Finalize()
   {
+    delete sRedirectCache;
+    sRedirectCache = 0;
+
+    //--------------------------------------------------------------------------
+    // The kept file handles are closed while the post master runs, the
+    // cache goes away after the task closing the expired ones
+    //--------------------------------------------------------------------------
+    if( sFileHandleCache )
+      sFileHandleCache->Clear();
+
+    sInitMutex.Lock();
+    sFinalized = true;
+    sInitMutex.UnLock();
+
+    if( sReadHedger )
+    {
+      sReadHedger->Stop();
+      delete sReadHedger;
+      sReadHedger = 0;
+    }
+
     if( sPostMaster )
     {
       sPostMaster->Stop();
@@ -376,6 +547,9 @@ namespace XrdCl
       sPostMaster = 0;
     }
 
+    delete sFileHandleCache;
+    sFileHandleCache = 0;
+
     delete sMonitor;
     sMonitor = 0;
 
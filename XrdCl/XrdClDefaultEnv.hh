@@ -32,6 +32,9 @@ namespace XrdCl
   class Log;
   class ForkHandler;
   class Monitor;
+  class ReadHedger;
+  class RedirectCache;
+  class FileHandleCache;
 
   //----------------------------------------------------------------------------
   //! Default environment for the client. Responsible for setting/importing
@@ -71,6 +74,23 @@ namespace XrdCl
       //------------------------------------------------------------------------
       static Monitor *GetMonitor();
 
+      //------------------------------------------------------------------------
+      //! Get the read hedger, 0 once the environment has been finalized
+      //------------------------------------------------------------------------
+      static ReadHedger *GetReadHedger();
+
+      //------------------------------------------------------------------------
+      //! Get the cache of the data servers the files have been opened at,
+      //! 0 unless RedirectCacheTTL is set
+      //------------------------------------------------------------------------
+      static RedirectCache *GetRedirectCache();
+
+      //------------------------------------------------------------------------
+      //! Get the cache of the file handles kept open after a close, 0 unless
+      //! FileHandleLinger is set
+      //------------------------------------------------------------------------
+      static FileHandleCache *GetFileHandleCache();
+
       //------------------------------------------------------------------------
       //! Get checksum manager
       //------------------------------------------------------------------------
@@ -104,6 +124,10 @@ namespace XrdCl
       static bool            sMonitorInitialized;
       static XrdCks         *sCheckSumManager;
       static bool            sCheckSumManagerInitialized;
+      static ReadHedger     *sReadHedger;
+      static bool            sFinalized;
+      static RedirectCache  *sRedirectCache;
+      static FileHandleCache *sFileHandleCache;
   };
 }
 
@@ -0,0 +1,212 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+#include "XrdCl/XrdClDirTreeWalker.hh"
+#include "XrdCl/XrdClFileSystem.hh"
+#include "XrdCl/XrdClConstants.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+
+#include <vector>
+#include <cstring>
+#include <pthread.h>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Lister thread
+  //----------------------------------------------------------------------------
+  void *RunDirLister( void *arg )
+  {
+    ((XrdCl::DirTreeWalker*)arg)->ListDirectories();
+    return 0;
+  }
+}
+
+namespace XrdCl
+{
+  //----------------------------------------------------------------------------
+  // Constructor
+  //----------------------------------------------------------------------------
+  DirTreeWalker::DirTreeWalker( uint16_t parallel ):
+    pParallel( parallel ),
+    pHandler( 0 ),
+    pBusy( 0 ),
+    pPartial( false )
+  {
+    if( !pParallel )
+    {
+      int val = DefaultParallelDirLists;
+      DefaultEnv::GetEnv()->GetInt( "ParallelDirLists", val );
+      pParallel = val > 0 ? val : 1;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Walk the tree
+  //----------------------------------------------------------------------------
+  XRootDStatus DirTreeWalker::Walk( const URL &root, DirTreeHandler *handler )
+  {
+    Log *log = DefaultEnv::GetLog();
+    log->Debug( UtilityMsg, "DirTreeWalker: walking %s, %d directories at "
+                "a time", root.GetURL().c_str(), pParallel );
+
+    pRoot       = root;
+    pHandler    = handler;
+    pBusy       = 0;
+    pPartial    = false;
+    pRootStatus = XRootDStatus();
+    pQueue.clear();
+    pQueue.push_back( root.GetPath() );
+
+    //--------------------------------------------------------------------------
+    // This thread is one of the listers
+    //--------------------------------------------------------------------------
+    std::vector<pthread_t> listers;
+    for( uint16_t i = 1; i < pParallel; ++i )
+    {
+      pthread_t lister;
+      int       ret = pthread_create( &lister, 0, RunDirLister, this );
+      if( ret != 0 )
+      {
+        log->Error( UtilityMsg, "DirTreeWalker: unable to spawn a lister "
+                    "thread: %s", strerror( ret ) );
+        break;
+      }
+      listers.push_back( lister );
+    }
+
+    ListDirectories();
+
+    for( size_t i = 0; i < listers.size(); ++i )
+      pthread_join( listers[i], 0 );
+
+    if( !pRootStatus.IsOK() )
+      return pRootStatus;
+    if( pPartial )
+      return XRootDStatus( stOK, suPartial );
+    return XRootDStatus();
+  }
+
+  //----------------------------------------------------------------------------
+  // List the directories until there is none left
+  //----------------------------------------------------------------------------
+  void DirTreeWalker::ListDirectories()
+  {
+    FileSystem fs( pRoot );
+    while( 1 )
+    {
+      //------------------------------------------------------------------------
+      // Wait for a directory to list, we're done if there is none and
+      // nobody is listing anything that could produce more
+      //------------------------------------------------------------------------
+      pCond.Lock();
+      while( pQueue.empty() && pBusy )
+        pCond.Wait();
+
+      if( pQueue.empty() )
+      {
+        pCond.Broadcast();
+        pCond.UnLock();
+        return;
+      }
+
+      std::string path = pQueue.front();
+      pQueue.pop_front();
+      ++pBusy;
+      pCond.UnLock();
+
+      ListDirectory( fs, path );
+
+      pCond.Lock();
+      --pBusy;
+      pCond.Broadcast();
+      pCond.UnLock();
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // List one directory and queue its subdirectories
+  //----------------------------------------------------------------------------
+  void DirTreeWalker::ListDirectory( FileSystem &fs, const std::string &path )
+  {
+    Log           *log  = DefaultEnv::GetLog();
+    DirectoryList *list = 0;
+    URL            dirUrl( pRoot );
+    dirUrl.SetPath( path );
+
+    XRootDStatus st = fs.DirList( path, DirListFlags::Stat, list );
+    if( !st.IsOK() )
+    {
+      log->Debug( UtilityMsg, "DirTreeWalker: unable to list %s: %s",
+                  dirUrl.GetURL().c_str(), st.ToStr().c_str() );
+      XrdSysMutexHelper scopedLock( pHandlerMutex );
+      if( path == pRoot.GetPath() )
+        pRootStatus = st;
+      else
+      {
+        pPartial = true;
+        pHandler->HandleError( dirUrl, st );
+      }
+      return;
+    }
+
+    //--------------------------------------------------------------------------
+    // Report the entries, queue the subdirectories
+    //--------------------------------------------------------------------------
+    std::vector<std::string> subdirs;
+    bool                     incomplete = st.code == suPartial;
+    {
+      XrdSysMutexHelper scopedLock( pHandlerMutex );
+      DirectoryList::Iterator it;
+      for( it = list->Begin(); it != list->End(); ++it )
+      {
+        StatInfo *info = (*it)->GetStatInfo();
+        if( !info )
+        {
+          incomplete = true;
+          continue;
+        }
+
+        URL entryUrl( pRoot );
+        entryUrl.SetPath( list->GetParentName() + (*it)->GetName() );
+        if( info->TestFlags( StatInfo::IsDir ) )
+        {
+          pHandler->HandleDirectory( entryUrl );
+          subdirs.push_back( entryUrl.GetPath() );
+        }
+        else
+          pHandler->HandleFile( entryUrl, *info );
+      }
+
+      if( incomplete )
+      {
+        pPartial = true;
+        pHandler->HandleError( dirUrl, XRootDStatus( stOK, suPartial ) );
+      }
+    }
+    delete list;
+
+    if( subdirs.empty() )
+      return;
+
+    XrdSysCondVarHelper scopedLock( pCond );
+    pQueue.insert( pQueue.end(), subdirs.begin(), subdirs.end() );
+    pCond.Broadcast();
+  }
+}
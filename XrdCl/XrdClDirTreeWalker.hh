@@ -0,0 +1,119 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+#ifndef __XRD_CL_DIR_TREE_WALKER_HH__
+#define __XRD_CL_DIR_TREE_WALKER_HH__
+
+#include "XrdCl/XrdClURL.hh"
+#include "XrdCl/XrdClXRootDResponses.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include <deque>
+#include <string>
+
+namespace XrdCl
+{
+  class FileSystem;
+
+  //----------------------------------------------------------------------------
+  //! Interface for the notifications about the entries of a directory tree.
+  //! The notifications are never delivered concurrently.
+  //----------------------------------------------------------------------------
+  class DirTreeHandler
+  {
+    public:
+      virtual ~DirTreeHandler() {}
+
+      //------------------------------------------------------------------------
+      //! A subdirectory has been found, it is reported before any of
+      //! its entries
+      //!
+      //! @param url the directory
+      //------------------------------------------------------------------------
+      virtual void HandleDirectory( const URL &url )
+      {
+        (void)url;
+      }
+
+      //------------------------------------------------------------------------
+      //! A file has been found
+      //!
+      //! @param url  the file
+      //! @param info stat info of the file
+      //------------------------------------------------------------------------
+      virtual void HandleFile( const URL &url, const StatInfo &info ) = 0;
+
+      //------------------------------------------------------------------------
+      //! A directory could not be listed completely, the walk goes on
+      //!
+      //! @param url    the directory
+      //! @param status the reason
+      //------------------------------------------------------------------------
+      virtual void HandleError( const URL &url, const XRootDStatus &status )
+      {
+        (void)url; (void)status;
+      }
+  };
+
+  //----------------------------------------------------------------------------
+  //! Walk a remote directory tree listing many directories at the same time
+  //----------------------------------------------------------------------------
+  class DirTreeWalker
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Constructor
+      //!
+      //! @param parallel maximum number of directories listed at the same
+      //!                 time, 0 means the ParallelDirLists environment
+      //!                 default
+      //------------------------------------------------------------------------
+      DirTreeWalker( uint16_t parallel = 0 );
+
+      //------------------------------------------------------------------------
+      //! Walk the tree, blocks until all the directories have been listed
+      //!
+      //! @param root    the top directory
+      //! @param handler the handler notified about the entries
+      //! @return        error if the top directory could not be listed,
+      //!                suPartial if some of the subdirectories could not
+      //!                be listed
+      //------------------------------------------------------------------------
+      XRootDStatus Walk( const URL &root, DirTreeHandler *handler );
+
+      //------------------------------------------------------------------------
+      //! List the directories until there is none left - loop of a worker
+      //! thread
+      //------------------------------------------------------------------------
+      void ListDirectories();
+
+    private:
+      void ListDirectory( FileSystem &fs, const std::string &path );
+
+      uint16_t                 pParallel;
+      URL                      pRoot;
+      DirTreeHandler          *pHandler;
+      std::deque<std::string>  pQueue;
+      uint32_t                 pBusy;
+      XRootDStatus             pRootStatus;
+      bool                     pPartial;
+      XrdSysCondVar            pCond;
+      XrdSysMutex              pHandlerMutex;
+  };
+}
+
+#endif // __XRD_CL_DIR_TREE_WALKER_HH__
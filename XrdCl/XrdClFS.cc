@@ -27,6 +27,7 @@
 #include <cstdio>
 #include <iostream>
 #include <iomanip>
+#include <fstream>
 
 #ifdef HAVE_READLINE
 #include <readline/readline.h>
@@ -96,6 +97,72 @@ XRootDStatus BuildPath( std::string &newPath, Env *env,
   return XRootDStatus();
 }
 
+//------------------------------------------------------------------------------
+// Check if the argument names a list of paths
+//------------------------------------------------------------------------------
+bool IsPathList( const std::string &arg )
+{
+  return arg.length() > 1 && arg[0] == '@';
+}
+
+//------------------------------------------------------------------------------
+// Build the paths listed one per line in the file named by the argument,
+// @- stands for the standard input
+//------------------------------------------------------------------------------
+XRootDStatus BuildPathList( std::vector<std::string> &paths, Env *env,
+                            const std::string &arg )
+{
+  std::ifstream  file;
+  std::istream  *in       = &std::cin;
+  std::string    listName = arg.substr( 1 );
+  if( listName != "-" )
+  {
+    file.open( listName.c_str() );
+    if( !file )
+      return XRootDStatus( stError, errOSError );
+    in = &file;
+  }
+
+  std::string line, path;
+  while( std::getline( *in, line ) )
+  {
+    if( !line.empty() && line[line.length()-1] == '\r' )
+      line.erase( line.length()-1 );
+    if( line.empty() )
+      continue;
+    XRootDStatus st = BuildPath( path, env, line );
+    if( !st.IsOK() )
+      return st;
+    paths.push_back( path );
+  }
+
+  if( paths.empty() )
+    return XRootDStatus( stError, errInvalidArgs );
+  return XRootDStatus();
+}
+
+//------------------------------------------------------------------------------
+// Report the paths a batch has failed for, the status of the first one
+// is returned
+//------------------------------------------------------------------------------
+XRootDStatus ReportBatch( const char                      *action,
+                          const std::vector<std::string>  &paths,
+                          const std::vector<XRootDStatus> &results )
+{
+  Log          *log = DefaultEnv::GetLog();
+  XRootDStatus  ret;
+  for( uint32_t i = 0; i < results.size(); ++i )
+  {
+    if( results[i].IsOK() )
+      continue;
+    log->Error( AppMsg, "Unable to %s %s: %s", action, paths[i].c_str(),
+                results[i].ToStr().c_str() );
+    if( ret.IsOK() )
+      ret = results[i];
+  }
+  return ret;
+}
+
 //------------------------------------------------------------------------------
 // Convert mode string to uint16_t
 //------------------------------------------------------------------------------
@@ -249,8 +316,12 @@ XRootDStatus DoLS( FileSystem                      *fs,
   }
 
   if( st.code == suPartial )
+  {
     log->Info( AppMsg, "Some of the requests failed. The result may be "
                        "incomplete" );
+    if( !st.GetErrorMessage().empty() )
+      log->Info( AppMsg, "Failed servers: %s", st.GetErrorMessage().c_str() );
+  }
 
   //----------------------------------------------------------------------------
   // Print the results
@@ -341,6 +412,19 @@ XRootDStatus DoMkDir( FileSystem                      *fs,
     return st;
   }
 
+  if( IsPathList( path ) )
+  {
+    std::vector<std::string>  paths;
+    std::vector<XRootDStatus> results;
+    if( !BuildPathList( paths, env, path ).IsOK() )
+    {
+      log->Error( AppMsg, "Invalid path list." );
+      return XRootDStatus( stError, errInvalidArgs );
+    }
+    fs->MkDir( paths, flags, mode, results );
+    return ReportBatch( "create directory", paths, results );
+  }
+
   std::string newPath;
   if( !BuildPath( newPath, env, path ).IsOK() )
   {
@@ -382,6 +466,19 @@ XRootDStatus DoRmDir( FileSystem                      *query,
     return XRootDStatus( stError, errInvalidArgs );
   }
 
+  if( IsPathList( args[1] ) )
+  {
+    std::vector<std::string>  paths;
+    std::vector<XRootDStatus> results;
+    if( !BuildPathList( paths, env, args[1] ).IsOK() )
+    {
+      log->Error( AppMsg, "Invalid path list." );
+      return XRootDStatus( stError, errInvalidArgs );
+    }
+    query->RmDir( paths, results );
+    return ReportBatch( "remove directory", paths, results );
+  }
+
   std::string fullPath;
   if( !BuildPath( fullPath, env, args[1] ).IsOK() )
   {
@@ -471,6 +568,19 @@ XRootDStatus DoRm( FileSystem                      *fs,
     return XRootDStatus( stError, errInvalidArgs );
   }
 
+  if( IsPathList( args[1] ) )
+  {
+    std::vector<std::string>  paths;
+    std::vector<XRootDStatus> results;
+    if( !BuildPathList( paths, env, args[1] ).IsOK() )
+    {
+      log->Error( AppMsg, "Invalid path list." );
+      return XRootDStatus( stError, errInvalidArgs );
+    }
+    fs->Rm( paths, results );
+    return ReportBatch( "remove", paths, results );
+  }
+
   std::string fullPath;
   if( !BuildPath( fullPath, env, args[1] ).IsOK() )
   {
@@ -512,13 +622,6 @@ XRootDStatus DoTruncate( FileSystem                      *fs,
     return XRootDStatus( stError, errInvalidArgs );
   }
 
-  std::string fullPath;
-  if( !BuildPath( fullPath, env, args[1] ).IsOK() )
-  {
-    log->Error( AppMsg, "Invalid path." );
-    return XRootDStatus( stError, errInvalidArgs );
-  }
-
   char *result;
   uint64_t size = ::strtoll( args[2].c_str(), &result, 0 );
   if( *result != 0 )
@@ -527,6 +630,26 @@ XRootDStatus DoTruncate( FileSystem                      *fs,
     return XRootDStatus( stError, errInvalidArgs );
   }
 
+  if( IsPathList( args[1] ) )
+  {
+    std::vector<std::string>  paths;
+    std::vector<XRootDStatus> results;
+    if( !BuildPathList( paths, env, args[1] ).IsOK() )
+    {
+      log->Error( AppMsg, "Invalid path list." );
+      return XRootDStatus( stError, errInvalidArgs );
+    }
+    fs->Truncate( paths, size, results );
+    return ReportBatch( "truncate", paths, results );
+  }
+
+  std::string fullPath;
+  if( !BuildPath( fullPath, env, args[1] ).IsOK() )
+  {
+    log->Error( AppMsg, "Invalid path." );
+    return XRootDStatus( stError, errInvalidArgs );
+  }
+
   //----------------------------------------------------------------------------
   // Run the query
   //----------------------------------------------------------------------------
@@ -561,13 +684,6 @@ XRootDStatus DoChMod( FileSystem                      *fs,
     return XRootDStatus( stError, errInvalidArgs );
   }
 
-  std::string fullPath;
-  if( !BuildPath( fullPath, env, args[1] ).IsOK() )
-  {
-    log->Error( AppMsg, "Invalid path." );
-    return XRootDStatus( stError, errInvalidArgs );
-  }
-
   uint16_t mode;
   XRootDStatus st = ConvertMode( mode, args[2] );
   if( !st.IsOK() )
@@ -576,6 +692,26 @@ XRootDStatus DoChMod( FileSystem                      *fs,
     return st;
   }
 
+  if( IsPathList( args[1] ) )
+  {
+    std::vector<std::string>  paths;
+    std::vector<XRootDStatus> results;
+    if( !BuildPathList( paths, env, args[1] ).IsOK() )
+    {
+      log->Error( AppMsg, "Invalid path list." );
+      return XRootDStatus( stError, errInvalidArgs );
+    }
+    fs->ChMod( paths, mode, results );
+    return ReportBatch( "change mode of", paths, results );
+  }
+
+  std::string fullPath;
+  if( !BuildPath( fullPath, env, args[1] ).IsOK() )
+  {
+    log->Error( AppMsg, "Invalid path." );
+    return XRootDStatus( stError, errInvalidArgs );
+  }
+
   //----------------------------------------------------------------------------
   // Run the query
   //----------------------------------------------------------------------------
@@ -591,6 +727,48 @@ XRootDStatus DoChMod( FileSystem                      *fs,
   return XRootDStatus();
 }
 
+//------------------------------------------------------------------------------
+// Print the locations
+//------------------------------------------------------------------------------
+void PrintLocations( LocationInfo *info )
+{
+  LocationInfo::Iterator it;
+  for( it = info->Begin(); it != info->End(); ++it )
+  {
+    std::cout << it->GetAddress() << " ";
+    switch( it->GetType() )
+    {
+      case LocationInfo::ManagerOnline:
+        std::cout << "Manager ";
+        break;
+      case LocationInfo::ManagerPending:
+        std::cout << "ManagerPending ";
+        break;
+      case LocationInfo::ServerOnline:
+        std::cout << "Server ";
+        break;
+      case LocationInfo::ServerPending:
+        std::cout << "ServerPending ";
+        break;
+      default:
+        std::cout << "Unknown ";
+    };
+
+    switch( it->GetAccessType() )
+    {
+      case LocationInfo::Read:
+        std::cout << "Read";
+        break;
+      case LocationInfo::ReadWrite:
+        std::cout << "ReadWrite ";
+        break;
+      default:
+        std::cout << "Unknown ";
+    };
+    std::cout << std::endl;
+  }
+}
+
 //------------------------------------------------------------------------------
 // Locate a path
 //------------------------------------------------------------------------------
@@ -634,6 +812,34 @@ XRootDStatus DoLocate( FileSystem                      *fs,
     }
   }
 
+  if( IsPathList( path ) && doDeepLocate )
+  {
+    log->Error( AppMsg, "Deep locate does not accept a path list." );
+    return XRootDStatus( stError, errInvalidArgs );
+  }
+
+  if( IsPathList( path ) )
+  {
+    std::vector<std::string>   paths;
+    std::vector<LocationInfo*> infos;
+    std::vector<XRootDStatus>  results;
+    if( !BuildPathList( paths, env, path ).IsOK() )
+    {
+      log->Error( AppMsg, "Invalid path list." );
+      return XRootDStatus( stError, errInvalidArgs );
+    }
+    fs->Locate( paths, flags, infos, results );
+    for( uint32_t i = 0; i < paths.size(); ++i )
+    {
+      if( !infos[i] )
+        continue;
+      std::cout << "Path: " << paths[i] << std::endl;
+      PrintLocations( infos[i] );
+      delete infos[i];
+    }
+    return ReportBatch( "locate", paths, results );
+  }
+
   std::string fullPath;
   if( !BuildPath( fullPath, env, path ).IsOK() )
   {
@@ -662,46 +868,43 @@ XRootDStatus DoLocate( FileSystem                      *fs,
   //----------------------------------------------------------------------------
   // Print the result
   //----------------------------------------------------------------------------
-  LocationInfo::Iterator it;
-  for( it = info->Begin(); it != info->End(); ++it )
-  {
-    std::cout << it->GetAddress() << " ";
-    switch( it->GetType() )
-    {
-      case LocationInfo::ManagerOnline:
-        std::cout << "Manager ";
-        break;
-      case LocationInfo::ManagerPending:
-        std::cout << "ManagerPending ";
-        break;
-      case LocationInfo::ServerOnline:
-        std::cout << "Server ";
-        break;
-      case LocationInfo::ServerPending:
-        std::cout << "ServerPending ";
-        break;
-      default:
-        std::cout << "Unknown ";
-    };
-
-    switch( it->GetAccessType() )
-    {
-      case LocationInfo::Read:
-        std::cout << "Read";
-        break;
-      case LocationInfo::ReadWrite:
-        std::cout << "ReadWrite ";
-        break;
-      default:
-        std::cout << "Unknown ";
-    };
-    std::cout << std::endl;
-  }
-
+  PrintLocations( info );
   delete info;
   return XRootDStatus();
 }
 
+//------------------------------------------------------------------------------
+// Print the stat info
+//------------------------------------------------------------------------------
+void PrintStatInfo( const std::string &path, StatInfo *info )
+{
+  std::string flags;
+
+  if( info->TestFlags( StatInfo::XBitSet ) )
+    flags += "XBitSet|";
+  if( info->TestFlags( StatInfo::IsDir ) )
+    flags += "IsDir|";
+  if( info->TestFlags( StatInfo::Other ) )
+    flags += "Other|";
+  if( info->TestFlags( StatInfo::Offline ) )
+    flags += "Offline|";
+  if( info->TestFlags( StatInfo::POSCPending ) )
+    flags += "POSCPending|";
+  if( info->TestFlags( StatInfo::IsReadable ) )
+    flags += "IsReadable|";
+  if( info->TestFlags( StatInfo::IsWritable ) )
+    flags += "IsWritable|";
+
+  if( !flags.empty() )
+    flags.erase( flags.length()-1, 1 );
+
+  std::cout << "Path:  " << path << std::endl;
+  std::cout << "Id:    " << info->GetId() << std::endl;
+  std::cout << "Size:  " << info->GetSize() << std::endl;
+  std::cout << "Flags: " << info->GetFlags() << " (" << flags << ")";
+  std::cout << std::endl;
+}
+
 //------------------------------------------------------------------------------
 // Stat a path
 //------------------------------------------------------------------------------
@@ -721,6 +924,27 @@ XRootDStatus DoStat( FileSystem                      *fs,
     return XRootDStatus( stError, errInvalidArgs );
   }
 
+  if( IsPathList( args[1] ) )
+  {
+    std::vector<std::string>  paths;
+    std::vector<StatInfo*>    infos;
+    std::vector<XRootDStatus> results;
+    if( !BuildPathList( paths, env, args[1] ).IsOK() )
+    {
+      log->Error( AppMsg, "Invalid path list." );
+      return XRootDStatus( stError, errInvalidArgs );
+    }
+    fs->Stat( paths, infos, results );
+    for( uint32_t i = 0; i < paths.size(); ++i )
+    {
+      if( !infos[i] )
+        continue;
+      PrintStatInfo( paths[i], infos[i] );
+      delete infos[i];
+    }
+    return ReportBatch( "stat", paths, results );
+  }
+
   std::string fullPath;
   if( !BuildPath( fullPath, env, args[1] ).IsOK() )
   {
@@ -745,32 +969,7 @@ XRootDStatus DoStat( FileSystem                      *fs,
   //----------------------------------------------------------------------------
   // Print the result
   //----------------------------------------------------------------------------
-  std::string flags;
-
-  if( info->TestFlags( StatInfo::XBitSet ) )
-    flags += "XBitSet|";
-  if( info->TestFlags( StatInfo::IsDir ) )
-    flags += "IsDir|";
-  if( info->TestFlags( StatInfo::Other ) )
-    flags += "Other|";
-  if( info->TestFlags( StatInfo::Offline ) )
-    flags += "Offline|";
-  if( info->TestFlags( StatInfo::POSCPending ) )
-    flags += "POSCPending|";
-  if( info->TestFlags( StatInfo::IsReadable ) )
-    flags += "IsReadable|";
-  if( info->TestFlags( StatInfo::IsWritable ) )
-    flags += "IsWritable|";
-
-  if( !flags.empty() )
-    flags.erase( flags.length()-1, 1 );
-
-  std::cout << "Path:  " << fullPath << std::endl;
-  std::cout << "Id:    " << info->GetId() << std::endl;
-  std::cout << "Size:  " << info->GetSize() << std::endl;
-  std::cout << "Flags: " << info->GetFlags() << " (" << flags << ")";
-  std::cout << std::endl;
-
+  PrintStatInfo( fullPath, info );
   delete info;
   return XRootDStatus();
 }
@@ -886,6 +1085,27 @@ XRootDStatus DoQuery( FileSystem                      *fs,
       qCode == QueryCode::Checksum       ||
       qCode == QueryCode::XAttr )
   {
+    if( IsPathList( args[2] ) )
+    {
+      std::vector<std::string>  paths;
+      std::vector<Buffer*>      responses;
+      std::vector<XRootDStatus> results;
+      if( !BuildPathList( paths, env, args[2] ).IsOK() )
+      {
+        log->Error( AppMsg, "Invalid path list." );
+        return XRootDStatus( stError, errInvalidArgs );
+      }
+      fs->Query( qCode, paths, responses, results );
+      for( uint32_t i = 0; i < paths.size(); ++i )
+      {
+        if( !responses[i] )
+          continue;
+        std::cout << paths[i] << " " << responses[i]->ToString() << std::endl;
+        delete responses[i];
+      }
+      return ReportBatch( "run query on", paths, results );
+    }
+
     if( !BuildPath( strArg, env, args[2] ).IsOK() )
     {
       log->Error( AppMsg, "Invalid path." );
@@ -983,6 +1203,12 @@ XRootDStatus PrintHelp( FileSystem *, Env *,
   printf( "   truncate <filename> <length>\n"                               );
   printf( "     Truncate a file.\n\n"                                       );
 
+  printf( "The chmod, locate (without -d), mkdir, query (on paths), rm,\n"  );
+  printf( "rmdir, stat and truncate commands accept @<file> in place of\n"  );
+  printf( "the path to act on all the paths listed in the file, one per\n"  );
+  printf( "line, or @- to read them from the standard input. The\n"         );
+  printf( "requests are pipelined, XRD_BATCHWINDOW of them at a time.\n\n"  );
+
   return XRootDStatus();
 }
 
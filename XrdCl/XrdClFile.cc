@@ -22,6 +22,49 @@
 #include "XrdCl/XrdClFile.hh"
 #include "XrdCl/XrdClFileStateHandler.hh"
 #include "XrdCl/XrdClMessageUtils.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include "XrdCl/XrdClRequestSync.hh"
+#include "XrdCl/XrdClFileHandleCache.hh"
+
+#include <map>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Store the outcome of one of the opens of a batch
+  //----------------------------------------------------------------------------
+  class BatchOpenHandler: public XrdCl::ResponseHandler
+  {
+    public:
+      //------------------------------------------------------------------------
+      // Constructor
+      //------------------------------------------------------------------------
+      BatchOpenHandler( XrdCl::XRootDStatus *result,
+                        XrdCl::RequestSync  *sync ):
+        pResult( result ),
+        pSync( sync )
+      {
+      }
+
+      //------------------------------------------------------------------------
+      // Keep the status
+      //------------------------------------------------------------------------
+      virtual void HandleResponse( XrdCl::XRootDStatus *status,
+                                   XrdCl::AnyObject    *response )
+      {
+        bool ok  = status->IsOK();
+        *pResult = *status;
+        delete response;
+        delete status;
+        pSync->TaskDone( ok );
+        delete this;
+      }
+
+    private:
+      XrdCl::XRootDStatus *pResult;
+      XrdCl::RequestSync  *pSync;
+  };
+}
 
 namespace XrdCl
 {
@@ -51,6 +94,22 @@ namespace XrdCl
                            ResponseHandler   *handler,
                            uint16_t           timeout )
   {
+    //--------------------------------------------------------------------------
+    // Take over a handle of the same file kept open after a close
+    //--------------------------------------------------------------------------
+    FileHandleCache *cache = DefaultEnv::GetFileHandleCache();
+    if( cache && pStateHandler->IsClosed() )
+    {
+      FileStateHandler *stateHandler = cache->Get( url, flags );
+      if( stateHandler )
+      {
+        delete pStateHandler;
+        pStateHandler = stateHandler;
+        if( handler )
+          handler->HandleResponse( new XRootDStatus(), 0 );
+        return XRootDStatus();
+      }
+    }
     return pStateHandler->Open( url, flags, mode, handler, timeout );
   }
 
@@ -70,12 +129,90 @@ namespace XrdCl
     return MessageUtils::WaitForStatus( &handler );
   }
 
+  //----------------------------------------------------------------------------
+  // Open many files - sync
+  //----------------------------------------------------------------------------
+  XRootDStatus File::Open( const std::vector<std::string> &urls,
+                           uint16_t                        flags,
+                           uint16_t                        mode,
+                           std::vector<File*>             &files,
+                           std::vector<XRootDStatus>      &results,
+                           uint16_t                        timeout )
+  {
+    files.assign( urls.size(), 0 );
+    results.assign( urls.size(), XRootDStatus() );
+    if( urls.empty() )
+      return XRootDStatus();
+
+    int window = DefaultBatchWindow;
+    DefaultEnv::GetEnv()->GetInt( "BatchWindow", window );
+    if( window <= 0 )
+      window = 1;
+
+    //--------------------------------------------------------------------------
+    // Sort the opens by the host in the url, the ones to the same host are
+    // sent one after another. The data servers are not known beforehand
+    // so the opens redirected to the same one are not grouped.
+    //--------------------------------------------------------------------------
+    typedef std::multimap<std::string, uint32_t> HostMap;
+    HostMap hosts;
+    for( uint32_t i = 0; i < urls.size(); ++i )
+      hosts.insert( std::make_pair( URL( urls[i] ).GetHostId(), i ) );
+
+    uint32_t nFiles = urls.size();
+    uint32_t quota  = nFiles <= (uint32_t)window ? nFiles : window;
+    Log     *log    = DefaultEnv::GetLog();
+    log->Debug( FileMsg, "Opening %d files at %d hosts, %d at a time",
+                nFiles, (int)hosts.size(), quota );
+
+    RequestSync sync( nFiles, quota );
+    HostMap::iterator it;
+    for( it = hosts.begin(); it != hosts.end(); ++it )
+    {
+      uint32_t index = it->second;
+      files[index]   = new File();
+      ResponseHandler *handler = new BatchOpenHandler( &results[index],
+                                                       &sync );
+      XRootDStatus st = files[index]->Open( urls[index], flags, mode,
+                                            handler, timeout );
+      if( !st.IsOK() )
+      {
+        results[index] = st;
+        sync.TaskDone( false );
+        delete handler;
+      }
+      sync.WaitForQuota();
+    }
+    sync.WaitForAll();
+
+    for( uint32_t i = 0; i < nFiles; ++i )
+    {
+      if( results[i].IsOK() )
+        continue;
+      delete files[i];
+      files[i] = 0;
+    }
+    return Utils::GetBatchStatus( results );
+  }
+
   //----------------------------------------------------------------------------
   // Close the file - async
   //----------------------------------------------------------------------------
   XRootDStatus File::Close( ResponseHandler *handler,
                             uint16_t         timeout )
   {
+    //--------------------------------------------------------------------------
+    // Keep the handle open for a while if it is idle and read only, the
+    // file is closed as far as the user is concerned
+    //--------------------------------------------------------------------------
+    FileHandleCache *cache = DefaultEnv::GetFileHandleCache();
+    if( cache && cache->Put( pStateHandler ) )
+    {
+      pStateHandler = new FileStateHandler();
+      if( handler )
+        handler->HandleResponse( new XRootDStatus(), 0 );
+      return XRootDStatus();
+    }
     return pStateHandler->Close( handler, timeout );
   }
 
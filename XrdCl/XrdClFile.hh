@@ -48,6 +48,10 @@ namespace XrdCl
       //------------------------------------------------------------------------
       //! Open the file pointed to by the given URL - async
       //!
+      //! If FileHandleLinger is set, a handle kept open after a close of the
+      //! same URL with the same flags is taken over and the handler is
+      //! called before this function returns.
+      //!
       //! @param url     url of the file to be opened
       //! @param flags   OpenFlags::Flags
       //! @param mode    Access::Mode for new files, 0 otherwise
@@ -77,9 +81,41 @@ namespace XrdCl
                          uint16_t           mode    = 0,
                          uint16_t           timeout = 0 );
 
+      //------------------------------------------------------------------------
+      //! Open many files - sync
+      //!
+      //! The open requests are sent in the order of the hosts in the urls,
+      //! up to BatchWindow of them at a time. Every open is redirected on
+      //! its own, nothing is shared between the files of the batch. Only
+      //! the files that have been opened before (the same host and path)
+      //! go straight to their data servers if the redirect cache is
+      //! enabled.
+      //!
+      //! @param urls    urls of the files to be opened
+      //! @param flags   OpenFlags::Flags
+      //! @param mode    Access::Mode for new files, 0 otherwise
+      //! @param files   the opened files, 0 for the ones that failed to open
+      //!                (to be deleted by the user)
+      //! @param results the status of every open
+      //! @param timeout timeout value, if 0 the environment default will be
+      //!                used
+      //! @return        OK if all the files have been opened, suPartial if
+      //!                some of them have, the first error otherwise
+      //------------------------------------------------------------------------
+      static XRootDStatus Open( const std::vector<std::string> &urls,
+                                uint16_t                        flags,
+                                uint16_t                        mode,
+                                std::vector<File*>             &files,
+                                std::vector<XRootDStatus>      &results,
+                                uint16_t                        timeout = 0 );
+
       //------------------------------------------------------------------------
       //! Close the file - async
       //!
+      //! If FileHandleLinger is set, the handle of a file open for reading
+      //! only with nothing in flight is kept open for that many seconds and
+      //! the handler is called before this function returns.
+      //!
       //! @param handler handler to be notified about the status of the operation
       //! @param timeout timeout value, if 0 the environment default will be
       //!                used
@@ -129,6 +165,11 @@ namespace XrdCl
       //------------------------------------------------------------------------
       //! Read a data chunk at a given offset - async
       //!
+      //! If ReadHedging is enabled and the file has been opened read-only
+      //! through a load balancer, a read taking longer than usual for its
+      //! data server is duplicated to another replica and the response
+      //! that arrives first is used.
+      //!
       //! @param offset  offset from the beginning of the file
       //! @param size    number of bytes to be read
       //! @param buffer  a pointer to a buffer big enough to hold the data
@@ -255,7 +296,11 @@ namespace XrdCl
       //!                  2097136 bytes and the default maximum number
       //!                  of chunks per request is 1024. The server
       //!                  may be queried using FileSystem::Query for the
-      //!                  actual settings.
+      //!                  actual settings. Lists exceeding the
+      //!                  MaxReadVSegments or MaxReadVSize environment
+      //!                  limits are split into several requests that
+      //!                  are sent in parallel and the handler is called
+      //!                  once with the merged result.
       //! @param buffer    if zero the buffer pointers in the chunk list
       //!                  will be used, otherwise it needs to point to a
       //!                  buffer big enough to hold the requested data
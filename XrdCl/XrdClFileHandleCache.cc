@@ -0,0 +1,271 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+#include "XrdCl/XrdClFileHandleCache.hh"
+#include "XrdCl/XrdClFileStateHandler.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClConstants.hh"
+#include "XrdCl/XrdClRequestSync.hh"
+#include "XrdCl/XrdClTaskManager.hh"
+#include "XrdCl/XrdClURL.hh"
+#include <vector>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Delete the handle once it has been closed
+  //----------------------------------------------------------------------------
+  class DisposeHandler: public XrdCl::ResponseHandler
+  {
+    public:
+      DisposeHandler( XrdCl::FileStateHandler *handle,
+                      XrdCl::RequestSync      *sync ):
+        pHandle( handle ),
+        pSync( sync )
+      {
+      }
+
+      virtual void HandleResponse( XrdCl::XRootDStatus *status,
+                                   XrdCl::AnyObject    *response )
+      {
+        delete pHandle;
+        if( pSync )
+          pSync->TaskDone( status->IsOK() );
+        delete status;
+        delete response;
+        delete this;
+      }
+
+    private:
+      XrdCl::FileStateHandler *pHandle;
+      XrdCl::RequestSync      *pSync;
+  };
+
+  //----------------------------------------------------------------------------
+  // Send the real close for the handles, the handles that cannot be
+  // closed are just deleted
+  //----------------------------------------------------------------------------
+  void CloseHandles( const std::vector<XrdCl::FileStateHandler*> &handles,
+                     XrdCl::RequestSync                          *sync )
+  {
+    using namespace XrdCl;
+    Log *log = DefaultEnv::GetLog();
+    std::vector<FileStateHandler*>::const_iterator it;
+    for( it = handles.begin(); it != handles.end(); ++it )
+    {
+      log->Debug( FileMsg, "[0x%x@%s] Closing the kept handle", *it,
+                  (*it)->GetFileURL().c_str() );
+      ResponseHandler *handler = new DisposeHandler( *it, sync );
+      if( !(*it)->Close( handler ).IsOK() )
+      {
+        delete handler;
+        delete *it;
+        if( sync )
+          sync->TaskDone( false );
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Close the expired handles
+  //----------------------------------------------------------------------------
+  class LingerTask: public XrdCl::Task
+  {
+    public:
+      LingerTask( XrdCl::FileHandleCache *cache ): pCache( cache )
+      {
+        SetName( "FileHandleCacheLingerTask" );
+      }
+
+      virtual time_t Run( time_t now )
+      {
+        pCache->CloseExpired( now );
+        return now+1;
+      }
+
+    private:
+      XrdCl::FileHandleCache *pCache;
+  };
+}
+
+namespace XrdCl
+{
+  //----------------------------------------------------------------------------
+  // Constructor
+  //----------------------------------------------------------------------------
+  FileHandleCache::FileHandleCache( uint32_t linger, uint32_t maxHandles ):
+    pLinger( linger ),
+    pMaxHandles( maxHandles ? maxHandles : 1 ),
+    pHits( 0 ),
+    pMisses( 0 )
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  // Destructor
+  //----------------------------------------------------------------------------
+  FileHandleCache::~FileHandleCache()
+  {
+    EntryList::iterator it;
+    for( it = pEntries.begin(); it != pEntries.end(); ++it )
+      delete it->handle;
+  }
+
+  //----------------------------------------------------------------------------
+  // Start closing the expired handles
+  //----------------------------------------------------------------------------
+  void FileHandleCache::Start( TaskManager *taskManager )
+  {
+    taskManager->RegisterTask( new LingerTask( this ), ::time(0)+1 );
+  }
+
+  //----------------------------------------------------------------------------
+  // Keep the handle of a file the user has closed
+  //----------------------------------------------------------------------------
+  bool FileHandleCache::Put( FileStateHandler *handle )
+  {
+    uint16_t flags = handle->GetOpenFlags();
+    if( !handle->IsIdleReadOnly() || (flags & OpenFlags::Refresh) )
+      return false;
+
+    Key  key( handle->GetFileURL(), flags );
+    Log *log = DefaultEnv::GetLog();
+    log->Debug( FileMsg, "[0x%x@%s] Keeping the handle open for %d seconds",
+                handle, key.first.c_str(), pLinger );
+
+    std::vector<FileStateHandler*> evicted;
+    {
+      XrdSysMutexHelper scopedLock( pMutex );
+      while( pEntries.size() >= pMaxHandles )
+      {
+        evicted.push_back( pEntries.back().handle );
+        Take( --pEntries.end() );
+      }
+
+      pEntries.push_front( Entry( handle, key, ::time(0)+pLinger ) );
+      pIndex.insert( std::make_pair( key, pEntries.begin() ) );
+    }
+    CloseHandles( evicted, 0 );
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Take a handle of the given file
+  //----------------------------------------------------------------------------
+  FileStateHandler *FileHandleCache::Get( const std::string &url,
+                                          uint16_t           flags )
+  {
+    if( flags & OpenFlags::Refresh )
+      return 0;
+
+    //--------------------------------------------------------------------------
+    // The handle kept last is the one to expire last
+    //--------------------------------------------------------------------------
+    Key key( URL( url ).GetURL(), flags );
+    XrdSysMutexHelper scopedLock( pMutex );
+    std::pair<EntryMap::iterator, EntryMap::iterator> range;
+    range = pIndex.equal_range( key );
+    if( range.first == range.second ||
+        (--range.second)->second->expires <= ::time(0) )
+    {
+      ++pMisses;
+      return 0;
+    }
+
+    ++pHits;
+    FileStateHandler *handle = range.second->second->handle;
+    Take( range.second->second );
+    return handle;
+  }
+
+  //----------------------------------------------------------------------------
+  // Close the handles kept for longer than the linger time
+  //----------------------------------------------------------------------------
+  void FileHandleCache::CloseExpired( time_t now )
+  {
+    std::vector<FileStateHandler*> expired;
+    {
+      XrdSysMutexHelper scopedLock( pMutex );
+      while( !pEntries.empty() && pEntries.back().expires <= now )
+      {
+        expired.push_back( pEntries.back().handle );
+        Take( --pEntries.end() );
+      }
+    }
+    CloseHandles( expired, 0 );
+  }
+
+  //----------------------------------------------------------------------------
+  // Close all the handles and wait for the closes to finish
+  //----------------------------------------------------------------------------
+  void FileHandleCache::Clear()
+  {
+    std::vector<FileStateHandler*> handles;
+    {
+      XrdSysMutexHelper scopedLock( pMutex );
+      while( !pEntries.empty() )
+      {
+        handles.push_back( pEntries.back().handle );
+        Take( --pEntries.end() );
+      }
+    }
+
+    RequestSync sync( handles.size(), handles.size() );
+    CloseHandles( handles, &sync );
+    sync.WaitForAll();
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the counters
+  //----------------------------------------------------------------------------
+  uint64_t FileHandleCache::GetHits()
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    return pHits;
+  }
+
+  uint64_t FileHandleCache::GetMisses()
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    return pMisses;
+  }
+
+  uint32_t FileHandleCache::GetSize()
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    return pEntries.size();
+  }
+
+  //----------------------------------------------------------------------------
+  // Remove an entry without closing its handle
+  //----------------------------------------------------------------------------
+  void FileHandleCache::Take( EntryList::iterator it )
+  {
+    std::pair<EntryMap::iterator, EntryMap::iterator> range;
+    range = pIndex.equal_range( it->key );
+    for( EntryMap::iterator itI = range.first; itI != range.second; ++itI )
+    {
+      if( itI->second != it )
+        continue;
+      pIndex.erase( itI );
+      break;
+    }
+    pEntries.erase( it );
+  }
+}
@@ -0,0 +1,127 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+#ifndef __XRD_CL_FILE_HANDLE_CACHE_HH__
+#define __XRD_CL_FILE_HANDLE_CACHE_HH__
+
+#include "XrdSys/XrdSysPthread.hh"
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <string>
+#include <time.h>
+
+namespace XrdCl
+{
+  class FileStateHandler;
+  class TaskManager;
+
+  //----------------------------------------------------------------------------
+  //! Keep the handles of the files closed by the user open for a while, so
+  //! that opening the same file again does not cost a round trip. Only the
+  //! files open for reading with nothing in flight are kept, the real close
+  //! is sent once the linger time passes or the room is needed.
+  //----------------------------------------------------------------------------
+  class FileHandleCache
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Constructor
+      //!
+      //! @param linger     time in seconds the handles are kept open
+      //! @param maxHandles maximum number of handles kept open
+      //------------------------------------------------------------------------
+      FileHandleCache( uint32_t linger, uint32_t maxHandles );
+
+      //------------------------------------------------------------------------
+      //! Destructor, the handles left are dropped without being closed
+      //------------------------------------------------------------------------
+      ~FileHandleCache();
+
+      //------------------------------------------------------------------------
+      //! Start closing the expired handles every second
+      //------------------------------------------------------------------------
+      void Start( TaskManager *taskManager );
+
+      //------------------------------------------------------------------------
+      //! Keep the handle of a file the user has closed
+      //!
+      //! @param handle the handle, the cache takes the ownership of it
+      //!               if accepted
+      //! @return       false if the file should be closed right away
+      //------------------------------------------------------------------------
+      bool Put( FileStateHandler *handle );
+
+      //------------------------------------------------------------------------
+      //! Take a handle of the given file opened with the given flags
+      //!
+      //! @return the handle, now owned by the caller, or 0 if none is kept
+      //------------------------------------------------------------------------
+      FileStateHandler *Get( const std::string &url, uint16_t flags );
+
+      //------------------------------------------------------------------------
+      //! Close the handles kept for longer than the linger time
+      //------------------------------------------------------------------------
+      void CloseExpired( time_t now );
+
+      //------------------------------------------------------------------------
+      //! Close all the handles and wait for the closes to finish
+      //------------------------------------------------------------------------
+      void Clear();
+
+      //------------------------------------------------------------------------
+      //! Get the number of opens served with a kept handle
+      //------------------------------------------------------------------------
+      uint64_t GetHits();
+
+      //------------------------------------------------------------------------
+      //! Get the number of opens sent to the server
+      //------------------------------------------------------------------------
+      uint64_t GetMisses();
+
+      //------------------------------------------------------------------------
+      //! Get the number of handles kept open
+      //------------------------------------------------------------------------
+      uint32_t GetSize();
+
+    private:
+      typedef std::pair<std::string, uint16_t> Key;
+      struct Entry
+      {
+        Entry( FileStateHandler *h, const Key &k, time_t e ):
+          handle( h ), key( k ), expires( e ) {}
+        FileStateHandler *handle;
+        Key               key;
+        time_t            expires;
+      };
+      typedef std::list<Entry>                        EntryList;
+      typedef std::multimap<Key, EntryList::iterator> EntryMap;
+
+      void Take( EntryList::iterator it );
+
+      XrdSysMutex pMutex;
+      EntryList   pEntries;
+      EntryMap    pIndex;
+      uint32_t    pLinger;
+      uint32_t    pMaxHandles;
+      uint64_t    pHits;
+      uint64_t    pMisses;
+  };
+}
+
+#endif // __XRD_CL_FILE_HANDLE_CACHE_HH__
@@ -27,6 +27,9 @@
 #include "XrdCl/XrdClXRootDTransport.hh"
 #include "XrdCl/XrdClXRootDResponses.hh"
 #include "XrdCl/XrdClMonitor.hh"
+#include "XrdCl/XrdClPrefetchProfile.hh"
+#include "XrdCl/XrdClReadHedger.hh"
+#include "XrdCl/XrdClRedirectCache.hh"
 
 #include <sstream>
 #include <sys/time.h>
@@ -93,6 +96,60 @@ namespace
       XrdCl::ResponseHandler  *pUserHandler;
   };
 
+  //----------------------------------------------------------------------------
+  // Send the open to the redirector if the data server remembered for
+  // the file has failed to open it, the redirector gets whatever is left
+  // of the timeout
+  //----------------------------------------------------------------------------
+  class CachedOpenHandler: public XrdCl::ResponseHandler
+  {
+    public:
+      //------------------------------------------------------------------------
+      // Constructor
+      //------------------------------------------------------------------------
+      CachedOpenHandler( XrdCl::FileStateHandler *stateHandler,
+                         XrdCl::ResponseHandler  *openHandler,
+                         time_t                   expires ):
+        pStateHandler( stateHandler ),
+        pOpenHandler( openHandler ),
+        pExpires( expires )
+      {
+      }
+
+      //------------------------------------------------------------------------
+      // Handle the response
+      //------------------------------------------------------------------------
+      virtual void HandleResponseWithHosts( XrdCl::XRootDStatus *status,
+                                            XrdCl::AnyObject    *response,
+                                            XrdCl::HostList     *hostList )
+      {
+        using namespace XrdCl;
+        time_t timeLeft = pExpires-::time(0);
+        if( !status->IsOK() && timeLeft > 0 )
+        {
+          XRootDStatus st = pStateHandler->OpenAtRedirector( pOpenHandler,
+                                                             timeLeft );
+          if( st.IsOK() )
+          {
+            delete status;
+            delete response;
+            delete hostList;
+            delete this;
+            return;
+          }
+          *status = st;
+        }
+
+        pOpenHandler->HandleResponseWithHosts( status, response, hostList );
+        delete this;
+      }
+
+    private:
+      XrdCl::FileStateHandler *pStateHandler;
+      XrdCl::ResponseHandler  *pOpenHandler;
+      time_t                   pExpires;
+  };
+
   //----------------------------------------------------------------------------
   // Object that does things to the FileStateHandler when kXR_close returns
   // and then calls the user handler
@@ -233,6 +290,227 @@ namespace
       XrdCl::Message           *pMessage;
       XrdCl::MessageSendParams  pSendParams;
   };
+
+  //----------------------------------------------------------------------------
+  // Collect the responses to the kXR_readv requests that an oversized vector
+  // read has been split into and notify the user handler when all of them
+  // have arrived
+  //----------------------------------------------------------------------------
+  class VectorReadJoint
+  {
+    public:
+      //------------------------------------------------------------------------
+      // Constructor
+      //------------------------------------------------------------------------
+      VectorReadJoint( XrdCl::ResponseHandler *userHandler, uint32_t parts ):
+        pUserHandler( userHandler ),
+        pParts( parts, 0 ),
+        pOutstanding( parts ),
+        pFailed( 0 ),
+        pStatus( 0 ),
+        pHostList( 0 )
+      {
+      }
+
+      //------------------------------------------------------------------------
+      // Destructor
+      //------------------------------------------------------------------------
+      ~VectorReadJoint()
+      {
+        for( uint32_t i = 0; i < pParts.size(); ++i )
+          delete pParts[i];
+        delete pStatus;
+        delete pHostList;
+      }
+
+      //------------------------------------------------------------------------
+      // Register the response to one of the parts
+      //------------------------------------------------------------------------
+      void PartDone( uint32_t             part,
+                     XrdCl::XRootDStatus *status,
+                     XrdCl::AnyObject    *response,
+                     XrdCl::HostList     *hostList )
+      {
+        using namespace XrdCl;
+        XrdSysMutexHelper scopedLock( pMutex );
+
+        //----------------------------------------------------------------------
+        // Remember the first error and the data of the successful parts
+        //----------------------------------------------------------------------
+        if( !status->IsOK() )
+        {
+          ++pFailed;
+          if( !pStatus )
+            pStatus = status;
+          else
+            delete status;
+        }
+        else
+        {
+          delete status;
+          VectorReadInfo *info = 0;
+          if( response )
+          {
+            response->Get( info );
+            response->Set( (VectorReadInfo*)0 );
+          }
+          pParts[part] = info;
+        }
+        delete response;
+
+        if( !pHostList )
+          pHostList = hostList;
+        else
+          delete hostList;
+
+        if( --pOutstanding )
+          return;
+
+        //----------------------------------------------------------------------
+        // We have everything, merge the parts or report the failure
+        //----------------------------------------------------------------------
+        XRootDStatus *st   = 0;
+        AnyObject    *resp = 0;
+        if( pFailed )
+        {
+          st = pStatus; pStatus = 0;
+          if( pFailed != pParts.size() )
+          {
+            std::ostringstream o;
+            o << pFailed << " out of " << pParts.size() << " vector read ";
+            o << "requests failed";
+            if( !st->GetErrorMessage().empty() )
+              o << ": " << st->GetErrorMessage();
+            st->SetErrorMessage( o.str() );
+          }
+        }
+        else
+        {
+          VectorReadInfo *info = new VectorReadInfo();
+          uint32_t        size = 0;
+          for( uint32_t i = 0; i < pParts.size(); ++i )
+          {
+            if( !pParts[i] )
+              continue;
+            ChunkList &chunks = pParts[i]->GetChunks();
+            info->GetChunks().insert( info->GetChunks().end(),
+                                      chunks.begin(), chunks.end() );
+            size += pParts[i]->GetSize();
+          }
+          info->SetSize( size );
+          st   = new XRootDStatus();
+          resp = new AnyObject();
+          resp->Set( info );
+        }
+
+        HostList *hosts = pHostList; pHostList = 0;
+        scopedLock.UnLock();
+        pUserHandler->HandleResponseWithHosts( st, resp, hosts );
+        delete this;
+      }
+
+    private:
+      XrdSysMutex                          pMutex;
+      XrdCl::ResponseHandler              *pUserHandler;
+      std::vector<XrdCl::VectorReadInfo*>  pParts;
+      uint32_t                             pOutstanding;
+      uint32_t                             pFailed;
+      XrdCl::XRootDStatus                 *pStatus;
+      XrdCl::HostList                     *pHostList;
+  };
+
+  //----------------------------------------------------------------------------
+  // Forward the response to one part of a split vector read to the joint
+  //----------------------------------------------------------------------------
+  class VectorReadPartHandler: public XrdCl::ResponseHandler
+  {
+    public:
+      //------------------------------------------------------------------------
+      // Constructor
+      //------------------------------------------------------------------------
+      VectorReadPartHandler( VectorReadJoint *joint, uint32_t part ):
+        pJoint( joint ),
+        pPart( part )
+      {
+      }
+
+      //------------------------------------------------------------------------
+      // Handle the response
+      //------------------------------------------------------------------------
+      virtual void HandleResponseWithHosts( XrdCl::XRootDStatus *status,
+                                            XrdCl::AnyObject    *response,
+                                            XrdCl::HostList     *hostList )
+      {
+        pJoint->PartDone( pPart, status, response, hostList );
+        delete this;
+      }
+
+    private:
+      VectorReadJoint *pJoint;
+      uint32_t         pPart;
+  };
+
+  //----------------------------------------------------------------------------
+  // Put the response to a prefetch request in the prefetch cache
+  //----------------------------------------------------------------------------
+  class PrefetchHandler: public XrdCl::ResponseHandler
+  {
+    public:
+      //------------------------------------------------------------------------
+      // Constructor
+      //------------------------------------------------------------------------
+      PrefetchHandler( XrdCl::PrefetchCache *cache,
+                       XrdCl::Message       *message,
+                       XrdCl::ChunkList     *chunkList,
+                       size_t                first ):
+        pCache( cache ),
+        pMessage( message ),
+        pChunkList( chunkList ),
+        pFirst( first )
+      {
+        pCache->Ref();
+      }
+
+      //------------------------------------------------------------------------
+      // Destructor
+      //------------------------------------------------------------------------
+      virtual ~PrefetchHandler()
+      {
+        delete pMessage;
+        delete pChunkList;
+        pCache->UnRef();
+      }
+
+      //------------------------------------------------------------------------
+      // Handle the response
+      //------------------------------------------------------------------------
+      virtual void HandleResponseWithHosts( XrdCl::XRootDStatus *status,
+                                            XrdCl::AnyObject    *response,
+                                            XrdCl::HostList     *hostList )
+      {
+        if( status->IsOK() )
+          pCache->SetReady( pFirst, pChunkList->size() );
+        delete status;
+        delete response;
+        delete hostList;
+        delete this;
+      }
+
+    private:
+      XrdCl::PrefetchCache *pCache;
+      XrdCl::Message       *pMessage;
+      XrdCl::ChunkList     *pChunkList;
+      size_t                pFirst;
+  };
+
+  //----------------------------------------------------------------------------
+  // Prefetch tunables: the maximum number of ranges recorded per file,
+  // the maximum hole between ranges merged into one prefetch chunk and the
+  // maximum size of a chunk accepted by the server in a kXR_readv
+  //----------------------------------------------------------------------------
+  const size_t   PrefetchMaxRecordedRanges = 16384;
+  const uint32_t PrefetchMaxGap            = 128*1024;
+  const uint32_t PrefetchMaxChunk          = 2097136;
 }
 
 namespace XrdCl
@@ -252,7 +530,12 @@ namespace XrdCl
     pOpenFlags( 0 ),
     pSessionId( 0 ),
     pDoRecoverRead( true ),
-    pDoRecoverWrite( true )
+    pDoRecoverWrite( true ),
+    pOpenedFromCache( false ),
+    pPrefetch( 0 ),
+    pHedgeReplica( 0 ),
+    pDeferredClose( 0 ),
+    pDeferredCloseTimeout( 0 )
   {
     pFileHandle = new uint8_t[4];
     ResetMonitoringVars();
@@ -272,6 +555,12 @@ namespace XrdCl
       MonitorClose( &st );
       ResetMonitoringVars();
     }
+    ResetPrefetch();
+    ResetHedging();
+
+    HedgedReadMap::iterator it;
+    for( it = pHedgedReads.begin(); it != pHedgedReads.end(); ++it )
+      it->second->UnRef();
 
     delete pStatInfo;
     delete pFileUrl;
@@ -352,24 +641,42 @@ namespace XrdCl
     pOpenMode  = mode;
     pOpenFlags = flags;
 
-    Message           *msg;
-    ClientOpenRequest *req;
-    std::string        path = pFileUrl->GetPathWithParams();
-    MessageUtils::CreateRequest( msg, req, path.length() );
-
-    req->requestid = kXR_open;
-    req->mode      = mode;
-    req->options   = flags | kXR_async | kXR_retstat;
-    req->dlen      = path.length();
-    msg->Append( path.c_str(), path.length(), 24 );
-
-    XRootDTransport::SetDescription( msg );
-    OpenHandler *openHandler = new OpenHandler( this, handler );
-    MessageSendParams params; params.timeout = timeout;
-    MessageUtils::ProcessSendParams( params );
+    //--------------------------------------------------------------------------
+    // Go straight to the data server the file has been opened at if we
+    // know it, the redirector is asked if it fails
+    //--------------------------------------------------------------------------
+    OpenHandler   *openHandler = new OpenHandler( this, handler );
+    RedirectCache *cache       = DefaultEnv::GetRedirectCache();
+    URL            dataServer;
+    std::string    cgi;
+    Status         st;
+    pOpenedFromCache = cache && IsReadOnly() &&
+                       cache->Get( *pFileUrl, dataServer, cgi );
+    if( pOpenedFromCache )
+    {
+      if( !timeout )
+      {
+        int requestTimeout = DefaultRequestTimeout;
+        DefaultEnv::GetEnv()->GetInt( "RequestTimeout", requestTimeout );
+        timeout = requestTimeout;
+      }
 
-    Status st = MessageUtils::SendMessage( *pFileUrl, msg, openHandler, params );
+      log->Debug( FileMsg, "[0x%x@%s] Sending the open to the remembered "
+                  "data server %s", this, pFileUrl->GetURL().c_str(),
+                  dataServer.GetHostId().c_str() );
+      time_t             expires       = ::time(0)+timeout;
+      CachedOpenHandler *cachedHandler = new CachedOpenHandler( this,
+                                                                openHandler,
+                                                                expires );
+      st = SendOpen( dataServer, cgi, cachedHandler, timeout );
+      if( st.IsOK() )
+        return st;
+      delete cachedHandler;
+      cache->Remove( *pFileUrl );
+      pOpenedFromCache = false;
+    }
 
+    st = SendOpen( *pFileUrl, "", openHandler, timeout );
     if( !st.IsOK() )
     {
       delete openHandler;
@@ -398,11 +705,36 @@ namespace XrdCl
       return XRootDStatus( stError, errInProgress );
 
     if( pFileState == OpenInProgress || pFileState == Closed ||
-        pFileState == Recovering || !pInTheFly.empty() )
+        pFileState == Recovering || !OnlyAbandonedInTheFly() )
       return XRootDStatus( stError, errInvalidOp );
 
     pStatus = CloseInProgress;
+    SaveReadProfile();
 
+    //--------------------------------------------------------------------------
+    // The reads beaten by their duplicates still hold the file handle, the
+    // close is sent when the last of them comes back
+    //--------------------------------------------------------------------------
+    if( !pInTheFly.empty() )
+    {
+      Log *log = DefaultEnv::GetLog();
+      log->Debug( FileMsg, "[0x%x@%s] Deferring the close until %d abandoned "
+                  "reads return", this, pFileUrl->GetURL().c_str(),
+                  pInTheFly.size() );
+      pFileState            = CloseInProgress;
+      pDeferredClose        = handler;
+      pDeferredCloseTimeout = timeout;
+      return XRootDStatus();
+    }
+    return SendClose( handler, timeout );
+  }
+
+  //----------------------------------------------------------------------------
+  // Send the close request
+  //----------------------------------------------------------------------------
+  XRootDStatus FileStateHandler::SendClose( ResponseHandler *handler,
+                                            uint16_t         timeout )
+  {
     Log *log = DefaultEnv::GetLog();
     log->Debug( FileMsg, "[0x%x@%s] Sending a close command for handle 0x%x to "
                 "%s", this, pFileUrl->GetURL().c_str(),
@@ -510,11 +842,44 @@ namespace XrdCl
     if( pFileState != Opened && pFileState != Recovering )
       return XRootDStatus( stError, errInvalidOp );
 
+    //--------------------------------------------------------------------------
+    // Serve the request from the prefetched data if possible
+    //--------------------------------------------------------------------------
+    RecordRead( offset, size );
+    if( pPrefetch && pPrefetch->Read( offset, size, buffer ) )
+    {
+      ++pRCount;
+      pRBytes += size;
+      AnyObject *obj = new AnyObject();
+      obj->Set( new ChunkInfo( offset, size, buffer ) );
+      scopedLock.UnLock();
+      handler->HandleResponseWithHosts( new XRootDStatus(), obj,
+                                        new HostList() );
+      return XRootDStatus();
+    }
+
     Log *log = DefaultEnv::GetLog();
     log->Debug( FileMsg, "[0x%x@%s] Sending a read command for handle 0x%x to "
                 "%s", this, pFileUrl->GetURL().c_str(),
                 *((uint32_t*)pFileHandle), pDataServer->GetHostId().c_str() );
 
+    //--------------------------------------------------------------------------
+    // Read to a private buffer if the request may be duplicated, the hedged
+    // read copies the data of whichever response arrives first
+    //--------------------------------------------------------------------------
+    HedgedRead *hedgedRead = 0;
+    ReadHedger *hedger     = 0;
+    if( pHedgeReplica && buffer && size )
+      hedger = DefaultEnv::GetReadHedger();
+    if( hedger )
+    {
+      hedgedRead = new HedgedRead( handler, offset, size, buffer,
+                                   pDataServer->GetHostId(), pHedgeReplica );
+      handler    = hedgedRead->GetHandler();
+      buffer     = hedgedRead->GetBuffer();
+      hedgedRead->Ref();
+    }
+
     Message           *msg;
     ClientReadRequest *req;
     MessageUtils::CreateRequest( msg, req );
@@ -536,7 +901,32 @@ namespace XrdCl
     MessageUtils::ProcessSendParams( params );
 
     StatefulHandler *stHandler = new StatefulHandler( this, handler, msg, params );
-    return SendOrQueue( *pDataServer, msg, stHandler, params );
+    Status st = SendOrQueue( *pDataServer, msg, stHandler, params );
+
+    if( hedgedRead )
+    {
+      if( st.IsOK() && pInTheFly.count( msg ) )
+      {
+        hedgedRead->Ref();
+        pHedgedReads[msg] = hedgedRead;
+      }
+
+      if( st.IsOK() )
+      {
+        hedger->Schedule( hedgedRead,
+                          hedger->GetDelay( pDataServer->GetHostId() ) );
+      }
+      else
+      {
+        //----------------------------------------------------------------------
+        // The handler has not been called so it still holds its reference
+        //----------------------------------------------------------------------
+        delete handler;
+        hedgedRead->UnRef();
+      }
+      hedgedRead->UnRef();
+    }
+    return st;
   }
 
   //----------------------------------------------------------------------------
@@ -665,61 +1055,198 @@ namespace XrdCl
     if( pFileState != Opened && pFileState != Recovering )
       return XRootDStatus( stError, errInvalidOp );
 
+    //--------------------------------------------------------------------------
+    // Serve the request from the prefetched data if possible
+    //--------------------------------------------------------------------------
+    for( size_t i = 0; i < chunks.size(); ++i )
+      RecordRead( chunks[i].offset, chunks[i].length );
+
+    VectorReadInfo *info = new VectorReadInfo();
+    if( pPrefetch && pPrefetch->ReadV( chunks, buffer, info->GetChunks() ) )
+    {
+      uint32_t size = 0;
+      for( size_t i = 0; i < chunks.size(); ++i )
+        size += chunks[i].length;
+      info->SetSize( size );
+      ++pVCount;
+      pVBytes += size;
+      pVSegs  += chunks.size();
+      AnyObject *obj = new AnyObject();
+      obj->Set( info );
+      scopedLock.UnLock();
+      handler->HandleResponseWithHosts( new XRootDStatus(), obj,
+                                        new HostList() );
+      return XRootDStatus();
+    }
+    delete info;
+
+    //--------------------------------------------------------------------------
+    // Split the chunk list into groups that fit within the segment and size
+    // limits of a single kXR_readv request
+    //--------------------------------------------------------------------------
+    std::vector<size_t> groups;
+    SplitVectorRead( chunks, groups );
+
+    //--------------------------------------------------------------------------
+    // Everything fits in one request
+    //--------------------------------------------------------------------------
+    if( groups.size() <= 2 )
+      return SendVectorRead( chunks, 0, chunks.size(), (char*)buffer,
+                             handler, timeout );
+
+    //--------------------------------------------------------------------------
+    // Send the parts in parallel and let the joint merge the results
+    //--------------------------------------------------------------------------
+    Log      *log   = DefaultEnv::GetLog();
+    uint32_t  parts = groups.size() - 1;
+    log->Debug( FileMsg, "[0x%x@%s] Splitting a vector read of %d chunks "
+                "into %d requests", this, pFileUrl->GetURL().c_str(),
+                chunks.size(), parts );
+
+    VectorReadJoint *joint  = new VectorReadJoint( handler, parts );
+    char            *cursor = (char*)buffer;
+    uint32_t         sent   = 0;
+    Status           st;
+
+    for( ; sent < parts; ++sent )
+    {
+      size_t           first       = groups[sent];
+      size_t           count       = groups[sent+1] - first;
+      ResponseHandler *partHandler = new VectorReadPartHandler( joint, sent );
+      st = SendVectorRead( chunks, first, count, cursor, partHandler, timeout );
+      if( !st.IsOK() )
+      {
+        delete partHandler;
+        break;
+      }
+
+      if( cursor )
+        for( size_t i = first; i < first+count; ++i )
+          cursor += chunks[i].length;
+    }
+
+    //--------------------------------------------------------------------------
+    // Nothing has been sent so we can just report the failure
+    //--------------------------------------------------------------------------
+    if( !sent )
+    {
+      delete joint;
+      return st;
+    }
+
+    //--------------------------------------------------------------------------
+    // Some of the parts are out already, so the remaining ones need to fail
+    // through the handler
+    //--------------------------------------------------------------------------
+    scopedLock.UnLock();
+    for( uint32_t i = sent; i < parts; ++i )
+      joint->PartDone( i, new XRootDStatus( st ), 0, 0 );
+    return Status();
+  }
+
+  //----------------------------------------------------------------------------
+  // Build and send a single kXR_readv request covering a subset of the chunks
+  //----------------------------------------------------------------------------
+  Status FileStateHandler::SendVectorRead( const ChunkList &chunks,
+                                           size_t           first,
+                                           size_t           count,
+                                           char            *cursor,
+                                           ResponseHandler *handler,
+                                           uint16_t         timeout )
+  {
     Log *log = DefaultEnv::GetLog();
     log->Debug( FileMsg, "[0x%x@%s] Sending a vector read command for handle "
                 "0x%x to %s", this, pFileUrl->GetURL().c_str(),
                 *((uint32_t*)pFileHandle), pDataServer->GetHostId().c_str() );
 
+    ChunkList *list = new ChunkList();
+    Message   *msg  = CreateVectorRead( chunks, first, count, cursor, list );
+
     //--------------------------------------------------------------------------
-    // Build the message
+    // Send the message
     //--------------------------------------------------------------------------
+    MessageSendParams params;
+    params.timeout         = timeout;
+    params.followRedirects = false;
+    params.stateful        = true;
+    params.chunkList       = list;
+    MessageUtils::ProcessSendParams( params );
+
+    StatefulHandler *stHandler = new StatefulHandler( this, handler, msg, params );
+    return SendOrQueue( *pDataServer, msg, stHandler, params );
+  }
+
+  //----------------------------------------------------------------------------
+  // Build a kXR_readv request covering a subset of the chunks
+  //----------------------------------------------------------------------------
+  Message *FileStateHandler::CreateVectorRead( const ChunkList &chunks,
+                                               size_t           first,
+                                               size_t           count,
+                                               char            *cursor,
+                                               ChunkList       *list )
+  {
     Message            *msg;
     ClientReadVRequest *req;
-    MessageUtils::CreateRequest( msg, req, sizeof(readahead_list)*chunks.size() );
+    MessageUtils::CreateRequest( msg, req, sizeof(readahead_list)*count );
 
     req->requestid = kXR_readv;
-    req->dlen      = sizeof(readahead_list)*chunks.size();
-
-    ChunkList *list   = new ChunkList();
-    char      *cursor = (char*)buffer;
+    req->dlen      = sizeof(readahead_list)*count;
 
     //--------------------------------------------------------------------------
     // Copy the chunk info
     //--------------------------------------------------------------------------
     readahead_list *dataChunk = (readahead_list*)msg->GetBuffer( 24 );
-    for( size_t i = 0; i < chunks.size(); ++i )
+    for( size_t i = 0; i < count; ++i )
     {
-      dataChunk[i].rlen   = chunks[i].length;
-      dataChunk[i].offset = chunks[i].offset;
+      const ChunkInfo &chunk = chunks[first+i];
+      dataChunk[i].rlen   = chunk.length;
+      dataChunk[i].offset = chunk.offset;
       memcpy( dataChunk[i].fhandle, pFileHandle, 4 );
 
       void *chunkBuffer;
       if( cursor )
       {
         chunkBuffer  = cursor;
-        cursor      += chunks[i].length;
+        cursor      += chunk.length;
       }
       else
-        chunkBuffer = chunks[i].buffer;
+        chunkBuffer = chunk.buffer;
 
-      list->push_back( ChunkInfo( chunks[i].offset,
-                                  chunks[i].length,
-                                  chunkBuffer ) );
+      list->push_back( ChunkInfo( chunk.offset, chunk.length, chunkBuffer ) );
     }
 
-    //--------------------------------------------------------------------------
-    // Send the message
-    //--------------------------------------------------------------------------
-    MessageSendParams params;
-    params.timeout         = timeout;
-    params.followRedirects = false;
-    params.stateful        = true;
-    params.chunkList       = list;
-    MessageUtils::ProcessSendParams( params );
-
     XRootDTransport::SetDescription( msg );
-    StatefulHandler *stHandler = new StatefulHandler( this, handler, msg, params );
-    return SendOrQueue( *pDataServer, msg, stHandler, params );
+    return msg;
+  }
+
+  //----------------------------------------------------------------------------
+  // Split the chunk list into groups that fit within the limits of a single
+  // kXR_readv request
+  //----------------------------------------------------------------------------
+  void FileStateHandler::SplitVectorRead( const ChunkList     &chunks,
+                                          std::vector<size_t> &groups ) const
+  {
+    Env *env      = DefaultEnv::GetEnv();
+    int  maxSegs  = DefaultMaxReadVSegments;
+    int  maxSize  = DefaultMaxReadVSize;
+    env->GetInt( "MaxReadVSegments", maxSegs );
+    env->GetInt( "MaxReadVSize",     maxSize );
+    if( maxSegs < 1 ) maxSegs = 1;
+    if( maxSize < 1 ) maxSize = 1;
+
+    uint64_t groupSize = 0;
+    for( size_t i = 0; i < chunks.size(); ++i )
+    {
+      if( groups.empty() ||
+          i - groups.back() >= (size_t)maxSegs ||
+          groupSize + chunks[i].length > (uint64_t)maxSize )
+      {
+        groups.push_back( i );
+        groupSize = 0;
+      }
+      groupSize += chunks[i].length;
+    }
+    groups.push_back( chunks.size() );
   }
 
   //----------------------------------------------------------------------------
@@ -734,6 +1261,43 @@ namespace XrdCl
     return false;
   }
 
+  //----------------------------------------------------------------------------
+  // Check if the file has never been opened or has been closed
+  //----------------------------------------------------------------------------
+  bool FileStateHandler::IsClosed() const
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    return pFileState == Closed;
+  }
+
+  //----------------------------------------------------------------------------
+  // Check if the file is open for reading only with no requests in flight
+  //----------------------------------------------------------------------------
+  bool FileStateHandler::IsIdleReadOnly() const
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    return pFileState == Opened && IsReadOnly() && OnlyAbandonedInTheFly() &&
+           pToBeRecovered.empty();
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the URL the file has been opened with
+  //----------------------------------------------------------------------------
+  std::string FileStateHandler::GetFileURL() const
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    return pFileUrl ? pFileUrl->GetURL() : "";
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the flags the file has been opened with
+  //----------------------------------------------------------------------------
+  uint16_t FileStateHandler::GetOpenFlags() const
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    return pOpenFlags;
+  }
+
   //----------------------------------------------------------------------------
   // Enable/disable state recovery procedures while the file is open for
   // reading
@@ -798,6 +1362,13 @@ namespace XrdCl
     if( pDataServer )
       lastServer = pDataServer->GetHostId();
 
+    //--------------------------------------------------------------------------
+    // The redirector stays the load balancer of a file opened straight at
+    // the data server
+    //--------------------------------------------------------------------------
+    if( pOpenedFromCache && !pLoadBalancer )
+      pLoadBalancer = new URL( pFileUrl->GetHostId() + "/" );
+
     log->Debug( FileMsg, "[0x%x@%s] Open has returned with status %s",
                 this, pFileUrl->GetURL().c_str(), status->ToStr().c_str() );
 
@@ -836,6 +1407,13 @@ namespace XrdCl
       //------------------------------------------------------------------------
       openInfo->GetFileHandle( pFileHandle );
       pSessionId = openInfo->GetSessionId();
+
+      //------------------------------------------------------------------------
+      // Remember where we have been redirected to
+      //------------------------------------------------------------------------
+      RedirectCache *cache = DefaultEnv::GetRedirectCache();
+      if( cache && IsReadOnly() && hostList && hostList->size() > 1 )
+        cache->Put( *pFileUrl, hostList->back().url, hostList->back().cgi );
       if( openInfo->GetStatInfo() )
       {
         delete pStatInfo;
@@ -862,6 +1440,18 @@ namespace XrdCl
         mon->Event( Monitor::EvOpen, &i );
       }
 
+      //------------------------------------------------------------------------
+      // Start prefetching unless we're recovering
+      //------------------------------------------------------------------------
+      if( pFileState != Recovering )
+        StartPrefetch();
+
+      //------------------------------------------------------------------------
+      // Find a new replica for the duplicated reads, the data server might
+      // have changed
+      //------------------------------------------------------------------------
+      StartHedging();
+
       //------------------------------------------------------------------------
       // Resend the queued messages if any
       //------------------------------------------------------------------------
@@ -888,6 +1478,8 @@ namespace XrdCl
 
     MonitorClose( status );
     ResetMonitoringVars();
+    ResetPrefetch();
+    ResetHedging();
 
     pStatus    = *status;
     pFileState = Closed;
@@ -903,7 +1495,8 @@ namespace XrdCl
   {
     Log *log = DefaultEnv::GetLog();
     XrdSysMutexHelper scopedLock( pMutex );
-    pInTheFly.erase( message );
+    bool abandoned = IsAbandoned( message );
+    RequestDone( message );
 
     log->Dump( FileMsg, "[0x%x@%s] File state error encountered. Message %s "
                "returned with %s", this, pFileUrl->GetURL().c_str(),
@@ -932,8 +1525,15 @@ namespace XrdCl
     }
 
     //--------------------------------------------------------------------------
-    // The message is not recoverable
+    // The message is not recoverable or nobody is waiting for it anymore
     //--------------------------------------------------------------------------
+    if( abandoned )
+    {
+      FailMessage( RequestData( message, userHandler, sendParams ), *status );
+      delete status;
+      return;
+    }
+
     if( !IsRecoverable( *status ) )
     {
       log->Error( FileMsg, "[0x%x@%s] Fatal file state error. Message %s "
@@ -963,7 +1563,15 @@ namespace XrdCl
                                              MessageSendParams &sendParams )
   {
     XrdSysMutexHelper scopedLock( pMutex );
-    pInTheFly.erase( message );
+    bool abandoned = IsAbandoned( message );
+    RequestDone( message );
+
+    if( abandoned )
+    {
+      FailMessage( RequestData( message, userHandler, sendParams ),
+                   XRootDStatus( stError, errOperationExpired ) );
+      return;
+    }
 
     //--------------------------------------------------------------------------
     // Register the state redirect url and append the new cgi information to
@@ -1002,7 +1610,7 @@ namespace XrdCl
     // Since this message may be the last "in-the-fly" and no recovery
     // is done if messages are in the fly, we may need to trigger recovery
     //--------------------------------------------------------------------------
-    pInTheFly.erase( message );
+    RequestDone( message );
     RunRecovery();
 
     //--------------------------------------------------------------------------
@@ -1230,6 +1838,56 @@ namespace XrdCl
     return st;
   }
 
+  //----------------------------------------------------------------------------
+  // Send the open request to the redirector
+  //----------------------------------------------------------------------------
+  XRootDStatus FileStateHandler::OpenAtRedirector( ResponseHandler *handler,
+                                                   uint16_t         timeout )
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    Log *log = DefaultEnv::GetLog();
+    log->Debug( FileMsg, "[0x%x@%s] The remembered data server has failed, "
+                "sending the open to the redirector", this,
+                pFileUrl->GetURL().c_str() );
+
+    RedirectCache *cache = DefaultEnv::GetRedirectCache();
+    if( cache )
+      cache->Remove( *pFileUrl );
+    pOpenedFromCache = false;
+    return SendOpen( *pFileUrl, "", handler, timeout );
+  }
+
+  //----------------------------------------------------------------------------
+  // Send the open request to the given server
+  //----------------------------------------------------------------------------
+  Status FileStateHandler::SendOpen( const URL         &url,
+                                     const std::string &cgi,
+                                     ResponseHandler   *handler,
+                                     uint16_t           timeout )
+  {
+    Message           *msg;
+    ClientOpenRequest *req;
+    std::string        path = pFileUrl->GetPathWithParams();
+    MessageUtils::CreateRequest( msg, req, path.length() );
+
+    req->requestid = kXR_open;
+    req->mode      = pOpenMode;
+    req->options   = pOpenFlags | kXR_async | kXR_retstat;
+    req->dlen      = path.length();
+    msg->Append( path.c_str(), path.length(), 24 );
+    if( !cgi.empty() )
+    {
+      URL cgiURL( "fake://fake:111//fake?" + cgi );
+      MessageUtils::AppendCGI( msg, cgiURL.GetParams(), false );
+    }
+
+    XRootDTransport::SetDescription( msg );
+    MessageSendParams params; params.timeout = timeout;
+    MessageUtils::ProcessSendParams( params );
+
+    return MessageUtils::SendMessage( url, msg, handler, params );
+  }
+
   //----------------------------------------------------------------------------
   // Re-open the current file at a given server
   //----------------------------------------------------------------------------
@@ -1392,7 +2050,212 @@ namespace XrdCl
       i.vCount = pVCount;
       i.wCount = pWCount;
       i.status = status;
+      if( pPrefetch )
+        pPrefetch->GetStats( i.pfBytes, i.pfWaste, i.pfHits, i.pfMisses );
       mon->Event( Monitor::EvClose, &i );
     }
   }
+
+  //----------------------------------------------------------------------------
+  // Start recording the read ranges and prefetch the ones recorded for
+  // the files of the same class
+  //----------------------------------------------------------------------------
+  void FileStateHandler::StartPrefetch()
+  {
+    Env *env = DefaultEnv::GetEnv();
+    pProfileDir = DefaultPrefetchProfileDir;
+    env->GetString( "PrefetchProfileDir", pProfileDir );
+    if( pProfileDir.empty() || !IsReadOnly() || !pStatInfo )
+      return;
+
+    Log *log = DefaultEnv::GetLog();
+    PrefetchProfileStore store( pProfileDir );
+    pProfileKey = PrefetchProfileStore::GetFingerprint( pFileUrl->GetPath(),
+                                                        pStatInfo->GetSize() );
+
+    //--------------------------------------------------------------------------
+    // Check if we know what is going to be read
+    //--------------------------------------------------------------------------
+    ChunkList profile;
+    if( !store.Load( pProfileKey, profile ) )
+    {
+      log->Debug( FileMsg, "[0x%x@%s] No prefetch profile for %s", this,
+                  pFileUrl->GetURL().c_str(), pProfileKey.c_str() );
+      return;
+    }
+
+    int maxSize = DefaultPrefetchMaxSize;
+    env->GetInt( "PrefetchMaxSize", maxSize );
+
+    ChunkList ranges;
+    PrefetchProfileStore::Coalesce( profile, ranges, pStatInfo->GetSize(),
+                                    PrefetchMaxGap, PrefetchMaxChunk,
+                                    maxSize );
+    if( ranges.empty() )
+      return;
+
+    log->Debug( FileMsg, "[0x%x@%s] Prefetching %d ranges according to the "
+                "profile for %s", this, pFileUrl->GetURL().c_str(),
+                ranges.size(), pProfileKey.c_str() );
+
+    //--------------------------------------------------------------------------
+    // Send the prefetch requests, they are not registered as being in the
+    // fly so that they don't hold back the close or the recovery and
+    // their failures are simply ignored
+    //--------------------------------------------------------------------------
+    pPrefetch = new PrefetchCache( ranges );
+    const ChunkList &chunks = pPrefetch->GetChunks();
+
+    std::vector<size_t> groups;
+    SplitVectorRead( chunks, groups );
+
+    for( size_t i = 0; i+1 < groups.size(); ++i )
+    {
+      size_t     first = groups[i];
+      size_t     count = groups[i+1] - first;
+      ChunkList *list  = new ChunkList();
+      Message   *msg   = CreateVectorRead( chunks, first, count, 0, list );
+      msg->SetSessionId( pSessionId );
+
+      MessageSendParams params;
+      params.followRedirects = false;
+      params.stateful        = true;
+      params.chunkList       = list;
+      MessageUtils::ProcessSendParams( params );
+
+      PrefetchHandler *handler = new PrefetchHandler( pPrefetch, msg, list,
+                                                      first );
+      Status st = MessageUtils::SendMessage( *pDataServer, msg, handler,
+                                             params );
+      if( !st.IsOK() )
+      {
+        log->Debug( FileMsg, "[0x%x@%s] Unable to send a prefetch request: %s",
+                    this, pFileUrl->GetURL().c_str(), st.ToString().c_str() );
+        delete handler;
+        break;
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Store the recorded read ranges in the profile store
+  //----------------------------------------------------------------------------
+  void FileStateHandler::SaveReadProfile()
+  {
+    if( pProfileKey.empty() || pReadProfile.empty() )
+      return;
+
+    PrefetchProfileStore store( pProfileDir );
+    store.Save( pProfileKey, pReadProfile );
+  }
+
+  //----------------------------------------------------------------------------
+  // Drop the prefetched data and the recorded ranges
+  //----------------------------------------------------------------------------
+  void FileStateHandler::ResetPrefetch()
+  {
+    if( pPrefetch )
+      pPrefetch->UnRef();
+    pPrefetch = 0;
+    pProfileKey.clear();
+    pReadProfile.clear();
+  }
+
+  //----------------------------------------------------------------------------
+  // Record a read range for the prefetch profile
+  //----------------------------------------------------------------------------
+  void FileStateHandler::RecordRead( uint64_t offset, uint32_t size )
+  {
+    if( pProfileKey.empty() || pReadProfile.size() >= PrefetchMaxRecordedRanges )
+      return;
+    pReadProfile.push_back( ChunkInfo( offset, size ) );
+  }
+
+  //----------------------------------------------------------------------------
+  // Prepare a second replica for the duplicates of the slow reads
+  //----------------------------------------------------------------------------
+  void FileStateHandler::StartHedging()
+  {
+    ResetHedging();
+
+    int hedging = DefaultReadHedging;
+    DefaultEnv::GetEnv()->GetInt( "ReadHedging", hedging );
+    if( !hedging || !IsReadOnly() || !pLoadBalancer || !pDataServer )
+      return;
+
+    Log *log = DefaultEnv::GetLog();
+    log->Debug( FileMsg, "[0x%x@%s] Slow reads will be duplicated to another "
+                "replica found by %s", this, pFileUrl->GetURL().c_str(),
+                pLoadBalancer->GetHostId().c_str() );
+
+    pHedgeReplica = new HedgeReplica( *pLoadBalancer, *pFileUrl, *pDataServer,
+                                      pOpenFlags );
+  }
+
+  //----------------------------------------------------------------------------
+  // Release the second replica
+  //----------------------------------------------------------------------------
+  void FileStateHandler::ResetHedging()
+  {
+    if( !pHedgeReplica )
+      return;
+
+    uint32_t sent, won;
+    pHedgeReplica->GetStats( sent, won );
+    if( sent )
+    {
+      Log *log = DefaultEnv::GetLog();
+      log->Debug( FileMsg, "[0x%x@%s] %d reads have been duplicated to %s, "
+                  "%d of the duplicates arrived first", this,
+                  pFileUrl->GetURL().c_str(), sent,
+                  pHedgeReplica->GetDataServer().c_str(), won );
+    }
+
+    pHedgeReplica->UnRef();
+    pHedgeReplica = 0;
+  }
+
+  //----------------------------------------------------------------------------
+  // Check if the request is an original read beaten by its duplicate
+  //----------------------------------------------------------------------------
+  bool FileStateHandler::IsAbandoned( Message *message ) const
+  {
+    HedgedReadMap::const_iterator it = pHedgedReads.find( message );
+    return it != pHedgedReads.end() && it->second->IsDone();
+  }
+
+  //----------------------------------------------------------------------------
+  // Check if all the requests in the fly have been abandoned
+  //----------------------------------------------------------------------------
+  bool FileStateHandler::OnlyAbandonedInTheFly() const
+  {
+    std::set<Message*>::const_iterator it;
+    for( it = pInTheFly.begin(); it != pInTheFly.end(); ++it )
+      if( !IsAbandoned( *it ) )
+        return false;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // The request is not in the fly anymore
+  //----------------------------------------------------------------------------
+  void FileStateHandler::RequestDone( Message *message )
+  {
+    pInTheFly.erase( message );
+    HedgedReadMap::iterator it = pHedgedReads.find( message );
+    if( it != pHedgedReads.end() )
+    {
+      it->second->UnRef();
+      pHedgedReads.erase( it );
+    }
+
+    if( !pDeferredClose || !pInTheFly.empty() )
+      return;
+
+    ResponseHandler *handler = pDeferredClose;
+    pDeferredClose = 0;
+    XRootDStatus st = SendClose( handler, pDeferredCloseTimeout );
+    if( !st.IsOK() )
+      handler->HandleResponse( new XRootDStatus( st ), 0 );
+  }
 }
@@ -25,11 +25,15 @@
 #include "XrdCl/XrdClMessageUtils.hh"
 #include "XrdSys/XrdSysPthread.hh"
 #include <list>
+#include <map>
 #include <set>
 
 namespace XrdCl
 {
   class Message;
+  class PrefetchCache;
+  class HedgeReplica;
+  class HedgedRead;
 
   //----------------------------------------------------------------------------
   //! Handle the statefull operations
@@ -190,6 +194,13 @@ namespace XrdCl
                    const OpenInfo     *openInfo,
                    const HostList     *hostList );
 
+      //------------------------------------------------------------------------
+      //! Send the open request to the redirector after the data server
+      //! remembered for the file has failed to open it
+      //------------------------------------------------------------------------
+      XRootDStatus OpenAtRedirector( ResponseHandler *handler,
+                                     uint16_t         timeout );
+
       //------------------------------------------------------------------------
       //! Process the results of the closing operation
       //------------------------------------------------------------------------
@@ -224,6 +235,27 @@ namespace XrdCl
       //------------------------------------------------------------------------
       bool IsOpen() const;
 
+      //------------------------------------------------------------------------
+      //! Check if the file has never been opened or has been closed
+      //------------------------------------------------------------------------
+      bool IsClosed() const;
+
+      //------------------------------------------------------------------------
+      //! Check if the file is open for reading only with no requests in
+      //! flight, so that its handle may be kept after the user closes it
+      //------------------------------------------------------------------------
+      bool IsIdleReadOnly() const;
+
+      //------------------------------------------------------------------------
+      //! Get the URL the file has been opened with
+      //------------------------------------------------------------------------
+      std::string GetFileURL() const;
+
+      //------------------------------------------------------------------------
+      //! Get the flags the file has been opened with
+      //------------------------------------------------------------------------
+      uint16_t GetOpenFlags() const;
+
       //------------------------------------------------------------------------
       //! Enable/disable state recovery procedures while the file is open for
       //! reading
@@ -278,6 +310,7 @@ namespace XrdCl
         MessageSendParams  params;
       };
       typedef std::list<RequestData> RequestList;
+      typedef std::map<Message*, HedgedRead*> HedgedReadMap;
 
       //------------------------------------------------------------------------
       //! Send a message to a host or put it in the recovery queue
@@ -287,6 +320,102 @@ namespace XrdCl
                           ResponseHandler   *handler,
                           MessageSendParams &sendParams );
 
+      //------------------------------------------------------------------------
+      //! Build and send a single kXR_readv request covering a subset of
+      //! the chunks
+      //!
+      //! @param chunks  list of all the chunks requested by the user
+      //! @param first   index of the first chunk to be included
+      //! @param count   number of chunks to be included
+      //! @param cursor  position in the user buffer corresponding to the
+      //!                first chunk, or 0 if the chunk buffers should be used
+      //! @param handler handler to be notified when the response arrives
+      //! @param timeout timeout value
+      //------------------------------------------------------------------------
+      Status SendVectorRead( const ChunkList &chunks,
+                             size_t           first,
+                             size_t           count,
+                             char            *cursor,
+                             ResponseHandler *handler,
+                             uint16_t         timeout );
+
+      //------------------------------------------------------------------------
+      //! Build a kXR_readv request covering a subset of the chunks
+      //!
+      //! @param list filled with the chunks and the buffers the data should
+      //!             be put in
+      //------------------------------------------------------------------------
+      Message *CreateVectorRead( const ChunkList &chunks,
+                                 size_t           first,
+                                 size_t           count,
+                                 char            *cursor,
+                                 ChunkList       *list );
+
+      //------------------------------------------------------------------------
+      //! Split the chunk list into groups that fit within the limits of
+      //! a single kXR_readv request
+      //!
+      //! @param groups indices of the first chunk of every group followed
+      //!               by the size of the list
+      //------------------------------------------------------------------------
+      void SplitVectorRead( const ChunkList     &chunks,
+                            std::vector<size_t> &groups ) const;
+
+      //------------------------------------------------------------------------
+      //! Start recording the read ranges and prefetch the ones recorded
+      //! for the files of the same class if the profile store is enabled
+      //------------------------------------------------------------------------
+      void StartPrefetch();
+
+      //------------------------------------------------------------------------
+      //! Store the recorded read ranges in the profile store
+      //------------------------------------------------------------------------
+      void SaveReadProfile();
+
+      //------------------------------------------------------------------------
+      //! Drop the prefetched data and the recorded ranges
+      //------------------------------------------------------------------------
+      void ResetPrefetch();
+
+      //------------------------------------------------------------------------
+      //! Record a read range for the prefetch profile
+      //------------------------------------------------------------------------
+      void RecordRead( uint64_t offset, uint32_t size );
+
+      //------------------------------------------------------------------------
+      //! Prepare a second replica for the duplicates of the slow reads if
+      //! hedged reads are enabled and the file has been opened through a
+      //! load balancer
+      //------------------------------------------------------------------------
+      void StartHedging();
+
+      //------------------------------------------------------------------------
+      //! Release the second replica
+      //------------------------------------------------------------------------
+      void ResetHedging();
+
+      //------------------------------------------------------------------------
+      //! Check if the request is an original read whose duplicate has
+      //! already been handed to the user
+      //------------------------------------------------------------------------
+      bool IsAbandoned( Message *message ) const;
+
+      //------------------------------------------------------------------------
+      //! Check if all the requests in the fly have been abandoned
+      //------------------------------------------------------------------------
+      bool OnlyAbandonedInTheFly() const;
+
+      //------------------------------------------------------------------------
+      //! The request is not in the fly anymore, send the close if it has
+      //! been waiting for the last abandoned request
+      //------------------------------------------------------------------------
+      void RequestDone( Message *message );
+
+      //------------------------------------------------------------------------
+      //! Send the close request
+      //------------------------------------------------------------------------
+      XRootDStatus SendClose( ResponseHandler *handler, uint16_t timeout );
+
       //------------------------------------------------------------------------
       //! Check if the stateful error is recoverable
       //------------------------------------------------------------------------
@@ -312,6 +441,15 @@ namespace XrdCl
       //------------------------------------------------------------------------
       bool IsReadOnly() const;
 
+      //------------------------------------------------------------------------
+      //! Send the open request to the given server with the opaque data
+      //! appended to the path
+      //------------------------------------------------------------------------
+      Status SendOpen( const URL         &url,
+                       const std::string &cgi,
+                       ResponseHandler   *handler,
+                       uint16_t           timeout );
+
       //------------------------------------------------------------------------
       //! Re-open the current file at a given server
       //------------------------------------------------------------------------
@@ -374,6 +512,7 @@ namespace XrdCl
       uint64_t                pSessionId;
       bool                    pDoRecoverRead;
       bool                    pDoRecoverWrite;
+      bool                    pOpenedFromCache;
 
       //------------------------------------------------------------------------
       // Monitoring variables
@@ -387,6 +526,22 @@ namespace XrdCl
       uint64_t                 pVCount;
       uint64_t                 pWCount;
       XRootDStatus             pCloseReason;
+
+      //------------------------------------------------------------------------
+      // Prefetching
+      //------------------------------------------------------------------------
+      PrefetchCache           *pPrefetch;
+      std::string              pProfileKey;
+      std::string              pProfileDir;
+      ChunkList                pReadProfile;
+
+      //------------------------------------------------------------------------
+      // Hedged reads
+      //------------------------------------------------------------------------
+      HedgeReplica            *pHedgeReplica;
+      HedgedReadMap            pHedgedReads;
+      ResponseHandler         *pDeferredClose;
+      uint16_t                 pDeferredCloseTimeout;
   };
 }
 
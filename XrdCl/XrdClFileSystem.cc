@@ -26,14 +26,23 @@
 #include "XrdCl/XrdClRequestSync.hh"
 #include "XrdCl/XrdClXRootDTransport.hh"
 #include "XrdCl/XrdClForkHandler.hh"
+#include "XrdCl/XrdClMetadataCache.hh"
+#include "XrdCl/XrdClUtils.hh"
 #include "XrdSys/XrdSysPthread.hh"
 
 #include <memory>
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
 
 namespace
 {
   //----------------------------------------------------------------------------
-  // Deep locate handler
+  // Deep locate handler. The managers returned by the locate requests are
+  // asked in turn, each of them once and up to ParallelLocates of them at
+  // a time, and the answer is given out once all of them have responded
+  // or enough servers have been found.
   //----------------------------------------------------------------------------
   class DeepLocateHandler: public XrdCl::ResponseHandler
   {
@@ -44,15 +53,22 @@ namespace
       DeepLocateHandler( XrdCl::ResponseHandler *handler,
                          const std::string          &path,
                          uint16_t                    flags,
+                         uint32_t                    enough,
                          time_t                      expires ):
         pFirstTime( true ),
+        pDone( false ),
         pOutstanding( 1 ),
+        pEnough( enough ),
         pHandler( handler ),
         pPath( path ),
         pFlags( flags ),
         pExpires(expires)
       {
         pLocations = new XrdCl::LocationInfo();
+
+        int parallel = XrdCl::DefaultParallelLocates;
+        XrdCl::DefaultEnv::GetEnv()->GetInt( "ParallelLocates", parallel );
+        pParallel = parallel > 0 ? parallel : 1;
       }
 
       //------------------------------------------------------------------------
@@ -71,6 +87,7 @@ namespace
       {
         using namespace XrdCl;
         Log *log = DefaultEnv::GetLog();
+        pMutex.Lock();
         --pOutstanding;
 
         //----------------------------------------------------------------------
@@ -90,23 +107,18 @@ namespace
             log->Debug( FileSystemMsg, "[0x%x@DeepLocate(%s)] Failed to get "
                         "the initial location list: %s", this, pPath.c_str(),
                         status->ToStr().c_str() );
-            pHandler->HandleResponse( status, response );
-            delete this;
+            ResponseHandler *handler = pHandler;
+            pDone = true;
+            pMutex.UnLock();
+            handler->HandleResponse( status, response );
+            Proceed( 0 );
             return;
           }
 
-          //--------------------------------------------------------------------
-          // We have no more outstanding requests, so let give to the client
-          // what we have
-          //--------------------------------------------------------------------
-          if( !pOutstanding )
-          {
-            log->Debug( FileSystemMsg, "[0x%x@DeepLocate(%s)] No outstanding "
-                        "requests, give out what we've got", this,
-                        pPath.c_str() );
-            HandleFinalResponse();
-          }
+          pMutex.UnLock();
           delete status;
+          delete response;
+          Proceed( 0 );
           return;
         }
         pFirstTime = false;
@@ -124,86 +136,207 @@ namespace
         for( it = info->Begin(); it != info->End(); ++it )
         {
           //--------------------------------------------------------------------
-          // Add the location to the list
+          // Add the location to the list, once
           //--------------------------------------------------------------------
           if( it->IsServer() )
           {
-            pLocations->Add( *it );
+            if( pLocations && pServers.insert( it->GetAddress() ).second )
+              pLocations->Add( *it );
             continue;
           }
 
           //--------------------------------------------------------------------
-          // Ask the manager for the location of servers
+          // Queue the manager to be asked for the location of servers
           //--------------------------------------------------------------------
-          if( it->IsManager() )
-          {
-            FileSystem fs( it->GetAddress() );
-            if( fs.Locate( pPath, pFlags, this, pExpires-::time(0)).IsOK() )
-              ++pOutstanding;
-          }
+          if( it->IsManager() && pManagers.insert( it->GetAddress() ).second )
+            pPending.push_back( it->GetAddress() );
         }
+        pMutex.UnLock();
 
-        //----------------------------------------------------------------------
-        // Clean up and check if we have anything else to do
-        //----------------------------------------------------------------------
         delete response;
         delete status;
-        if( !pOutstanding )
-          HandleFinalResponse();
+        Proceed( 0 );
+      }
+
+    private:
+      //------------------------------------------------------------------------
+      // Ask the pending managers or give out the answer if there is nothing
+      // more to wait for, the handler is gone once all the responses have
+      // come back after the answer
+      //------------------------------------------------------------------------
+      void Proceed( uint32_t failed )
+      {
+        using namespace XrdCl;
+        while( 1 )
+        {
+          std::vector<std::string> managers;
+          ResponseHandler         *handler  = pHandler;
+          XRootDStatus            *status   = 0;
+          AnyObject               *response = 0;
+          bool                     destroy;
+
+          pMutex.Lock();
+          pOutstanding -= failed;
+          if( !pDone )
+          {
+            bool enough = pEnough && pLocations->GetSize() >= pEnough;
+            while( !enough && !pPending.empty() && pOutstanding < pParallel )
+            {
+              managers.push_back( pPending.front() );
+              pPending.pop_front();
+              ++pOutstanding;
+            }
+
+            if( enough || !pOutstanding )
+            {
+              BuildFinalResponse( status, response );
+              pDone = true;
+            }
+          }
+          destroy = pDone && !pOutstanding;
+          pMutex.UnLock();
+
+          if( status )
+            handler->HandleResponse( status, response );
+
+          if( destroy )
+          {
+            delete this;
+            return;
+          }
+
+          //--------------------------------------------------------------------
+          // Send the requests, the ones that could not be sent will not
+          // respond
+          //--------------------------------------------------------------------
+          failed = 0;
+          std::vector<std::string>::iterator it;
+          for( it = managers.begin(); it != managers.end(); ++it )
+          {
+            time_t timeLeft = pExpires-::time(0);
+            FileSystem fs( *it );
+            if( timeLeft <= 0 ||
+                !fs.Locate( pPath, pFlags, this, timeLeft ).IsOK() )
+              ++failed;
+          }
+          if( !failed )
+            return;
+        }
       }
 
       //------------------------------------------------------------------------
       // Build the response for the client
       //------------------------------------------------------------------------
-      void HandleFinalResponse()
+      void BuildFinalResponse( XrdCl::XRootDStatus *&status,
+                               XrdCl::AnyObject    *&response )
       {
         using namespace XrdCl;
+        Log *log = DefaultEnv::GetLog();
+        log->Debug( FileSystemMsg, "[0x%x@DeepLocate(%s)] Giving out %d "
+                    "locations, %d requests outstanding", this, pPath.c_str(),
+                    pLocations->GetSize(), pOutstanding );
 
         //----------------------------------------------------------------------
         // Nothing found
         //----------------------------------------------------------------------
         if( !pLocations->GetSize() )
         {
-          pHandler->HandleResponse( new XRootDStatus( stError, errErrorResponse,
-                                                   kXR_NotFound,
-                                                   "No valid location found" ),
-                                    0 );
+          status = new XRootDStatus( stError, errErrorResponse, kXR_NotFound,
+                                     "No valid location found" );
+          return;
         }
+
         //----------------------------------------------------------------------
         // We return an answer
         //----------------------------------------------------------------------
-        else
-        {
-          AnyObject *obj = new AnyObject();
-          obj->Set( pLocations );
-          pLocations = 0;
-          pHandler->HandleResponse( new XRootDStatus(), obj );
-        }
-        delete this;
+        status   = new XRootDStatus();
+        response = new AnyObject();
+        response->Set( pLocations );
+        pLocations = 0;
       }
 
-    private:
+      XrdSysMutex             pMutex;
       bool                    pFirstTime;
-      uint16_t                pOutstanding;
+      bool                    pDone;
+      uint32_t                pOutstanding;
+      uint32_t                pParallel;
+      uint32_t                pEnough;
       XrdCl::ResponseHandler *pHandler;
       XrdCl::LocationInfo    *pLocations;
+      std::set<std::string>   pServers;
+      std::set<std::string>   pManagers;
+      std::list<std::string>  pPending;
       std::string             pPath;
       uint16_t                pFlags;
       time_t                  pExpires;
   };
 
+  //----------------------------------------------------------------------------
+  // Access the entries of both kinds of directory lists
+  //----------------------------------------------------------------------------
+  bool HasStatInfo( XrdCl::DirectoryList *list, uint32_t index )
+  {
+    return list->At( index )->GetStatInfo();
+  }
+
+  bool HasStatInfo( XrdCl::CompactDirectoryList *list, uint32_t index )
+  {
+    return list->At( index ).HasStatInfo();
+  }
+
+  const std::string &GetHostAddress( XrdCl::DirectoryList *list,
+                                     uint32_t              index )
+  {
+    return list->At( index )->GetHostAddress();
+  }
+
+  const std::string &GetHostAddress( XrdCl::CompactDirectoryList *list,
+                                     uint32_t                     index )
+  {
+    return list->At( index ).GetHostAddress();
+  }
+
+  void AppendName( std::string          &path,
+                   XrdCl::DirectoryList *list,
+                   uint32_t              index )
+  {
+    path += list->At( index )->GetName();
+  }
+
+  void AppendName( std::string                 &path,
+                   XrdCl::CompactDirectoryList *list,
+                   uint32_t                     index )
+  {
+    XrdCl::CompactDirectoryList::Entry entry = list->At( index );
+    path.append( entry.GetName(), entry.GetNameLength() );
+  }
+
+  void SetStatInfo( XrdCl::DirectoryList *list, uint32_t index,
+                    XrdCl::StatInfo *info )
+  {
+    list->At( index )->SetStatInfo( info );
+  }
+
+  void SetStatInfo( XrdCl::CompactDirectoryList *list, uint32_t index,
+                    XrdCl::StatInfo *info )
+  {
+    list->SetStatInfo( index, *info );
+    delete info;
+  }
+
   //----------------------------------------------------------------------------
   // Handle stat results for a dirlist request
   //----------------------------------------------------------------------------
+  template<class List>
   class DirListStatHandler: public XrdCl::ResponseHandler
   {
     public:
       //------------------------------------------------------------------------
       // Constructor
       //------------------------------------------------------------------------
-      DirListStatHandler( XrdCl::DirectoryList *list,
-                          uint32_t                  index,
-                          XrdCl::RequestSync   *sync ):
+      DirListStatHandler( List               *list,
+                          uint32_t            index,
+                          XrdCl::RequestSync *sync ):
         pList( list ),
         pIndex( index ),
         pSync( sync )
@@ -228,7 +361,7 @@ namespace
         XrdCl::StatInfo *info = 0;
         response->Get( info );
         response->Set( (char*) 0 );
-        pList->At( pIndex )->SetStatInfo( info );
+        SetStatInfo( pList, pIndex, info );
         delete status;
         delete response;
         pSync->TaskDone();
@@ -236,10 +369,501 @@ namespace
       }
 
     private:
-      XrdCl::DirectoryList *pList;
-      uint32_t                  pIndex;
+      List               *pList;
+      uint32_t            pIndex;
+      XrdCl::RequestSync *pSync;
+  };
+
+  //----------------------------------------------------------------------------
+  // Merge the directory lists coming from many servers as they arrive,
+  // an entry found at more than one server is listed once
+  //----------------------------------------------------------------------------
+  class DirListMerger
+  {
+    public:
+      //------------------------------------------------------------------------
+      // Constructor
+      //------------------------------------------------------------------------
+      DirListMerger( XrdCl::DirectoryList *list ): pList( list ) {}
+
+      //------------------------------------------------------------------------
+      // Move the new entries of the list to the merged list
+      //------------------------------------------------------------------------
+      void Merge( XrdCl::DirectoryList *list )
+      {
+        XrdSysMutexHelper scopedLock( pMutex );
+        XrdCl::DirectoryList::Iterator it;
+        for( it = list->Begin(); it != list->End(); ++it )
+        {
+          if( pNames.insert( (*it)->GetName() ).second )
+            pList->Add( *it );
+          else
+            delete *it;
+          *it = 0;
+        }
+      }
+
+      //------------------------------------------------------------------------
+      // Note that a server could not be listed
+      //------------------------------------------------------------------------
+      void Fail( const std::string         &server,
+                 const XrdCl::XRootDStatus &status )
+      {
+        XrdSysMutexHelper scopedLock( pMutex );
+        if( !pFailures.empty() )
+          pFailures += ", ";
+        pFailures += server + ": " + status.ToStr();
+      }
+
+      //------------------------------------------------------------------------
+      // Get the servers that could not be listed and the reasons
+      //------------------------------------------------------------------------
+      std::string GetFailures()
+      {
+        XrdSysMutexHelper scopedLock( pMutex );
+        return pFailures;
+      }
+
+    private:
+      XrdSysMutex            pMutex;
+      XrdCl::DirectoryList  *pList;
+      std::set<std::string>  pNames;
+      std::string            pFailures;
+  };
+
+  //----------------------------------------------------------------------------
+  // Handle the dirlist response of one of the servers holding a directory
+  //----------------------------------------------------------------------------
+  class DirListLocateHandler: public XrdCl::ResponseHandler
+  {
+    public:
+      //------------------------------------------------------------------------
+      // Constructor
+      //------------------------------------------------------------------------
+      DirListLocateHandler( const std::string   &server,
+                            DirListMerger       *merger,
+                            XrdCl::RequestSync  *sync ):
+        pServer( server ),
+        pMerger( merger ),
+        pSync( sync )
+      {
+      }
+
+      //------------------------------------------------------------------------
+      // Merge the entries or note the failure
+      //------------------------------------------------------------------------
+      virtual void HandleResponse( XrdCl::XRootDStatus *status,
+                                   XrdCl::AnyObject    *response )
+      {
+        using namespace XrdCl;
+        if( !status->IsOK() )
+        {
+          Log *log = DefaultEnv::GetLog();
+          log->Error( FileSystemMsg, "Unable to list the directory at %s: %s",
+                      pServer.c_str(), status->ToStr().c_str() );
+          pMerger->Fail( pServer, *status );
+          delete status;
+          delete response;
+          pSync->TaskDone( false );
+          delete this;
+          return;
+        }
+
+        DirectoryList *list = 0;
+        response->Get( list );
+        pMerger->Merge( list );
+        delete status;
+        delete response;
+        pSync->TaskDone();
+        delete this;
+      }
+
+    private:
+      std::string         pServer;
+      DirListMerger      *pMerger;
+      XrdCl::RequestSync *pSync;
+  };
+
+  //----------------------------------------------------------------------------
+  // Stat the entries that came without the stat info because the server
+  // ignored the stat option of the dirlist request. The stats are pipelined,
+  // up to DirListStatQuota at a time, and go to the given file system
+  // or, if there is none, to the server that listed the entry.
+  //
+  // Returns the number of the entries that could not be stat'ed.
+  //----------------------------------------------------------------------------
+  template<class List>
+  uint32_t StatEntries( List                                      *list,
+                        XrdCl::FileSystem                         *fs,
+                        std::map<std::string, XrdCl::FileSystem*> &servers,
+                        uint16_t                                   timeout )
+  {
+    using namespace XrdCl;
+    std::vector<uint32_t> missing;
+    for( uint32_t i = 0; i < list->GetSize(); ++i )
+      if( !HasStatInfo( list, i ) )
+        missing.push_back( i );
+
+    if( missing.empty() )
+      return 0;
+
+    int parallel = DefaultDirListStatQuota;
+    DefaultEnv::GetEnv()->GetInt( "DirListStatQuota", parallel );
+    if( parallel <= 0 )
+      parallel = 1;
+
+    uint32_t nMissing = missing.size();
+    uint32_t quota    = nMissing <= (uint32_t)parallel ? nMissing : parallel;
+    Log     *log      = DefaultEnv::GetLog();
+    log->Debug( FileSystemMsg, "Stating %d entries of %s, %d at a time",
+                nMissing, list->GetParentName().c_str(), quota );
+
+    std::string fullPath = list->GetParentName();
+    size_t      base     = fullPath.length();
+    RequestSync sync( nMissing, quota );
+    for( uint32_t i = 0; i < nMissing; ++i )
+    {
+      FileSystem *target = fs;
+      if( !target )
+      {
+        const std::string &address = GetHostAddress( list, missing[i] );
+        FileSystem *&server = servers[address];
+        if( !server )
+          server = new FileSystem( address );
+        target = server;
+      }
+
+      fullPath.resize( base );
+      AppendName( fullPath, list, missing[i] );
+      ResponseHandler *handler = new DirListStatHandler<List>( list,
+                                                               missing[i],
+                                                               &sync );
+      XRootDStatus st = target->Stat( fullPath, handler, timeout );
+      if( !st.IsOK() )
+      {
+        sync.TaskDone( false );
+        delete handler;
+      }
+      sync.WaitForQuota();
+    }
+    sync.WaitForAll();
+    return sync.FailureCount();
+  }
+
+  //----------------------------------------------------------------------------
+  // Pack the batches of a directory listing in a compact list as they come
+  //----------------------------------------------------------------------------
+  class CompactDirListHandler: public XrdCl::DirListHandler
+  {
+    public:
+      //------------------------------------------------------------------------
+      // Constructor
+      //------------------------------------------------------------------------
+      CompactDirListHandler( XrdCl::CompactDirectoryList *list ):
+        pList( list ), pStatus( 0 ), pSem( 0 ) {}
+
+      //------------------------------------------------------------------------
+      // Pack the batch and free it
+      //------------------------------------------------------------------------
+      virtual void HandleEntries( XrdCl::DirectoryList *entries )
+      {
+        pList->Append( *entries );
+        delete entries;
+      }
+
+      //------------------------------------------------------------------------
+      // The listing is complete
+      //------------------------------------------------------------------------
+      virtual void HandleResponse( XrdCl::XRootDStatus *status,
+                                   XrdCl::AnyObject    *response )
+      {
+        delete response;
+        pStatus = status;
+        pSem.Post();
+      }
+
+      //------------------------------------------------------------------------
+      // Wait for the listing to complete
+      //------------------------------------------------------------------------
+      XrdCl::XRootDStatus WaitForStatus()
+      {
+        pSem.Wait();
+        XrdCl::XRootDStatus st( *pStatus );
+        delete pStatus;
+        return st;
+      }
+
+    private:
+      XrdCl::CompactDirectoryList *pList;
+      XrdCl::XRootDStatus         *pStatus;
+      XrdSysSemaphore              pSem;
+  };
+
+  //----------------------------------------------------------------------------
+  // Invalidate the cached metadata of the modified paths once the request
+  // is done, a stat sent in the meantime might have seen the old state.
+  // Holds a reference to the cache, the file system object may be gone
+  // by the time the response comes.
+  //----------------------------------------------------------------------------
+  class MetadataInvalidator: public XrdCl::ResponseHandler
+  {
+    public:
+      //------------------------------------------------------------------------
+      // Constructor
+      //------------------------------------------------------------------------
+      MetadataInvalidator( XrdCl::MetadataCache   *cache,
+                           const std::string      &path,
+                           const std::string      &other,
+                           XrdCl::ResponseHandler *userHandler ):
+        pCache( cache ), pPath( path ), pOther( other ),
+        pUserHandler( userHandler )
+      {
+        pCache->Ref();
+      }
+
+      //------------------------------------------------------------------------
+      // Destructor
+      //------------------------------------------------------------------------
+      virtual ~MetadataInvalidator()
+      {
+        pCache->UnRef();
+      }
+
+      //------------------------------------------------------------------------
+      // Response callback
+      //------------------------------------------------------------------------
+      virtual void HandleResponseWithHosts( XrdCl::XRootDStatus *status,
+                                            XrdCl::AnyObject    *response,
+                                            XrdCl::HostList     *hostList )
+      {
+        pCache->Invalidate( pPath );
+        if( !pOther.empty() )
+          pCache->Invalidate( pOther );
+        pUserHandler->HandleResponseWithHosts( status, response, hostList );
+        delete this;
+      }
+
+    private:
+      XrdCl::MetadataCache   *pCache;
+      std::string             pPath;
+      std::string             pOther;
+      XrdCl::ResponseHandler *pUserHandler;
+  };
+
+  //----------------------------------------------------------------------------
+  // The request sent for every path of a batch
+  //----------------------------------------------------------------------------
+  struct BatchRequest
+  {
+    BatchRequest( uint16_t reqId ):
+      requestId( reqId ), flags( 0 ), mode( 0 ), size( 0 ) {}
+
+    //--------------------------------------------------------------------------
+    // Send the request for the given path
+    //--------------------------------------------------------------------------
+    XrdCl::XRootDStatus Send( XrdCl::FileSystem      *fs,
+                              const std::string      &path,
+                              XrdCl::ResponseHandler *handler,
+                              uint16_t                timeout ) const
+    {
+      using namespace XrdCl;
+      switch( requestId )
+      {
+        case kXR_stat:
+          return fs->Stat( path, handler, timeout );
+        case kXR_locate:
+          return fs->Locate( path, flags, handler, timeout );
+        case kXR_query:
+        {
+          Buffer arg( path.size() );
+          arg.FromString( path );
+          return fs->Query( (QueryCode::Code)flags, arg, handler, timeout );
+        }
+        case kXR_rm:
+          return fs->Rm( path, handler, timeout );
+        case kXR_mkdir:
+          return fs->MkDir( path, flags, mode, handler, timeout );
+        case kXR_rmdir:
+          return fs->RmDir( path, handler, timeout );
+        case kXR_chmod:
+          return fs->ChMod( path, mode, handler, timeout );
+        case kXR_truncate:
+          return fs->Truncate( path, size, handler, timeout );
+      }
+      return XRootDStatus( stError, errNotSupported );
+    }
+
+    uint16_t requestId;
+    uint16_t flags;
+    uint16_t mode;
+    uint64_t size;
+  };
+
+  //----------------------------------------------------------------------------
+  // Store the outcome of one of the requests of a batch
+  //----------------------------------------------------------------------------
+  class BatchHandler: public XrdCl::ResponseHandler
+  {
+    public:
+      //------------------------------------------------------------------------
+      // Constructor
+      //------------------------------------------------------------------------
+      BatchHandler( XrdCl::XRootDStatus  *result,
+                    XrdCl::AnyObject    **response,
+                    XrdCl::RequestSync   *sync ):
+        pResult( result ),
+        pResponse( response ),
+        pSync( sync )
+      {
+      }
+
+      //------------------------------------------------------------------------
+      // Keep the status and the response
+      //------------------------------------------------------------------------
+      virtual void HandleResponse( XrdCl::XRootDStatus *status,
+                                   XrdCl::AnyObject    *response )
+      {
+        bool ok  = status->IsOK();
+        *pResult = *status;
+        if( pResponse && ok )
+          *pResponse = response;
+        else
+          delete response;
+        delete status;
+        pSync->TaskDone( ok );
+        delete this;
+      }
+
+    private:
+      XrdCl::XRootDStatus  *pResult;
+      XrdCl::AnyObject    **pResponse;
       XrdCl::RequestSync   *pSync;
   };
+
+  //----------------------------------------------------------------------------
+  // Send the request for the paths of the given indices, up to BatchWindow
+  // of them in flight at a time, and wait for all of them to finish
+  //----------------------------------------------------------------------------
+  void SendBatch( XrdCl::FileSystem                *fs,
+                  const std::vector<std::string>   &paths,
+                  const std::vector<uint32_t>      &indices,
+                  const BatchRequest               &request,
+                  std::vector<XrdCl::XRootDStatus> &results,
+                  std::vector<XrdCl::AnyObject*>   *responses,
+                  uint16_t                          timeout )
+  {
+    using namespace XrdCl;
+    if( indices.empty() )
+      return;
+
+    int window = DefaultBatchWindow;
+    DefaultEnv::GetEnv()->GetInt( "BatchWindow", window );
+    if( window <= 0 )
+      window = 1;
+
+    uint32_t nPaths = indices.size();
+    uint32_t quota  = nPaths <= (uint32_t)window ? nPaths : window;
+    Log     *log    = DefaultEnv::GetLog();
+    log->Debug( FileSystemMsg, "Sending a batch of %d requests, %d at a time",
+                nPaths, quota );
+
+    RequestSync sync( nPaths, quota );
+    for( uint32_t i = 0; i < nPaths; ++i )
+    {
+      uint32_t    index    = indices[i];
+      AnyObject **response = responses ? &(*responses)[index] : 0;
+      ResponseHandler *handler = new BatchHandler( &results[index], response,
+                                                   &sync );
+      XRootDStatus st = request.Send( fs, paths[index], handler, timeout );
+      if( !st.IsOK() )
+      {
+        results[index] = st;
+        sync.TaskDone( false );
+        delete handler;
+      }
+      sync.WaitForQuota();
+    }
+    sync.WaitForAll();
+  }
+
+  //----------------------------------------------------------------------------
+  // Send the request for all the paths
+  //----------------------------------------------------------------------------
+  void SendBatch( XrdCl::FileSystem                *fs,
+                  const std::vector<std::string>   &paths,
+                  const BatchRequest               &request,
+                  std::vector<XrdCl::XRootDStatus> &results,
+                  std::vector<XrdCl::AnyObject*>   *responses,
+                  uint16_t                          timeout )
+  {
+    std::vector<uint32_t> indices( paths.size() );
+    for( uint32_t i = 0; i < indices.size(); ++i )
+      indices[i] = i;
+    results.assign( paths.size(), XrdCl::XRootDStatus() );
+    if( responses )
+      responses->assign( paths.size(), 0 );
+    SendBatch( fs, paths, indices, request, results, responses, timeout );
+  }
+
+  //----------------------------------------------------------------------------
+  // Send the request for the paths level by level, the shallow ones first
+  // or the deep ones first, so that the directories are created before
+  // and removed after their subdirectories
+  //----------------------------------------------------------------------------
+  void SendBatchByDepth( XrdCl::FileSystem                *fs,
+                         const std::vector<std::string>   &paths,
+                         const BatchRequest               &request,
+                         bool                              deepFirst,
+                         std::vector<XrdCl::XRootDStatus> &results,
+                         uint16_t                          timeout )
+  {
+    typedef std::map<uint32_t, std::vector<uint32_t> > LevelMap;
+    LevelMap levels;
+    for( uint32_t i = 0; i < paths.size(); ++i )
+    {
+      const std::string      &path = paths[i];
+      std::string::size_type  end  = path.find( '?' );
+      if( end == std::string::npos )
+        end = path.length();
+      uint32_t depth = 0;
+      for( std::string::size_type j = 0; j < end; ++j )
+        if( path[j] != '/' && (j == 0 || path[j-1] == '/') )
+          ++depth;
+      levels[depth].push_back( i );
+    }
+
+    results.assign( paths.size(), XrdCl::XRootDStatus() );
+    if( deepFirst )
+    {
+      LevelMap::reverse_iterator it;
+      for( it = levels.rbegin(); it != levels.rend(); ++it )
+        SendBatch( fs, paths, it->second, request, results, 0, timeout );
+    }
+    else
+    {
+      LevelMap::iterator it;
+      for( it = levels.begin(); it != levels.end(); ++it )
+        SendBatch( fs, paths, it->second, request, results, 0, timeout );
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the responses of a batch out of their holders
+  //----------------------------------------------------------------------------
+  template<class Type>
+  void GetBatchResponses( std::vector<XrdCl::AnyObject*> &objects,
+                          std::vector<Type*>             &responses )
+  {
+    responses.assign( objects.size(), 0 );
+    for( uint32_t i = 0; i < objects.size(); ++i )
+    {
+      if( !objects[i] )
+        continue;
+      objects[i]->Get( responses[i] );
+      objects[i]->Set( (int *)0 );
+      delete objects[i];
+    }
+  }
 }
 
 namespace XrdCl
@@ -288,9 +912,24 @@ namespace XrdCl
   //----------------------------------------------------------------------------
   // Constructor
   //----------------------------------------------------------------------------
-  FileSystem::FileSystem( const URL &url ): pLoadBalancerLookupDone( false )
+  FileSystem::FileSystem( const URL &url ):
+    pLoadBalancerLookupDone( false ),
+    pMetadataCache( 0 )
   {
     pUrl = new URL( url.GetURL() );
+
+    Env *env = DefaultEnv::GetEnv();
+    int ttl         = DefaultMetadataCacheTTL;
+    int negativeTTL = DefaultMetadataNegCacheTTL;
+    int maxPaths    = DefaultMetadataCacheSize;
+    env->GetInt( "MetadataCacheTTL",    ttl );
+    env->GetInt( "MetadataNegCacheTTL", negativeTTL );
+    env->GetInt( "MetadataCacheSize",   maxPaths );
+    if( ttl > 0 )
+      pMetadataCache = new MetadataCache( ttl,
+                                          negativeTTL > 0 ? negativeTTL : 0,
+                                          maxPaths > 0 ? maxPaths : 1 );
+
     DefaultEnv::GetForkHandler()->RegisterFileSystemObject( this );
   }
 
@@ -301,6 +940,8 @@ namespace XrdCl
   {
     DefaultEnv::GetForkHandler()->UnRegisterFileSystemObject( this );
     delete pUrl;
+    if( pMetadataCache )
+      pMetadataCache->UnRef();
   }
 
   //----------------------------------------------------------------------------
@@ -335,12 +976,24 @@ namespace XrdCl
                                    LocationInfo      *&response,
                                    uint16_t            timeout )
   {
+    XRootDStatus status;
+    uint64_t     epoch = 0;
+    if( pMetadataCache )
+    {
+      if( pMetadataCache->Get( path, flags, response, status ) )
+        return status;
+      epoch = pMetadataCache->GetEpoch();
+    }
+
     SyncResponseHandler handler;
     Status st = Locate( path, flags, &handler, timeout );
     if( !st.IsOK() )
       return st;
 
-    return MessageUtils::WaitForResponse( &handler, response );
+    status = MessageUtils::WaitForResponse( &handler, response );
+    if( pMetadataCache )
+      pMetadataCache->Put( path, flags, status, response, epoch );
+    return status;
   }
 
   //----------------------------------------------------------------------------
@@ -351,10 +1004,35 @@ namespace XrdCl
                                        ResponseHandler   *handler,
                                        uint16_t           timeout )
   {
-    return Locate( path, flags,
-                   new DeepLocateHandler( handler, path, flags,
-                                          ::time(0)+timeout ),
-                   timeout );
+    return DeepLocate( path, flags, 0, handler, timeout );
+  }
+
+  //----------------------------------------------------------------------------
+  // Locate a file, recursively locate enough disk servers - async
+  //----------------------------------------------------------------------------
+  XRootDStatus FileSystem::DeepLocate( const std::string &path,
+                                       uint16_t           flags,
+                                       uint32_t           enough,
+                                       ResponseHandler   *handler,
+                                       uint16_t           timeout )
+  {
+    //--------------------------------------------------------------------------
+    // The requests to the managers get whatever is left of the timeout
+    //--------------------------------------------------------------------------
+    if( !timeout )
+    {
+      int requestTimeout = DefaultRequestTimeout;
+      DefaultEnv::GetEnv()->GetInt( "RequestTimeout", requestTimeout );
+      timeout = requestTimeout;
+    }
+
+    ResponseHandler *locateHandler = new DeepLocateHandler( handler, path,
+                                                            flags, enough,
+                                                            ::time(0)+timeout );
+    XRootDStatus st = Locate( path, flags, locateHandler, timeout );
+    if( !st.IsOK() )
+      delete locateHandler;
+    return st;
   }
 
   //----------------------------------------------------------------------------
@@ -365,12 +1043,41 @@ namespace XrdCl
                                   LocationInfo      *&response,
                                   uint16_t            timeout )
   {
+    return DeepLocate( path, flags, 0, response, timeout );
+  }
+
+  //----------------------------------------------------------------------------
+  // Locate a file, recursively locate enough disk servers - sync
+  //----------------------------------------------------------------------------
+  XRootDStatus FileSystem::DeepLocate( const std::string  &path,
+                                       uint16_t            flags,
+                                       uint32_t            enough,
+                                       LocationInfo      *&response,
+                                       uint16_t            timeout )
+  {
+    XRootDStatus status;
+    uint64_t     epoch = 0;
+    if( pMetadataCache )
+    {
+      if( pMetadataCache->GetDeepLocate( path, flags, response, status ) )
+        return status;
+      epoch = pMetadataCache->GetEpoch();
+    }
+
     SyncResponseHandler handler;
-    Status st = DeepLocate( path, flags, &handler, timeout );
+    Status st = DeepLocate( path, flags, enough, &handler, timeout );
     if( !st.IsOK() )
       return st;
 
-    return MessageUtils::WaitForResponse( &handler, response );
+    status = MessageUtils::WaitForResponse( &handler, response );
+
+    //--------------------------------------------------------------------------
+    // An answer given out early may lack some of the servers
+    //--------------------------------------------------------------------------
+    if( pMetadataCache &&
+        (!enough || !status.IsOK() || response->GetSize() < enough) )
+      pMetadataCache->PutDeepLocate( path, flags, status, response, epoch );
+    return status;
   }
 
   //----------------------------------------------------------------------------
@@ -395,7 +1102,7 @@ namespace XrdCl
 
     XRootDTransport::SetDescription( msg );
 
-    return Send( msg, handler, params );
+    return SendInvalidating( msg, source, dest, handler, params );
   }
 
   //----------------------------------------------------------------------------
@@ -472,7 +1179,7 @@ namespace XrdCl
     MessageUtils::ProcessSendParams( params );
     XRootDTransport::SetDescription( msg );
 
-    return Send( msg, handler, params );
+    return SendInvalidating( msg, path, "", handler, params );
   }
 
   //----------------------------------------------------------------------------
@@ -508,7 +1215,7 @@ namespace XrdCl
     MessageUtils::ProcessSendParams( params );
     XRootDTransport::SetDescription( msg );
 
-    return Send( msg, handler, params );
+    return SendInvalidating( msg, path, "", handler, params );
   }
 
   //----------------------------------------------------------------------------
@@ -547,7 +1254,7 @@ namespace XrdCl
     MessageUtils::ProcessSendParams( params );
     XRootDTransport::SetDescription( msg );
 
-    return Send( msg, handler, params );
+    return SendInvalidating( msg, path, "", handler, params );
   }
 
   //----------------------------------------------------------------------------
@@ -584,7 +1291,7 @@ namespace XrdCl
     MessageUtils::ProcessSendParams( params );
     XRootDTransport::SetDescription( msg );
 
-    return Send( msg, handler, params );
+    return SendInvalidating( msg, path, "", handler, params );
   }
 
   //----------------------------------------------------------------------------
@@ -621,7 +1328,7 @@ namespace XrdCl
     MessageUtils::ProcessSendParams( params );
     XRootDTransport::SetDescription( msg );
 
-    return Send( msg, handler, params );
+    return SendInvalidating( msg, path, "", handler, params );
   }
 
   //----------------------------------------------------------------------------
@@ -699,12 +1406,24 @@ namespace XrdCl
                                  StatInfo          *&response,
                                  uint16_t            timeout )
   {
+    XRootDStatus status;
+    uint64_t     epoch = 0;
+    if( pMetadataCache )
+    {
+      if( pMetadataCache->Get( path, response, status ) )
+        return status;
+      epoch = pMetadataCache->GetEpoch();
+    }
+
     SyncResponseHandler handler;
     Status st = Stat( path, &handler, timeout );
     if( !st.IsOK() )
       return st;
 
-    return MessageUtils::WaitForResponse( &handler, response );
+    status = MessageUtils::WaitForResponse( &handler, response );
+    if( pMetadataCache )
+      pMetadataCache->Put( path, status, response, epoch );
+    return status;
   }
 
   //----------------------------------------------------------------------------
@@ -736,12 +1455,24 @@ namespace XrdCl
                                     StatInfoVFS       *&response,
                                     uint16_t            timeout )
   {
+    XRootDStatus status;
+    uint64_t     epoch = 0;
+    if( pMetadataCache )
+    {
+      if( pMetadataCache->Get( path, response, status ) )
+        return status;
+      epoch = pMetadataCache->GetEpoch();
+    }
+
     SyncResponseHandler handler;
     Status st = StatVFS( path, &handler, timeout );
     if( !st.IsOK() )
       return st;
 
-    return MessageUtils::WaitForResponse( &handler, response );
+    status = MessageUtils::WaitForResponse( &handler, response );
+    if( pMetadataCache )
+      pMetadataCache->Put( path, status, response, epoch );
+    return status;
   }
 
   //----------------------------------------------------------------------------
@@ -784,18 +1515,31 @@ namespace XrdCl
                                     ResponseHandler   *handler,
                                     uint16_t           timeout )
   {
-    Message           *msg;
-    ClientStatRequest *req;
-    MessageUtils::CreateRequest( msg, req, path.length() );
+    return DirList( path, DirListFlags::None, handler, timeout );
+  }
 
-    req->requestid  = kXR_dirlist;
-    req->dlen       = path.length();
-    msg->Append( path.c_str(), path.length(), 24 );
-    MessageSendParams params; params.timeout = timeout;
-    MessageUtils::ProcessSendParams( params );
-    XRootDTransport::SetDescription( msg );
+  //----------------------------------------------------------------------------
+  // List entries of a directory, with the stat info if requested - async
+  //----------------------------------------------------------------------------
+  XRootDStatus FileSystem::DirList( const std::string &path,
+                                    uint8_t            flags,
+                                    ResponseHandler   *handler,
+                                    uint16_t           timeout )
+  {
+    return SendDirList( path, flags, handler, 0, timeout );
+  }
 
-    return Send( msg, handler, params );
+  //----------------------------------------------------------------------------
+  // List entries of a directory in batches - async
+  //----------------------------------------------------------------------------
+  XRootDStatus FileSystem::DirList( const std::string &path,
+                                    uint8_t            flags,
+                                    DirListHandler    *handler,
+                                    uint16_t           timeout )
+  {
+    if( flags & DirListFlags::Locate )
+      return XRootDStatus( stError, errNotSupported );
+    return SendDirList( path, flags, handler, handler, timeout );
   }
 
   //----------------------------------------------------------------------------
@@ -828,46 +1572,64 @@ namespace XrdCl
       }
 
       //------------------------------------------------------------------------
-      // Ask each server for a directory list
+      // Ask the servers for a directory list, many of them at a time, and
+      // merge the entries as the responses come
       //------------------------------------------------------------------------
-      flags &= ~DirListFlags::Locate;
-      FileSystem    *fs;
-      DirectoryList *currentResp = 0;
-      bool           errors = false;
+      int parallel = DefaultParallelDirLists;
+      DefaultEnv::GetEnv()->GetInt( "ParallelDirLists", parallel );
+      if( parallel <= 0 )
+        parallel = 1;
+
+      uint32_t nServers = locations->GetSize();
+      uint32_t quota    = nServers <= (uint32_t)parallel ? nServers : parallel;
+      std::map<std::string, FileSystem*>           servers;
+      std::map<std::string, FileSystem*>::iterator sIt;
 
       response = new DirectoryList( "", path, 0 );
+      DirListMerger merger( response );
+      RequestSync   sync( nServers, quota );
+
+      Log *log = DefaultEnv::GetLog();
+      log->Debug( FileSystemMsg, "Listing %s at %d servers, %d at a time",
+                  path.c_str(), nServers, quota );
 
-      for( uint32_t i = 0; i < locations->GetSize(); ++i )
+      for( uint32_t i = 0; i < nServers; ++i )
       {
-        fs = new FileSystem( locations->At(i).GetAddress() );
-        st = fs->DirList( path, flags, currentResp, timeout );
+        const std::string &address = locations->At(i).GetAddress();
+        FileSystem *&fs = servers[address];
+        if( !fs )
+          fs = new FileSystem( address );
+
+        ResponseHandler *handler = new DirListLocateHandler( address, &merger,
+                                                             &sync );
+        st = fs->DirList( path, flags & DirListFlags::Stat, handler, timeout );
         if( !st.IsOK() )
         {
-          errors = true;
-          delete fs;
-          continue;
+          log->Error( FileSystemMsg, "Unable to list the directory at %s: %s",
+                      address.c_str(), st.ToStr().c_str() );
+          merger.Fail( address, st );
+          sync.TaskDone( false );
+          delete handler;
         }
+        sync.WaitForQuota();
+      }
+      sync.WaitForAll();
+      delete locations;
 
-        if( st.code == suPartial )
-          errors = true;
-
-        DirectoryList::Iterator it;
+      bool errors = sync.FailureCount();
 
-        for( it = currentResp->Begin(); it != currentResp->End(); ++it )
-        {
-          response->Add( *it );
-          *it = 0;
-        }
+      //------------------------------------------------------------------------
+      // Stat the entries that the servers did not stat themselves
+      //------------------------------------------------------------------------
+      if( (flags & DirListFlags::Stat) &&
+          StatEntries( response, 0, servers, timeout ) )
+        errors = true;
 
-        delete fs;
-        delete currentResp;
-        fs          = 0;
-        currentResp = 0;
-      }
-      delete locations;
+      for( sIt = servers.begin(); sIt != servers.end(); ++sIt )
+        delete sIt->second;
 
       if( errors )
-        return XRootDStatus( stOK, suPartial );
+        return XRootDStatus( stOK, suPartial, 0, merger.GetFailures() );
       return XRootDStatus();
     };
 
@@ -875,7 +1637,8 @@ namespace XrdCl
     // We just ask the current server
     //--------------------------------------------------------------------------
     SyncResponseHandler handler;
-    XRootDStatus st = DirList( path, &handler, timeout );
+    XRootDStatus st = DirList( path, flags & DirListFlags::Stat, &handler,
+                               timeout );
     if( !st.IsOK() )
       return st;
 
@@ -884,28 +1647,66 @@ namespace XrdCl
       return st;
 
     //--------------------------------------------------------------------------
-    // Do the stats on all the entries if necessary
+    // Stat the entries if the server did not do it
     //--------------------------------------------------------------------------
     if( !(flags & DirListFlags::Stat) )
       return st;
 
-    uint32_t quota = response->GetSize() <= 1024 ? response->GetSize() : 1024;
-    RequestSync sync( response->GetSize(), quota );
-    for( uint32_t i = 0; i < response->GetSize(); ++i )
+    std::map<std::string, FileSystem*> servers;
+    if( StatEntries( response, this, servers, timeout ) )
+      return XRootDStatus( stOK, suPartial );
+
+    return XRootDStatus();
+  }
+
+  //----------------------------------------------------------------------------
+  // List entries of a directory in the compact form - sync
+  //----------------------------------------------------------------------------
+  XRootDStatus FileSystem::DirList( const std::string     &path,
+                                    uint8_t                flags,
+                                    CompactDirectoryList *&response,
+                                    uint16_t               timeout )
+  {
+    //--------------------------------------------------------------------------
+    // The listings of many servers are merged in the regular list first
+    //--------------------------------------------------------------------------
+    if( flags & DirListFlags::Locate )
     {
-      std::string fullPath = response->GetParentName()+response->At(i)->GetName();
-      ResponseHandler *handler = new DirListStatHandler( response, i, &sync );
-      st = Stat( fullPath, handler, timeout );
+      DirectoryList *list = 0;
+      XRootDStatus st = DirList( path, flags, list, timeout );
       if( !st.IsOK() )
-      {
-        sync.TaskDone( false );
-        delete handler;
-      }
-      sync.WaitForQuota();
+        return st;
+      response = new CompactDirectoryList( "", path );
+      response->Reserve( list->GetSize(), 0 );
+      response->Append( *list );
+      delete list;
+      return st;
     }
-    sync.WaitForAll();
 
-    if( sync.FailureCount() )
+    //--------------------------------------------------------------------------
+    // Pack the entries as the parts of the response arrive
+    //--------------------------------------------------------------------------
+    CompactDirectoryList  *list = new CompactDirectoryList( "", path );
+    CompactDirListHandler  handler( list );
+    XRootDStatus st = DirList( path, flags & DirListFlags::Stat, &handler,
+                               timeout );
+    if( st.IsOK() )
+      st = handler.WaitForStatus();
+    if( !st.IsOK() )
+    {
+      delete list;
+      return st;
+    }
+    response = list;
+
+    //--------------------------------------------------------------------------
+    // Stat the entries if the server did not do it
+    //--------------------------------------------------------------------------
+    if( !(flags & DirListFlags::Stat) )
+      return st;
+
+    std::map<std::string, FileSystem*> servers;
+    if( StatEntries( response, this, servers, timeout ) )
       return XRootDStatus( stOK, suPartial );
 
     return XRootDStatus();
@@ -1004,6 +1805,122 @@ namespace XrdCl
     return MessageUtils::WaitForResponse( &handler, response );
   }
 
+  //----------------------------------------------------------------------------
+  // Obtain status information for many paths - sync
+  //----------------------------------------------------------------------------
+  XRootDStatus FileSystem::Stat( const std::vector<std::string> &paths,
+                                 std::vector<StatInfo*>         &responses,
+                                 std::vector<XRootDStatus>      &results,
+                                 uint16_t                        timeout )
+  {
+    std::vector<AnyObject*> objects;
+    SendBatch( this, paths, BatchRequest( kXR_stat ), results, &objects,
+               timeout );
+    GetBatchResponses( objects, responses );
+    return Utils::GetBatchStatus( results );
+  }
+
+  //----------------------------------------------------------------------------
+  // Locate many paths - sync
+  //----------------------------------------------------------------------------
+  XRootDStatus FileSystem::Locate( const std::vector<std::string> &paths,
+                                   uint16_t                        flags,
+                                   std::vector<LocationInfo*>     &responses,
+                                   std::vector<XRootDStatus>      &results,
+                                   uint16_t                        timeout )
+  {
+    BatchRequest request( kXR_locate );
+    request.flags = flags;
+    std::vector<AnyObject*> objects;
+    SendBatch( this, paths, request, results, &objects, timeout );
+    GetBatchResponses( objects, responses );
+    return Utils::GetBatchStatus( results );
+  }
+
+  //----------------------------------------------------------------------------
+  // Send many queries of the same kind - sync
+  //----------------------------------------------------------------------------
+  XRootDStatus FileSystem::Query( QueryCode::Code                 queryCode,
+                                  const std::vector<std::string> &args,
+                                  std::vector<Buffer*>           &responses,
+                                  std::vector<XRootDStatus>      &results,
+                                  uint16_t                        timeout )
+  {
+    BatchRequest request( kXR_query );
+    request.flags = queryCode;
+    std::vector<AnyObject*> objects;
+    SendBatch( this, args, request, results, &objects, timeout );
+    GetBatchResponses( objects, responses );
+    return Utils::GetBatchStatus( results );
+  }
+
+  //----------------------------------------------------------------------------
+  // Remove many files - sync
+  //----------------------------------------------------------------------------
+  XRootDStatus FileSystem::Rm( const std::vector<std::string> &paths,
+                               std::vector<XRootDStatus>      &results,
+                               uint16_t                        timeout )
+  {
+    SendBatch( this, paths, BatchRequest( kXR_rm ), results, 0, timeout );
+    return Utils::GetBatchStatus( results );
+  }
+
+  //----------------------------------------------------------------------------
+  // Create many directories - sync
+  //----------------------------------------------------------------------------
+  XRootDStatus FileSystem::MkDir( const std::vector<std::string> &paths,
+                                  uint8_t                         flags,
+                                  uint16_t                        mode,
+                                  std::vector<XRootDStatus>      &results,
+                                  uint16_t                        timeout )
+  {
+    BatchRequest request( kXR_mkdir );
+    request.flags = flags;
+    request.mode  = mode;
+    SendBatchByDepth( this, paths, request, false, results, timeout );
+    return Utils::GetBatchStatus( results );
+  }
+
+  //----------------------------------------------------------------------------
+  // Remove many directories - sync
+  //----------------------------------------------------------------------------
+  XRootDStatus FileSystem::RmDir( const std::vector<std::string> &paths,
+                                  std::vector<XRootDStatus>      &results,
+                                  uint16_t                        timeout )
+  {
+    SendBatchByDepth( this, paths, BatchRequest( kXR_rmdir ), true, results,
+                      timeout );
+    return Utils::GetBatchStatus( results );
+  }
+
+  //----------------------------------------------------------------------------
+  // Change the access mode of many paths - sync
+  //----------------------------------------------------------------------------
+  XRootDStatus FileSystem::ChMod( const std::vector<std::string> &paths,
+                                  uint16_t                        mode,
+                                  std::vector<XRootDStatus>      &results,
+                                  uint16_t                        timeout )
+  {
+    BatchRequest request( kXR_chmod );
+    request.mode = mode;
+    SendBatch( this, paths, request, results, 0, timeout );
+    return Utils::GetBatchStatus( results );
+  }
+
+  //----------------------------------------------------------------------------
+  // Truncate many files - sync
+  //----------------------------------------------------------------------------
+  XRootDStatus FileSystem::Truncate( const std::vector<std::string> &paths,
+                                     uint64_t                        size,
+                                     std::vector<XRootDStatus>      &results,
+                                     uint16_t                        timeout )
+  {
+    BatchRequest request( kXR_truncate );
+    request.size = size;
+    SendBatch( this, paths, request, results, 0, timeout );
+    return Utils::GetBatchStatus( results );
+  }
+
   //----------------------------------------------------------------------------
   // Assign a loadbalancer if it has not already been assigned
   //----------------------------------------------------------------------------
@@ -1023,6 +1940,30 @@ namespace XrdCl
     pLoadBalancerLookupDone = true;
   }
 
+  //----------------------------------------------------------------------------
+  // Send a request modifying the given paths
+  //----------------------------------------------------------------------------
+  Status FileSystem::SendInvalidating( Message                 *msg,
+                                       const std::string       &path,
+                                       const std::string       &other,
+                                       ResponseHandler         *handler,
+                                       const MessageSendParams &params )
+  {
+    if( !pMetadataCache )
+      return Send( msg, handler, params );
+
+    pMetadataCache->Invalidate( path );
+    if( !other.empty() )
+      pMetadataCache->Invalidate( other );
+
+    MetadataInvalidator *invalidator =
+      new MetadataInvalidator( pMetadataCache, path, other, handler );
+    Status st = Send( msg, invalidator, params );
+    if( !st.IsOK() )
+      delete invalidator;
+    return st;
+  }
+
   //----------------------------------------------------------------------------
   // Send a message in a locked environment
   //----------------------------------------------------------------------------
@@ -1041,4 +1982,30 @@ namespace XrdCl
 
     return MessageUtils::SendMessage( *pUrl, msg, handler, params );
   }
+
+  //----------------------------------------------------------------------------
+  // Send a dirlist request
+  //----------------------------------------------------------------------------
+  XRootDStatus FileSystem::SendDirList( const std::string &path,
+                                        uint8_t            flags,
+                                        ResponseHandler   *handler,
+                                        DirListHandler    *dirListHandler,
+                                        uint16_t           timeout )
+  {
+    Message              *msg;
+    ClientDirlistRequest *req;
+    MessageUtils::CreateRequest( msg, req, path.length() );
+
+    req->requestid  = kXR_dirlist;
+    req->dlen       = path.length();
+    if( flags & DirListFlags::Stat )
+      req->options[0] = kXR_dstat;
+    msg->Append( path.c_str(), path.length(), 24 );
+    MessageSendParams params; params.timeout = timeout;
+    params.dirListHandler = dirListHandler;
+    MessageUtils::ProcessSendParams( params );
+    XRootDTransport::SetDescription( msg );
+
+    return Send( msg, handler, params );
+  }
 }
@@ -31,6 +31,7 @@ namespace XrdCl
 {
   class PostMaster;
   class Message;
+  class MetadataCache;
   struct MessageSendParams;
 
   //----------------------------------------------------------------------------
@@ -131,10 +132,14 @@ namespace XrdCl
   struct DirListFlags
   {
     static const uint8_t None   = 0;  //!< Nothing special
-    static const uint8_t Stat   = 1;  //!< Stat each entry
+    static const uint8_t Stat   = 1;  //!< Stat each entry, in the listing
+                                      //!< response if the server can
     static const uint8_t Locate = 2;  //!< Locate all servers hosting the
                                       //!< directory and send the dirlist
-                                      //!< request to all of them
+                                      //!< request to all of them, up to
+                                      //!< ParallelDirLists at a time; an
+                                      //!< entry found at many servers is
+                                      //!< listed once
   };
 
   //----------------------------------------------------------------------------
@@ -250,6 +255,49 @@ namespace XrdCl
                                LocationInfo      *&response,
                                uint16_t            timeout  = 0 );
 
+      //------------------------------------------------------------------------
+      //! Locate a file, recursively locate the disk servers until enough
+      //! of them are found - async
+      //!
+      //! The managers are asked once each, up to ParallelLocates of them
+      //! at a time.
+      //!
+      //! @param path    path to the file to be located
+      //! @param flags   some of the OpenFlags::Flags
+      //! @param enough  give out the answer as soon as this many servers
+      //!                are found, 0 waits for all of them
+      //! @param handler handler to be notified when the response arrives,
+      //!                the response parameter will hold a LocationInfo
+      //!                object if the procedure is successfull
+      //! @param timeout timeout value, if 0 the environment default will
+      //!                be used
+      //! @return        status of the operation
+      //------------------------------------------------------------------------
+      XRootDStatus DeepLocate( const std::string &path,
+                               uint16_t           flags,
+                               uint32_t           enough,
+                               ResponseHandler   *handler,
+                               uint16_t           timeout = 0 );
+
+      //------------------------------------------------------------------------
+      //! Locate a file, recursively locate the disk servers until enough
+      //! of them are found - sync
+      //!
+      //! @param path     path to the file to be located
+      //! @param flags    some of the OpenFlags::Flags
+      //! @param enough   give out the answer as soon as this many servers
+      //!                 are found, 0 waits for all of them
+      //! @param response the response (to be deleted by the user)
+      //! @param timeout  timeout value, if 0 the environment default will
+      //!                 be used
+      //! @return         status of the operation
+      //------------------------------------------------------------------------
+      XRootDStatus DeepLocate( const std::string  &path,
+                               uint16_t            flags,
+                               uint32_t            enough,
+                               LocationInfo      *&response,
+                               uint16_t            timeout = 0 );
+
       //------------------------------------------------------------------------
       //! Move a directory or a file - async
       //!
@@ -561,6 +609,48 @@ namespace XrdCl
                             ResponseHandler   *handler,
                             uint16_t           timeout = 0 );
 
+      //------------------------------------------------------------------------
+      //! List entries of a directory - async
+      //!
+      //! @param path    directory path
+      //! @param flags   DirListFlags, with Stat the server is asked to send
+      //!                the stat info of the entries along with the names,
+      //!                the servers not supporting it send only the names
+      //!                and the entries come without the stat info
+      //! @param handler handler to be notified when the response arrives,
+      //!                the response parameter will hold a DirectoryList
+      //!                object if the procedure is successfull
+      //! @param timeout timeout value, if 0 the environment default will
+      //!                be used
+      //! @return        status of the operation
+      //------------------------------------------------------------------------
+      XRootDStatus DirList( const std::string &path,
+                            uint8_t            flags,
+                            ResponseHandler   *handler,
+                            uint16_t           timeout = 0 );
+
+      //------------------------------------------------------------------------
+      //! List entries of a directory, hand them out in batches as the parts
+      //! of the response arrive - async
+      //!
+      //! The parts are parsed and freed as they come, so that a huge
+      //! directory can be processed without holding all of it in memory.
+      //!
+      //! @param path    directory path
+      //! @param flags   DirListFlags, Locate is not supported, with Stat
+      //!                the entries come with the stat info if the server
+      //!                supports the stat option of the dirlist request
+      //! @param handler handler to be notified about the batches of entries
+      //!                and, at the end, about the final status
+      //! @param timeout timeout value, if 0 the environment default will
+      //!                be used
+      //! @return        status of the operation
+      //------------------------------------------------------------------------
+      XRootDStatus DirList( const std::string &path,
+                            uint8_t            flags,
+                            DirListHandler    *handler,
+                            uint16_t           timeout = 0 );
+
       //------------------------------------------------------------------------
       //! List entries of a directory - sync
       //!
@@ -569,13 +659,36 @@ namespace XrdCl
       //! @param response the response (to be deleted by the user)
       //! @param timeout  timeout value, if 0 the environment default will
       //!                 be used
-      //! @return         status of the operation
+      //! @return         status of the operation, suPartial if some of
+      //!                 the servers or entries could not be queried, the
+      //!                 message names the servers that failed to list
+      //!                 the directory
       //------------------------------------------------------------------------
       XRootDStatus DirList( const std::string  &path,
                             uint8_t            flags,
                             DirectoryList    *&response,
                             uint16_t           timeout = 0 );
 
+      //------------------------------------------------------------------------
+      //! List entries of a directory in the compact form - sync
+      //!
+      //! Unless the Locate flag is given, the parts of the response are
+      //! packed as they arrive, so that only the compact list and a single
+      //! part are held in memory.
+      //!
+      //! @param path     directory path
+      //! @param flags    DirListFlags
+      //! @param response the response (to be deleted by the user)
+      //! @param timeout  timeout value, if 0 the environment default will
+      //!                 be used
+      //! @return         status of the operation, suPartial if some of
+      //!                 the servers or entries could not be queried
+      //------------------------------------------------------------------------
+      XRootDStatus DirList( const std::string     &path,
+                            uint8_t                flags,
+                            CompactDirectoryList *&response,
+                            uint16_t               timeout = 0 );
+
       //------------------------------------------------------------------------
       //! Send info to the server (up to 1024 characters)- async
       //!
@@ -640,6 +753,102 @@ namespace XrdCl
                             Buffer                         *&response,
                             uint16_t                         timeout = 0 );
 
+      //------------------------------------------------------------------------
+      //! Obtain status information for many paths - sync
+      //!
+      //! The batch calls pipeline the requests, up to BatchWindow of them
+      //! in flight at a time, and wait for all of them to finish.
+      //!
+      //! @param paths     the paths
+      //! @param responses the responses in the order of the paths, 0 for
+      //!                  the failed requests (to be deleted by the user)
+      //! @param results   the statuses of the requests in the order of
+      //!                  the paths
+      //! @param timeout   timeout value of every request, if 0 the
+      //!                  environment default will be used
+      //! @return          stOK if all the requests succeeded, stOK with
+      //!                  suPartial if some of them did, the status of the
+      //!                  first request otherwise
+      //------------------------------------------------------------------------
+      XRootDStatus Stat( const std::vector<std::string> &paths,
+                         std::vector<StatInfo*>         &responses,
+                         std::vector<XRootDStatus>      &results,
+                         uint16_t                        timeout = 0 );
+
+      //------------------------------------------------------------------------
+      //! Locate many paths - sync, see the batch Stat
+      //------------------------------------------------------------------------
+      XRootDStatus Locate( const std::vector<std::string> &paths,
+                           uint16_t                        flags,
+                           std::vector<LocationInfo*>     &responses,
+                           std::vector<XRootDStatus>      &results,
+                           uint16_t                        timeout = 0 );
+
+      //------------------------------------------------------------------------
+      //! Send many queries of the same kind, ie. the checksums of many
+      //! files - sync, see the batch Stat
+      //------------------------------------------------------------------------
+      XRootDStatus Query( QueryCode::Code                 queryCode,
+                          const std::vector<std::string> &args,
+                          std::vector<Buffer*>           &responses,
+                          std::vector<XRootDStatus>      &results,
+                          uint16_t                        timeout = 0 );
+
+      //------------------------------------------------------------------------
+      //! Remove many files - sync, see the batch Stat
+      //------------------------------------------------------------------------
+      XRootDStatus Rm( const std::vector<std::string> &paths,
+                       std::vector<XRootDStatus>      &results,
+                       uint16_t                        timeout = 0 );
+
+      //------------------------------------------------------------------------
+      //! Create many directories - sync, see the batch Stat. A directory
+      //! is created only after its parents given in the batch are.
+      //------------------------------------------------------------------------
+      XRootDStatus MkDir( const std::vector<std::string> &paths,
+                          uint8_t                         flags,
+                          uint16_t                        mode,
+                          std::vector<XRootDStatus>      &results,
+                          uint16_t                        timeout = 0 );
+
+      //------------------------------------------------------------------------
+      //! Remove many directories - sync, see the batch Stat. A directory
+      //! is removed only after its subdirectories given in the batch are.
+      //------------------------------------------------------------------------
+      XRootDStatus RmDir( const std::vector<std::string> &paths,
+                          std::vector<XRootDStatus>      &results,
+                          uint16_t                        timeout = 0 );
+
+      //------------------------------------------------------------------------
+      //! Change the access mode of many paths - sync, see the batch Stat
+      //------------------------------------------------------------------------
+      XRootDStatus ChMod( const std::vector<std::string> &paths,
+                          uint16_t                        mode,
+                          std::vector<XRootDStatus>      &results,
+                          uint16_t                        timeout = 0 );
+
+      //------------------------------------------------------------------------
+      //! Truncate many files - sync, see the batch Stat
+      //------------------------------------------------------------------------
+      XRootDStatus Truncate( const std::vector<std::string> &paths,
+                             uint64_t                        size,
+                             std::vector<XRootDStatus>      &results,
+                             uint16_t                        timeout = 0 );
+
+      //------------------------------------------------------------------------
+      //! Get the metadata cache answering the synchronous Stat, StatVFS,
+      //! Locate and DeepLocate requests. The cache is enabled by setting
+      //! MetadataCacheTTL in the environment before the file system object
+      //! is created; the Mv, Truncate, Rm, MkDir, RmDir and ChMod requests
+      //! issued through this object invalidate the paths they touch.
+      //!
+      //! @return the cache or 0 if it is disabled
+      //------------------------------------------------------------------------
+      MetadataCache *GetMetadataCache()
+      {
+        return pMetadataCache;
+      }
+
     private:
 
       //------------------------------------------------------------------------
@@ -649,6 +858,16 @@ namespace XrdCl
                    ResponseHandler         *handler,
                    const MessageSendParams &params );
 
+      //------------------------------------------------------------------------
+      // Send a dirlist request, the entries go to the dirlist handler
+      // as they come if there is one
+      //------------------------------------------------------------------------
+      XRootDStatus SendDirList( const std::string &path,
+                                uint8_t            flags,
+                                ResponseHandler   *handler,
+                                DirListHandler    *dirListHandler,
+                                uint16_t           timeout );
+
       //------------------------------------------------------------------------
       // Assign a loadbalancer if it has not already been assigned
       //------------------------------------------------------------------------
@@ -670,9 +889,20 @@ namespace XrdCl
         pMutex.UnLock();
       }
 
-      XrdSysMutex  pMutex;
-      bool         pLoadBalancerLookupDone;
-      URL         *pUrl;
+      //------------------------------------------------------------------------
+      // Send a request modifying the given paths, their cached metadata is
+      // invalidated now and once again when the request is done
+      //------------------------------------------------------------------------
+      Status SendInvalidating( Message                 *msg,
+                               const std::string       &path,
+                               const std::string       &other,
+                               ResponseHandler         *handler,
+                               const MessageSendParams &params );
+
+      XrdSysMutex    pMutex;
+      bool           pLoadBalancerLookupDone;
+      URL           *pUrl;
+      MetadataCache *pMetadataCache;
   };
 }
 
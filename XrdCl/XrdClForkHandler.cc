@@ -22,13 +22,15 @@
 #include "XrdCl/XrdClDefaultEnv.hh"
 #include "XrdCl/XrdClPostMaster.hh"
 #include "XrdCl/XrdClFileStateHandler.hh"
+#include "XrdCl/XrdClReadHedger.hh"
 
 namespace XrdCl
 {
   //----------------------------------------------------------------------------
   // Constructor
   //----------------------------------------------------------------------------
-  ForkHandler::ForkHandler()
+  ForkHandler::ForkHandler():
+    pReadHedger( 0 )
   {
   }
 
@@ -43,6 +45,8 @@ namespace XrdCl
                 pid );
 
     pMutex.Lock();
+    if( pReadHedger )
+      pReadHedger->Stop();
     pPostMaster->Stop();
 
     //--------------------------------------------------------------------------
@@ -86,6 +90,8 @@ namespace XrdCl
       (*itFs)->UnLock();
 
     pPostMaster->Start();
+    if( pReadHedger )
+      pReadHedger->Start();
 
     pMutex.UnLock();
   }
@@ -119,6 +125,8 @@ namespace XrdCl
     pPostMaster->Finalize();
     pPostMaster->Initialize();
     pPostMaster->Start();
+    if( pReadHedger )
+      pReadHedger->Start();
 
     pMutex.UnLock();
   }
@@ -27,6 +27,7 @@ namespace XrdCl
   class FileStateHandler;
   class FileSystem;
   class PostMaster;
+  class ReadHedger;
 
   //----------------------------------------------------------------------------
   // Helper class for handling forking
@@ -81,6 +82,15 @@ namespace XrdCl
         pPostMaster = postMaster;
       }
 
+      //------------------------------------------------------------------------
+      //! Register a read hedger object
+      //------------------------------------------------------------------------
+      void RegisterReadHedger( ReadHedger *readHedger )
+      {
+        XrdSysMutexHelper scopedLock( pMutex );
+        pReadHedger = readHedger;
+      }
+
       //------------------------------------------------------------------------
       //! Handle the preparation part of the forking process
       //------------------------------------------------------------------------
@@ -100,6 +110,7 @@ namespace XrdCl
       std::set<FileStateHandler*>  pFileObjects;
       std::set<FileSystem*>        pFileSystemObjects;
       PostMaster                  *pPostMaster;
+      ReadHedger                  *pReadHedger;
       XrdSysMutex                  pMutex;
   };
 }
@@ -88,6 +88,7 @@ namespace XrdCl
     msgHandler->SetRedirectAsAnswer( !sendParams.followRedirects );
     msgHandler->SetChunkList( sendParams.chunkList );
     msgHandler->SetRedirectCounter( sendParams.redirectLimit );
+    msgHandler->SetDirListHandler( sendParams.dirListHandler );
 
     if( sendParams.loadBalancer.url.IsValid() )
       msgHandler->SetLoadBalancer( sendParams.loadBalancer );
@@ -98,7 +98,7 @@ namespace XrdCl
   {
     MessageSendParams():
       timeout(0), expires(0), followRedirects(true), stateful(true),
-      hostList(0), chunkList(0), redirectLimit(0) {}
+      hostList(0), chunkList(0), redirectLimit(0), dirListHandler(0) {}
     uint16_t         timeout;
     time_t           expires;
     const HostInfo   loadBalancer;
@@ -107,6 +107,7 @@ namespace XrdCl
     HostList        *hostList;
     ChunkList       *chunkList;
     uint16_t         redirectLimit;
+    DirListHandler  *dirListHandler;
   };
 
   class MessageUtils
@@ -0,0 +1,322 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+#include "XrdCl/XrdClMetadataCache.hh"
+#include "XProtocol/XProtocol.hh"
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Check if the error means that the path does not exist
+  //----------------------------------------------------------------------------
+  bool IsNotFound( const XrdCl::XRootDStatus &status )
+  {
+    return status.code == XrdCl::errErrorResponse &&
+           status.errNo == kXR_NotFound;
+  }
+
+  //----------------------------------------------------------------------------
+  // Strip the trailing slashes, so that the paths of a directory with and
+  // without them share the entry
+  //----------------------------------------------------------------------------
+  std::string GetKey( const std::string &path )
+  {
+    std::string::size_type end = path.find( '?' );
+    if( end == std::string::npos )
+      end = path.length();
+    std::string::size_type last = end;
+    while( last > 1 && path[last-1] == '/' )
+      --last;
+    if( last == end )
+      return path;
+    return path.substr( 0, last ) + path.substr( end );
+  }
+}
+
+namespace XrdCl
+{
+  //----------------------------------------------------------------------------
+  // Constructor
+  //----------------------------------------------------------------------------
+  MetadataCache::MetadataCache( uint32_t ttl,
+                                uint32_t negativeTTL,
+                                uint32_t maxPaths ):
+    pTTL( ttl ),
+    pNegativeTTL( negativeTTL ),
+    pMaxPaths( maxPaths ? maxPaths : 1 ),
+    pEpoch( 0 ),
+    pHits( 0 ),
+    pMisses( 0 ),
+    pRefCount( 1 )
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  // Destructor
+  //----------------------------------------------------------------------------
+  MetadataCache::~MetadataCache()
+  {
+    Clear();
+  }
+
+  //----------------------------------------------------------------------------
+  // Release a reference
+  //----------------------------------------------------------------------------
+  void MetadataCache::UnRef()
+  {
+    pMutex.Lock();
+    uint32_t refs = --pRefCount;
+    pMutex.UnLock();
+    if( !refs )
+      delete this;
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the cached responses
+  //----------------------------------------------------------------------------
+  bool MetadataCache::Get( const std::string &path, StatInfo *&response,
+                           XRootDStatus &status )
+  {
+    return GetSlot( path, &Node::stat, 0, response, status );
+  }
+
+  bool MetadataCache::Get( const std::string &path, StatInfoVFS *&response,
+                           XRootDStatus &status )
+  {
+    return GetSlot( path, &Node::statVFS, 0, response, status );
+  }
+
+  bool MetadataCache::Get( const std::string &path, uint16_t flags,
+                           LocationInfo *&response, XRootDStatus &status )
+  {
+    return GetSlot( path, &Node::locate, flags, response, status );
+  }
+
+  bool MetadataCache::GetDeepLocate( const std::string &path, uint16_t flags,
+                                     LocationInfo *&response,
+                                     XRootDStatus &status )
+  {
+    return GetSlot( path, &Node::deepLocate, flags, response, status );
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the invalidation epoch
+  //----------------------------------------------------------------------------
+  uint64_t MetadataCache::GetEpoch()
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    return pEpoch;
+  }
+
+  //----------------------------------------------------------------------------
+  // Cache the responses
+  //----------------------------------------------------------------------------
+  void MetadataCache::Put( const std::string &path, const XRootDStatus &status,
+                           const StatInfo *response, uint64_t epoch )
+  {
+    PutSlot( path, &Node::stat, 0, status, response, epoch );
+  }
+
+  void MetadataCache::Put( const std::string &path, const XRootDStatus &status,
+                           const StatInfoVFS *response, uint64_t epoch )
+  {
+    PutSlot( path, &Node::statVFS, 0, status, response, epoch );
+  }
+
+  void MetadataCache::Put( const std::string &path, uint16_t flags,
+                           const XRootDStatus &status,
+                           const LocationInfo *response, uint64_t epoch )
+  {
+    PutSlot( path, &Node::locate, flags, status, response, epoch );
+  }
+
+  void MetadataCache::PutDeepLocate( const std::string &path, uint16_t flags,
+                                     const XRootDStatus &status,
+                                     const LocationInfo *response,
+                                     uint64_t epoch )
+  {
+    PutSlot( path, &Node::deepLocate, flags, status, response, epoch );
+  }
+
+  //----------------------------------------------------------------------------
+  // Drop the responses for a path, everything below it and its parents
+  //----------------------------------------------------------------------------
+  void MetadataCache::Invalidate( const std::string &path )
+  {
+    std::string key = GetKey( path );
+    std::string::size_type end = key.find( '?' );
+    if( end != std::string::npos )
+      key.erase( end );
+
+    XrdSysMutexHelper scopedLock( pMutex );
+    ++pEpoch;
+
+    //--------------------------------------------------------------------------
+    // The path itself with any opaque data and everything below it sort
+    // together
+    //--------------------------------------------------------------------------
+    NodeMap::iterator it = pNodes.lower_bound( key );
+    while( it != pNodes.end() &&
+           it->first.compare( 0, key.length(), key ) == 0 )
+    {
+      NodeMap::iterator current = it++;
+      if( current->first.length() == key.length() ||
+          current->first[key.length()] == '/' ||
+          current->first[key.length()] == '?' || key == "/" )
+        Erase( current );
+    }
+
+    //--------------------------------------------------------------------------
+    // The parent directories have changed too
+    //--------------------------------------------------------------------------
+    std::string::size_type pos = key.rfind( '/' );
+    while( pos != std::string::npos && pos > 0 )
+    {
+      it = pNodes.find( key.substr( 0, pos ) );
+      if( it != pNodes.end() )
+        Erase( it );
+      pos = key.rfind( '/', pos-1 );
+    }
+    it = pNodes.find( "/" );
+    if( it != pNodes.end() )
+      Erase( it );
+  }
+
+  //----------------------------------------------------------------------------
+  // Drop all the responses
+  //----------------------------------------------------------------------------
+  void MetadataCache::Clear()
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    ++pEpoch;
+    while( !pNodes.empty() )
+      Erase( pNodes.begin() );
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the counters
+  //----------------------------------------------------------------------------
+  uint64_t MetadataCache::GetHits()
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    return pHits;
+  }
+
+  uint64_t MetadataCache::GetMisses()
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    return pMisses;
+  }
+
+  uint32_t MetadataCache::GetSize()
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    return pNodes.size();
+  }
+
+  //----------------------------------------------------------------------------
+  // Get a response of the given kind
+  //----------------------------------------------------------------------------
+  template<class Type>
+  bool MetadataCache::GetSlot( const std::string  &path,
+                               Slot<Type> Node::*  slot,
+                               uint16_t            flags,
+                               Type              *&response,
+                               XRootDStatus       &status )
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    NodeMap::iterator it = pNodes.find( GetKey( path ) );
+    if( it == pNodes.end() )
+    {
+      ++pMisses;
+      return false;
+    }
+
+    Slot<Type> &s = it->second.*slot;
+    if( s.expires <= ::time(0) || s.flags != flags )
+    {
+      ++pMisses;
+      return false;
+    }
+
+    ++pHits;
+    pLRU.splice( pLRU.begin(), pLRU, it->second.lru );
+    status   = s.status;
+    response = s.response ? new Type( *s.response ) : 0;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Store a response of the given kind
+  //----------------------------------------------------------------------------
+  template<class Type>
+  void MetadataCache::PutSlot( const std::string  &path,
+                               Slot<Type> Node::*  slot,
+                               uint16_t            flags,
+                               const XRootDStatus &status,
+                               const Type         *response,
+                               uint64_t            epoch )
+  {
+    time_t ttl = pTTL;
+    if( !status.IsOK() )
+    {
+      if( !IsNotFound( status ) || !pNegativeTTL )
+        return;
+      ttl = pNegativeTTL;
+    }
+    else if( !response )
+      return;
+
+    XrdSysMutexHelper scopedLock( pMutex );
+    if( epoch != pEpoch )
+      return;
+
+    std::string key = GetKey( path );
+    NodeMap::iterator it = pNodes.find( key );
+    if( it == pNodes.end() )
+    {
+      while( pNodes.size() >= pMaxPaths )
+        Erase( pNodes.find( pLRU.back() ) );
+      it = pNodes.insert( std::make_pair( key, Node() ) ).first;
+      pLRU.push_front( key );
+      it->second.lru = pLRU.begin();
+    }
+    else
+      pLRU.splice( pLRU.begin(), pLRU, it->second.lru );
+
+    Slot<Type> &s = it->second.*slot;
+    delete s.response;
+    s.response = status.IsOK() ? new Type( *response ) : 0;
+    s.status   = status;
+    s.expires  = ::time(0) + ttl;
+    s.flags    = flags;
+  }
+
+  //----------------------------------------------------------------------------
+  // Remove a path
+  //----------------------------------------------------------------------------
+  void MetadataCache::Erase( NodeMap::iterator it )
+  {
+    delete it->second.stat.response;
+    delete it->second.statVFS.response;
+    delete it->second.locate.response;
+    delete it->second.deepLocate.response;
+    pLRU.erase( it->second.lru );
+    pNodes.erase( it );
+  }
+}
@@ -0,0 +1,207 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+#ifndef __XRD_CL_METADATA_CACHE_HH__
+#define __XRD_CL_METADATA_CACHE_HH__
+
+#include "XrdCl/XrdClXRootDResponses.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include <list>
+#include <map>
+#include <string>
+#include <time.h>
+
+namespace XrdCl
+{
+  //----------------------------------------------------------------------------
+  //! Cache of the stat, statvfs, locate and deep locate responses of a file
+  //! system.
+  //! The entries expire after a time to live, the "not found" errors are
+  //! cached for a separate time to live and the least recently used paths
+  //! are dropped when the cache is full.
+  //----------------------------------------------------------------------------
+  class MetadataCache
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Constructor - the caller holds the first reference
+      //!
+      //! @param ttl         time to live of the responses in seconds
+      //! @param negativeTTL time to live of the "not found" errors in
+      //!                    seconds, 0 disables caching them
+      //! @param maxPaths    maximum number of paths held
+      //------------------------------------------------------------------------
+      MetadataCache( uint32_t ttl, uint32_t negativeTTL, uint32_t maxPaths );
+
+      //------------------------------------------------------------------------
+      //! Get a reference
+      //------------------------------------------------------------------------
+      void Ref()
+      {
+        XrdSysMutexHelper scopedLock( pMutex );
+        ++pRefCount;
+      }
+
+      //------------------------------------------------------------------------
+      //! Release a reference, the object is deleted when the last one is
+      //! released
+      //------------------------------------------------------------------------
+      void UnRef();
+
+      //------------------------------------------------------------------------
+      //! Get the cached stat response
+      //!
+      //! @param path     the path
+      //! @param response a copy of the response (to be deleted by the user)
+      //!                 or 0 if the path was not found
+      //! @param status   the status of the cached response
+      //! @return         true if the response was cached
+      //------------------------------------------------------------------------
+      bool Get( const std::string &path, StatInfo *&response,
+                XRootDStatus &status );
+
+      //------------------------------------------------------------------------
+      //! Get the cached statvfs response
+      //------------------------------------------------------------------------
+      bool Get( const std::string &path, StatInfoVFS *&response,
+                XRootDStatus &status );
+
+      //------------------------------------------------------------------------
+      //! Get the cached locate response for the given flags
+      //------------------------------------------------------------------------
+      bool Get( const std::string &path, uint16_t flags,
+                LocationInfo *&response, XRootDStatus &status );
+
+      //------------------------------------------------------------------------
+      //! Get the cached deep locate response for the given flags
+      //------------------------------------------------------------------------
+      bool GetDeepLocate( const std::string &path, uint16_t flags,
+                          LocationInfo *&response, XRootDStatus &status );
+
+      //------------------------------------------------------------------------
+      //! Get the invalidation epoch, to be taken before sending a request
+      //! whose response is to be cached
+      //------------------------------------------------------------------------
+      uint64_t GetEpoch();
+
+      //------------------------------------------------------------------------
+      //! Cache a stat response
+      //!
+      //! @param path     the path
+      //! @param status   the status of the request
+      //! @param response the response, 0 if the request failed
+      //! @param epoch    the epoch taken before sending the request, the
+      //!                 response is dropped if any path has been
+      //!                 invalidated since then
+      //------------------------------------------------------------------------
+      void Put( const std::string &path, const XRootDStatus &status,
+                const StatInfo *response, uint64_t epoch );
+
+      //------------------------------------------------------------------------
+      //! Cache a statvfs response
+      //------------------------------------------------------------------------
+      void Put( const std::string &path, const XRootDStatus &status,
+                const StatInfoVFS *response, uint64_t epoch );
+
+      //------------------------------------------------------------------------
+      //! Cache a locate response for the given flags
+      //------------------------------------------------------------------------
+      void Put( const std::string &path, uint16_t flags,
+                const XRootDStatus &status, const LocationInfo *response,
+                uint64_t epoch );
+
+      //------------------------------------------------------------------------
+      //! Cache a deep locate response for the given flags, it should hold
+      //! all the servers
+      //------------------------------------------------------------------------
+      void PutDeepLocate( const std::string &path, uint16_t flags,
+                          const XRootDStatus &status,
+                          const LocationInfo *response, uint64_t epoch );
+
+      //------------------------------------------------------------------------
+      //! Drop the responses for a path that has been modified, for
+      //! everything below it and for its parent directories
+      //------------------------------------------------------------------------
+      void Invalidate( const std::string &path );
+
+      //------------------------------------------------------------------------
+      //! Drop all the responses
+      //------------------------------------------------------------------------
+      void Clear();
+
+      //------------------------------------------------------------------------
+      //! Get the number of requests answered from the cache
+      //------------------------------------------------------------------------
+      uint64_t GetHits();
+
+      //------------------------------------------------------------------------
+      //! Get the number of requests that had to go to the server
+      //------------------------------------------------------------------------
+      uint64_t GetMisses();
+
+      //------------------------------------------------------------------------
+      //! Get the number of paths held
+      //------------------------------------------------------------------------
+      uint32_t GetSize();
+
+    private:
+      ~MetadataCache();
+
+      template<class Type>
+      struct Slot
+      {
+        Slot(): response( 0 ), expires( 0 ), flags( 0 ) {}
+        Type         *response;
+        XRootDStatus  status;
+        time_t        expires;
+        uint16_t      flags;
+      };
+
+      struct Node
+      {
+        Slot<StatInfo>                   stat;
+        Slot<StatInfoVFS>                statVFS;
+        Slot<LocationInfo>               locate;
+        Slot<LocationInfo>               deepLocate;
+        std::list<std::string>::iterator lru;
+      };
+      typedef std::map<std::string, Node> NodeMap;
+
+      template<class Type>
+      bool GetSlot( const std::string &path, Slot<Type> Node::*slot,
+                    uint16_t flags, Type *&response, XRootDStatus &status );
+      template<class Type>
+      void PutSlot( const std::string &path, Slot<Type> Node::*slot,
+                    uint16_t flags, const XRootDStatus &status,
+                    const Type *response, uint64_t epoch );
+      void Erase( NodeMap::iterator it );
+
+      XrdSysMutex            pMutex;
+      NodeMap                pNodes;
+      std::list<std::string> pLRU;
+      uint32_t               pTTL;
+      uint32_t               pNegativeTTL;
+      uint32_t               pMaxPaths;
+      uint64_t               pEpoch;
+      uint64_t               pHits;
+      uint64_t               pMisses;
+      uint32_t               pRefCount;
+  };
+}
+
+#endif // __XRD_CL_METADATA_CACHE_HH__
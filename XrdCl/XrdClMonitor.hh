@@ -113,7 +113,8 @@ namespace XrdCl
       {
         CloseInfo():
           file(0), rBytes(0), vBytes(0), wBytes(0), vSegs(0), rCount(0),
-          vCount(0), wCount(0), status(0)
+          vCount(0), wCount(0), pfBytes(0), pfWaste(0), pfHits(0),
+          pfMisses(0), status(0)
         {
           oTOD.tv_sec = 0; oTOD.tv_usec = 0;
           cTOD.tv_sec = 0; cTOD.tv_usec = 0;
@@ -128,6 +129,10 @@ namespace XrdCl
         uint32_t            rCount;  //!< Total count  of reads
         uint32_t            vCount;  //!< Total count  of readv
         uint32_t            wCount;  //!< Total count  of writes
+        uint64_t            pfBytes; //!< Total number of bytes prefetched
+        uint64_t            pfWaste; //!< Prefetched bytes never used
+        uint32_t            pfHits;  //!< Reads served from prefetched data
+        uint32_t            pfMisses;//!< Reads not served from prefetched data
         const XRootDStatus *status;  //!< Close status
       };
 
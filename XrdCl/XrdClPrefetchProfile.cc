@@ -0,0 +1,412 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+#include "XrdCl/XrdClPrefetchProfile.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include "XrdCl/XrdClConstants.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cctype>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Order the chunks by offset
+  //----------------------------------------------------------------------------
+  bool ChunkOffsetLess( const XrdCl::ChunkInfo &a, const XrdCl::ChunkInfo &b )
+  {
+    return a.offset < b.offset;
+  }
+}
+
+namespace XrdCl
+{
+  //----------------------------------------------------------------------------
+  // Compute the fingerprint of the file class
+  //----------------------------------------------------------------------------
+  std::string PrefetchProfileStore::GetFingerprint( const std::string &path,
+                                                    uint64_t           size )
+  {
+    std::string pattern;
+    for( size_t i = 0; i < path.length(); ++i )
+    {
+      if( isdigit( path[i] ) )
+      {
+        if( pattern.empty() || pattern[pattern.length()-1] != '#' )
+          pattern += '#';
+        continue;
+      }
+      pattern += path[i];
+    }
+
+    int magnitude = 0;
+    while( size >>= 1 )
+      ++magnitude;
+
+    std::ostringstream o;
+    o << pattern << ":" << magnitude;
+    return o.str();
+  }
+
+  //----------------------------------------------------------------------------
+  // Load the profile for the given fingerprint
+  //----------------------------------------------------------------------------
+  bool PrefetchProfileStore::Load( const std::string &fingerprint,
+                                   ChunkList         &ranges ) const
+  {
+    std::ifstream in( GetFileName( fingerprint ).c_str() );
+    if( !in.good() )
+      return false;
+
+    //--------------------------------------------------------------------------
+    // The first line holds the fingerprint to detect hash collisions
+    //--------------------------------------------------------------------------
+    std::string line;
+    std::getline( in, line );
+    if( line != fingerprint )
+      return false;
+
+    uint64_t offset;
+    uint32_t length;
+    while( in >> offset >> length )
+      ranges.push_back( ChunkInfo( offset, length ) );
+    return !ranges.empty();
+  }
+
+  //----------------------------------------------------------------------------
+  // Save the profile
+  //----------------------------------------------------------------------------
+  Status PrefetchProfileStore::Save( const std::string &fingerprint,
+                                     const ChunkList   &ranges ) const
+  {
+    Log *log = DefaultEnv::GetLog();
+
+    //--------------------------------------------------------------------------
+    // Write to a temporary file and move it in place so that concurrent
+    // readers never see a partial profile
+    //--------------------------------------------------------------------------
+    std::string fileName = GetFileName( fingerprint );
+    std::ostringstream tmp;
+    tmp << fileName << "." << getpid() << ".tmp";
+
+    std::ofstream out( tmp.str().c_str() );
+    if( !out.good() )
+    {
+      log->Debug( FileMsg, "Unable to write the prefetch profile %s: %s",
+                  tmp.str().c_str(), strerror( errno ) );
+      return Status( stError, errOSError, errno );
+    }
+
+    out << fingerprint << "\n";
+    ChunkList::const_iterator it;
+    for( it = ranges.begin(); it != ranges.end(); ++it )
+      out << it->offset << " " << it->length << "\n";
+    out.close();
+
+    if( !out.good() || rename( tmp.str().c_str(), fileName.c_str() ) != 0 )
+    {
+      int err = errno;
+      unlink( tmp.str().c_str() );
+      log->Debug( FileMsg, "Unable to store the prefetch profile %s: %s",
+                  fileName.c_str(), strerror( err ) );
+      return Status( stError, errOSError, err );
+    }
+
+    log->Dump( FileMsg, "Stored %d ranges in the prefetch profile for %s",
+               ranges.size(), fingerprint.c_str() );
+    return Status();
+  }
+
+  //----------------------------------------------------------------------------
+  // Coalesce the ranges
+  //----------------------------------------------------------------------------
+  void PrefetchProfileStore::Coalesce( const ChunkList &ranges,
+                                       ChunkList       &result,
+                                       uint64_t         fileSize,
+                                       uint32_t         maxGap,
+                                       uint32_t         maxChunk,
+                                       uint64_t         maxTotal )
+  {
+    ChunkList sorted( ranges );
+    std::sort( sorted.begin(), sorted.end(), ChunkOffsetLess );
+
+    uint64_t total = 0;
+    ChunkList::iterator it;
+    for( it = sorted.begin(); it != sorted.end(); ++it )
+    {
+      //------------------------------------------------------------------------
+      // Clip to the file size
+      //------------------------------------------------------------------------
+      if( it->offset >= fileSize || !it->length )
+        continue;
+      uint64_t end = it->offset + it->length;
+      if( end > fileSize )
+        end = fileSize;
+
+      //------------------------------------------------------------------------
+      // Extend the last range if close enough
+      //------------------------------------------------------------------------
+      if( !result.empty() )
+      {
+        ChunkInfo &last    = result.back();
+        uint64_t   lastEnd = last.offset + last.length;
+        if( end <= lastEnd )
+          continue;
+
+        if( it->offset <= lastEnd + maxGap && end - last.offset <= maxChunk )
+        {
+          total       += end - lastEnd;
+          last.length  = end - last.offset;
+          if( total >= maxTotal )
+            break;
+          continue;
+        }
+
+        if( it->offset < lastEnd )
+          it->offset = lastEnd;
+      }
+
+      //------------------------------------------------------------------------
+      // Start a new range, splitting it if it's too big
+      //------------------------------------------------------------------------
+      uint64_t offset = it->offset;
+      while( offset < end && total < maxTotal )
+      {
+        uint32_t length = std::min( (uint64_t)maxChunk, end - offset );
+        result.push_back( ChunkInfo( offset, length ) );
+        offset += length;
+        total  += length;
+      }
+
+      if( total >= maxTotal )
+        break;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the name of the file holding the profile
+  //----------------------------------------------------------------------------
+  std::string PrefetchProfileStore::GetFileName(
+                                        const std::string &fingerprint ) const
+  {
+    //--------------------------------------------------------------------------
+    // 64-bit FNV-1a
+    //--------------------------------------------------------------------------
+    uint64_t hash = 14695981039346656037ULL;
+    for( size_t i = 0; i < fingerprint.length(); ++i )
+    {
+      hash ^= (unsigned char)fingerprint[i];
+      hash *= 1099511628211ULL;
+    }
+
+    char name[32];
+    snprintf( name, 32, "%016llx.prof", (unsigned long long)hash );
+    return pDirectory + "/" + name;
+  }
+
+  //----------------------------------------------------------------------------
+  // Constructor
+  //----------------------------------------------------------------------------
+  PrefetchCache::PrefetchCache( const ChunkList &ranges ):
+    pChunks( ranges ),
+    pReady( ranges.size(), false ),
+    pUsedRanges( ranges.size() ),
+    pUsed( ranges.size(), 0 ),
+    pRefCount( 1 ),
+    pBytes( 0 ),
+    pHits( 0 ),
+    pMisses( 0 )
+  {
+    for( size_t i = 0; i < pChunks.size(); ++i )
+      pChunks[i].buffer = new char[pChunks[i].length];
+  }
+
+  //----------------------------------------------------------------------------
+  // Destructor
+  //----------------------------------------------------------------------------
+  PrefetchCache::~PrefetchCache()
+  {
+    for( size_t i = 0; i < pChunks.size(); ++i )
+      delete [] (char*)pChunks[i].buffer;
+  }
+
+  //----------------------------------------------------------------------------
+  // Release a reference
+  //----------------------------------------------------------------------------
+  void PrefetchCache::UnRef()
+  {
+    pMutex.Lock();
+    uint32_t refs = --pRefCount;
+    pMutex.UnLock();
+    if( !refs )
+      delete this;
+  }
+
+  //----------------------------------------------------------------------------
+  // Mark the given chunks as available
+  //----------------------------------------------------------------------------
+  void PrefetchCache::SetReady( size_t first, size_t count )
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    for( size_t i = first; i < first+count && i < pChunks.size(); ++i )
+    {
+      if( pReady[i] )
+        continue;
+      pReady[i]  = true;
+      pBytes    += pChunks[i].length;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Copy the given range to the buffer if it is available
+  //----------------------------------------------------------------------------
+  bool PrefetchCache::Read( uint64_t offset, uint32_t size, void *buffer )
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    int index = Find( offset, size );
+    if( index < 0 )
+    {
+      ++pMisses;
+      return false;
+    }
+
+    ChunkInfo &chunk = pChunks[index];
+    memcpy( buffer, (char*)chunk.buffer + (offset - chunk.offset), size );
+    MarkUsed( index, offset, size );
+    ++pHits;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Serve a vector read if all the chunks are available
+  //----------------------------------------------------------------------------
+  bool PrefetchCache::ReadV( const ChunkList &chunks,
+                             void            *buffer,
+                             ChunkList       &result )
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    std::vector<int> indices;
+    for( size_t i = 0; i < chunks.size(); ++i )
+    {
+      int index = Find( chunks[i].offset, chunks[i].length );
+      if( index < 0 )
+      {
+        ++pMisses;
+        return false;
+      }
+      indices.push_back( index );
+    }
+
+    char *cursor = (char*)buffer;
+    for( size_t i = 0; i < chunks.size(); ++i )
+    {
+      ChunkInfo &chunk = pChunks[indices[i]];
+      char      *dest  = cursor ? cursor : (char*)chunks[i].buffer;
+      memcpy( dest, (char*)chunk.buffer + (chunks[i].offset - chunk.offset),
+              chunks[i].length );
+      MarkUsed( indices[i], chunks[i].offset, chunks[i].length );
+      result.push_back( ChunkInfo( chunks[i].offset, chunks[i].length, dest ) );
+      if( cursor )
+        cursor += chunks[i].length;
+    }
+    ++pHits;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the statistics
+  //----------------------------------------------------------------------------
+  void PrefetchCache::GetStats( uint64_t &bytes, uint64_t &wasted,
+                                uint32_t &hits,  uint32_t &misses ) const
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    bytes  = pBytes;
+    wasted = 0;
+    for( size_t i = 0; i < pChunks.size(); ++i )
+      if( pReady[i] )
+        wasted += pChunks[i].length - pUsed[i];
+    hits   = pHits;
+    misses = pMisses;
+  }
+
+  //----------------------------------------------------------------------------
+  // Add the range to the used part of the chunk, the bytes read more than
+  // once are counted once
+  //----------------------------------------------------------------------------
+  void PrefetchCache::MarkUsed( size_t index, uint64_t offset, uint32_t size )
+  {
+    UsedRanges &ranges = pUsedRanges[index];
+    uint32_t    begin  = offset - pChunks[index].offset;
+    uint32_t    end    = begin + size;
+
+    //--------------------------------------------------------------------------
+    // Merge with the preceding range if they touch
+    //--------------------------------------------------------------------------
+    UsedRanges::iterator it = ranges.upper_bound( begin );
+    if( it != ranges.begin() )
+    {
+      UsedRanges::iterator prev = it;
+      --prev;
+      if( prev->second >= end )
+        return;
+      if( prev->second >= begin )
+      {
+        begin = prev->first;
+        it    = prev;
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    // Swallow the following ranges that touch
+    //--------------------------------------------------------------------------
+    while( it != ranges.end() && it->first <= end )
+    {
+      end           = std::max( end, it->second );
+      pUsed[index] -= it->second - it->first;
+      ranges.erase( it++ );
+    }
+    ranges[begin]  = end;
+    pUsed[index]  += end - begin;
+  }
+
+  //----------------------------------------------------------------------------
+  // Find the available chunk containing the given range
+  //----------------------------------------------------------------------------
+  int PrefetchCache::Find( uint64_t offset, uint32_t size ) const
+  {
+    ChunkInfo key( offset, 0 );
+    ChunkList::const_iterator it;
+    it = std::upper_bound( pChunks.begin(), pChunks.end(), key,
+                           ChunkOffsetLess );
+    if( it == pChunks.begin() )
+      return -1;
+    --it;
+
+    int index = it - pChunks.begin();
+    if( !pReady[index] || offset + size > it->offset + it->length )
+      return -1;
+    return index;
+  }
+}
@@ -0,0 +1,192 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+#ifndef __XRD_CL_PREFETCH_PROFILE_HH__
+#define __XRD_CL_PREFETCH_PROFILE_HH__
+
+#include "XrdCl/XrdClStatus.hh"
+#include "XrdCl/XrdClXRootDResponses.hh"
+#include "XrdSys/XrdSysPthread.hh"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace XrdCl
+{
+  //----------------------------------------------------------------------------
+  //! Store of the byte ranges read from the files of a given class, used
+  //! to prefetch the data when a similar file is opened next time
+  //----------------------------------------------------------------------------
+  class PrefetchProfileStore
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Constructor
+      //!
+      //! @param directory directory where the profiles are kept
+      //------------------------------------------------------------------------
+      PrefetchProfileStore( const std::string &directory ):
+        pDirectory( directory ) {}
+
+      //------------------------------------------------------------------------
+      //! Compute the fingerprint of the class of files the given one
+      //! belongs to, ie. the path with all the digit sequences masked out
+      //! and the order of magnitude of the size
+      //------------------------------------------------------------------------
+      static std::string GetFingerprint( const std::string &path,
+                                         uint64_t           size );
+
+      //------------------------------------------------------------------------
+      //! Load the profile for the given fingerprint
+      //!
+      //! @param fingerprint fingerprint of the file class
+      //! @param ranges      the ranges read last time, in the order they
+      //!                    have been read
+      //! @return            false if the profile does not exist or is
+      //!                    not readable
+      //------------------------------------------------------------------------
+      bool Load( const std::string &fingerprint, ChunkList &ranges ) const;
+
+      //------------------------------------------------------------------------
+      //! Save the profile for the given fingerprint replacing the existing
+      //! one
+      //------------------------------------------------------------------------
+      Status Save( const std::string &fingerprint,
+                   const ChunkList   &ranges ) const;
+
+      //------------------------------------------------------------------------
+      //! Sort the ranges, clip them to the file size and merge the ones
+      //! that are closer to each other than the given gap
+      //!
+      //! @param ranges   ranges as recorded
+      //! @param result   the coalesced ranges
+      //! @param fileSize size of the file
+      //! @param maxGap   maximum hole between the ranges to be merged
+      //! @param maxChunk maximum size of a resulting range
+      //! @param maxTotal maximum number of bytes covered by the result
+      //------------------------------------------------------------------------
+      static void Coalesce( const ChunkList &ranges,
+                            ChunkList       &result,
+                            uint64_t         fileSize,
+                            uint32_t         maxGap,
+                            uint32_t         maxChunk,
+                            uint64_t         maxTotal );
+
+    private:
+      std::string GetFileName( const std::string &fingerprint ) const;
+
+      std::string pDirectory;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Reference counted holder of the prefetched data of an open file. It
+  //! outlives the file if the prefetch requests are still in flight when
+  //! the file is closed.
+  //----------------------------------------------------------------------------
+  class PrefetchCache
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Constructor - allocates the buffers for the given ranges, the
+      //! caller holds the first reference
+      //------------------------------------------------------------------------
+      PrefetchCache( const ChunkList &ranges );
+
+      //------------------------------------------------------------------------
+      //! Get a reference
+      //------------------------------------------------------------------------
+      void Ref()
+      {
+        XrdSysMutexHelper scopedLock( pMutex );
+        ++pRefCount;
+      }
+
+      //------------------------------------------------------------------------
+      //! Release a reference, the object is deleted when the last one is
+      //! released
+      //------------------------------------------------------------------------
+      void UnRef();
+
+      //------------------------------------------------------------------------
+      //! Get the ranges with the buffers the data should be written to
+      //------------------------------------------------------------------------
+      const ChunkList &GetChunks() const
+      {
+        return pChunks;
+      }
+
+      //------------------------------------------------------------------------
+      //! Mark the given chunks as available
+      //------------------------------------------------------------------------
+      void SetReady( size_t first, size_t count );
+
+      //------------------------------------------------------------------------
+      //! Serve a vector read if all the chunks are available
+      //!
+      //! @param chunks the chunks to be read
+      //! @param buffer if not zero the data is put there one chunk after
+      //!               another, otherwise the chunk buffers are used
+      //! @param result the chunks that have been read
+      //! @return       true if the data has been copied (a hit), false
+      //!               otherwise
+      //------------------------------------------------------------------------
+      bool ReadV( const ChunkList &chunks, void *buffer, ChunkList &result );
+
+      //------------------------------------------------------------------------
+      //! Copy the given range to the buffer if it is available
+      //!
+      //! @return true if the data has been copied (a hit), false otherwise
+      //------------------------------------------------------------------------
+      bool Read( uint64_t offset, uint32_t size, void *buffer );
+
+      //------------------------------------------------------------------------
+      //! Get the statistics
+      //!
+      //! @param bytes  number of bytes that have been prefetched
+      //! @param wasted number of prefetched bytes that have never been used
+      //! @param hits   number of reads served from the cache
+      //! @param misses number of reads that had to go to the server
+      //------------------------------------------------------------------------
+      void GetStats( uint64_t &bytes, uint64_t &wasted,
+                     uint32_t &hits,  uint32_t &misses ) const;
+
+    private:
+      //------------------------------------------------------------------------
+      // Disjoint ranges of a chunk that have been read, begin -> end
+      //------------------------------------------------------------------------
+      typedef std::map<uint32_t, uint32_t> UsedRanges;
+
+      ~PrefetchCache();
+      int Find( uint64_t offset, uint32_t size ) const;
+      void MarkUsed( size_t index, uint64_t offset, uint32_t size );
+
+      mutable XrdSysMutex     pMutex;
+      ChunkList               pChunks;
+      std::vector<bool>       pReady;
+      std::vector<UsedRanges> pUsedRanges;
+      std::vector<uint32_t>   pUsed;
+      uint32_t                pRefCount;
+      uint64_t                pBytes;
+      uint32_t                pHits;
+      uint32_t                pMisses;
+  };
+}
+
+#endif // __XRD_CL_PREFETCH_PROFILE_HH__
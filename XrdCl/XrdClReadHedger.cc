@@ -0,0 +1,868 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+#include "XrdCl/XrdClReadHedger.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include "XrdCl/XrdClConstants.hh"
+#include "XrdCl/XrdClMessageUtils.hh"
+#include "XrdCl/XrdClXRootDTransport.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+//------------------------------------------------------------------------------
+// The thread
+//------------------------------------------------------------------------------
+extern "C"
+{
+  static void *RunTimerThread( void *arg )
+  {
+    using namespace XrdCl;
+    ReadHedger *hedger = (ReadHedger*)arg;
+    hedger->RunTimers();
+    return 0;
+  }
+}
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Number of latencies remembered per server and the number of them needed
+  // to compute a meaningful percentile
+  //----------------------------------------------------------------------------
+  const size_t HedgeLatencyWindow = 256;
+  const size_t HedgeMinSamples    = 32;
+
+  //----------------------------------------------------------------------------
+  // Forward the response to a request sent to a replica and clean up the
+  // request
+  //----------------------------------------------------------------------------
+  class ReplicaRequestHandler: public XrdCl::ResponseHandler
+  {
+    public:
+      //------------------------------------------------------------------------
+      // Constructor
+      //------------------------------------------------------------------------
+      ReplicaRequestHandler( XrdCl::ResponseHandler *handler,
+                             XrdCl::Message         *message,
+                             XrdCl::ChunkList       *chunkList ):
+        pHandler( handler ),
+        pMessage( message ),
+        pChunkList( chunkList )
+      {
+      }
+
+      //------------------------------------------------------------------------
+      // Destructor
+      //------------------------------------------------------------------------
+      virtual ~ReplicaRequestHandler()
+      {
+        delete pMessage;
+        delete pChunkList;
+      }
+
+      //------------------------------------------------------------------------
+      // Handle the response
+      //------------------------------------------------------------------------
+      virtual void HandleResponseWithHosts( XrdCl::XRootDStatus *status,
+                                            XrdCl::AnyObject    *response,
+                                            XrdCl::HostList     *hostList )
+      {
+        if( pHandler )
+          pHandler->HandleResponseWithHosts( status, response, hostList );
+        else
+        {
+          delete status;
+          delete response;
+          delete hostList;
+        }
+        delete this;
+      }
+
+    private:
+      XrdCl::ResponseHandler *pHandler;
+      XrdCl::Message         *pMessage;
+      XrdCl::ChunkList       *pChunkList;
+  };
+
+  //----------------------------------------------------------------------------
+  // Pass the result of the kXR_open to the replica
+  //----------------------------------------------------------------------------
+  class ReplicaOpenHandler: public XrdCl::ResponseHandler
+  {
+    public:
+      //------------------------------------------------------------------------
+      // Constructor
+      //------------------------------------------------------------------------
+      ReplicaOpenHandler( XrdCl::HedgeReplica *replica ): pReplica( replica )
+      {
+      }
+
+      //------------------------------------------------------------------------
+      // Handle the response
+      //------------------------------------------------------------------------
+      virtual void HandleResponseWithHosts( XrdCl::XRootDStatus *status,
+                                            XrdCl::AnyObject    *response,
+                                            XrdCl::HostList     *hostList )
+      {
+        using namespace XrdCl;
+        OpenInfo *openInfo = 0;
+        if( status->IsOK() && response )
+          response->Get( openInfo );
+
+        pReplica->OnOpen( status, openInfo, hostList );
+        pReplica->UnRef();
+        delete status;
+        delete response;
+        delete hostList;
+        delete this;
+      }
+
+    private:
+      XrdCl::HedgeReplica *pReplica;
+  };
+
+  //----------------------------------------------------------------------------
+  // Pass the response to one of the requests of a hedged read
+  //----------------------------------------------------------------------------
+  class HedgedReadHandler: public XrdCl::ResponseHandler
+  {
+    public:
+      //------------------------------------------------------------------------
+      // Constructor
+      //------------------------------------------------------------------------
+      HedgedReadHandler( XrdCl::HedgedRead *read, bool hedge ):
+        pRead( read ),
+        pHedge( hedge )
+      {
+      }
+
+      //------------------------------------------------------------------------
+      // Handle the response
+      //------------------------------------------------------------------------
+      virtual void HandleResponseWithHosts( XrdCl::XRootDStatus *status,
+                                            XrdCl::AnyObject    *response,
+                                            XrdCl::HostList     *hostList )
+      {
+        pRead->OnResponse( pHedge, status, response, hostList );
+        pRead->UnRef();
+        delete this;
+      }
+
+    private:
+      XrdCl::HedgedRead *pRead;
+      bool               pHedge;
+  };
+
+  //----------------------------------------------------------------------------
+  // Close the file handle at the given server, don't wait for the answer
+  //----------------------------------------------------------------------------
+  void CloseReplica( const XrdCl::URL &url,
+                     const uint8_t    *fileHandle,
+                     uint64_t          sessionId )
+  {
+    using namespace XrdCl;
+    Message            *msg;
+    ClientCloseRequest *req;
+    MessageUtils::CreateRequest( msg, req );
+
+    req->requestid = kXR_close;
+    memcpy( req->fhandle, fileHandle, 4 );
+
+    XRootDTransport::SetDescription( msg );
+    msg->SetSessionId( sessionId );
+    ReplicaRequestHandler *handler = new ReplicaRequestHandler( 0, msg, 0 );
+    MessageSendParams params;
+    MessageUtils::ProcessSendParams( params );
+
+    Status st = MessageUtils::SendMessage( url, msg, handler, params );
+    if( !st.IsOK() )
+      delete handler;
+  }
+}
+
+namespace XrdCl
+{
+  //----------------------------------------------------------------------------
+  // Constructor
+  //----------------------------------------------------------------------------
+  HedgeReplica::HedgeReplica( const URL &loadBalancer,
+                              const URL &file,
+                              const URL &dataServer,
+                              uint16_t   flags ):
+    pRefCount( 1 ),
+    pState( Idle ),
+    pUrl( loadBalancer ),
+    pAvoid( dataServer.GetHostId() ),
+    pFlags( flags ),
+    pDataServer( 0 ),
+    pSessionId( 0 ),
+    pSent( 0 ),
+    pWon( 0 )
+  {
+    //--------------------------------------------------------------------------
+    // Ask the load balancer for a server other than the current one
+    //--------------------------------------------------------------------------
+    pUrl.SetPath( file.GetPath() );
+    pUrl.GetParams() = file.GetParams();
+    pUrl.GetParams()["tried"] = dataServer.GetHostName();
+    memset( pFileHandle, 0, 4 );
+  }
+
+  //----------------------------------------------------------------------------
+  // Destructor
+  //----------------------------------------------------------------------------
+  HedgeReplica::~HedgeReplica()
+  {
+    if( pState == Opened )
+      CloseReplica( *pDataServer, pFileHandle, pSessionId );
+    delete pDataServer;
+  }
+
+  //----------------------------------------------------------------------------
+  // Release a reference
+  //----------------------------------------------------------------------------
+  void HedgeReplica::UnRef()
+  {
+    pMutex.Lock();
+    uint32_t refs = --pRefCount;
+    pMutex.UnLock();
+    if( !refs )
+      delete this;
+  }
+
+  //----------------------------------------------------------------------------
+  // Send a read request to the replica
+  //----------------------------------------------------------------------------
+  Status HedgeReplica::Read( uint64_t         offset,
+                             uint32_t         size,
+                             void            *buffer,
+                             ResponseHandler *handler )
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+
+    if( pState == Idle )
+    {
+      Status st = Open();
+      if( !st.IsOK() )
+      {
+        pState = Failed;
+        return st;
+      }
+      return Status( stError, errInProgress );
+    }
+
+    if( pState == Opening )
+      return Status( stError, errInProgress );
+
+    if( pState == Failed )
+      return Status( stError, errNotSupported );
+
+    Message           *msg;
+    ClientReadRequest *req;
+    MessageUtils::CreateRequest( msg, req );
+
+    req->requestid  = kXR_read;
+    req->offset     = offset;
+    req->rlen       = size;
+    memcpy( req->fhandle, pFileHandle, 4 );
+
+    ChunkList *list = new ChunkList();
+    list->push_back( ChunkInfo( offset, size, buffer ) );
+
+    XRootDTransport::SetDescription( msg );
+    msg->SetSessionId( pSessionId );
+    MessageSendParams params;
+    params.followRedirects = false;
+    params.stateful        = true;
+    params.chunkList       = list;
+    MessageUtils::ProcessSendParams( params );
+
+    ReplicaRequestHandler *reqHandler = new ReplicaRequestHandler( handler, msg,
+                                                                   list );
+    Status st = MessageUtils::SendMessage( *pDataServer, msg, reqHandler,
+                                           params );
+    if( !st.IsOK() )
+    {
+      //------------------------------------------------------------------------
+      // The connection to the replica has been broken, we don't try to
+      // recover it
+      //------------------------------------------------------------------------
+      if( st.code == errInvalidSession )
+        pState = Failed;
+      delete reqHandler;
+    }
+    return st;
+  }
+
+  //----------------------------------------------------------------------------
+  // Open the replica
+  //----------------------------------------------------------------------------
+  Status HedgeReplica::Open()
+  {
+    Log *log = DefaultEnv::GetLog();
+    log->Debug( FileMsg, "Opening a replica for hedged reads: %s",
+                pUrl.GetURL().c_str() );
+
+    Message           *msg;
+    ClientOpenRequest *req;
+    std::string        path = pUrl.GetPathWithParams();
+    MessageUtils::CreateRequest( msg, req, path.length() );
+
+    req->requestid = kXR_open;
+    req->mode      = 0;
+    req->options   = pFlags | kXR_async;
+    req->dlen      = path.length();
+    msg->Append( path.c_str(), path.length(), 24 );
+
+    XRootDTransport::SetDescription( msg );
+    MessageSendParams params;
+    MessageUtils::ProcessSendParams( params );
+
+    //--------------------------------------------------------------------------
+    // The handler holds a reference until the response arrives
+    //--------------------------------------------------------------------------
+    ++pRefCount;
+    ReplicaOpenHandler *handler = new ReplicaOpenHandler( this );
+    Status st = MessageUtils::SendMessage( pUrl, msg, handler, params );
+    if( !st.IsOK() )
+    {
+      --pRefCount;
+      delete handler;
+      return st;
+    }
+    pState = Opening;
+    return st;
+  }
+
+  //----------------------------------------------------------------------------
+  // Process the result of the opening operation
+  //----------------------------------------------------------------------------
+  void HedgeReplica::OnOpen( const XRootDStatus *status,
+                             const OpenInfo     *openInfo,
+                             const HostList     *hostList )
+  {
+    Log *log = DefaultEnv::GetLog();
+    XrdSysMutexHelper scopedLock( pMutex );
+
+    if( !status->IsOK() || !openInfo || !hostList || hostList->empty() )
+    {
+      log->Debug( FileMsg, "Unable to open a replica for hedged reads %s: %s",
+                  pUrl.GetURL().c_str(), status->ToStr().c_str() );
+      pState = Failed;
+      return;
+    }
+
+    //--------------------------------------------------------------------------
+    // The load balancer might have had no other choice
+    //--------------------------------------------------------------------------
+    URL     dataServer( hostList->back().url );
+    uint8_t fileHandle[4];
+    openInfo->GetFileHandle( fileHandle );
+
+    if( dataServer.GetHostId() == pAvoid )
+    {
+      log->Debug( FileMsg, "No other replica of %s available for hedged reads",
+                  pUrl.GetURL().c_str() );
+      CloseReplica( dataServer, fileHandle, openInfo->GetSessionId() );
+      pState = Failed;
+      return;
+    }
+
+    log->Debug( FileMsg, "Opened a replica of %s for hedged reads at %s",
+                pUrl.GetURL().c_str(), dataServer.GetHostId().c_str() );
+
+    memcpy( pFileHandle, fileHandle, 4 );
+    pSessionId  = openInfo->GetSessionId();
+    pDataServer = new URL( dataServer );
+    pState      = Opened;
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the data server serving the replica
+  //----------------------------------------------------------------------------
+  std::string HedgeReplica::GetDataServer() const
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    if( pDataServer )
+      return pDataServer->GetHostId();
+    return "";
+  }
+
+  //----------------------------------------------------------------------------
+  // Count a duplicate read
+  //----------------------------------------------------------------------------
+  void HedgeReplica::CountHedge( bool won )
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    if( won )
+      ++pWon;
+    else
+      ++pSent;
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the statistics
+  //----------------------------------------------------------------------------
+  void HedgeReplica::GetStats( uint32_t &sent, uint32_t &won ) const
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    sent = pSent;
+    won  = pWon;
+  }
+
+  //----------------------------------------------------------------------------
+  // Constructor
+  //----------------------------------------------------------------------------
+  HedgedRead::HedgedRead( ResponseHandler   *userHandler,
+                          uint64_t           offset,
+                          uint32_t           size,
+                          void              *buffer,
+                          const std::string &dataServer,
+                          HedgeReplica      *replica ):
+    pRefCount( 1 ),
+    pUserHandler( userHandler ),
+    pOffset( offset ),
+    pSize( size ),
+    pUserBuffer( buffer ),
+    pDone( false ),
+    pError( 0 ),
+    pErrorHosts( 0 ),
+    pReplica( replica ),
+    pDeadline( 0 )
+  {
+    pBuffers[0]     = new char[size];
+    pBuffers[1]     = 0;
+    pServers[0]     = dataServer;
+    pStart[0]       = ReadHedger::Now();
+    pStart[1]       = 0;
+    pOutstanding[0] = true;
+    pOutstanding[1] = false;
+    pReplica->Ref();
+  }
+
+  //----------------------------------------------------------------------------
+  // Destructor
+  //----------------------------------------------------------------------------
+  HedgedRead::~HedgedRead()
+  {
+    delete [] pBuffers[0];
+    delete [] pBuffers[1];
+    delete pError;
+    delete pErrorHosts;
+    pReplica->UnRef();
+  }
+
+  //----------------------------------------------------------------------------
+  // Release a reference
+  //----------------------------------------------------------------------------
+  void HedgedRead::UnRef()
+  {
+    pMutex.Lock();
+    uint32_t refs = --pRefCount;
+    pMutex.UnLock();
+    if( !refs )
+      delete this;
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the handler for the original request
+  //----------------------------------------------------------------------------
+  ResponseHandler *HedgedRead::GetHandler()
+  {
+    return new HedgedReadHandler( this, false );
+  }
+
+  //----------------------------------------------------------------------------
+  // Send the duplicate request
+  //----------------------------------------------------------------------------
+  void HedgedRead::Hedge()
+  {
+    Log        *log    = DefaultEnv::GetLog();
+    ReadHedger *hedger = DefaultEnv::GetReadHedger();
+    if( !hedger )
+      return;
+
+    XrdSysMutexHelper scopedLock( pMutex );
+
+    if( pDone || pOutstanding[1] )
+      return;
+
+    if( !hedger->AcquireSlot() )
+    {
+      log->Dump( FileMsg, "Too many hedged reads in the fly, not duplicating "
+                 "the read of %d bytes at %ld from %s", pSize, pOffset,
+                 pServers[0].c_str() );
+      return;
+    }
+
+    if( !pBuffers[1] )
+      pBuffers[1] = new char[pSize];
+
+    ++pRefCount;
+    HedgedReadHandler *handler = new HedgedReadHandler( this, true );
+    pStart[1] = ReadHedger::Now();
+    Status st = pReplica->Read( pOffset, pSize, pBuffers[1], handler );
+    if( !st.IsOK() )
+    {
+      --pRefCount;
+      delete handler;
+      hedger->ReleaseSlot();
+
+      //------------------------------------------------------------------------
+      // The replica is opened when it is needed for the first time, we
+      // try again shortly unless the original request returns meanwhile
+      //------------------------------------------------------------------------
+      if( st.code == errInProgress )
+      {
+        int retryDelay = DefaultReadHedgeMinDelay;
+        DefaultEnv::GetEnv()->GetInt( "ReadHedgeMinDelay", retryDelay );
+        log->Dump( FileMsg, "Replica for the read of %d bytes at %ld from %s "
+                   "is being opened, retrying in %d ms", pSize, pOffset,
+                   pServers[0].c_str(), retryDelay );
+        scopedLock.UnLock();
+        hedger->Schedule( this, retryDelay > 0 ? retryDelay : 1 );
+      }
+      return;
+    }
+
+    pServers[1]     = pReplica->GetDataServer();
+    pOutstanding[1] = true;
+    pReplica->CountHedge( false );
+    log->Dump( FileMsg, "Read of %d bytes at %ld from %s is taking %ld ms, "
+               "duplicated to %s", pSize, pOffset, pServers[0].c_str(),
+               pStart[1]-pStart[0], pServers[1].c_str() );
+  }
+
+  //----------------------------------------------------------------------------
+  // Process a response
+  //----------------------------------------------------------------------------
+  void HedgedRead::OnResponse( bool          hedge,
+                               XRootDStatus *status,
+                               AnyObject    *response,
+                               HostList     *hostList )
+  {
+    ReadHedger *hedger = DefaultEnv::GetReadHedger();
+    int         index  = hedge ? 1 : 0;
+    ChunkInfo  *chunk  = 0;
+    if( status->IsOK() && response )
+      response->Get( chunk );
+
+    //--------------------------------------------------------------------------
+    // The latency is known even if the response lost the race
+    //--------------------------------------------------------------------------
+    if( chunk && hedger )
+      hedger->AddSample( pServers[index], ReadHedger::Now() - pStart[index] );
+    if( hedge && hedger )
+      hedger->ReleaseSlot();
+
+    pMutex.Lock();
+    pOutstanding[index] = false;
+
+    //--------------------------------------------------------------------------
+    // We have lost the race
+    //--------------------------------------------------------------------------
+    if( pDone )
+    {
+      pMutex.UnLock();
+      delete status;
+      delete response;
+      delete hostList;
+      return;
+    }
+
+    //--------------------------------------------------------------------------
+    // A failure is reported only if the other request has failed too or
+    // has never been sent, the error of the original request takes
+    // precedence
+    //--------------------------------------------------------------------------
+    if( !chunk )
+    {
+      delete response;
+      if( pOutstanding[1-index] )
+      {
+        if( hedge )
+        {
+          delete status;
+          delete hostList;
+        }
+        else
+        {
+          pError      = status;
+          pErrorHosts = hostList;
+        }
+        pMutex.UnLock();
+        return;
+      }
+
+      if( hedge && pError )
+      {
+        delete status;
+        delete hostList;
+        status       = pError;
+        hostList     = pErrorHosts;
+        pError       = 0;
+        pErrorHosts  = 0;
+      }
+      pDone = true;
+      pMutex.UnLock();
+
+      if( hedger )
+        hedger->Cancel( this );
+      pUserHandler->HandleResponseWithHosts( status, 0, hostList );
+      return;
+    }
+
+    //--------------------------------------------------------------------------
+    // We have won
+    //--------------------------------------------------------------------------
+    memcpy( pUserBuffer, chunk->buffer, chunk->length );
+    AnyObject *obj = new AnyObject();
+    obj->Set( new ChunkInfo( chunk->offset, chunk->length, pUserBuffer ) );
+    delete response;
+    if( hedge )
+      pReplica->CountHedge( true );
+    pDone = true;
+    pMutex.UnLock();
+
+    if( hedger )
+      hedger->Cancel( this );
+    pUserHandler->HandleResponseWithHosts( status, obj, hostList );
+  }
+
+  //----------------------------------------------------------------------------
+  // Constructor
+  //----------------------------------------------------------------------------
+  ReadHedger::ReadHedger():
+    pInFlight( 0 ),
+    pTimerThread( 0 ),
+    pRunning( false ),
+    pStop( false )
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  // Destructor
+  //----------------------------------------------------------------------------
+  ReadHedger::~ReadHedger()
+  {
+    TimerMap::iterator it;
+    for( it = pTimers.begin(); it != pTimers.end(); ++it )
+      it->second->UnRef();
+  }
+
+  //----------------------------------------------------------------------------
+  // Start the timer thread
+  //----------------------------------------------------------------------------
+  bool ReadHedger::Start()
+  {
+    XrdSysMutexHelper scopedLock( pOpMutex );
+    Log *log = DefaultEnv::GetLog();
+
+    if( pRunning )
+      return false;
+
+    pStop = false;
+    int ret = ::pthread_create( &pTimerThread, 0, ::RunTimerThread, this );
+    if( ret != 0 )
+    {
+      log->Error( FileMsg, "Unable to spawn the read hedger thread: %s",
+                  strerror( ret ) );
+      return false;
+    }
+    pRunning = true;
+    log->Debug( FileMsg, "Read hedger started" );
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Stop the timer thread
+  //----------------------------------------------------------------------------
+  bool ReadHedger::Stop()
+  {
+    XrdSysMutexHelper scopedLock( pOpMutex );
+    Log *log = DefaultEnv::GetLog();
+
+    if( !pRunning )
+      return false;
+
+    pTimerCond.Lock();
+    pStop = true;
+    pTimerCond.Broadcast();
+    pTimerCond.UnLock();
+
+    int ret = pthread_join( pTimerThread, 0 );
+    if( ret != 0 )
+    {
+      log->Error( FileMsg, "Failed to join the read hedger thread: %s",
+                  strerror( ret ) );
+      return false;
+    }
+    pRunning = false;
+    log->Debug( FileMsg, "Read hedger stopped" );
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Record the latency of a read
+  //----------------------------------------------------------------------------
+  void ReadHedger::AddSample( const std::string &server, uint32_t latency )
+  {
+    XrdSysMutexHelper scopedLock( pStatsMutex );
+    LatencyWindow &window = pLatencies[server];
+    if( window.samples.size() < HedgeLatencyWindow )
+      window.samples.push_back( latency );
+    else
+      window.samples[window.next] = latency;
+    window.next = (window.next + 1) % HedgeLatencyWindow;
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the delay after which the reads should be duplicated
+  //----------------------------------------------------------------------------
+  uint32_t ReadHedger::GetDelay( const std::string &server )
+  {
+    Env *env      = DefaultEnv::GetEnv();
+    int  minDelay = DefaultReadHedgeMinDelay;
+    int  maxDelay = DefaultReadHedgeMaxDelay;
+    env->GetInt( "ReadHedgeMinDelay", minDelay );
+    env->GetInt( "ReadHedgeMaxDelay", maxDelay );
+
+    //--------------------------------------------------------------------------
+    // We don't know the server well enough yet
+    //--------------------------------------------------------------------------
+    XrdSysMutexHelper scopedLock( pStatsMutex );
+    LatencyMap::iterator it = pLatencies.find( server );
+    if( it == pLatencies.end() || it->second.samples.size() < HedgeMinSamples )
+      return maxDelay;
+
+    std::vector<uint32_t> samples( it->second.samples );
+    scopedLock.UnLock();
+
+    size_t index = samples.size()*95/100;
+    std::nth_element( samples.begin(), samples.begin()+index, samples.end() );
+    int delay = samples[index];
+    if( delay > maxDelay )
+      delay = maxDelay;
+    if( delay < minDelay )
+      delay = minDelay;
+    return delay;
+  }
+
+  //----------------------------------------------------------------------------
+  // Duplicate the read after the given delay
+  //----------------------------------------------------------------------------
+  void ReadHedger::Schedule( HedgedRead *read, uint32_t delay )
+  {
+    read->Ref();
+    read->SetDeadline( Now() + delay );
+
+    pTimerCond.Lock();
+    TimerMap::iterator it;
+    it = pTimers.insert( std::make_pair( read->GetDeadline(), read ) );
+    if( it == pTimers.begin() )
+      pTimerCond.Signal();
+    pTimerCond.UnLock();
+  }
+
+  //----------------------------------------------------------------------------
+  // Cancel the duplication of the read
+  //----------------------------------------------------------------------------
+  void ReadHedger::Cancel( HedgedRead *read )
+  {
+    bool found = false;
+    pTimerCond.Lock();
+    std::pair<TimerMap::iterator, TimerMap::iterator> range;
+    range = pTimers.equal_range( read->GetDeadline() );
+    for( TimerMap::iterator it = range.first; it != range.second; ++it )
+    {
+      if( it->second == read )
+      {
+        pTimers.erase( it );
+        found = true;
+        break;
+      }
+    }
+    pTimerCond.UnLock();
+
+    if( found )
+      read->UnRef();
+  }
+
+  //----------------------------------------------------------------------------
+  // Reserve a slot for a duplicate request
+  //----------------------------------------------------------------------------
+  bool ReadHedger::AcquireSlot()
+  {
+    int maxInFlight = DefaultReadHedgeMaxInFlight;
+    DefaultEnv::GetEnv()->GetInt( "ReadHedgeMaxInFlight", maxInFlight );
+
+    XrdSysMutexHelper scopedLock( pStatsMutex );
+    if( (int)pInFlight >= maxInFlight )
+      return false;
+    ++pInFlight;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Release a slot
+  //----------------------------------------------------------------------------
+  void ReadHedger::ReleaseSlot()
+  {
+    XrdSysMutexHelper scopedLock( pStatsMutex );
+    if( pInFlight )
+      --pInFlight;
+  }
+
+  //----------------------------------------------------------------------------
+  // Run the timers
+  //----------------------------------------------------------------------------
+  void ReadHedger::RunTimers()
+  {
+    pTimerCond.Lock();
+    while( !pStop )
+    {
+      if( pTimers.empty() )
+      {
+        pTimerCond.Wait();
+        continue;
+      }
+
+      uint64_t           now = Now();
+      TimerMap::iterator it  = pTimers.begin();
+      if( it->first > now )
+      {
+        pTimerCond.WaitMS( it->first - now );
+        continue;
+      }
+
+      //------------------------------------------------------------------------
+      // The timer holds a reference that we release once we're done
+      //------------------------------------------------------------------------
+      HedgedRead *read = it->second;
+      pTimers.erase( it );
+      pTimerCond.UnLock();
+      read->Hedge();
+      read->UnRef();
+      pTimerCond.Lock();
+    }
+    pTimerCond.UnLock();
+  }
+}
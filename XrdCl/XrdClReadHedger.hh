@@ -0,0 +1,354 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+#ifndef __XRD_CL_READ_HEDGER_HH__
+#define __XRD_CL_READ_HEDGER_HH__
+
+#include "XrdCl/XrdClStatus.hh"
+#include "XrdCl/XrdClURL.hh"
+#include "XrdCl/XrdClXRootDResponses.hh"
+#include "XrdSys/XrdSysPthread.hh"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+namespace XrdCl
+{
+  //----------------------------------------------------------------------------
+  //! Second replica of a read-only file, opened through the load balancer
+  //! at a server different from the one serving the file, to which the
+  //! duplicates of the slow reads are sent
+  //----------------------------------------------------------------------------
+  class HedgeReplica
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Constructor - nothing is opened until the first read, the caller
+      //! holds the first reference
+      //!
+      //! @param loadBalancer the load balancer to open the replica at
+      //! @param file         url of the file
+      //! @param dataServer   the server to be avoided
+      //! @param flags        open flags
+      //------------------------------------------------------------------------
+      HedgeReplica( const URL &loadBalancer,
+                    const URL &file,
+                    const URL &dataServer,
+                    uint16_t   flags );
+
+      //------------------------------------------------------------------------
+      //! Get a reference
+      //------------------------------------------------------------------------
+      void Ref()
+      {
+        XrdSysMutexHelper scopedLock( pMutex );
+        ++pRefCount;
+      }
+
+      //------------------------------------------------------------------------
+      //! Release a reference, the replica is closed and deleted when the
+      //! last one is released
+      //------------------------------------------------------------------------
+      void UnRef();
+
+      //------------------------------------------------------------------------
+      //! Send a read request to the replica
+      //!
+      //! @return errInProgress if the replica is being opened, in which case
+      //!         the opening is started if necessary, errNotSupported if
+      //!         no suitable replica is available
+      //------------------------------------------------------------------------
+      Status Read( uint64_t         offset,
+                   uint32_t         size,
+                   void            *buffer,
+                   ResponseHandler *handler );
+
+      //------------------------------------------------------------------------
+      //! Process the result of the opening operation
+      //------------------------------------------------------------------------
+      void OnOpen( const XRootDStatus *status,
+                   const OpenInfo     *openInfo,
+                   const HostList     *hostList );
+
+      //------------------------------------------------------------------------
+      //! Get the data server serving the replica, empty if not open
+      //------------------------------------------------------------------------
+      std::string GetDataServer() const;
+
+      //------------------------------------------------------------------------
+      //! Count a duplicate read that has been sent and the ones that
+      //! arrived first
+      //------------------------------------------------------------------------
+      void CountHedge( bool won );
+
+      //------------------------------------------------------------------------
+      //! Get the number of duplicate reads sent and the number of those
+      //! that arrived before the original ones
+      //------------------------------------------------------------------------
+      void GetStats( uint32_t &sent, uint32_t &won ) const;
+
+    private:
+      enum State
+      {
+        Idle,
+        Opening,
+        Opened,
+        Failed
+      };
+
+      ~HedgeReplica();
+      Status Open();
+
+      mutable XrdSysMutex  pMutex;
+      uint32_t             pRefCount;
+      State                pState;
+      URL                  pUrl;
+      std::string          pAvoid;
+      uint16_t             pFlags;
+      URL                 *pDataServer;
+      uint8_t              pFileHandle[4];
+      uint64_t             pSessionId;
+      uint32_t             pSent;
+      uint32_t             pWon;
+  };
+
+  //----------------------------------------------------------------------------
+  //! A read that may be duplicated. Both the original and the duplicate
+  //! requests read to private buffers, the data of the one that arrives
+  //! first is copied to the user buffer and the other one is discarded
+  //! when it arrives.
+  //----------------------------------------------------------------------------
+  class HedgedRead
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Constructor, the caller holds the first reference
+      //------------------------------------------------------------------------
+      HedgedRead( ResponseHandler   *userHandler,
+                  uint64_t           offset,
+                  uint32_t           size,
+                  void              *buffer,
+                  const std::string &dataServer,
+                  HedgeReplica      *replica );
+
+      //------------------------------------------------------------------------
+      //! Get a reference
+      //------------------------------------------------------------------------
+      void Ref()
+      {
+        XrdSysMutexHelper scopedLock( pMutex );
+        ++pRefCount;
+      }
+
+      //------------------------------------------------------------------------
+      //! Release a reference
+      //------------------------------------------------------------------------
+      void UnRef();
+
+      //------------------------------------------------------------------------
+      //! Get the handler for the original request, the first reference
+      //! is handed over to it
+      //------------------------------------------------------------------------
+      ResponseHandler *GetHandler();
+
+      //------------------------------------------------------------------------
+      //! Get the buffer the original request should read to
+      //------------------------------------------------------------------------
+      void *GetBuffer()
+      {
+        return pBuffers[0];
+      }
+
+      //------------------------------------------------------------------------
+      //! Send the duplicate request if the original one has not returned
+      //! yet. The replica is opened by the first duplicate request, while
+      //! it is being opened the duplication is retried every
+      //! ReadHedgeMinDelay milliseconds.
+      //------------------------------------------------------------------------
+      void Hedge();
+
+      //------------------------------------------------------------------------
+      //! Process a response
+      //!
+      //! @param hedge true if the response is to the duplicate request
+      //------------------------------------------------------------------------
+      void OnResponse( bool          hedge,
+                       XRootDStatus *status,
+                       AnyObject    *response,
+                       HostList     *hostList );
+
+      //------------------------------------------------------------------------
+      //! Check if the outcome has been handed to the user, the request
+      //! still outstanding, if any, is of no use anymore
+      //------------------------------------------------------------------------
+      bool IsDone()
+      {
+        XrdSysMutexHelper scopedLock( pMutex );
+        return pDone;
+      }
+
+      //------------------------------------------------------------------------
+      //! Set the time at which the duplicate request is due (in
+      //! milliseconds)
+      //------------------------------------------------------------------------
+      void SetDeadline( uint64_t deadline )
+      {
+        pDeadline = deadline;
+      }
+
+      //------------------------------------------------------------------------
+      //! Get the time at which the duplicate request is due
+      //------------------------------------------------------------------------
+      uint64_t GetDeadline() const
+      {
+        return pDeadline;
+      }
+
+    private:
+      ~HedgedRead();
+
+      XrdSysMutex      pMutex;
+      uint32_t         pRefCount;
+      ResponseHandler *pUserHandler;
+      uint64_t         pOffset;
+      uint32_t         pSize;
+      void            *pUserBuffer;
+      char            *pBuffers[2];
+      std::string      pServers[2];
+      uint64_t         pStart[2];
+      bool             pOutstanding[2];
+      bool             pDone;
+      XRootDStatus    *pError;
+      HostList        *pErrorHosts;
+      HedgeReplica    *pReplica;
+      uint64_t         pDeadline;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Keep track of the read latencies of the data servers and send the
+  //! duplicates of the reads taking longer than usual. The delay after
+  //! which a read is duplicated is the 95th percentile of the recent
+  //! latencies of its server bounded by ReadHedgeMinDelay and
+  //! ReadHedgeMaxDelay, and no more than ReadHedgeMaxInFlight duplicates
+  //! are outstanding in the process at any given time.
+  //----------------------------------------------------------------------------
+  class ReadHedger
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Constructor
+      //------------------------------------------------------------------------
+      ReadHedger();
+
+      //------------------------------------------------------------------------
+      //! Destructor
+      //------------------------------------------------------------------------
+      ~ReadHedger();
+
+      //------------------------------------------------------------------------
+      //! Start the timer thread
+      //------------------------------------------------------------------------
+      bool Start();
+
+      //------------------------------------------------------------------------
+      //! Stop the timer thread, the pending reads are kept
+      //------------------------------------------------------------------------
+      bool Stop();
+
+      //------------------------------------------------------------------------
+      //! Record the latency of a read
+      //!
+      //! @param server  host id of the server
+      //! @param latency latency in milliseconds
+      //------------------------------------------------------------------------
+      void AddSample( const std::string &server, uint32_t latency );
+
+      //------------------------------------------------------------------------
+      //! Get the delay in milliseconds after which the reads sent to the
+      //! given server should be duplicated
+      //------------------------------------------------------------------------
+      uint32_t GetDelay( const std::string &server );
+
+      //------------------------------------------------------------------------
+      //! Duplicate the read after the given delay unless it is cancelled
+      //------------------------------------------------------------------------
+      void Schedule( HedgedRead *read, uint32_t delay );
+
+      //------------------------------------------------------------------------
+      //! Cancel the duplication of the read
+      //------------------------------------------------------------------------
+      void Cancel( HedgedRead *read );
+
+      //------------------------------------------------------------------------
+      //! Reserve a slot for a duplicate request
+      //!
+      //! @return false if there is too many of them in the fly
+      //------------------------------------------------------------------------
+      bool AcquireSlot();
+
+      //------------------------------------------------------------------------
+      //! Release a slot reserved for a duplicate request
+      //------------------------------------------------------------------------
+      void ReleaseSlot();
+
+      //------------------------------------------------------------------------
+      //! Run the timers - loops until stopped
+      //------------------------------------------------------------------------
+      void RunTimers();
+
+      //------------------------------------------------------------------------
+      //! Current time in milliseconds
+      //------------------------------------------------------------------------
+      static uint64_t Now()
+      {
+        timeval now;
+        gettimeofday( &now, 0 );
+        return (uint64_t)now.tv_sec*1000 + now.tv_usec/1000;
+      }
+
+    private:
+      //------------------------------------------------------------------------
+      // Recent latencies of a server
+      //------------------------------------------------------------------------
+      struct LatencyWindow
+      {
+        LatencyWindow(): next(0) {}
+        std::vector<uint32_t> samples;
+        size_t                next;
+      };
+
+      typedef std::map<std::string, LatencyWindow> LatencyMap;
+      typedef std::multimap<uint64_t, HedgedRead*> TimerMap;
+
+      XrdSysMutex   pStatsMutex;
+      LatencyMap    pLatencies;
+      XrdSysCondVar pTimerCond;
+      TimerMap      pTimers;
+      uint32_t      pInFlight;
+      pthread_t     pTimerThread;
+      bool          pRunning;
+      bool          pStop;
+      XrdSysMutex   pOpMutex;
+  };
+}
+
+#endif // __XRD_CL_READ_HEDGER_HH__
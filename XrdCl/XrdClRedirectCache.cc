@@ -0,0 +1,130 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+#include "XrdCl/XrdClRedirectCache.hh"
+
+namespace XrdCl
+{
+  //----------------------------------------------------------------------------
+  // Constructor
+  //----------------------------------------------------------------------------
+  RedirectCache::RedirectCache( uint32_t ttl, uint32_t maxEntries ):
+    pTTL( ttl ),
+    pMaxEntries( maxEntries ? maxEntries : 1 ),
+    pHits( 0 ),
+    pMisses( 0 )
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the data server a file has been opened at
+  //----------------------------------------------------------------------------
+  bool RedirectCache::Get( const URL &url, URL &dataServer, std::string &cgi )
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    EntryMap::iterator it = pEntries.find( GetKey( url ) );
+    if( it == pEntries.end() )
+    {
+      ++pMisses;
+      return false;
+    }
+
+    if( it->second.expires <= ::time(0) )
+    {
+      Erase( it );
+      ++pMisses;
+      return false;
+    }
+
+    ++pHits;
+    pLRU.splice( pLRU.begin(), pLRU, it->second.lru );
+    dataServer = it->second.dataServer;
+    cgi        = it->second.cgi;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Remember the data server a file has been opened at
+  //----------------------------------------------------------------------------
+  void RedirectCache::Put( const URL         &url,
+                           const URL         &dataServer,
+                           const std::string &cgi )
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    std::string key = GetKey( url );
+    EntryMap::iterator it = pEntries.find( key );
+    if( it == pEntries.end() )
+    {
+      while( pEntries.size() >= pMaxEntries )
+        Erase( pEntries.find( pLRU.back() ) );
+      it = pEntries.insert( std::make_pair( key, Entry() ) ).first;
+      pLRU.push_front( key );
+      it->second.lru = pLRU.begin();
+    }
+    else
+      pLRU.splice( pLRU.begin(), pLRU, it->second.lru );
+
+    it->second.dataServer = dataServer;
+    it->second.cgi        = cgi;
+    it->second.expires    = ::time(0) + pTTL;
+  }
+
+  //----------------------------------------------------------------------------
+  // Forget the data server of a file
+  //----------------------------------------------------------------------------
+  void RedirectCache::Remove( const URL &url )
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    EntryMap::iterator it = pEntries.find( GetKey( url ) );
+    if( it != pEntries.end() )
+      Erase( it );
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the counters
+  //----------------------------------------------------------------------------
+  uint64_t RedirectCache::GetHits()
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    return pHits;
+  }
+
+  uint64_t RedirectCache::GetMisses()
+  {
+    XrdSysMutexHelper scopedLock( pMutex );
+    return pMisses;
+  }
+
+  //----------------------------------------------------------------------------
+  // The files are told apart by the redirector and the path, the opaque
+  // data of the user is sent along with every open anyway
+  //----------------------------------------------------------------------------
+  std::string RedirectCache::GetKey( const URL &url )
+  {
+    return url.GetHostId() + url.GetPath();
+  }
+
+  //----------------------------------------------------------------------------
+  // Remove an entry
+  //----------------------------------------------------------------------------
+  void RedirectCache::Erase( EntryMap::iterator it )
+  {
+    pLRU.erase( it->second.lru );
+    pEntries.erase( it );
+  }
+}
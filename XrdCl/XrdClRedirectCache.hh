@@ -0,0 +1,101 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+#ifndef __XRD_CL_REDIRECT_CACHE_HH__
+#define __XRD_CL_REDIRECT_CACHE_HH__
+
+#include "XrdCl/XrdClURL.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include <list>
+#include <map>
+#include <string>
+#include <time.h>
+
+namespace XrdCl
+{
+  //----------------------------------------------------------------------------
+  //! Remember the data servers the files have been opened at after being
+  //! redirected, so that the next open of the same file may skip the
+  //! redirector. The entries expire after a time to live and the least
+  //! recently used ones are dropped when the cache is full.
+  //----------------------------------------------------------------------------
+  class RedirectCache
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Constructor
+      //!
+      //! @param ttl        time to live of the entries in seconds
+      //! @param maxEntries maximum number of files remembered
+      //------------------------------------------------------------------------
+      RedirectCache( uint32_t ttl, uint32_t maxEntries );
+
+      //------------------------------------------------------------------------
+      //! Get the data server a file has been opened at
+      //!
+      //! @param url        the URL of the file at the redirector
+      //! @param dataServer the data server
+      //! @param cgi        the opaque data the redirector has sent along
+      //! @return           true if the data server is known
+      //------------------------------------------------------------------------
+      bool Get( const URL &url, URL &dataServer, std::string &cgi );
+
+      //------------------------------------------------------------------------
+      //! Remember the data server a file has been opened at
+      //------------------------------------------------------------------------
+      void Put( const URL &url, const URL &dataServer, const std::string &cgi );
+
+      //------------------------------------------------------------------------
+      //! Forget the data server of a file
+      //------------------------------------------------------------------------
+      void Remove( const URL &url );
+
+      //------------------------------------------------------------------------
+      //! Get the number of opens sent directly to a data server
+      //------------------------------------------------------------------------
+      uint64_t GetHits();
+
+      //------------------------------------------------------------------------
+      //! Get the number of opens sent to the redirector
+      //------------------------------------------------------------------------
+      uint64_t GetMisses();
+
+    private:
+      struct Entry
+      {
+        URL                              dataServer;
+        std::string                      cgi;
+        time_t                           expires;
+        std::list<std::string>::iterator lru;
+      };
+      typedef std::map<std::string, Entry> EntryMap;
+
+      static std::string GetKey( const URL &url );
+      void Erase( EntryMap::iterator it );
+
+      XrdSysMutex            pMutex;
+      EntryMap               pEntries;
+      std::list<std::string> pLRU;
+      uint32_t               pTTL;
+      uint32_t               pMaxEntries;
+      uint64_t               pHits;
+      uint64_t               pMisses;
+  };
+}
+
+#endif // __XRD_CL_REDIRECT_CACHE_HH__
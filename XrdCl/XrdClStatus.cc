@@ -54,6 +54,7 @@ namespace
     { errNotFound,           "Resource not found"   },
     { errCheckSumError,      "CheckSum error"       },
     { errRedirectLimit,      "Redirect limit has been reached" },
+    { errDataError,          "Data is corrupted or incomplete" },
     { errHandShakeFailed,    "Hand shake failed"    },
     { errLoginFailed,        "Login failed"         },
     { errAuthFailed,         "Auth failed"          },
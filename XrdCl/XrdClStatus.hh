@@ -94,6 +94,8 @@ namespace XrdCl
   const uint16_t errNotFound           = 304;
   const uint16_t errCheckSumError      = 305;
   const uint16_t errRedirectLimit      = 306;
+  const uint16_t errDataError          = 307; //!< data is corrupted or
+                                              //!< incomplete
 
   const uint16_t errErrorResponse      = 400;
 
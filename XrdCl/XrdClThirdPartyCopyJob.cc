@@ -17,6 +17,135 @@
 //------------------------------------------------------------------------------
 
 #include "XrdCl/XrdClThirdPartyCopyJob.hh"
+#include "XrdCl/XrdClConstants.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include "XrdCl/XrdClFile.hh"
+#include "XrdCl/XrdClMonitor.hh"
+#include "XrdCl/XrdClUtils.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  //! Wait for the response to the sync request that drives the transfer
+  //----------------------------------------------------------------------------
+  class TPCSyncHandler: public XrdCl::ResponseHandler
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Constructor
+      //------------------------------------------------------------------------
+      TPCSyncHandler(): pStatus( 0 ), pDone( false ) {}
+
+      //------------------------------------------------------------------------
+      //! Destructor
+      //------------------------------------------------------------------------
+      virtual ~TPCSyncHandler()
+      {
+        delete pStatus;
+      }
+
+      //------------------------------------------------------------------------
+      //! Handle the response
+      //------------------------------------------------------------------------
+      virtual void HandleResponse( XrdCl::XRootDStatus *status,
+                                   XrdCl::AnyObject    *response )
+      {
+        delete response;
+        XrdSysCondVarHelper scopedLock( pCV );
+        pStatus = status;
+        pDone   = true;
+        pCV.Broadcast();
+      }
+
+      //------------------------------------------------------------------------
+      //! Wait at most the given number of milliseconds for the response
+      //!
+      //! @return true if the response has arrived
+      //------------------------------------------------------------------------
+      bool WaitFor( int timeout )
+      {
+        XrdSysCondVarHelper scopedLock( pCV );
+        if( !pDone )
+          pCV.WaitMS( timeout );
+        return pDone;
+      }
+
+      //------------------------------------------------------------------------
+      //! Get the status of the transfer
+      //------------------------------------------------------------------------
+      XrdCl::XRootDStatus GetStatus()
+      {
+        XrdSysCondVarHelper scopedLock( pCV );
+        if( !pStatus )
+          return XrdCl::XRootDStatus( XrdCl::stError, XrdCl::errInternal );
+        return *pStatus;
+      }
+
+    private:
+      XrdCl::XRootDStatus *pStatus;
+      bool                 pDone;
+      XrdSysCondVar        pCV;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Generate a key identifying the transfer at both the data servers
+  //----------------------------------------------------------------------------
+  std::string GenerateKey()
+  {
+    static XrdSysMutex mutex;
+    static uint32_t    counter = 0;
+
+    uint32_t seq;
+    {
+      XrdSysMutexHelper scopedLock( mutex );
+      seq = ++counter;
+    }
+
+    uint64_t random = 0;
+    int fd = open( "/dev/urandom", O_RDONLY );
+    if( fd != -1 )
+    {
+      if( read( fd, &random, sizeof( random ) ) != sizeof( random ) )
+        random = 0;
+      close( fd );
+    }
+
+    timeval now;
+    gettimeofday( &now, 0 );
+
+    std::ostringstream o;
+    o << std::hex << std::setfill( '0' );
+    o << std::setw( 16 ) << random;
+    o << std::setw( 8 )  << (uint32_t)now.tv_sec;
+    o << std::setw( 5 )  << (uint32_t)now.tv_usec;
+    o << std::setw( 8 )  << (uint32_t)getpid();
+    o << std::setw( 8 )  << seq;
+    return o.str();
+  }
+
+  //----------------------------------------------------------------------------
+  //! Get the time the destination is given to complete the transfer
+  //----------------------------------------------------------------------------
+  uint16_t GetTPCTimeout()
+  {
+    int timeout = XrdCl::DefaultCPTPCTimeout;
+    XrdCl::DefaultEnv::GetEnv()->GetInt( "CPTPCTimeout", timeout );
+    if( timeout <= 0 )
+      timeout = XrdCl::DefaultCPTPCTimeout;
+    if( timeout > 65535 )
+      timeout = 65535;
+    return timeout;
+  }
+}
 
 namespace XrdCl
 {
@@ -33,8 +162,226 @@ namespace XrdCl
   //----------------------------------------------------------------------------
   // Run the copy job
   //----------------------------------------------------------------------------
-  XRootDStatus ThirdPartyCopyJob::Run( CopyProgressHandler */*progress*/ )
+  XRootDStatus ThirdPartyCopyJob::Run( CopyProgressHandler *progress )
   {
+    Log *log = DefaultEnv::GetLog();
+
+    //--------------------------------------------------------------------------
+    // Both ends need to be xrootd servers
+    //--------------------------------------------------------------------------
+    if( pSource->GetProtocol() != "root" ||
+        pDestination->GetProtocol() != "root" )
+    {
+      log->Error( UtilityMsg, "Third party copy is only supported between "
+                  "xrootd servers: %s -> %s", pSource->GetURL().c_str(),
+                  pDestination->GetURL().c_str() );
+      return XRootDStatus( stError, errNotSupported );
+    }
+
+    //--------------------------------------------------------------------------
+    // Find the data server holding the source and the size of the file
+    //--------------------------------------------------------------------------
+    log->Debug( UtilityMsg, "Locating the third party copy source %s",
+                            pSource->GetURL().c_str() );
+
+    std::string srcDataServer;
+    uint64_t    size = 0;
+    {
+      File      probe;
+      StatInfo *statInfo = 0;
+      XRootDStatus st = probe.Open( pSource->GetURL(), OpenFlags::Read );
+      if( !st.IsOK() )
+        return st;
+
+      st = probe.Stat( false, statInfo );
+      if( !st.IsOK() )
+        return st;
+
+      size = statInfo->GetSize();
+      delete statInfo;
+      srcDataServer = probe.GetDataServer();
+      probe.Close();
+    }
+
+    std::string key = GenerateKey();
+    URL         srcServerUrl( srcDataServer );
+
+    //--------------------------------------------------------------------------
+    // Open the destination, telling it where to pull the data from
+    //--------------------------------------------------------------------------
+    URL tpcTarget( *pDestination );
+    URL::ParamsMap &dstParams = tpcTarget.GetParams();
+    std::ostringstream o; o << size;
+    dstParams["oss.asize"] = o.str();
+    dstParams["tpc.key"]   = key;
+    dstParams["tpc.src"]   = srcServerUrl.GetHostId();
+    dstParams["tpc.lfn"]   = pSource->GetPath();
+    dstParams["tpc.stage"] = "copy";
+
+    uint16_t flags = OpenFlags::Update;
+    if( pForce )
+      flags |= OpenFlags::Delete;
+    else
+      flags |= OpenFlags::New;
+
+    if( pPosc )
+      flags |= OpenFlags::POSC;
+
+    log->Debug( UtilityMsg, "Opening %s as the third party copy destination",
+                            tpcTarget.GetURL().c_str() );
+
+    File dstFile;
+    XRootDStatus st = dstFile.Open( tpcTarget.GetURL(), flags,
+                                    Access::UR|Access::UW );
+    if( !st.IsOK() )
+      return st;
+
+    std::string dstDataServer = dstFile.GetDataServer();
+
+    //--------------------------------------------------------------------------
+    // Open the source at its data server with the matching key, authorizing
+    // the destination to read the file
+    //--------------------------------------------------------------------------
+    URL tpcSource( *pSource );
+    tpcSource.SetHostName( srcServerUrl.GetHostName() );
+    tpcSource.SetPort( srcServerUrl.GetPort() );
+    URL::ParamsMap &srcParams = tpcSource.GetParams();
+    srcParams["tpc.key"]   = key;
+    srcParams["tpc.dst"]   = URL( dstDataServer ).GetHostId();
+    srcParams["tpc.stage"] = "copy";
+
+    log->Debug( UtilityMsg, "Opening %s as the third party copy source",
+                            tpcSource.GetURL().c_str() );
+
+    File srcFile;
+    st = srcFile.Open( tpcSource.GetURL(), OpenFlags::Read );
+    if( !st.IsOK() )
+    {
+      dstFile.Close();
+      return st;
+    }
+
+    //--------------------------------------------------------------------------
+    // Trigger the transfer and report the progress until it's done
+    //--------------------------------------------------------------------------
+    TPCSyncHandler syncHandler;
+    st = dstFile.Sync( &syncHandler, GetTPCTimeout() );
+    if( !st.IsOK() )
+    {
+      srcFile.Close();
+      dstFile.Close();
+      return st;
+    }
+
+    log->Debug( UtilityMsg, "Third party copy of %s to %s in progress",
+                            pSource->GetURL().c_str(),
+                            pDestination->GetURL().c_str() );
+
+    while( !syncHandler.WaitFor( 1000 ) )
+    {
+      if( !progress )
+        continue;
+
+      StatInfo *statInfo = 0;
+      XRootDStatus stStat = dstFile.Stat( true, statInfo );
+      if( stStat.IsOK() )
+      {
+        uint64_t processed = statInfo->GetSize();
+        delete statInfo;
+        if( processed < size )
+          progress->JobProgress( pJobNum, processed, size );
+      }
+    }
+
+    st = syncHandler.GetStatus();
+    srcFile.Close();
+    XRootDStatus stClose = dstFile.Close();
+    if( !st.IsOK() )
+    {
+      log->Error( UtilityMsg, "Third party copy of %s to %s failed: %s",
+                  pSource->GetURL().c_str(), pDestination->GetURL().c_str(),
+                  st.ToStr().c_str() );
+      return st;
+    }
+
+    if( !stClose.IsOK() )
+      return stClose;
+
+    if( progress )
+      progress->JobProgress( pJobNum, size, size );
+
+    //--------------------------------------------------------------------------
+    // Verify the checksums if needed
+    //--------------------------------------------------------------------------
+    if( !pCheckSumType.empty() )
+    {
+      log->Debug( UtilityMsg, "Attempring checksum calculation." );
+
+      //------------------------------------------------------------------------
+      // Get the check sum at source
+      //------------------------------------------------------------------------
+      timeval oStart, oEnd;
+      std::string sourceCheckSum;
+      gettimeofday( &oStart, 0 );
+      if( !pCheckSumPreset.empty() )
+      {
+        sourceCheckSum  = pCheckSumType + ":";
+        sourceCheckSum += pCheckSumPreset;
+      }
+      else
+        st = Utils::GetRemoteCheckSum( sourceCheckSum, pCheckSumType,
+                                       srcDataServer, pSource->GetPath() );
+      gettimeofday( &oEnd, 0 );
+
+      //------------------------------------------------------------------------
+      // Print the checksum if so requested and exit
+      //------------------------------------------------------------------------
+      if( pCheckSumPrint )
+      {
+        if( sourceCheckSum.empty() ) sourceCheckSum = st.ToStr();
+        std::cerr << std::endl << "CheckSum: " << sourceCheckSum << std::endl;
+        return XRootDStatus();
+      }
+
+      if( !st.IsOK() )
+        return st;
+
+      //------------------------------------------------------------------------
+      // Get the check sum at destination
+      //------------------------------------------------------------------------
+      timeval tStart, tEnd;
+      std::string destCheckSum;
+      gettimeofday( &tStart, 0 );
+      st = Utils::GetRemoteCheckSum( destCheckSum, pCheckSumType,
+                                     dstDataServer, pDestination->GetPath() );
+      if( !st.IsOK() )
+        return st;
+      gettimeofday( &tEnd, 0 );
+
+      //------------------------------------------------------------------------
+      // Compare and inform monitoring
+      //------------------------------------------------------------------------
+      bool match = false;
+      if( sourceCheckSum == destCheckSum )
+        match = true;
+
+      Monitor *mon = DefaultEnv::GetMonitor();
+      if( mon )
+      {
+        Monitor::CheckSumInfo i;
+        i.transfer.origin = pSource;
+        i.transfer.target = pDestination;
+        i.cksum           = sourceCheckSum;
+        i.oTime           = Utils::GetElapsedMicroSecs( oStart, oEnd );
+        i.tTime           = Utils::GetElapsedMicroSecs( tStart, tEnd );
+        i.isOK            = match;
+        mon->Event( Monitor::EvCheckSum, &i );
+      }
+
+      if( !match )
+        return XRootDStatus( stError, errCheckSumError, 0 );
+    }
+
     return XRootDStatus();
   }
 }
@@ -23,6 +23,11 @@
 
 namespace XrdCl
 {
+  //----------------------------------------------------------------------------
+  //! Server-to-server copy job, the destination data server pulls the data
+  //! directly from the source data server, the client only sets up the
+  //! transfer and monitors its progress
+  //----------------------------------------------------------------------------
   class ThirdPartyCopyJob: public CopyJob
   {
     public:
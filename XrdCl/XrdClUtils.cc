@@ -21,10 +21,102 @@
 #include "XrdCl/XrdClFileSystem.hh"
 #include "XrdCl/XrdClDefaultEnv.hh"
 #include "XrdCl/XrdClConstants.hh"
+#include "XrdCl/XrdClCheckSumCalc.hh"
 #include "XrdCks/XrdCksManager.hh"
 #include "XrdCks/XrdCksCalc.hh"
 
 #include <algorithm>
+#include <memory>
+#include <sstream>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+namespace
+{
+  const uint32_t CheckSumBufferSize = 4*1024*1024;
+
+  //----------------------------------------------------------------------------
+  // Range of a file to be checksummed
+  //----------------------------------------------------------------------------
+  struct CheckSumRange
+  {
+    CheckSumRange(): fd( -1 ), offset( 0 ), length( 0 ), done( 0 ), err( 0 ),
+      calc( 0 ), running( false ) {}
+
+    //--------------------------------------------------------------------------
+    // Read the range until its end or the end of file
+    //--------------------------------------------------------------------------
+    void Run()
+    {
+      char *buffer = new char[CheckSumBufferSize];
+      while( done < length )
+      {
+        uint64_t toRead = length - done;
+        if( toRead > CheckSumBufferSize )
+          toRead = CheckSumBufferSize;
+
+        ssize_t bytesRead = pread( fd, buffer, toRead, offset + done );
+        if( bytesRead == -1 && errno == EINTR )
+          continue;
+        if( bytesRead == -1 )
+        {
+          err = errno;
+          break;
+        }
+        if( bytesRead == 0 )
+          break;
+        calc->Update( buffer, bytesRead );
+        done += bytesRead;
+      }
+      delete [] buffer;
+    }
+
+    //--------------------------------------------------------------------------
+    // Check if the range ended before its length, the last one goes up to
+    // the end of file whatever it is
+    //--------------------------------------------------------------------------
+    bool IsShort() const
+    {
+      return length != (uint64_t)-1 && done != length;
+    }
+
+    int                  fd;
+    uint64_t             offset;
+    uint64_t             length;
+    uint64_t             done;
+    int                  err;
+    XrdCl::CheckSumCalc *calc;
+    pthread_t            thread;
+    bool                 running;
+  };
+
+  void *RunCheckSumRange( void *arg )
+  {
+    ((CheckSumRange*)arg)->Run();
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  // Number of threads computing the local checksums, all the online CPUs
+  // by default
+  //----------------------------------------------------------------------------
+  uint16_t GetCheckSumThreads()
+  {
+    int threads = XrdCl::DefaultCheckSumThreads;
+    XrdCl::DefaultEnv::GetEnv()->GetInt( "CheckSumThreads", threads );
+    if( threads <= 0 )
+      threads = sysconf( _SC_NPROCESSORS_ONLN );
+    if( threads <= 0 )
+      threads = 1;
+    if( threads > 64 )
+      threads = 64;
+    return threads;
+  }
+}
 
 namespace XrdCl
 {
@@ -148,6 +240,99 @@ namespace XrdCl
     return XRootDStatus();
   }
 
+  //------------------------------------------------------------------------
+  // Feed the contents of a local file to a checksum calculator
+  //------------------------------------------------------------------------
+  XRootDStatus Utils::ComputeCheckSum( CheckSumCalc      *calc,
+                                       const std::string &path,
+                                       uint16_t           threads )
+  {
+    Log *log = DefaultEnv::GetLog();
+    int  fd  = open( path.c_str(), O_RDONLY );
+    if( fd == -1 )
+    {
+      log->Error( UtilityMsg, "Unable to open %s: %s", path.c_str(),
+                  strerror( errno ) );
+      return XRootDStatus( stError, errOSError, errno );
+    }
+
+    //--------------------------------------------------------------------------
+    // Split the file into ranges if the partial checksums can be combined,
+    // every range is worth at least a couple of reads
+    //--------------------------------------------------------------------------
+    struct stat st;
+    uint64_t    size = 0;
+    if( fstat( fd, &st ) == 0 )
+      size = st.st_size;
+
+    uint64_t ranges = size / (2*CheckSumBufferSize);
+    if( ranges > threads )
+      ranges = threads;
+    if( ranges < 2 || !calc->IsCombinable() )
+      ranges = 1;
+
+    std::vector<CheckSumRange> jobs( ranges );
+    uint64_t rangeSize = size / ranges;
+    for( uint64_t i = 0; i < ranges; ++i )
+    {
+      jobs[i].fd     = fd;
+      jobs[i].offset = i * rangeSize;
+      jobs[i].length = i == ranges-1 ? (uint64_t)-1 : rangeSize;
+      jobs[i].calc   = i == 0 ? calc : CheckSumCalc::Create( calc->GetType() );
+    }
+
+    if( ranges > 1 )
+      log->Dump( UtilityMsg, "Computing the %s checksum of %s using %d "
+                 "threads", calc->GetType().c_str(), path.c_str(), (int)ranges );
+
+    //--------------------------------------------------------------------------
+    // The first range is processed by the calling thread
+    //--------------------------------------------------------------------------
+    for( uint64_t i = 1; i < ranges; ++i )
+      jobs[i].running = pthread_create( &jobs[i].thread, 0,
+                                        RunCheckSumRange, &jobs[i] ) == 0;
+    jobs[0].Run();
+
+    int  err       = jobs[0].err;
+    bool truncated = jobs[0].IsShort();
+    for( uint64_t i = 1; i < ranges; ++i )
+    {
+      if( jobs[i].running )
+        pthread_join( jobs[i].thread, 0 );
+      else
+        jobs[i].Run();
+
+      if( !err && jobs[i].err )
+        err = jobs[i].err;
+      if( jobs[i].IsShort() )
+        truncated = true;
+      if( !err && !truncated &&
+          !calc->Combine( *jobs[i].calc, jobs[i].done ) )
+        err = EINVAL;
+      delete jobs[i].calc;
+    }
+    close( fd );
+
+    if( err )
+    {
+      log->Error( UtilityMsg, "Error while calculating checksum for %s: %s",
+                  path.c_str(), strerror( err ) );
+      return XRootDStatus( stError, errOSError, err );
+    }
+
+    //--------------------------------------------------------------------------
+    // A range cut short means the file has shrunk under us, the partial
+    // checksums glued together would not describe any version of it
+    //--------------------------------------------------------------------------
+    if( truncated )
+    {
+      log->Error( UtilityMsg, "Unable to calculate checksum for %s: the file "
+                  "has been truncated while being read", path.c_str() );
+      return XRootDStatus( stError, errDataError );
+    }
+    return XRootDStatus();
+  }
+
   //------------------------------------------------------------------------
   // Get a checksum from local file
   //------------------------------------------------------------------------
@@ -156,6 +341,24 @@ namespace XrdCl
                                         const std::string &path )
   {
     Log    *log    = DefaultEnv::GetLog();
+
+    //--------------------------------------------------------------------------
+    // The built-in types are computed here with the accelerated kernels
+    //--------------------------------------------------------------------------
+    if( CheckSumCalc::IsBuiltIn( checkSumType ) )
+    {
+      std::auto_ptr<CheckSumCalc> calc( CheckSumCalc::Create( checkSumType ) );
+      XRootDStatus st = ComputeCheckSum( calc.get(), path,
+                                         GetCheckSumThreads() );
+      if( !st.IsOK() )
+        return st;
+
+      checkSum = calc->GetCheckSum();
+      log->Dump( UtilityMsg, "Checksum for %s is: %s", path.c_str(),
+                 checkSum.c_str() );
+      return XRootDStatus();
+    }
+
     XrdCks *cksMan = DefaultEnv::GetCheckSumManager();
 
     if( !cksMan )
@@ -184,4 +387,24 @@ namespace XrdCl
 
     return XRootDStatus();
   }
+
+  //----------------------------------------------------------------------------
+  // Sum up the outcome of a batch of requests
+  //----------------------------------------------------------------------------
+  XRootDStatus Utils::GetBatchStatus( const std::vector<XRootDStatus> &results )
+  {
+    uint32_t failures = 0;
+    for( uint32_t i = 0; i < results.size(); ++i )
+      if( !results[i].IsOK() )
+        ++failures;
+
+    if( !failures )
+      return XRootDStatus();
+    if( failures == results.size() )
+      return results[0];
+
+    std::ostringstream o;
+    o << failures << " of " << results.size() << " requests failed";
+    return XRootDStatus( stOK, suPartial, 0, o.str() );
+  }
 }
@@ -31,6 +31,8 @@
 
 namespace XrdCl
 {
+  class CheckSumCalc;
+
   //----------------------------------------------------------------------------
   //! Random utilities
   //----------------------------------------------------------------------------
@@ -104,6 +106,28 @@ namespace XrdCl
       static XRootDStatus GetLocalCheckSum( std::string       &checkSum,
                                             const std::string &checkSumType,
                                             const std::string &path );
+
+      //------------------------------------------------------------------------
+      //! Feed the contents of a local file to a checksum calculator
+      //!
+      //! @param calc    the calculator
+      //! @param path    path to the file
+      //! @param threads if the checksum is combinable, the file is split
+      //!                into up to this many ranges processed in parallel
+      //------------------------------------------------------------------------
+      static XRootDStatus ComputeCheckSum( CheckSumCalc      *calc,
+                                           const std::string &path,
+                                           uint16_t           threads = 1 );
+
+      //------------------------------------------------------------------------
+      //! Sum up the outcome of a batch of requests
+      //!
+      //! @param results the statuses of the requests
+      //! @return        OK if all of them succeeded, the first error if all
+      //!                of them failed and suPartial otherwise
+      //------------------------------------------------------------------------
+      static XRootDStatus GetBatchStatus(
+                            const std::vector<XRootDStatus> &results );
   };
 
   //----------------------------------------------------------------------------
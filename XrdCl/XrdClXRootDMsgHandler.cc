@@ -32,6 +32,7 @@
 #include "XrdSys/XrdSysPlatform.hh" // same as above
 #include <memory>
 #include <sstream>
+#include <algorithm>
 
 namespace
 {
@@ -273,6 +274,8 @@ namespace XrdCl
         // Send the request to the new location
         //----------------------------------------------------------------------
         pHosts->push_back( pUrl );
+        if( urlComponents.size() > 1 )
+          pHosts->back().cgi = urlComponents[1];
         HandleError( RetryAtServer(pUrl) );
         return Take | RemoveHandler;
       }
@@ -333,6 +336,20 @@ namespace XrdCl
         log->Dump( XRootDMsg, "[%s] Got a kXR_oksofar response to request "
                    "%s", pUrl.GetHostId().c_str(),
                    pRequest->GetDescription().c_str() );
+
+        //----------------------------------------------------------------------
+        // The listing is handed out as it comes, the request is still
+        // marshalled here
+        //----------------------------------------------------------------------
+        if( pDirListHandler )
+        {
+          if( pDirListParent.empty() )
+            pDirListParent.assign( pRequest->GetBuffer( 24 ),
+                                   ntohl( req->header.dlen ) );
+          HandleDirListPart( rsp->body.buffer.data, rsp->hdr.dlen, false );
+          return Take;
+        }
+
         pPartialResps.push_back( msgPtr.release() );
         return Take;
       }
@@ -651,6 +668,20 @@ namespace XrdCl
         char *path = new char[req->dirlist.dlen+1];
         path[req->dirlist.dlen] = 0;
         memcpy( path, pRequest->GetBuffer(24), req->dirlist.dlen );
+
+        //----------------------------------------------------------------------
+        // The last batch of a listing handed out as it comes
+        //----------------------------------------------------------------------
+        if( pDirListHandler )
+        {
+          if( pDirListParent.empty() )
+            pDirListParent = path;
+          delete [] path;
+          delete obj;
+          HandleDirListPart( buffer, length, true );
+          return Status();
+        }
+
         DirectoryList *data = new DirectoryList( pUrl.GetHostId(), path,
                                                  length ? buffer : 0 );
         delete [] path;
@@ -942,6 +973,20 @@ namespace XrdCl
                 pUrl.GetHostId().c_str(), pRequest->GetDescription().c_str(),
                 status.ToString().c_str() );
 
+    //--------------------------------------------------------------------------
+    // The entries handed out already can't be taken back, so a listing
+    // that has started streaming can't be retried
+    //--------------------------------------------------------------------------
+    if( pDirListDelivered )
+    {
+      log->Error( XRootDMsg, "[%s] Unable to retry %s, a part of the listing "
+                  "has been handed out already", pUrl.GetHostId().c_str(),
+                  pRequest->GetDescription().c_str() );
+      pStatus = status;
+      HandleResponse();
+      return;
+    }
+
     //--------------------------------------------------------------------------
     // We have got an error message, we can recover it at the load balancer if:
     // 1) we haven't got it from the load balancer
@@ -1019,11 +1064,98 @@ namespace XrdCl
   //----------------------------------------------------------------------------
   Status XRootDMsgHandler::RetryAtServer( const URL &url )
   {
+    //--------------------------------------------------------------------------
+    // The listing starts over, nothing of it has been handed out yet
+    //--------------------------------------------------------------------------
+    if( pDirListDelivered )
+      return Status( stFatal, errDataError );
+    pDirListParent.clear();
+    pDirListPending.clear();
+    pDirListStarted = false;
+    pDirListStat    = false;
+
     pUrl = url;
     pHosts->push_back( pUrl );
     return pPostMaster->Send( pUrl, pRequest, this, true, pExpiration );
   }
 
+  //----------------------------------------------------------------------------
+  // Hand out the complete entries of a part of a directory listing
+  //----------------------------------------------------------------------------
+  void XRootDMsgHandler::HandleDirListPart( const char *data,
+                                            uint32_t    length,
+                                            bool        final )
+  {
+    while( length && !data[length-1] )
+      --length;
+    pDirListPending.append( data, length );
+
+    //--------------------------------------------------------------------------
+    // With the stat option the first part starts with a dummy entry and
+    // the names and the stat infos alternate
+    //--------------------------------------------------------------------------
+    static const std::string statLead = ".\n0 0 0 0";
+    if( !pDirListStarted )
+    {
+      if( !final && pDirListPending.length() <= statLead.length() &&
+          statLead.compare( 0, pDirListPending.length(),
+                            pDirListPending ) == 0 )
+        return;
+
+      pDirListStarted = true;
+      if( pDirListPending.compare( 0, statLead.length(), statLead ) == 0 &&
+          ( pDirListPending.length() == statLead.length() ||
+            pDirListPending[statLead.length()] == '\n' ) )
+      {
+        pDirListStat = true;
+        pDirListPending.erase( 0, statLead.length()+1 );
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    // Cut the complete entries, a name without its stat info waits
+    // for the next part
+    //--------------------------------------------------------------------------
+    size_t end = pDirListPending.length();
+    if( !final )
+    {
+      end = pDirListPending.rfind( '\n' );
+      end = end == std::string::npos ? 0 : end+1;
+      if( pDirListStat && end &&
+          std::count( pDirListPending.begin(),
+                      pDirListPending.begin()+end, '\n' ) % 2 )
+      {
+        size_t prev = end > 1 ? pDirListPending.rfind( '\n', end-2 ) :
+                                std::string::npos;
+        end = prev == std::string::npos ? 0 : prev+1;
+      }
+    }
+
+    if( !end )
+      return;
+
+    std::string batch;
+    if( pDirListStat )
+      batch = statLead + "\n";
+    batch.append( pDirListPending, 0, end );
+    pDirListPending.erase( 0, end );
+
+    DirectoryList *list = new DirectoryList( pUrl.GetHostId(), pDirListParent,
+                                             batch.c_str() );
+    if( !list->GetSize() )
+    {
+      delete list;
+      return;
+    }
+
+    Log *log = DefaultEnv::GetLog();
+    log->Dump( XRootDMsg, "[%s] Handing out %d entries of %s",
+               pUrl.GetHostId().c_str(), list->GetSize(),
+               pDirListParent.c_str() );
+    pDirListDelivered = true;
+    pDirListHandler->HandleEntries( list );
+  }
+
   //----------------------------------------------------------------------------
   // Update the "tried=" part of the CGI of the current message
   //----------------------------------------------------------------------------
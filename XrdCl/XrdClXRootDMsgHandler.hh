@@ -62,7 +62,11 @@ namespace XrdCl
         pHasLoadBalancer( false ),
         pHasSessionId( false ),
         pChunkList( 0 ),
-        pRedirectCounter( 0 )
+        pRedirectCounter( 0 ),
+        pDirListHandler( 0 ),
+        pDirListStarted( false ),
+        pDirListStat( false ),
+        pDirListDelivered( false )
       {
         pPostMaster = DefaultEnv::GetPostMaster();
         if( msg->GetSessionId() )
@@ -177,6 +181,15 @@ namespace XrdCl
         pRedirectCounter = redirectCounter;
       }
 
+      //------------------------------------------------------------------------
+      //! Hand out the entries of a directory listing to the given handler
+      //! as the parts of the response arrive
+      //------------------------------------------------------------------------
+      void SetDirListHandler( DirListHandler *dirListHandler )
+      {
+        pDirListHandler = dirListHandler;
+      }
+
     private:
       //------------------------------------------------------------------------
       //! Recover error
@@ -223,6 +236,12 @@ namespace XrdCl
                                char           *sourceBuffer,
                                uint32_t        sourceBufferSize );
 
+      //------------------------------------------------------------------------
+      //! Hand out the complete entries of a part of a directory listing,
+      //! the incomplete ones wait for the next part
+      //------------------------------------------------------------------------
+      void HandleDirListPart( const char *data, uint32_t length, bool final );
+
       //------------------------------------------------------------------------
       //! Update the "tried=" part of the CGI of the current message
       //------------------------------------------------------------------------
@@ -250,6 +269,12 @@ namespace XrdCl
       std::string                pRedirectCgi;
       ChunkList                 *pChunkList;
       uint16_t                   pRedirectCounter;
+      DirListHandler            *pDirListHandler;
+      std::string                pDirListParent;
+      std::string                pDirListPending;
+      bool                       pDirListStarted;
+      bool                       pDirListStat;
+      bool                       pDirListDelivered;
   };
 }
 
@@ -22,6 +22,57 @@
 #include "XrdCl/XrdClConstants.hh"
 #include "XrdCl/XrdClUtils.hh"
 #include <cstdlib>
+#include <cstring>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Get the next non-empty line of a server response
+  //----------------------------------------------------------------------------
+  bool NextLine( const char *&cursor, const char *&line, uint32_t &length )
+  {
+    while( *cursor == '\n' )
+      ++cursor;
+    if( !*cursor )
+      return false;
+
+    line = cursor;
+    while( *cursor && *cursor != '\n' )
+      ++cursor;
+    length = cursor - line;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Parse the "id size flags mtime" stat info, the fields that cannot be
+  // parsed are zero
+  //----------------------------------------------------------------------------
+  void ParseStat( const char *line, uint32_t length, uint64_t &size,
+                  uint32_t &flags, uint64_t &modTime )
+  {
+    //--------------------------------------------------------------------------
+    // The first field is the id, the numbers follow; the line is followed
+    // by a new line or the end of the response so strtoll stops there
+    //--------------------------------------------------------------------------
+    uint64_t    fields[3] = { 0, 0, 0 };
+    const char *end       = line + length;
+    const char *cursor    = (const char *)memchr( line, ' ', length );
+    for( int i = 0; cursor && cursor < end && i < 3; ++i )
+    {
+      char *next = 0;
+      fields[i] = ::strtoll( cursor, &next, 0 );
+      if( next == cursor || next > end )
+      {
+        fields[i] = 0;
+        break;
+      }
+      cursor = next;
+    }
+    size    = fields[0];
+    flags   = fields[1];
+    modTime = fields[2];
+  }
+}
 
 namespace XrdCl
 {
@@ -247,11 +298,197 @@ namespace XrdCl
   void DirectoryList::ParseServerResponse( const std::string &hostId,
                                            const char *data )
   {
-    std::vector<std::string>           entries;
-    std::vector<std::string>::iterator it;
+    std::vector<std::string> entries;
     Utils::splitString( entries, data, "\n" );
 
+    //--------------------------------------------------------------------------
+    // The response to a dirlist with the stat option starts with a dummy
+    // "." entry and each name is followed by its stat info
+    //--------------------------------------------------------------------------
+    if( entries.size() >= 2 && entries[0] == "." && entries[1] == "0 0 0 0" )
+    {
+      for( uint32_t i = 2; i+1 < entries.size(); i += 2 )
+        Add( new ListEntry( hostId, entries[i],
+                            new StatInfo( entries[i+1].c_str() ) ) );
+      return;
+    }
+
+    std::vector<std::string>::iterator it;
     for( it = entries.begin(); it != entries.end(); ++it )
       Add( new ListEntry( hostId, *it ) );
   }
+
+  //----------------------------------------------------------------------------
+  // CompactDirectoryList constructor
+  //----------------------------------------------------------------------------
+  CompactDirectoryList::CompactDirectoryList( const std::string &hostId,
+                                              const std::string &parent,
+                                              const char        *data )
+  {
+    pParent = parent;
+    if( pParent.empty() || pParent[pParent.length()-1] != '/' )
+      pParent += "/";
+    pNameOffsets.push_back( 0 );
+
+    if( data )
+      ParseServerResponse( hostId, data );
+  }
+
+  //----------------------------------------------------------------------------
+  // Reserve the space for the entries
+  //----------------------------------------------------------------------------
+  void CompactDirectoryList::Reserve( uint32_t entries, uint64_t nameBytes )
+  {
+    pNames.reserve( nameBytes + entries );
+    pNameOffsets.reserve( entries + 1 );
+    pHostIndex.reserve( entries );
+    pSizes.reserve( entries );
+    pModTimes.reserve( entries );
+    pFlags.reserve( entries );
+    pHasStat.reserve( entries );
+  }
+
+  //----------------------------------------------------------------------------
+  // Add an entry
+  //----------------------------------------------------------------------------
+  void CompactDirectoryList::Add( const std::string &hostAddress,
+                                  const std::string &name,
+                                  const StatInfo    *statInfo )
+  {
+    AddName( name.c_str(), name.length(), InternHost( hostAddress ) );
+    if( statInfo )
+      SetStatInfo( GetSize()-1, *statInfo );
+  }
+
+  //----------------------------------------------------------------------------
+  // Add all the entries of a directory list
+  //----------------------------------------------------------------------------
+  void CompactDirectoryList::Append( const DirectoryList &list )
+  {
+    DirectoryList::ConstIterator it;
+    for( it = list.Begin(); it != list.End(); ++it )
+      if( *it )
+        Add( (*it)->GetHostAddress(), (*it)->GetName(),
+             (*it)->GetStatInfo() );
+  }
+
+  //----------------------------------------------------------------------------
+  // Set the stat info of an entry
+  //----------------------------------------------------------------------------
+  void CompactDirectoryList::SetStatInfo( uint32_t        index,
+                                          const StatInfo &info )
+  {
+    pSizes[index]    = info.GetSize();
+    pFlags[index]    = info.GetFlags();
+    pModTimes[index] = info.GetModTime();
+    pHasStat[index]  = 1;
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the number of bytes allocated for the entries
+  //----------------------------------------------------------------------------
+  uint64_t CompactDirectoryList::GetMemoryUsage() const
+  {
+    uint64_t usage = pNames.capacity();
+    usage += pNameOffsets.capacity() * sizeof( uint64_t );
+    usage += pHostIndex.capacity()   * sizeof( uint32_t );
+    usage += pSizes.capacity()       * sizeof( uint64_t );
+    usage += pModTimes.capacity()    * sizeof( uint64_t );
+    usage += pFlags.capacity()       * sizeof( uint32_t );
+    usage += pHasStat.capacity()     * sizeof( uint8_t );
+    for( uint32_t i = 0; i < pHosts.size(); ++i )
+      usage += sizeof( std::string ) + pHosts[i].capacity();
+    return usage;
+  }
+
+  //----------------------------------------------------------------------------
+  // Parse the directory list
+  //----------------------------------------------------------------------------
+  void CompactDirectoryList::ParseServerResponse( const std::string &hostId,
+                                                  const char        *data )
+  {
+    uint32_t    host   = InternHost( hostId );
+    const char *cursor = data;
+    const char *line   = 0;
+    uint32_t    length = 0;
+
+    //--------------------------------------------------------------------------
+    // The response to a dirlist with the stat option starts with a dummy
+    // "." entry and each name is followed by its stat info
+    //--------------------------------------------------------------------------
+    bool withStat = false;
+    const char *start = cursor;
+    if( NextLine( cursor, line, length ) && length == 1 && *line == '.' &&
+        NextLine( cursor, line, length ) && length == 7 &&
+        !strncmp( line, "0 0 0 0", 7 ) )
+      withStat = true;
+    else
+      cursor = start;
+
+    //--------------------------------------------------------------------------
+    // Size the arrays up front, huge listings would otherwise be copied
+    // over many times while growing
+    //--------------------------------------------------------------------------
+    uint32_t    lines = 1;
+    const char *end   = cursor;
+    for( ; *end; ++end )
+      if( *end == '\n' )
+        ++lines;
+    if( withStat )
+      Reserve( GetSize() + lines/2, 0 );
+    else
+      Reserve( GetSize() + lines, pNames.size() + (end - cursor) );
+
+    while( NextLine( cursor, line, length ) )
+    {
+      if( !withStat )
+      {
+        AddName( line, length, host );
+        continue;
+      }
+
+      const char *name       = line;
+      uint32_t    nameLength = length;
+      if( !NextLine( cursor, line, length ) )
+        break;
+      AddName( name, nameLength, host );
+      uint32_t index = GetSize()-1;
+      ParseStat( line, length, pSizes[index], pFlags[index],
+                 pModTimes[index] );
+      pHasStat[index] = 1;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Get the index of a host address, the consecutive entries usually
+  // come from the same host
+  //----------------------------------------------------------------------------
+  uint32_t CompactDirectoryList::InternHost( const std::string &hostAddress )
+  {
+    if( !pHostIndex.empty() && pHosts[pHostIndex.back()] == hostAddress )
+      return pHostIndex.back();
+
+    for( uint32_t i = 0; i < pHosts.size(); ++i )
+      if( pHosts[i] == hostAddress )
+        return i;
+
+    pHosts.push_back( hostAddress );
+    return pHosts.size()-1;
+  }
+
+  //----------------------------------------------------------------------------
+  // Add an entry without the stat info
+  //----------------------------------------------------------------------------
+  void CompactDirectoryList::AddName( const char *name, uint32_t length,
+                                      uint32_t host )
+  {
+    pNames.append( name, length );
+    pNames.push_back( 0 );
+    pNameOffsets.push_back( pNames.size() );
+    pHostIndex.push_back( host );
+    pSizes.push_back( 0 );
+    pModTimes.push_back( 0 );
+    pFlags.push_back( 0 );
+    pHasStat.push_back( 0 );
+  }
 }
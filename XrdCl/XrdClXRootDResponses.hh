@@ -666,6 +666,242 @@ namespace XrdCl
       std::string pParent;
   };
 
+  //----------------------------------------------------------------------------
+  //! Directory list stored compactly for huge listings: the names share
+  //! a single buffer, the host addresses are stored once per server and
+  //! the stat info of the entries lives in parallel arrays. The stat info
+  //! keeps the size, the flags and the modification time, not the id.
+  //----------------------------------------------------------------------------
+  class CompactDirectoryList
+  {
+    public:
+      class ConstIterator;
+
+      //------------------------------------------------------------------------
+      //! View of an entry, valid as long as the list is not modified
+      //------------------------------------------------------------------------
+      class Entry
+      {
+        public:
+          //--------------------------------------------------------------------
+          //! Constructor
+          //--------------------------------------------------------------------
+          Entry( const CompactDirectoryList *list, uint32_t index ):
+            pList( list ), pIndex( index ) {}
+
+          //--------------------------------------------------------------------
+          //! Get host address
+          //--------------------------------------------------------------------
+          const std::string &GetHostAddress() const
+          {
+            return pList->pHosts[pList->pHostIndex[pIndex]];
+          }
+
+          //--------------------------------------------------------------------
+          //! Get file name, null terminated
+          //--------------------------------------------------------------------
+          const char *GetName() const
+          {
+            return pList->pNames.data() + pList->pNameOffsets[pIndex];
+          }
+
+          //--------------------------------------------------------------------
+          //! Get the length of the file name
+          //--------------------------------------------------------------------
+          uint32_t GetNameLength() const
+          {
+            return pList->pNameOffsets[pIndex+1] -
+                   pList->pNameOffsets[pIndex] - 1;
+          }
+
+          //--------------------------------------------------------------------
+          //! Check if the stat info is available
+          //--------------------------------------------------------------------
+          bool HasStatInfo() const
+          {
+            return pList->pHasStat[pIndex];
+          }
+
+          //--------------------------------------------------------------------
+          //! Get size (in bytes)
+          //--------------------------------------------------------------------
+          uint64_t GetSize() const
+          {
+            return pList->pSizes[pIndex];
+          }
+
+          //--------------------------------------------------------------------
+          //! Get flags
+          //--------------------------------------------------------------------
+          uint32_t GetFlags() const
+          {
+            return pList->pFlags[pIndex];
+          }
+
+          //--------------------------------------------------------------------
+          //! Test flags
+          //--------------------------------------------------------------------
+          bool TestFlags( uint32_t flags ) const
+          {
+            return pList->pFlags[pIndex] & flags;
+          }
+
+          //--------------------------------------------------------------------
+          //! Get modification time (in seconds since epoch)
+          //--------------------------------------------------------------------
+          uint64_t GetModTime() const
+          {
+            return pList->pModTimes[pIndex];
+          }
+
+          //--------------------------------------------------------------------
+          //! Get the index of the entry in the list
+          //--------------------------------------------------------------------
+          uint32_t GetIndex() const
+          {
+            return pIndex;
+          }
+
+        private:
+          friend class ConstIterator;
+          const CompactDirectoryList *pList;
+          uint32_t                    pIndex;
+      };
+
+      //------------------------------------------------------------------------
+      //! Iterator over the entries
+      //------------------------------------------------------------------------
+      class ConstIterator
+      {
+        public:
+          //--------------------------------------------------------------------
+          //! Constructor
+          //--------------------------------------------------------------------
+          ConstIterator( const CompactDirectoryList *list, uint32_t index ):
+            pEntry( list, index ) {}
+
+          const Entry &operator*() const  { return pEntry; }
+          const Entry *operator->() const { return &pEntry; }
+
+          ConstIterator &operator++()
+          {
+            ++pEntry.pIndex;
+            return *this;
+          }
+
+          bool operator==( const ConstIterator &other ) const
+          {
+            return pEntry.pIndex == other.pEntry.pIndex;
+          }
+
+          bool operator!=( const ConstIterator &other ) const
+          {
+            return pEntry.pIndex != other.pEntry.pIndex;
+          }
+
+        private:
+          Entry pEntry;
+      };
+
+      //------------------------------------------------------------------------
+      //! Constructor
+      //!
+      //! @param hostId the server that sent the listing
+      //! @param parent the directory
+      //! @param data   the dirlist response of the server, may be 0
+      //------------------------------------------------------------------------
+      CompactDirectoryList( const std::string &hostId,
+                            const std::string &parent,
+                            const char        *data = 0 );
+
+      //------------------------------------------------------------------------
+      //! Reserve the space for the given number of entries and bytes of
+      //! the names
+      //------------------------------------------------------------------------
+      void Reserve( uint32_t entries, uint64_t nameBytes );
+
+      //------------------------------------------------------------------------
+      //! Add an entry
+      //------------------------------------------------------------------------
+      void Add( const std::string &hostAddress,
+                const std::string &name,
+                const StatInfo    *statInfo = 0 );
+
+      //------------------------------------------------------------------------
+      //! Add all the entries of a directory list
+      //------------------------------------------------------------------------
+      void Append( const DirectoryList &list );
+
+      //------------------------------------------------------------------------
+      //! Set the stat info of an entry, the entries may be updated from
+      //! different threads as long as the list is not being extended
+      //------------------------------------------------------------------------
+      void SetStatInfo( uint32_t index, const StatInfo &info );
+
+      //------------------------------------------------------------------------
+      //! Get an entry at given index
+      //------------------------------------------------------------------------
+      Entry At( uint32_t index ) const
+      {
+        return Entry( this, index );
+      }
+
+      //------------------------------------------------------------------------
+      //! Get the begin iterator
+      //------------------------------------------------------------------------
+      ConstIterator Begin() const
+      {
+        return ConstIterator( this, 0 );
+      }
+
+      //------------------------------------------------------------------------
+      //! Get the end iterator
+      //------------------------------------------------------------------------
+      ConstIterator End() const
+      {
+        return ConstIterator( this, GetSize() );
+      }
+
+      //------------------------------------------------------------------------
+      //! Get the size of the listing
+      //------------------------------------------------------------------------
+      uint32_t GetSize() const
+      {
+        return pHostIndex.size();
+      }
+
+      //------------------------------------------------------------------------
+      //! Get parent directory name
+      //------------------------------------------------------------------------
+      const std::string &GetParentName() const
+      {
+        return pParent;
+      }
+
+      //------------------------------------------------------------------------
+      //! Get the number of bytes allocated for the entries
+      //------------------------------------------------------------------------
+      uint64_t GetMemoryUsage() const;
+
+    private:
+      friend class Entry;
+      void     ParseServerResponse( const std::string &hostId,
+                                    const char        *data );
+      uint32_t InternHost( const std::string &hostAddress );
+      void     AddName( const char *name, uint32_t length,
+                        uint32_t host );
+
+      std::string              pParent;
+      std::string              pNames;
+      std::vector<uint64_t>    pNameOffsets;
+      std::vector<std::string> pHosts;
+      std::vector<uint32_t>    pHostIndex;
+      std::vector<uint64_t>    pSizes;
+      std::vector<uint64_t>    pModTimes;
+      std::vector<uint32_t>    pFlags;
+      std::vector<uint8_t>     pHasStat;
+  };
+
   //----------------------------------------------------------------------------
   //! Information returned by file open operation
   //----------------------------------------------------------------------------
@@ -799,10 +1035,11 @@ namespace XrdCl
       flags(0), protocol(0), loadBalancer(false) {}
     HostInfo( const URL &u, bool lb = false ):
       flags(0), protocol(0), loadBalancer(lb), url(u) {}
-    uint32_t flags;        //!< Host type
-    uint32_t protocol;     //!< Version of the protocol the host is speaking
-    bool     loadBalancer; //!< Was the host used as a load balancer
-    URL      url;          //!< URL of the host
+    uint32_t    flags;        //!< Host type
+    uint32_t    protocol;     //!< Version of the protocol the host is speaking
+    bool        loadBalancer; //!< Was the host used as a load balancer
+    URL         url;          //!< URL of the host
+    std::string cgi;          //!< Opaque data the host was redirected to with
   };
 
   typedef std::vector<HostInfo> HostList;
@@ -861,6 +1098,23 @@ namespace XrdCl
       virtual void HandleResponse( XRootDStatus *status,
                                    AnyObject    *response ) {}
   };
+
+  //----------------------------------------------------------------------------
+  //! Handle a directory listing in batches of entries, as the parts of
+  //! the response arrive. The batches are delivered in order and never
+  //! concurrently, the final response comes last and carries no response
+  //! object.
+  //----------------------------------------------------------------------------
+  class DirListHandler: public ResponseHandler
+  {
+    public:
+      //------------------------------------------------------------------------
+      //! Called when a batch of entries arrives
+      //!
+      //! @param entries the entries (to be deleted by the user)
+      //------------------------------------------------------------------------
+      virtual void HandleEntries( DirectoryList *entries ) = 0;
+  };
 }
 
 #endif // __XRD_CL_XROOTD_RESPONSES_HH__
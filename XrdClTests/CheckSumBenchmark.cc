@@ -0,0 +1,100 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+
+#include "XrdCl/XrdClCheckSumCalc.hh"
+#include "XrdCl/XrdClUtils.hh"
+
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <cstdlib>
+#include <sys/time.h>
+
+//------------------------------------------------------------------------------
+// Measure the throughput of a checksum calculator in MB/s, negative if
+// the checksum type is not supported
+//------------------------------------------------------------------------------
+double Measure( const std::string &type, bool accelerated,
+                const char *buffer, uint32_t size, int iterations )
+{
+  std::auto_ptr<XrdCl::CheckSumCalc> calc(
+    XrdCl::CheckSumCalc::Create( type, accelerated ) );
+  if( !calc.get() )
+    return -1;
+
+  timeval start, end;
+  gettimeofday( &start, 0 );
+  for( int i = 0; i < iterations; ++i )
+    calc->Update( buffer, size );
+  calc->GetCheckSum();
+  gettimeofday( &end, 0 );
+
+  uint64_t usecs = XrdCl::Utils::GetElapsedMicroSecs( start, end );
+  if( !usecs )
+    usecs = 1;
+  return (double)size * iterations / usecs;
+}
+
+//------------------------------------------------------------------------------
+// Start the show
+//------------------------------------------------------------------------------
+int main( int argc, char **argv )
+{
+  uint32_t size       = 64;
+  int      iterations = 16;
+  if( argc > 1 ) size       = atoi( argv[1] );
+  if( argc > 2 ) iterations = atoi( argv[2] );
+  if( !size || iterations <= 0 )
+  {
+    std::cerr << "Usage: " << argv[0] << " [buffer size in MB] ";
+    std::cerr << "[iterations]" << std::endl;
+    return 1;
+  }
+  size *= 1024*1024;
+
+  char *buffer = new char[size];
+  for( uint32_t i = 0; i < size; ++i )
+    buffer[i] = random();
+
+  std::string acc = XrdCl::CheckSumCalc::GetAcceleration();
+  std::cout << "CPU extensions: " << (acc.empty() ? "none" : acc);
+  std::cout << std::endl;
+  std::cout << std::setw(10) << "type";
+  std::cout << std::setw(16) << "portable MB/s";
+  std::cout << std::setw(16) << "accel MB/s" << std::endl;
+
+  const char *types[] = { "adler32", "crc32", "zcrc32", "crc32c", "md5" };
+  for( int i = 0; i < 5; ++i )
+  {
+    double portable    = Measure( types[i], false, buffer, size, iterations );
+    double accelerated = Measure( types[i], true,  buffer, size, iterations );
+    std::cout << std::setw(10) << types[i] << std::fixed;
+    std::cout << std::setprecision(1);
+    if( portable < 0 )
+    {
+      std::cout << std::setw(32) << "not supported" << std::endl;
+      continue;
+    }
+    std::cout << std::setw(16) << portable;
+    std::cout << std::setw(16) << accelerated << std::endl;
+  }
+
+  delete [] buffer;
+  return 0;
+}
@@ -0,0 +1,198 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+#include "XrdCl/XrdClXRootDResponses.hh"
+#include "XrdCl/XrdClUtils.hh"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstdlib>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/time.h>
+
+//------------------------------------------------------------------------------
+// Build a dirlist response of the given number of entries, with the stat
+// info if requested
+//------------------------------------------------------------------------------
+std::string BuildResponse( uint32_t entries, bool stat )
+{
+  std::ostringstream o;
+  if( stat )
+    o << ".\n0 0 0 0\n";
+  for( uint32_t i = 0; i < entries; ++i )
+  {
+    o << "file-" << std::setw(8) << std::setfill('0') << i << ".root\n";
+    if( stat )
+      o << "id" << i << " " << (uint64_t)i*1024 << " 16 1356000000\n";
+  }
+  std::string response = o.str();
+  response.resize( response.size()-1 );
+  return response;
+}
+
+//------------------------------------------------------------------------------
+// Get the resident set size of the process in bytes
+//------------------------------------------------------------------------------
+uint64_t GetResidentSize()
+{
+  FILE *f = fopen( "/proc/self/statm", "r" );
+  if( !f )
+    return 0;
+  unsigned long size = 0, resident = 0;
+  if( fscanf( f, "%lu %lu", &size, &resident ) != 2 )
+    resident = 0;
+  fclose( f );
+  return (uint64_t)resident * sysconf( _SC_PAGESIZE );
+}
+
+//------------------------------------------------------------------------------
+// Results of a run
+//------------------------------------------------------------------------------
+struct Result
+{
+  Result(): parseTime( 0 ), iterateTime( 0 ), memory( 0 ), checkSum( 0 ) {}
+  double   parseTime;
+  double   iterateTime;
+  uint64_t memory;
+  uint64_t checkSum;
+};
+
+//------------------------------------------------------------------------------
+// Get the elapsed time in seconds
+//------------------------------------------------------------------------------
+double Elapsed( const timeval &start, const timeval &end )
+{
+  return XrdCl::Utils::GetElapsedMicroSecs( start, end ) / 1000000.0;
+}
+
+//------------------------------------------------------------------------------
+// Parse and walk the response using the regular directory list
+//------------------------------------------------------------------------------
+Result MeasureRegular( const std::string &response )
+{
+  using namespace XrdCl;
+  Result   result;
+  timeval  start, parsed, end;
+  uint64_t before = GetResidentSize();
+
+  gettimeofday( &start, 0 );
+  DirectoryList *list = new DirectoryList( "localhost:1094", "/data",
+                                           response.c_str() );
+  gettimeofday( &parsed, 0 );
+  result.memory = GetResidentSize() - before;
+
+  DirectoryList::Iterator it;
+  for( it = list->Begin(); it != list->End(); ++it )
+  {
+    result.checkSum += (*it)->GetName().length();
+    if( (*it)->GetStatInfo() )
+      result.checkSum += (*it)->GetStatInfo()->GetSize();
+  }
+  gettimeofday( &end, 0 );
+  delete list;
+
+  result.parseTime   = Elapsed( start, parsed );
+  result.iterateTime = Elapsed( parsed, end );
+  return result;
+}
+
+//------------------------------------------------------------------------------
+// Parse and walk the response using the compact directory list
+//------------------------------------------------------------------------------
+Result MeasureCompact( const std::string &response )
+{
+  using namespace XrdCl;
+  Result   result;
+  timeval  start, parsed, end;
+  uint64_t before = GetResidentSize();
+
+  gettimeofday( &start, 0 );
+  CompactDirectoryList *list = new CompactDirectoryList( "localhost:1094",
+                                                         "/data",
+                                                         response.c_str() );
+  gettimeofday( &parsed, 0 );
+  result.memory = GetResidentSize() - before;
+
+  CompactDirectoryList::ConstIterator it   = list->Begin();
+  CompactDirectoryList::ConstIterator last = list->End();
+  for( ; it != last; ++it )
+  {
+    result.checkSum += it->GetNameLength();
+    if( it->HasStatInfo() )
+      result.checkSum += it->GetSize();
+  }
+  gettimeofday( &end, 0 );
+  delete list;
+
+  result.parseTime   = Elapsed( start, parsed );
+  result.iterateTime = Elapsed( parsed, end );
+  return result;
+}
+
+//------------------------------------------------------------------------------
+// Print the results
+//------------------------------------------------------------------------------
+void Print( const std::string &name, const Result &result )
+{
+  std::cout << std::setw(16) << name << std::fixed << std::setprecision(3);
+  std::cout << std::setw(12) << result.parseTime;
+  std::cout << std::setw(12) << result.iterateTime;
+  std::cout << std::setprecision(1);
+  std::cout << std::setw(12) << result.memory / (1024.0*1024.0);
+  std::cout << std::endl;
+}
+
+//------------------------------------------------------------------------------
+// Start the show
+//------------------------------------------------------------------------------
+int main( int argc, char **argv )
+{
+  uint32_t entries = 1000000;
+  if( argc > 1 ) entries = atoi( argv[1] );
+  if( !entries )
+  {
+    std::cerr << "Usage: " << argv[0] << " [number of entries]";
+    std::cerr << std::endl;
+    return 1;
+  }
+
+  //----------------------------------------------------------------------------
+  // The compact list runs first for every kind of response so that it
+  // does not reuse the memory freed by the regular list
+  //----------------------------------------------------------------------------
+  std::cout << std::setw(16) << "list" << std::setw(12) << "parse s";
+  std::cout << std::setw(12) << "iterate s" << std::setw(12) << "RSS MB";
+  std::cout << std::endl;
+  for( int stat = 0; stat < 2; ++stat )
+  {
+    std::string response = BuildResponse( entries, stat );
+    Result      compact  = MeasureCompact( response );
+    Result      regular  = MeasureRegular( response );
+    std::string suffix   = stat ? "+stat" : "";
+    Print( "compact" + suffix, compact );
+    Print( "regular" + suffix, regular );
+    if( compact.checkSum != regular.checkSum )
+    {
+      std::cerr << "The lists differ" << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
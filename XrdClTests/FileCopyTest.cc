@@ -21,6 +21,7 @@
 #include "CppUnitXrdHelpers.hh"
 #include "XrdCl/XrdClFile.hh"
 #include "XrdCl/XrdClDefaultEnv.hh"
+#include "XrdCl/XrdClConstants.hh"
 #include "XrdCl/XrdClMessage.hh"
 #include "XrdCl/XrdClSIDManager.hh"
 #include "XrdCl/XrdClPostMaster.hh"
@@ -28,6 +29,10 @@
 #include "XrdCl/XrdClMessageUtils.hh"
 #include "XrdCl/XrdClXRootDMsgHandler.hh"
 #include "XrdCl/XrdClUtils.hh"
+#include "XrdCl/XrdClCopyProcess.hh"
+#include "XrdCl/XrdClDirTreeWalker.hh"
+#include "Server.hh"
+#include "XRootDEmulator.hh"
 
 #include "XrdCks/XrdCks.hh"
 #include "XrdCks/XrdCksCalc.hh"
@@ -36,6 +41,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
+#include <sstream>
 
 using namespace XrdClTests;
 
@@ -50,6 +57,16 @@ class FileCopyTest: public CppUnit::TestCase
       CPPUNIT_TEST( UploadTest );
       CPPUNIT_TEST( MultiStreamDownloadTest );
       CPPUNIT_TEST( MultiStreamUploadTest );
+      CPPUNIT_TEST( PipelinedCopyTest );
+      CPPUNIT_TEST( ThirdPartyCopyTest );
+      CPPUNIT_TEST( RecursiveCopyTest );
+      CPPUNIT_TEST( MultiSourceCopyTest );
+      CPPUNIT_TEST( AdaptiveCopyTest );
+      CPPUNIT_TEST( SparseCopyTest );
+      CPPUNIT_TEST( ResumeCopyTest );
+      CPPUNIT_TEST( CheckSumCopyTest );
+      CPPUNIT_TEST( InterruptedCopyTest );
+      CPPUNIT_TEST( LocalIOEngineTest );
     CPPUNIT_TEST_SUITE_END();
     void DownloadTestFunc();
     void UploadTestFunc();
@@ -57,6 +74,16 @@ class FileCopyTest: public CppUnit::TestCase
     void UploadTest();
     void MultiStreamDownloadTest();
     void MultiStreamUploadTest();
+    void PipelinedCopyTest();
+    void ThirdPartyCopyTest();
+    void RecursiveCopyTest();
+    void MultiSourceCopyTest();
+    void AdaptiveCopyTest();
+    void SparseCopyTest();
+    void ResumeCopyTest();
+    void CheckSumCopyTest();
+    void InterruptedCopyTest();
+    void LocalIOEngineTest();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION( FileCopyTest );
@@ -259,3 +286,880 @@ void FileCopyTest::MultiStreamDownloadTest()
   env->PutInt( "SubStreamsPerChannel", 4 );
   DownloadTestFunc();
 }
+
+//------------------------------------------------------------------------------
+// Pipelined copy test
+//------------------------------------------------------------------------------
+void FileCopyTest::PipelinedCopyTest()
+{
+  using namespace XrdCl;
+
+  //----------------------------------------------------------------------------
+  // Initialize
+  //----------------------------------------------------------------------------
+  Env *testEnv = TestEnv::GetEnv();
+
+  std::string address;
+  std::string remoteFile;
+  std::string dataPath;
+
+  CPPUNIT_ASSERT( testEnv->GetString( "MainServerURL", address ) );
+  CPPUNIT_ASSERT( testEnv->GetString( "RemoteFile",    remoteFile ) );
+  CPPUNIT_ASSERT( testEnv->GetString( "DataPath",      dataPath ) );
+
+  URL url( address );
+  CPPUNIT_ASSERT( url.IsValid() );
+
+  std::string sourceUrl = address + "/" + remoteFile;
+  std::string localFile = "/tmp/xrdclPipelinedCopy.dat";
+  std::string targetUrl = address + "/" + dataPath + "/testPipelined.dat";
+
+  //----------------------------------------------------------------------------
+  // Download with odd sized chunks, many of them in the fly, so that they
+  // are written out of order
+  //----------------------------------------------------------------------------
+  CopyProcess download;
+  CPPUNIT_ASSERT( download.AddSource( sourceUrl ) );
+  CPPUNIT_ASSERT( download.SetDestination( "file://" + localFile ) );
+  download.SetForce( true );
+  download.SetChunkSize( 1024*1024+13 );
+  download.SetParallelChunks( 16 );
+  download.EnableCheckSumVerification( "zcrc32" );
+  CPPUNIT_ASSERT_XRDST( download.Prepare() );
+  CPPUNIT_ASSERT_XRDST( download.Run() );
+
+  //----------------------------------------------------------------------------
+  // Upload it back, the writes go to the server in order
+  //----------------------------------------------------------------------------
+  CopyProcess upload;
+  CPPUNIT_ASSERT( upload.AddSource( "file://" + localFile ) );
+  CPPUNIT_ASSERT( upload.SetDestination( targetUrl ) );
+  upload.SetForce( true );
+  upload.SetChunkSize( 512*1024+7 );
+  upload.SetParallelChunks( 16 );
+  upload.EnableCheckSumVerification( "zcrc32" );
+  CPPUNIT_ASSERT_XRDST( upload.Prepare() );
+  CPPUNIT_ASSERT_XRDST( upload.Run() );
+
+  //----------------------------------------------------------------------------
+  // Clean up
+  //----------------------------------------------------------------------------
+  FileSystem fs( url );
+  CPPUNIT_ASSERT_XRDST( fs.Rm( dataPath + "/testPipelined.dat" ) );
+  CPPUNIT_ASSERT( unlink( localFile.c_str() ) == 0 );
+}
+
+//------------------------------------------------------------------------------
+// Record the progress of the copy jobs
+//------------------------------------------------------------------------------
+class ProgressRecorder: public XrdCl::CopyProgressHandler
+{
+  public:
+    ProgressRecorder(): jobs( 0 ), updates( 0 ), processed( 0 ), total( 0 ) {}
+
+    virtual void BeginJob( uint16_t          jobNum,
+                           uint16_t          jobTotal,
+                           const XrdCl::URL *source,
+                           const XrdCl::URL *destination )
+    {
+      ++jobs;
+    }
+
+    virtual void EndJob( uint16_t                   jobNum,
+                         const XrdCl::XRootDStatus &status ) {}
+
+    virtual void JobProgress( uint16_t jobNum,
+                              uint64_t bytesProcessed,
+                              uint64_t bytesTotal )
+    {
+      ++updates;
+      processed = bytesProcessed;
+      total     = bytesTotal;
+    }
+
+    uint32_t jobs;
+    uint32_t updates;
+    uint64_t processed;
+    uint64_t total;
+};
+
+//------------------------------------------------------------------------------
+// Third party copy test
+//------------------------------------------------------------------------------
+void FileCopyTest::ThirdPartyCopyTest()
+{
+  using namespace XrdCl;
+
+  //----------------------------------------------------------------------------
+  // Set up two emulated data servers
+  //----------------------------------------------------------------------------
+  XRootDStorage srcStorage;
+  XRootDStorage dstStorage;
+  Server        srcServer;
+  Server        dstServer;
+  CPPUNIT_ASSERT( srcServer.Setup( 10201, 1,
+                                   new XRootDHandlerFactory( &srcStorage ) ) );
+  CPPUNIT_ASSERT( dstServer.Setup( 10202, 1,
+                                   new XRootDHandlerFactory( &dstStorage ) ) );
+  CPPUNIT_ASSERT( srcServer.Start() );
+  CPPUNIT_ASSERT( dstServer.Start() );
+
+  std::string sourceUrl = "root://127.0.0.1:10201//data/tpcSource.dat";
+  std::string targetUrl = "root://127.0.0.1:10202//data/tpcTarget.dat";
+  std::string sourcePath = URL( sourceUrl ).GetPath();
+  std::string targetPath = URL( targetUrl ).GetPath();
+
+  std::string data( 5*1024*1024+13, 0 );
+  unsigned int seed = 1;
+  for( uint32_t i = 0; i < data.size(); ++i )
+    data[i] = rand_r( &seed );
+  srcStorage.PutFile( sourcePath, data );
+
+  //----------------------------------------------------------------------------
+  // The source can't be read without the key
+  //----------------------------------------------------------------------------
+  File f;
+  CPPUNIT_ASSERT_XRDST_NOTOK( f.Open( sourceUrl + "?tpc.key=1234",
+                                      OpenFlags::Read ),
+                              errErrorResponse );
+
+  //----------------------------------------------------------------------------
+  // Copy the file, the data goes from server to server
+  //----------------------------------------------------------------------------
+  ProgressRecorder progress;
+  CopyProcess      process;
+  CPPUNIT_ASSERT( process.AddSource( sourceUrl ) );
+  CPPUNIT_ASSERT( process.SetDestination( targetUrl ) );
+  process.SetThirdPartyCopy( true );
+  process.SetProgressHandler( &progress );
+  process.EnableCheckSumVerification( "adler32" );
+  CPPUNIT_ASSERT_XRDST( process.Prepare() );
+  CPPUNIT_ASSERT_XRDST( process.Run() );
+
+  std::string copied;
+  CPPUNIT_ASSERT( dstStorage.GetFile( targetPath, copied ) );
+  CPPUNIT_ASSERT( copied == data );
+  CPPUNIT_ASSERT( dstStorage.GetTPCCount() == 1 );
+  CPPUNIT_ASSERT( progress.updates > 0 );
+  CPPUNIT_ASSERT( progress.processed == data.size() );
+  CPPUNIT_ASSERT( progress.total == data.size() );
+
+  //----------------------------------------------------------------------------
+  // The target exists now so it needs to be forced
+  //----------------------------------------------------------------------------
+  CopyProcess again;
+  CPPUNIT_ASSERT( again.AddSource( sourceUrl ) );
+  CPPUNIT_ASSERT( again.SetDestination( targetUrl ) );
+  again.SetThirdPartyCopy( true );
+  CPPUNIT_ASSERT_XRDST( again.Prepare() );
+  CPPUNIT_ASSERT( !again.Run().IsOK() );
+
+  CopyProcess forced;
+  CPPUNIT_ASSERT( forced.AddSource( sourceUrl ) );
+  CPPUNIT_ASSERT( forced.SetDestination( targetUrl ) );
+  forced.SetThirdPartyCopy( true );
+  forced.SetForce( true );
+  CPPUNIT_ASSERT_XRDST( forced.Prepare() );
+  CPPUNIT_ASSERT_XRDST( forced.Run() );
+  CPPUNIT_ASSERT( dstStorage.GetTPCCount() == 2 );
+
+  //----------------------------------------------------------------------------
+  // Clean up
+  //----------------------------------------------------------------------------
+  srcStorage.Disconnect();
+  dstStorage.Disconnect();
+  CPPUNIT_ASSERT( srcServer.Stop() );
+  CPPUNIT_ASSERT( dstServer.Stop() );
+}
+
+//------------------------------------------------------------------------------
+// Collect the entries of a directory tree
+//------------------------------------------------------------------------------
+class TreeRecorder: public XrdCl::DirTreeHandler
+{
+  public:
+    TreeRecorder(): errors( 0 ) {}
+
+    virtual void HandleDirectory( const XrdCl::URL &url )
+    {
+      dirs.insert( url.GetPath() );
+    }
+
+    virtual void HandleFile( const XrdCl::URL &url,
+                             const XrdCl::StatInfo &info )
+    {
+      files[url.GetPath()] = info.GetSize();
+    }
+
+    virtual void HandleError( const XrdCl::URL &,
+                              const XrdCl::XRootDStatus & )
+    {
+      ++errors;
+    }
+
+    std::set<std::string>             dirs;
+    std::map<std::string, uint64_t>   files;
+    uint32_t                          errors;
+};
+
+//------------------------------------------------------------------------------
+// Recursive copy test
+//------------------------------------------------------------------------------
+void FileCopyTest::RecursiveCopyTest()
+{
+  using namespace XrdCl;
+
+  //----------------------------------------------------------------------------
+  // Set up two emulated data servers, the source one holding a tree
+  //----------------------------------------------------------------------------
+  XRootDStorage srcStorage;
+  XRootDStorage dstStorage;
+  Server        srcServer;
+  Server        dstServer;
+  CPPUNIT_ASSERT( srcServer.Setup( 10203, 1,
+                                   new XRootDHandlerFactory( &srcStorage ) ) );
+  CPPUNIT_ASSERT( dstServer.Setup( 10204, 1,
+                                   new XRootDHandlerFactory( &dstStorage ) ) );
+  CPPUNIT_ASSERT( srcServer.Start() );
+  CPPUNIT_ASSERT( dstServer.Start() );
+
+  const char *paths[] = { "/data/tree/a.dat", "/data/tree/b.dat",
+                          "/data/tree/sub/c.dat", "/data/tree/sub/deep/d.dat",
+                          "/data/tree/sub/deep/deeper/e.dat", 0 };
+  std::map<std::string, std::string> content;
+  unsigned int seed = 1;
+  for( int i = 0; paths[i]; ++i )
+  {
+    std::string data( 1024*1024+i*7, 0 );
+    for( uint32_t j = 0; j < data.size(); ++j )
+      data[j] = rand_r( &seed );
+    srcStorage.PutFile( paths[i], data );
+    content[paths[i]] = data;
+  }
+  srcStorage.MakeDir( "/data/tree/empty" );
+  dstStorage.MakeDir( "/copy" );
+
+  std::string sourceUrl = "root://127.0.0.1:10203//data/tree";
+  std::string targetUrl = "root://127.0.0.1:10204//copy";
+
+  //----------------------------------------------------------------------------
+  // Walk the tree
+  //----------------------------------------------------------------------------
+  TreeRecorder  tree;
+  DirTreeWalker walker( 3 );
+  CPPUNIT_ASSERT_XRDST( walker.Walk( URL( sourceUrl ), &tree ) );
+  CPPUNIT_ASSERT( tree.errors == 0 );
+  CPPUNIT_ASSERT( tree.dirs.size() == 4 );
+  CPPUNIT_ASSERT( tree.dirs.count( "/data/tree/empty" ) );
+  CPPUNIT_ASSERT( tree.dirs.count( "/data/tree/sub/deep/deeper" ) );
+  CPPUNIT_ASSERT( tree.files.size() == content.size() );
+  std::map<std::string, std::string>::iterator it;
+  for( it = content.begin(); it != content.end(); ++it )
+    CPPUNIT_ASSERT( tree.files[it->first] == it->second.size() );
+
+  TreeRecorder missing;
+  CPPUNIT_ASSERT( !walker.Walk( URL( "root://127.0.0.1:10203//data/none" ),
+                                &missing ).IsOK() );
+
+  //----------------------------------------------------------------------------
+  // Copy the tree, the files are copied while it's being listed
+  //----------------------------------------------------------------------------
+  ProgressRecorder progress;
+  CopyProcess      process;
+  CPPUNIT_ASSERT( process.AddSource( sourceUrl ) );
+  CPPUNIT_ASSERT( process.SetDestination( targetUrl ) );
+  process.SetRecursive( true );
+  process.SetParallelJobs( 3 );
+  process.SetParallelDirLists( 2 );
+  process.SetProgressHandler( &progress );
+  CPPUNIT_ASSERT_XRDST( process.Prepare() );
+  CPPUNIT_ASSERT_XRDST( process.Run() );
+
+  for( it = content.begin(); it != content.end(); ++it )
+  {
+    std::string copied;
+    std::string target = "/copy/tree" + it->first.substr( 10 );
+    CPPUNIT_ASSERT( dstStorage.GetFile( target, copied ) );
+    CPPUNIT_ASSERT( copied == it->second );
+  }
+  CPPUNIT_ASSERT( progress.jobs == content.size() );
+  CPPUNIT_ASSERT( dstStorage.IsDirectory( "/copy/tree/empty" ) );
+
+  //----------------------------------------------------------------------------
+  // Clean up
+  //----------------------------------------------------------------------------
+  srcStorage.Disconnect();
+  dstStorage.Disconnect();
+  CPPUNIT_ASSERT( srcServer.Stop() );
+  CPPUNIT_ASSERT( dstServer.Stop() );
+}
+
+//------------------------------------------------------------------------------
+// Multi-source copy test
+//------------------------------------------------------------------------------
+void FileCopyTest::MultiSourceCopyTest()
+{
+  using namespace XrdCl;
+
+  //----------------------------------------------------------------------------
+  // Set up three replicas and the destination, the first replica knows
+  // about all of them
+  //----------------------------------------------------------------------------
+  XRootDStorage storage[4];
+  Server        server[4];
+  for( int i = 0; i < 4; ++i )
+  {
+    CPPUNIT_ASSERT( server[i].Setup( 10205+i, 1,
+                                     new XRootDHandlerFactory( &storage[i] ) ) );
+    CPPUNIT_ASSERT( server[i].Start() );
+  }
+  storage[0].SetLocations( "Sr127.0.0.1:10205 Sr127.0.0.1:10206 "
+                           "Sr127.0.0.1:10207" );
+
+  std::string data( 4*1024*1024+5, 0 );
+  unsigned int seed = 1;
+  for( uint32_t i = 0; i < data.size(); ++i )
+    data[i] = rand_r( &seed );
+  for( int i = 0; i < 3; ++i )
+    storage[i].PutFile( "/data/replica.dat", data );
+
+  std::string sourceUrl = "root://127.0.0.1:10205//data/replica.dat";
+  std::string targetUrl = "root://127.0.0.1:10208//data/target.dat";
+
+  //----------------------------------------------------------------------------
+  // Read from all the replicas
+  //----------------------------------------------------------------------------
+  CopyProcess process;
+  CPPUNIT_ASSERT( process.AddSource( sourceUrl ) );
+  CPPUNIT_ASSERT( process.SetDestination( targetUrl ) );
+  process.SetSourceLimit( 3 );
+  process.SetChunkSize( 64*1024 );
+  CPPUNIT_ASSERT_XRDST( process.Prepare() );
+  CPPUNIT_ASSERT_XRDST( process.Run() );
+
+  std::string copied;
+  CPPUNIT_ASSERT( storage[3].GetFile( "/data/target.dat", copied ) );
+  CPPUNIT_ASSERT( copied == data );
+  uint64_t total = 0;
+  for( int i = 0; i < 3; ++i )
+  {
+    CPPUNIT_ASSERT( storage[i].GetBytesRead() > 0 );
+    total += storage[i].GetBytesRead();
+  }
+  CPPUNIT_ASSERT( total == data.size() );
+
+  //----------------------------------------------------------------------------
+  // A failing replica is dropped and its chunks are read from the others
+  //----------------------------------------------------------------------------
+  storage[1].SetFailReads( true );
+  CopyProcess failover;
+  CPPUNIT_ASSERT( failover.AddSource( sourceUrl ) );
+  CPPUNIT_ASSERT( failover.SetDestination( targetUrl ) );
+  failover.SetSourceLimit( 3 );
+  failover.SetChunkSize( 64*1024 );
+  failover.SetForce( true );
+  CPPUNIT_ASSERT_XRDST( failover.Prepare() );
+  CPPUNIT_ASSERT_XRDST( failover.Run() );
+  CPPUNIT_ASSERT( storage[3].GetFile( "/data/target.dat", copied ) );
+  CPPUNIT_ASSERT( copied == data );
+  storage[1].SetFailReads( false );
+
+  //----------------------------------------------------------------------------
+  // The chunks held by a stalled replica are read once more from the idle
+  // ones
+  //----------------------------------------------------------------------------
+  Env *env = DefaultEnv::GetEnv();
+  env->PutInt( "CPStallTimeout", 1 );
+  storage[2].SetReadDelay( 2000 );
+  uint64_t before = 0;
+  for( int i = 0; i < 3; ++i )
+    before += storage[i].GetBytesRead();
+
+  CopyProcess stalled;
+  CPPUNIT_ASSERT( stalled.AddSource( sourceUrl ) );
+  CPPUNIT_ASSERT( stalled.SetDestination( targetUrl ) );
+  stalled.SetSourceLimit( 3 );
+  stalled.SetChunkSize( 64*1024 );
+  stalled.SetForce( true );
+  XRootDStatus st = stalled.Prepare();
+  if( st.IsOK() )
+    st = stalled.Run();
+  env->PutInt( "CPStallTimeout", DefaultCPStallTimeout );
+  storage[2].SetReadDelay( 0 );
+
+  CPPUNIT_ASSERT_XRDST( st );
+  CPPUNIT_ASSERT( storage[3].GetFile( "/data/target.dat", copied ) );
+  CPPUNIT_ASSERT( copied == data );
+  uint64_t after = 0;
+  for( int i = 0; i < 3; ++i )
+    after += storage[i].GetBytesRead();
+  CPPUNIT_ASSERT( after - before > data.size() );
+
+  //----------------------------------------------------------------------------
+  // Clean up
+  //----------------------------------------------------------------------------
+  for( int i = 0; i < 4; ++i )
+  {
+    storage[i].Disconnect();
+    CPPUNIT_ASSERT( server[i].Stop() );
+  }
+}
+
+//------------------------------------------------------------------------------
+// Adaptive chunk size test
+//------------------------------------------------------------------------------
+void FileCopyTest::AdaptiveCopyTest()
+{
+  using namespace XrdCl;
+
+  //----------------------------------------------------------------------------
+  // Start with small chunks within narrow bounds so that the chunk size
+  // changes while the data is being copied
+  //----------------------------------------------------------------------------
+  XRootDStorage storage[2];
+  Server        server[2];
+  for( int i = 0; i < 2; ++i )
+  {
+    CPPUNIT_ASSERT( server[i].Setup( 10209+i, 1,
+                                     new XRootDHandlerFactory( &storage[i] ) ) );
+    CPPUNIT_ASSERT( server[i].Start() );
+  }
+
+  std::string data( 8*1024*1024+11, 0 );
+  unsigned int seed = 2;
+  for( uint32_t i = 0; i < data.size(); ++i )
+    data[i] = rand_r( &seed );
+  storage[0].PutFile( "/data/adaptive.dat", data );
+
+  Env *env = DefaultEnv::GetEnv();
+  env->PutInt( "CPChunkSize",         4096 );
+  env->PutInt( "CPParallelChunks",    1 );
+  env->PutInt( "CPMinChunkSize",      4096 );
+  env->PutInt( "CPMaxChunkSize",      256*1024 );
+  env->PutInt( "CPMinParallelChunks", 1 );
+  env->PutInt( "CPMaxParallelChunks", 8 );
+
+  CopyProcess process;
+  CPPUNIT_ASSERT( process.AddSource(
+                    "root://127.0.0.1:10209//data/adaptive.dat" ) );
+  CPPUNIT_ASSERT( process.SetDestination(
+                    "root://127.0.0.1:10210//data/adaptive.dat" ) );
+  CPPUNIT_ASSERT_XRDST( process.Prepare() );
+  XRootDStatus st = process.Run();
+
+  env->PutInt( "CPChunkSize",         DefaultCPChunkSize );
+  env->PutInt( "CPParallelChunks",    DefaultCPParallelChunks );
+  env->PutInt( "CPMinChunkSize",      DefaultCPMinChunkSize );
+  env->PutInt( "CPMaxChunkSize",      DefaultCPMaxChunkSize );
+  env->PutInt( "CPMinParallelChunks", DefaultCPMinParallelChunks );
+  env->PutInt( "CPMaxParallelChunks", DefaultCPMaxParallelChunks );
+
+  CPPUNIT_ASSERT_XRDST( st );
+  std::string copied;
+  CPPUNIT_ASSERT( storage[1].GetFile( "/data/adaptive.dat", copied ) );
+  CPPUNIT_ASSERT( copied == data );
+
+  //----------------------------------------------------------------------------
+  // Clean up
+  //----------------------------------------------------------------------------
+  for( int i = 0; i < 2; ++i )
+  {
+    storage[i].Disconnect();
+    CPPUNIT_ASSERT( server[i].Stop() );
+  }
+}
+
+//------------------------------------------------------------------------------
+// Sparse copy test
+//------------------------------------------------------------------------------
+void FileCopyTest::SparseCopyTest()
+{
+  using namespace XrdCl;
+
+  //----------------------------------------------------------------------------
+  // A file with zero regions in the middle and at the end
+  //----------------------------------------------------------------------------
+  XRootDStorage storage[2];
+  Server        server[2];
+  for( int i = 0; i < 2; ++i )
+  {
+    CPPUNIT_ASSERT( server[i].Setup( 10211+i, 1,
+                                     new XRootDHandlerFactory( &storage[i] ) ) );
+    CPPUNIT_ASSERT( server[i].Start() );
+  }
+
+  std::string data( 6*1024*1024+3, 0 );
+  unsigned int seed = 3;
+  for( uint32_t i = 0; i < 1024*1024+17; ++i )
+    data[i] = rand_r( &seed );
+  for( uint32_t i = 4*1024*1024; i < 4*1024*1024+5; ++i )
+    data[i] = rand_r( &seed );
+  storage[0].PutFile( "/data/sparse.dat", data );
+
+  std::string sourceUrl = "root://127.0.0.1:10211//data/sparse.dat";
+  std::string localFile = "/tmp/xrdclSparseCopy.dat";
+
+  //----------------------------------------------------------------------------
+  // Download, the zero blocks are not written
+  //----------------------------------------------------------------------------
+  CopyProcess download;
+  CPPUNIT_ASSERT( download.AddSource( sourceUrl ) );
+  CPPUNIT_ASSERT( download.SetDestination( "file://" + localFile ) );
+  download.SetForce( true );
+  download.SetChunkSize( 256*1024 );
+  CPPUNIT_ASSERT_XRDST( download.Prepare() );
+  CPPUNIT_ASSERT_XRDST( download.Run() );
+
+  std::string copied( data.size()+1, 1 );
+  int fd = open( localFile.c_str(), O_RDONLY );
+  CPPUNIT_ASSERT( fd != -1 );
+  CPPUNIT_ASSERT( pread( fd, &copied[0], copied.size(), 0 ) ==
+                  (ssize_t)data.size() );
+  close( fd );
+  copied.resize( data.size() );
+  CPPUNIT_ASSERT( copied == data );
+  CPPUNIT_ASSERT( unlink( localFile.c_str() ) == 0 );
+
+  //----------------------------------------------------------------------------
+  // Copy to the other server skipping the zero chunks, the trailing hole
+  // is made by truncating the file
+  //----------------------------------------------------------------------------
+  Env *env = DefaultEnv::GetEnv();
+  env->PutInt( "CPSparseRemote", 1 );
+  CopyProcess process;
+  CPPUNIT_ASSERT( process.AddSource( sourceUrl ) );
+  CPPUNIT_ASSERT( process.SetDestination(
+                    "root://127.0.0.1:10212//data/sparse.dat" ) );
+  process.SetChunkSize( 256*1024 );
+  CPPUNIT_ASSERT_XRDST( process.Prepare() );
+  XRootDStatus st = process.Run();
+  env->PutInt( "CPSparseRemote", DefaultCPSparseRemote );
+
+  CPPUNIT_ASSERT_XRDST( st );
+  CPPUNIT_ASSERT( storage[1].GetFile( "/data/sparse.dat", copied ) );
+  CPPUNIT_ASSERT( copied == data );
+  CPPUNIT_ASSERT( storage[1].GetBytesWritten() == 6*256*1024 );
+
+  //----------------------------------------------------------------------------
+  // Clean up
+  //----------------------------------------------------------------------------
+  for( int i = 0; i < 2; ++i )
+  {
+    storage[i].Disconnect();
+    CPPUNIT_ASSERT( server[i].Stop() );
+  }
+}
+
+//------------------------------------------------------------------------------
+// Resumed copy test
+//------------------------------------------------------------------------------
+void FileCopyTest::ResumeCopyTest()
+{
+  using namespace XrdCl;
+
+  XRootDStorage storage;
+  Server        server;
+  CPPUNIT_ASSERT( server.Setup( 10213, 1,
+                                new XRootDHandlerFactory( &storage ) ) );
+  CPPUNIT_ASSERT( server.Start() );
+
+  std::string data( 3*1024*1024+7, 0 );
+  unsigned int seed = 4;
+  for( uint32_t i = 0; i < data.size(); ++i )
+    data[i] = rand_r( &seed );
+  storage.PutFile( "/data/resume.dat", data );
+
+  std::string sourceUrl   = "root://127.0.0.1:10213//data/resume.dat";
+  std::string localFile   = "/tmp/xrdclResumeCopy.dat";
+  std::string journalFile = localFile + ".xrdcl-journal";
+  unlink( localFile.c_str() );
+  unlink( journalFile.c_str() );
+
+  //----------------------------------------------------------------------------
+  // A failed copy leaves the journal behind
+  //----------------------------------------------------------------------------
+  storage.SetFailReads( true );
+  CopyProcess failed;
+  CPPUNIT_ASSERT( failed.AddSource( sourceUrl ) );
+  CPPUNIT_ASSERT( failed.SetDestination( "file://" + localFile ) );
+  failed.SetResume( true );
+  CPPUNIT_ASSERT_XRDST( failed.Prepare() );
+  CPPUNIT_ASSERT( !failed.Run().IsOK() );
+  CPPUNIT_ASSERT( access( journalFile.c_str(), F_OK ) == 0 );
+  storage.SetFailReads( false );
+
+  //----------------------------------------------------------------------------
+  // Pretend that the first megabyte made it, only the rest is copied
+  // when resuming
+  //----------------------------------------------------------------------------
+  int fd = open( localFile.c_str(), O_WRONLY );
+  CPPUNIT_ASSERT( fd != -1 );
+  CPPUNIT_ASSERT( pwrite( fd, data.data(), 1024*1024, 0 ) == 1024*1024 );
+  close( fd );
+  fd = open( journalFile.c_str(), O_WRONLY|O_APPEND );
+  CPPUNIT_ASSERT( fd != -1 );
+  std::string record = "0 1048576\n";
+  CPPUNIT_ASSERT( write( fd, record.data(), record.size() ) ==
+                  (ssize_t)record.size() );
+  close( fd );
+
+  CopyProcess resumed;
+  CPPUNIT_ASSERT( resumed.AddSource( sourceUrl ) );
+  CPPUNIT_ASSERT( resumed.SetDestination( "file://" + localFile ) );
+  resumed.SetResume( true );
+  resumed.SetChunkSize( 256*1024 );
+  CPPUNIT_ASSERT_XRDST( resumed.Prepare() );
+  CPPUNIT_ASSERT_XRDST( resumed.Run() );
+  CPPUNIT_ASSERT( storage.GetBytesRead() == data.size() - 1024*1024 );
+  CPPUNIT_ASSERT( access( journalFile.c_str(), F_OK ) != 0 );
+
+  std::string copied( data.size()+1, 0 );
+  fd = open( localFile.c_str(), O_RDONLY );
+  CPPUNIT_ASSERT( fd != -1 );
+  CPPUNIT_ASSERT( pread( fd, &copied[0], copied.size(), 0 ) ==
+                  (ssize_t)data.size() );
+  close( fd );
+  copied.resize( data.size() );
+  CPPUNIT_ASSERT( copied == data );
+
+  //----------------------------------------------------------------------------
+  // Clean up
+  //----------------------------------------------------------------------------
+  CPPUNIT_ASSERT( unlink( localFile.c_str() ) == 0 );
+  storage.Disconnect();
+  CPPUNIT_ASSERT( server.Stop() );
+}
+
+//------------------------------------------------------------------------------
+// Checksum verification of a local copy
+//------------------------------------------------------------------------------
+void FileCopyTest::CheckSumCopyTest()
+{
+  using namespace XrdCl;
+
+  std::string data( 3*1024*1024+5, 0 );
+  unsigned int seed = 7;
+  for( uint32_t i = 0; i < data.size(); ++i )
+    data[i] = rand_r( &seed );
+
+  std::string sourceFile = "/tmp/xrdclCheckSumSource.dat";
+  std::string localFile  = "/tmp/xrdclCheckSumCopy.dat";
+  int fd = open( sourceFile.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644 );
+  CPPUNIT_ASSERT( fd != -1 );
+  CPPUNIT_ASSERT( write( fd, data.data(), data.size() ) ==
+                  (ssize_t)data.size() );
+  close( fd );
+
+  //----------------------------------------------------------------------------
+  // A good copy passes the verification
+  //----------------------------------------------------------------------------
+  CopyProcess process;
+  CPPUNIT_ASSERT( process.AddSource( "file://" + sourceFile ) );
+  CPPUNIT_ASSERT( process.SetDestination( "file://" + localFile ) );
+  process.SetForce( true );
+  process.EnableCheckSumVerification( "adler32" );
+  CPPUNIT_ASSERT_XRDST( process.Prepare() );
+  CPPUNIT_ASSERT_XRDST( process.Run() );
+  CPPUNIT_ASSERT( unlink( localFile.c_str() ) == 0 );
+
+  //----------------------------------------------------------------------------
+  // The data written to the destination never reaches the disk, the
+  // destination checksum comes from the file and does not match
+  //----------------------------------------------------------------------------
+  CPPUNIT_ASSERT( symlink( "/dev/null", localFile.c_str() ) == 0 );
+  CopyProcess broken;
+  CPPUNIT_ASSERT( broken.AddSource( "file://" + sourceFile ) );
+  CPPUNIT_ASSERT( broken.SetDestination( "file://" + localFile ) );
+  broken.SetForce( true );
+  broken.EnableCheckSumVerification( "adler32" );
+  CPPUNIT_ASSERT_XRDST( broken.Prepare() );
+  XRootDStatus st = broken.Run();
+  CPPUNIT_ASSERT( !st.IsOK() );
+  CPPUNIT_ASSERT( st.code == errCheckSumError );
+
+  CPPUNIT_ASSERT( unlink( localFile.c_str() ) == 0 );
+  CPPUNIT_ASSERT( unlink( sourceFile.c_str() ) == 0 );
+}
+
+//------------------------------------------------------------------------------
+// Make the reads fail once half of the data has been copied
+//------------------------------------------------------------------------------
+class FailHalfway: public ProgressRecorder
+{
+  public:
+    FailHalfway( XRootDStorage *storage ): pStorage( storage ) {}
+
+    virtual void JobProgress( uint16_t jobNum,
+                              uint64_t bytesProcessed,
+                              uint64_t bytesTotal )
+    {
+      ProgressRecorder::JobProgress( jobNum, bytesProcessed, bytesTotal );
+      if( bytesProcessed >= bytesTotal/2 )
+        pStorage->SetFailReads( true );
+    }
+
+  private:
+    XRootDStorage *pStorage;
+};
+
+//------------------------------------------------------------------------------
+// Copy interrupted half way through and resumed
+//------------------------------------------------------------------------------
+void FileCopyTest::InterruptedCopyTest()
+{
+  using namespace XrdCl;
+
+  XRootDStorage storage;
+  Server        server;
+  CPPUNIT_ASSERT( server.Setup( 10237, 1,
+                                new XRootDHandlerFactory( &storage ) ) );
+  CPPUNIT_ASSERT( server.Start() );
+
+  std::string data( 8*1024*1024+3, 0 );
+  unsigned int seed = 5;
+  for( uint32_t i = 0; i < data.size(); ++i )
+    data[i] = rand_r( &seed );
+  storage.PutFile( "/data/interrupted.dat", data );
+
+  std::string sourceUrl   = "root://127.0.0.1:10237//data/interrupted.dat";
+  std::string localFile   = "/tmp/xrdclInterruptedCopy.dat";
+  std::string journalFile = localFile + ".xrdcl-journal";
+  unlink( localFile.c_str() );
+  unlink( journalFile.c_str() );
+
+  //----------------------------------------------------------------------------
+  // The source fails in the middle of the copy
+  //----------------------------------------------------------------------------
+  FailHalfway failer( &storage );
+  CopyProcess failed;
+  CPPUNIT_ASSERT( failed.AddSource( sourceUrl ) );
+  CPPUNIT_ASSERT( failed.SetDestination( "file://" + localFile ) );
+  failed.SetResume( true );
+  failed.SetChunkSize( 512*1024 );
+  failed.SetProgressHandler( &failer );
+  CPPUNIT_ASSERT_XRDST( failed.Prepare() );
+  CPPUNIT_ASSERT( !failed.Run().IsOK() );
+  CPPUNIT_ASSERT( failer.processed >= data.size()/2 );
+  CPPUNIT_ASSERT( failer.processed < data.size() );
+  storage.SetFailReads( false );
+
+  //----------------------------------------------------------------------------
+  // Every range in the journal holds the data of the source
+  //----------------------------------------------------------------------------
+  std::string journal;
+  char        buffer[4096];
+  ssize_t     rd;
+  int fd = open( journalFile.c_str(), O_RDONLY );
+  CPPUNIT_ASSERT( fd != -1 );
+  while( (rd = read( fd, buffer, sizeof( buffer ) )) > 0 )
+    journal.append( buffer, rd );
+  close( fd );
+
+  std::istringstream records( journal );
+  std::string        line;
+  for( int i = 0; i < 3; ++i )
+    CPPUNIT_ASSERT( std::getline( records, line ) );
+
+  uint64_t journaled = 0, offset, length;
+  fd = open( localFile.c_str(), O_RDONLY );
+  CPPUNIT_ASSERT( fd != -1 );
+  while( records >> offset >> length )
+  {
+    std::string chunk( length, 0 );
+    CPPUNIT_ASSERT( pread( fd, &chunk[0], length, offset ) ==
+                    (ssize_t)length );
+    CPPUNIT_ASSERT( chunk == data.substr( offset, length ) );
+    journaled += length;
+  }
+  close( fd );
+  CPPUNIT_ASSERT( journaled >= data.size()/2 );
+
+  //----------------------------------------------------------------------------
+  // Only the missing part is copied when resuming
+  //----------------------------------------------------------------------------
+  uint64_t bytesRead = storage.GetBytesRead();
+  CopyProcess resumed;
+  CPPUNIT_ASSERT( resumed.AddSource( sourceUrl ) );
+  CPPUNIT_ASSERT( resumed.SetDestination( "file://" + localFile ) );
+  resumed.SetResume( true );
+  resumed.SetChunkSize( 512*1024 );
+  CPPUNIT_ASSERT_XRDST( resumed.Prepare() );
+  CPPUNIT_ASSERT_XRDST( resumed.Run() );
+  CPPUNIT_ASSERT( storage.GetBytesRead() - bytesRead ==
+                  data.size() - journaled );
+  CPPUNIT_ASSERT( access( journalFile.c_str(), F_OK ) != 0 );
+
+  std::string copied( data.size()+1, 0 );
+  fd = open( localFile.c_str(), O_RDONLY );
+  CPPUNIT_ASSERT( fd != -1 );
+  CPPUNIT_ASSERT( pread( fd, &copied[0], copied.size(), 0 ) ==
+                  (ssize_t)data.size() );
+  close( fd );
+  copied.resize( data.size() );
+  CPPUNIT_ASSERT( copied == data );
+
+  //----------------------------------------------------------------------------
+  // Clean up
+  //----------------------------------------------------------------------------
+  CPPUNIT_ASSERT( unlink( localFile.c_str() ) == 0 );
+  storage.Disconnect();
+  CPPUNIT_ASSERT( server.Stop() );
+}
+
+//------------------------------------------------------------------------------
+// Copy a local file with every local I/O engine
+//------------------------------------------------------------------------------
+void FileCopyTest::LocalIOEngineTest()
+{
+  using namespace XrdCl;
+
+  //----------------------------------------------------------------------------
+  // The size is not aligned so that the direct engine has to fall back for
+  // the last chunk
+  //----------------------------------------------------------------------------
+  std::string data( 3*1024*1024+4097, 0 );
+  unsigned int seed = 6;
+  for( uint32_t i = 0; i < data.size(); ++i )
+    data[i] = rand_r( &seed );
+
+  std::string sourceFile = "/tmp/xrdclLocalIOEngineSource.dat";
+  std::string targetFile = "/tmp/xrdclLocalIOEngineTarget.dat";
+  int fd = open( sourceFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+  CPPUNIT_ASSERT( fd != -1 );
+  CPPUNIT_ASSERT( write( fd, data.c_str(), data.size() ) ==
+                  (ssize_t)data.size() );
+  close( fd );
+
+  const char *engines[] = { "posix", "auto", "fadvise", "direct", "mmap" };
+  Env        *env       = DefaultEnv::GetEnv();
+  for( size_t i = 0; i < sizeof( engines )/sizeof( engines[0] ); ++i )
+  {
+    unlink( targetFile.c_str() );
+    env->PutString( "CPLocalIOEngine", engines[i] );
+
+    CopyProcess process;
+    CPPUNIT_ASSERT( process.AddSource( "file://" + sourceFile ) );
+    CPPUNIT_ASSERT( process.SetDestination( "file://" + targetFile ) );
+    process.SetChunkSize( 256*1024 );
+    XRootDStatus st = process.Prepare();
+    if( st.IsOK() )
+      st = process.Run();
+    env->PutString( "CPLocalIOEngine", DefaultCPLocalIOEngine );
+    CPPUNIT_ASSERT_XRDST( st );
+
+    std::string copied( data.size()+1, 0 );
+    fd = open( targetFile.c_str(), O_RDONLY );
+    CPPUNIT_ASSERT( fd != -1 );
+    CPPUNIT_ASSERT( pread( fd, &copied[0], copied.size(), 0 ) ==
+                    (ssize_t)data.size() );
+    close( fd );
+    copied.resize( data.size() );
+    CPPUNIT_ASSERT_MESSAGE( engines[i], copied == data );
+  }
+
+  //----------------------------------------------------------------------------
+  // Clean up
+  //----------------------------------------------------------------------------
+  CPPUNIT_ASSERT( unlink( targetFile.c_str() ) == 0 );
+  CPPUNIT_ASSERT( unlink( sourceFile.c_str() ) == 0 );
+}
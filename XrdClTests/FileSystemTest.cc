@@ -19,9 +19,20 @@
 #include <cppunit/extensions/HelperMacros.h>
 #include <XrdCl/XrdClFileSystem.hh>
 #include <XrdCl/XrdClFile.hh>
+#include <XrdCl/XrdClDefaultEnv.hh>
+#include <XrdCl/XrdClMetadataCache.hh>
+#include <XrdCl/XrdClMessageUtils.hh>
+#include <XrdCl/XrdClConstants.hh>
 #include "CppUnitXrdHelpers.hh"
+#include "Server.hh"
+#include "XRootDEmulator.hh"
 
 #include <pthread.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
+#include <cstdlib>
 
 #include "TestEnv.hh"
 
@@ -45,7 +56,15 @@ class FileSystemTest: public CppUnit::TestCase
       CPPUNIT_TEST( StatVFSTest );
       CPPUNIT_TEST( ProtocolTest );
       CPPUNIT_TEST( DeepLocateTest );
+      CPPUNIT_TEST( DeepLocateManagersTest );
       CPPUNIT_TEST( DirListTest );
+      CPPUNIT_TEST( LocateDirListTest );
+      CPPUNIT_TEST( DirListStatTest );
+      CPPUNIT_TEST( DirListStreamTest );
+      CPPUNIT_TEST( DirListRetryTest );
+      CPPUNIT_TEST( CompactDirListTest );
+      CPPUNIT_TEST( MetadataCacheTest );
+      CPPUNIT_TEST( BatchTest );
       CPPUNIT_TEST( SendInfoTest );
       CPPUNIT_TEST( PrepareTest );
     CPPUNIT_TEST_SUITE_END();
@@ -60,7 +79,15 @@ class FileSystemTest: public CppUnit::TestCase
     void StatVFSTest();
     void ProtocolTest();
     void DeepLocateTest();
+    void DeepLocateManagersTest();
     void DirListTest();
+    void LocateDirListTest();
+    void DirListStatTest();
+    void DirListStreamTest();
+    void DirListRetryTest();
+    void CompactDirListTest();
+    void MetadataCacheTest();
+    void BatchTest();
     void SendInfoTest();
     void PrepareTest();
 };
@@ -429,6 +456,600 @@ void FileSystemTest::DirListTest()
   delete list;
 }
 
+//------------------------------------------------------------------------------
+// Dir list at all the servers holding the directory
+//------------------------------------------------------------------------------
+void FileSystemTest::LocateDirListTest()
+{
+  using namespace XrdCl;
+
+  //----------------------------------------------------------------------------
+  // Set up three servers, the first one knows about all of them, the last
+  // one does not have the directory
+  //----------------------------------------------------------------------------
+  XRootDStorage storage[3];
+  Server        server[3];
+  for( int i = 0; i < 3; ++i )
+  {
+    CPPUNIT_ASSERT( server[i].Setup( 10214+i, 1,
+                                     new XRootDHandlerFactory( &storage[i] ) ) );
+    CPPUNIT_ASSERT( server[i].Start() );
+  }
+  storage[0].SetLocations( "Sr127.0.0.1:10214 Sr127.0.0.1:10215 "
+                           "Sr127.0.0.1:10216" );
+  storage[0].PutFile( "/data/dir/a", "a" );
+  storage[0].PutFile( "/data/dir/b", "bb" );
+  storage[1].PutFile( "/data/dir/b", "bb" );
+  storage[1].PutFile( "/data/dir/c", "ccc" );
+
+  //----------------------------------------------------------------------------
+  // The entries are merged, the failing server is reported
+  //----------------------------------------------------------------------------
+  FileSystem fs( URL( "root://127.0.0.1:10214" ) );
+  DirectoryList *list = 0;
+  XRootDStatus st = fs.DirList( "/data/dir",
+                                DirListFlags::Stat | DirListFlags::Locate,
+                                list );
+  CPPUNIT_ASSERT_XRDST( st );
+  CPPUNIT_ASSERT( st.code == suPartial );
+  CPPUNIT_ASSERT( st.GetErrorMessage().find( "127.0.0.1:10216" ) !=
+                  std::string::npos );
+  CPPUNIT_ASSERT( list );
+  CPPUNIT_ASSERT( list->GetSize() == 3 );
+
+  std::map<std::string, uint64_t> sizes;
+  DirectoryList::Iterator it;
+  for( it = list->Begin(); it != list->End(); ++it )
+  {
+    CPPUNIT_ASSERT( (*it)->GetStatInfo() );
+    sizes[(*it)->GetName()] = (*it)->GetStatInfo()->GetSize();
+  }
+  CPPUNIT_ASSERT( sizes["a"] == 1 );
+  CPPUNIT_ASSERT( sizes["b"] == 2 );
+  CPPUNIT_ASSERT( sizes["c"] == 3 );
+  delete list;
+
+  //----------------------------------------------------------------------------
+  // Clean up
+  //----------------------------------------------------------------------------
+  for( int i = 0; i < 3; ++i )
+  {
+    storage[i].Disconnect();
+    CPPUNIT_ASSERT( server[i].Stop() );
+  }
+}
+
+
+//------------------------------------------------------------------------------
+// Dir list with the stat info
+//------------------------------------------------------------------------------
+void FileSystemTest::DirListStatTest()
+{
+  using namespace XrdCl;
+
+  XRootDStorage storage;
+  Server        server;
+  CPPUNIT_ASSERT( server.Setup( 10217, 1,
+                                new XRootDHandlerFactory( &storage ) ) );
+  CPPUNIT_ASSERT( server.Start() );
+
+  const uint32_t nFiles = 50;
+  for( uint32_t i = 0; i < nFiles; ++i )
+  {
+    std::ostringstream name;
+    name << "/data/dir/file" << i;
+    storage.PutFile( name.str(), std::string( i, 'x' ) );
+  }
+  storage.MakeDir( "/data/dir/subdir" );
+
+  //----------------------------------------------------------------------------
+  // The stat info comes with the listing, first from a server supporting
+  // it and then from a server ignoring the stat option
+  //----------------------------------------------------------------------------
+  FileSystem fs( URL( "root://127.0.0.1:10217" ) );
+  for( int pass = 0; pass < 2; ++pass )
+  {
+    storage.SetDirListStat( pass == 0 );
+    uint32_t statCount = storage.GetStatCount();
+
+    DirectoryList *list = 0;
+    CPPUNIT_ASSERT_XRDST( fs.DirList( "/data/dir", DirListFlags::Stat, list ) );
+    CPPUNIT_ASSERT( list );
+    CPPUNIT_ASSERT( list->GetSize() == nFiles+1 );
+
+    DirectoryList::Iterator it;
+    for( it = list->Begin(); it != list->End(); ++it )
+    {
+      StatInfo *info = (*it)->GetStatInfo();
+      CPPUNIT_ASSERT( info );
+      if( (*it)->GetName() == "subdir" )
+      {
+        CPPUNIT_ASSERT( info->TestFlags( StatInfo::IsDir ) );
+        continue;
+      }
+      uint32_t index = atoi( (*it)->GetName().c_str()+4 );
+      CPPUNIT_ASSERT( info->GetSize() == index );
+    }
+    delete list;
+
+    if( pass == 0 )
+      CPPUNIT_ASSERT( storage.GetStatCount() == statCount );
+    else
+      CPPUNIT_ASSERT( storage.GetStatCount() == statCount+nFiles+1 );
+  }
+
+  storage.Disconnect();
+  CPPUNIT_ASSERT( server.Stop() );
+}
+
+//------------------------------------------------------------------------------
+// Collect the batches of a streamed directory listing
+//------------------------------------------------------------------------------
+class DirListCollector: public XrdCl::DirListHandler
+{
+  public:
+    DirListCollector(): batches( 0 ), status( 0 ), sem( 0 ) {}
+
+    virtual void HandleEntries( XrdCl::DirectoryList *entries )
+    {
+      ++batches;
+      XrdCl::DirectoryList::Iterator it;
+      for( it = entries->Begin(); it != entries->End(); ++it )
+      {
+        XrdCl::StatInfo *info = (*it)->GetStatInfo();
+        sizes[(*it)->GetName()] = info ? info->GetSize() : -1;
+      }
+      delete entries;
+    }
+
+    virtual void HandleResponse( XrdCl::XRootDStatus *st,
+                                 XrdCl::AnyObject    *response )
+    {
+      status = st;
+      delete response;
+      sem.Post();
+    }
+
+    uint32_t                        batches;
+    std::map<std::string, int64_t>  sizes;
+    XrdCl::XRootDStatus            *status;
+    XrdSysSemaphore                 sem;
+};
+
+//------------------------------------------------------------------------------
+// Dir list handed out as the parts of the response arrive
+//------------------------------------------------------------------------------
+void FileSystemTest::DirListStreamTest()
+{
+  using namespace XrdCl;
+
+  XRootDStorage storage;
+  Server        server;
+  CPPUNIT_ASSERT( server.Setup( 10218, 1,
+                                new XRootDHandlerFactory( &storage ) ) );
+  CPPUNIT_ASSERT( server.Start() );
+
+  const uint32_t nFiles = 2000;
+  for( uint32_t i = 0; i < nFiles; ++i )
+  {
+    std::ostringstream name;
+    name << "/data/dir/file" << i;
+    storage.PutFile( name.str(), std::string( i % 100, 'x' ) );
+  }
+  storage.SetDirListPartSize( 1000 );
+
+  FileSystem fs( URL( "root://127.0.0.1:10218" ) );
+  for( int pass = 0; pass < 2; ++pass )
+  {
+    //--------------------------------------------------------------------------
+    // The entries come in many batches, cut at any byte by the server
+    //--------------------------------------------------------------------------
+    uint8_t flags = pass ? DirListFlags::Stat : DirListFlags::None;
+    DirListCollector collector;
+    CPPUNIT_ASSERT_XRDST( fs.DirList( "/data/dir", flags, &collector ) );
+    collector.sem.Wait();
+    CPPUNIT_ASSERT_XRDST( *collector.status );
+    delete collector.status;
+
+    CPPUNIT_ASSERT( collector.batches > 1 );
+    CPPUNIT_ASSERT( collector.sizes.size() == nFiles );
+    for( uint32_t i = 0; i < nFiles; ++i )
+    {
+      std::ostringstream name;
+      name << "file" << i;
+      CPPUNIT_ASSERT( collector.sizes.count( name.str() ) );
+      if( pass )
+        CPPUNIT_ASSERT( collector.sizes[name.str()] == i % 100 );
+    }
+
+    //--------------------------------------------------------------------------
+    // The parts are glued together for the whole listing
+    //--------------------------------------------------------------------------
+    DirectoryList *list = 0;
+    CPPUNIT_ASSERT_XRDST( fs.DirList( "/data/dir", flags, list ) );
+    CPPUNIT_ASSERT( list );
+    CPPUNIT_ASSERT( list->GetSize() == nFiles );
+    delete list;
+  }
+
+  storage.Disconnect();
+  CPPUNIT_ASSERT( server.Stop() );
+}
+
+//------------------------------------------------------------------------------
+// Dir list interrupted by a dropped connection
+//------------------------------------------------------------------------------
+void FileSystemTest::DirListRetryTest()
+{
+  using namespace XrdCl;
+
+  XRootDStorage storage;
+  Server        server;
+  CPPUNIT_ASSERT( server.Setup( 10238, 1,
+                                new XRootDHandlerFactory( &storage ) ) );
+  CPPUNIT_ASSERT( server.Start() );
+
+  const uint32_t nFiles = 10;
+  for( uint32_t i = 0; i < nFiles; ++i )
+  {
+    std::ostringstream name;
+    name << "/data/dir/file" << i;
+    storage.PutFile( name.str(), std::string( i, 'x' ) );
+  }
+
+  //----------------------------------------------------------------------------
+  // The first part holds the stat lead but no complete entry, the listing
+  // starts over at the new connection
+  //----------------------------------------------------------------------------
+  FileSystem fs( URL( "root://127.0.0.1:10238" ) );
+  storage.SetDirListPartSize( 12 );
+  storage.SetDirListDrops( 1 );
+  DirListCollector restarted;
+  CPPUNIT_ASSERT_XRDST( fs.DirList( "/data/dir", DirListFlags::Stat,
+                                    &restarted ) );
+  restarted.sem.Wait();
+  CPPUNIT_ASSERT_XRDST( *restarted.status );
+  delete restarted.status;
+  CPPUNIT_ASSERT( restarted.sizes.size() == nFiles );
+  for( uint32_t i = 0; i < nFiles; ++i )
+  {
+    std::ostringstream name;
+    name << "file" << i;
+    CPPUNIT_ASSERT( restarted.sizes.count( name.str() ) );
+    CPPUNIT_ASSERT( restarted.sizes[name.str()] == i );
+  }
+
+  //----------------------------------------------------------------------------
+  // Some entries have been handed out already, the listing fails
+  //----------------------------------------------------------------------------
+  storage.SetDirListPartSize( 100 );
+  storage.SetDirListDrops( 1 );
+  DirListCollector failed;
+  CPPUNIT_ASSERT_XRDST( fs.DirList( "/data/dir", DirListFlags::Stat,
+                                    &failed ) );
+  failed.sem.Wait();
+  CPPUNIT_ASSERT( !failed.status->IsOK() );
+  delete failed.status;
+  CPPUNIT_ASSERT( failed.batches == 1 );
+  CPPUNIT_ASSERT( !failed.sizes.empty() );
+  CPPUNIT_ASSERT( failed.sizes.size() < nFiles );
+
+  storage.Disconnect();
+  CPPUNIT_ASSERT( server.Stop() );
+}
+
+//------------------------------------------------------------------------------
+// Dir list in the compact form
+//------------------------------------------------------------------------------
+void FileSystemTest::CompactDirListTest()
+{
+  using namespace XrdCl;
+
+  XRootDStorage storage;
+  Server        server;
+  CPPUNIT_ASSERT( server.Setup( 10219, 1,
+                                new XRootDHandlerFactory( &storage ) ) );
+  CPPUNIT_ASSERT( server.Start() );
+
+  const uint32_t nFiles = 2000;
+  for( uint32_t i = 0; i < nFiles; ++i )
+  {
+    std::ostringstream name;
+    name << "/data/dir/file" << i;
+    storage.PutFile( name.str(), std::string( i % 100, 'x' ) );
+  }
+  storage.SetDirListPartSize( 1000 );
+
+  //----------------------------------------------------------------------------
+  // The stat info comes with the listing in the second pass and is
+  // queried entry by entry in the third one
+  //----------------------------------------------------------------------------
+  FileSystem fs( URL( "root://127.0.0.1:10219" ) );
+  for( int pass = 0; pass < 3; ++pass )
+  {
+    storage.SetDirListStat( pass == 1 );
+    uint8_t flags = pass ? DirListFlags::Stat : DirListFlags::None;
+
+    CompactDirectoryList *list = 0;
+    CPPUNIT_ASSERT_XRDST( fs.DirList( "/data/dir", flags, list ) );
+    CPPUNIT_ASSERT( list );
+    CPPUNIT_ASSERT( list->GetSize() == nFiles );
+    CPPUNIT_ASSERT( list->GetParentName() == "/data/dir/" );
+
+    std::set<std::string> names;
+    CompactDirectoryList::ConstIterator it  = list->Begin();
+    CompactDirectoryList::ConstIterator end = list->End();
+    for( ; it != end; ++it )
+    {
+      std::string name( it->GetName(), it->GetNameLength() );
+      CPPUNIT_ASSERT( name.compare( 0, 4, "file" ) == 0 );
+      CPPUNIT_ASSERT( !it->GetHostAddress().empty() );
+      CPPUNIT_ASSERT( it->HasStatInfo() == (pass != 0) );
+      if( pass )
+        CPPUNIT_ASSERT( it->GetSize() ==
+                        (uint64_t)atoi( name.c_str()+4 ) % 100 );
+      names.insert( name );
+    }
+    CPPUNIT_ASSERT( names.size() == nFiles );
+    delete list;
+  }
+
+  storage.Disconnect();
+  CPPUNIT_ASSERT( server.Stop() );
+}
+
+//------------------------------------------------------------------------------
+// Stat answered from the metadata cache
+//------------------------------------------------------------------------------
+void FileSystemTest::MetadataCacheTest()
+{
+  using namespace XrdCl;
+
+  XRootDStorage storage;
+  Server        server;
+  CPPUNIT_ASSERT( server.Setup( 10220, 1,
+                                new XRootDHandlerFactory( &storage ) ) );
+  CPPUNIT_ASSERT( server.Start() );
+  storage.PutFile( "/data/file", std::string( 10, 'x' ) );
+
+  Env *env = DefaultEnv::GetEnv();
+  env->PutInt( "MetadataCacheTTL", 60 );
+  FileSystem fs( URL( "root://127.0.0.1:10220" ) );
+  env->PutInt( "MetadataCacheTTL", 0 );
+  MetadataCache *cache = fs.GetMetadataCache();
+  CPPUNIT_ASSERT( cache );
+
+  //----------------------------------------------------------------------------
+  // Only the first stat of a file goes to the server
+  //----------------------------------------------------------------------------
+  uint32_t statCount = storage.GetStatCount();
+  for( int i = 0; i < 3; ++i )
+  {
+    StatInfo *info = 0;
+    CPPUNIT_ASSERT_XRDST( fs.Stat( "/data/file", info ) );
+    CPPUNIT_ASSERT( info );
+    CPPUNIT_ASSERT( info->GetSize() == 10 );
+    delete info;
+  }
+  CPPUNIT_ASSERT( storage.GetStatCount() == statCount+1 );
+  CPPUNIT_ASSERT( cache->GetHits() == 2 );
+  CPPUNIT_ASSERT( cache->GetMisses() == 1 );
+
+  //----------------------------------------------------------------------------
+  // The missing paths are cached too, until they are created
+  //----------------------------------------------------------------------------
+  for( int i = 0; i < 2; ++i )
+  {
+    StatInfo *info = 0;
+    XRootDStatus st = fs.Stat( "/data/newdir", info );
+    CPPUNIT_ASSERT( !st.IsOK() );
+    CPPUNIT_ASSERT( st.errNo == kXR_NotFound );
+    CPPUNIT_ASSERT( !info );
+  }
+  CPPUNIT_ASSERT( storage.GetStatCount() == statCount+2 );
+
+  CPPUNIT_ASSERT_XRDST( fs.MkDir( "/data/newdir", MkDirFlags::None,
+                                  Access::UR | Access::UW | Access::UX ) );
+  StatInfo *info = 0;
+  CPPUNIT_ASSERT_XRDST( fs.Stat( "/data/newdir", info ) );
+  CPPUNIT_ASSERT( info );
+  CPPUNIT_ASSERT( info->TestFlags( StatInfo::IsDir ) );
+  delete info;
+  CPPUNIT_ASSERT( storage.GetStatCount() == statCount+3 );
+
+  //----------------------------------------------------------------------------
+  // The response to a modification may come after the file system object
+  // is gone
+  //----------------------------------------------------------------------------
+  env->PutInt( "MetadataCacheTTL", 60 );
+  FileSystem *tmpFs = new FileSystem( URL( "root://127.0.0.1:10220" ) );
+  env->PutInt( "MetadataCacheTTL", 0 );
+  SyncResponseHandler handler;
+  CPPUNIT_ASSERT_XRDST( tmpFs->Rm( "/data/file", &handler ) );
+  delete tmpFs;
+  CPPUNIT_ASSERT_XRDST( MessageUtils::WaitForStatus( &handler ) );
+  std::string data;
+  CPPUNIT_ASSERT( !storage.GetFile( "/data/file", data ) );
+
+  storage.Disconnect();
+  CPPUNIT_ASSERT( server.Stop() );
+}
+
+//------------------------------------------------------------------------------
+// Deep locate through managers pointing at each other
+//------------------------------------------------------------------------------
+void FileSystemTest::DeepLocateManagersTest()
+{
+  using namespace XrdCl;
+
+  //----------------------------------------------------------------------------
+  // A redirector and two managers knowing about each other and about two
+  // servers, the servers themselves are never asked
+  //----------------------------------------------------------------------------
+  XRootDStorage storage[3];
+  Server        server[3];
+  for( int i = 0; i < 3; ++i )
+  {
+    CPPUNIT_ASSERT( server[i].Setup( 10225+i, 1,
+                                     new XRootDHandlerFactory( &storage[i] ) ) );
+    CPPUNIT_ASSERT( server[i].Start() );
+  }
+  storage[0].SetLocations( "Mr127.0.0.1:10226 Mr127.0.0.1:10227 "
+                           "Mr127.0.0.1:10226" );
+  storage[1].SetLocations( "Sr127.0.0.1:10228 Mr127.0.0.1:10227" );
+  storage[2].SetLocations( "Sr127.0.0.1:10228 Sr127.0.0.1:10229 "
+                           "Mr127.0.0.1:10226" );
+
+  Env *env = DefaultEnv::GetEnv();
+  env->PutInt( "ParallelLocates", 1 );
+  env->PutInt( "MetadataCacheTTL", 60 );
+  FileSystem fs( URL( "root://127.0.0.1:10225" ) );
+  env->PutInt( "MetadataCacheTTL", 0 );
+
+  //----------------------------------------------------------------------------
+  // Every manager is asked once and every server is reported once, the
+  // second time the answer comes from the cache
+  //----------------------------------------------------------------------------
+  for( int i = 0; i < 2; ++i )
+  {
+    LocationInfo *info = 0;
+    CPPUNIT_ASSERT_XRDST( fs.DeepLocate( "/data/file", OpenFlags::None,
+                                         info ) );
+    CPPUNIT_ASSERT( info );
+    CPPUNIT_ASSERT( info->GetSize() == 2 );
+    delete info;
+  }
+  CPPUNIT_ASSERT( storage[0].GetLocateCount() == 1 );
+  CPPUNIT_ASSERT( storage[1].GetLocateCount() == 1 );
+  CPPUNIT_ASSERT( storage[2].GetLocateCount() == 1 );
+
+  //----------------------------------------------------------------------------
+  // The managers are not asked when the redirector knows enough servers
+  //----------------------------------------------------------------------------
+  storage[0].SetLocations( "Sr127.0.0.1:10228 Mr127.0.0.1:10226" );
+  FileSystem fs2( URL( "root://127.0.0.1:10225" ) );
+  LocationInfo *info = 0;
+  CPPUNIT_ASSERT_XRDST( fs2.DeepLocate( "/data/file", OpenFlags::None, 1,
+                                        info ) );
+  CPPUNIT_ASSERT( info );
+  CPPUNIT_ASSERT( info->GetSize() == 1 );
+  CPPUNIT_ASSERT( info->Begin()->GetAddress() == "127.0.0.1:10228" );
+  delete info;
+  CPPUNIT_ASSERT( storage[0].GetLocateCount() == 2 );
+  CPPUNIT_ASSERT( storage[1].GetLocateCount() == 1 );
+
+  env->PutInt( "ParallelLocates", DefaultParallelLocates );
+  for( int i = 0; i < 3; ++i )
+  {
+    storage[i].Disconnect();
+    CPPUNIT_ASSERT( server[i].Stop() );
+  }
+}
+
+//------------------------------------------------------------------------------
+// Batches of requests
+//------------------------------------------------------------------------------
+void FileSystemTest::BatchTest()
+{
+  using namespace XrdCl;
+
+  XRootDStorage storage;
+  Server        server;
+  CPPUNIT_ASSERT( server.Setup( 10224, 1,
+                                new XRootDHandlerFactory( &storage ) ) );
+  CPPUNIT_ASSERT( server.Start() );
+
+  std::vector<std::string> files;
+  for( int i = 0; i < 10; ++i )
+  {
+    std::ostringstream o;
+    o << "/data/file" << i;
+    files.push_back( o.str() );
+    storage.PutFile( o.str(), std::string( 100, 'a'+i ) );
+  }
+
+  Env *env = DefaultEnv::GetEnv();
+  env->PutInt( "BatchWindow", 3 );
+  FileSystem fs( URL( "root://127.0.0.1:10224" ) );
+  std::vector<XRootDStatus> results;
+
+  //----------------------------------------------------------------------------
+  // Stat the files and a missing one
+  //----------------------------------------------------------------------------
+  std::vector<std::string> paths = files;
+  paths.push_back( "/data/missing" );
+  std::vector<StatInfo*> infos;
+  XRootDStatus st = fs.Stat( paths, infos, results );
+  CPPUNIT_ASSERT( st.IsOK() && st.code == suPartial );
+  CPPUNIT_ASSERT( infos.size() == 11 && results.size() == 11 );
+  for( int i = 0; i < 10; ++i )
+  {
+    CPPUNIT_ASSERT_XRDST( results[i] );
+    CPPUNIT_ASSERT( infos[i] && infos[i]->GetSize() == 100 );
+    delete infos[i];
+  }
+  CPPUNIT_ASSERT( !results[10].IsOK() );
+  CPPUNIT_ASSERT( results[10].errNo == kXR_NotFound );
+  CPPUNIT_ASSERT( !infos[10] );
+
+  //----------------------------------------------------------------------------
+  // Get the checksums
+  //----------------------------------------------------------------------------
+  std::vector<Buffer*> checkSums;
+  CPPUNIT_ASSERT_XRDST( fs.Query( QueryCode::Checksum, files, checkSums,
+                                  results ) );
+  for( int i = 0; i < 10; ++i )
+  {
+    CPPUNIT_ASSERT( checkSums[i] );
+    CPPUNIT_ASSERT( checkSums[i]->ToString().compare( 0, 8, "adler32 " ) == 0 );
+    delete checkSums[i];
+  }
+
+  //----------------------------------------------------------------------------
+  // Truncate the files
+  //----------------------------------------------------------------------------
+  CPPUNIT_ASSERT_XRDST( fs.Truncate( files, 10, results ) );
+  for( int i = 0; i < 10; ++i )
+  {
+    uint64_t size;
+    time_t   mtime;
+    CPPUNIT_ASSERT( storage.Stat( files[i], size, mtime ) );
+    CPPUNIT_ASSERT( size == 10 );
+  }
+
+  //----------------------------------------------------------------------------
+  // The parents are created first and removed last whatever the order
+  // of the paths
+  //----------------------------------------------------------------------------
+  std::vector<std::string> dirs;
+  dirs.push_back( "/data/a/b/c" );
+  dirs.push_back( "/data/a/b" );
+  dirs.push_back( "/data/a/d" );
+  dirs.push_back( "/data/a" );
+  CPPUNIT_ASSERT_XRDST( fs.MkDir( dirs, MkDirFlags::None,
+                                  Access::UR | Access::UW | Access::UX,
+                                  results ) );
+  CPPUNIT_ASSERT( storage.IsDirectory( "/data/a/b/c" ) );
+  CPPUNIT_ASSERT( storage.IsDirectory( "/data/a/d" ) );
+
+  std::reverse( dirs.begin(), dirs.end() );
+  CPPUNIT_ASSERT_XRDST( fs.RmDir( dirs, results ) );
+  CPPUNIT_ASSERT( !storage.IsDirectory( "/data/a" ) );
+
+  //----------------------------------------------------------------------------
+  // Remove the files, the second time every request fails
+  //----------------------------------------------------------------------------
+  CPPUNIT_ASSERT_XRDST( fs.Rm( files, results ) );
+  st = fs.Rm( files, results );
+  CPPUNIT_ASSERT( !st.IsOK() );
+  CPPUNIT_ASSERT( st.errNo == kXR_NotFound );
+  for( int i = 0; i < 10; ++i )
+    CPPUNIT_ASSERT( !results[i].IsOK() );
+
+  env->PutInt( "BatchWindow", DefaultBatchWindow );
+  storage.Disconnect();
+  CPPUNIT_ASSERT( server.Stop() );
+}
 
 //------------------------------------------------------------------------------
 // Set
@@ -22,12 +22,21 @@
 #include "CppUnitXrdHelpers.hh"
 #include "XrdCl/XrdClFile.hh"
 #include "XrdCl/XrdClDefaultEnv.hh"
+#include "XrdCl/XrdClConstants.hh"
 #include "XrdCl/XrdClMessage.hh"
 #include "XrdCl/XrdClSIDManager.hh"
 #include "XrdCl/XrdClPostMaster.hh"
 #include "XrdCl/XrdClXRootDTransport.hh"
 #include "XrdCl/XrdClMessageUtils.hh"
 #include "XrdCl/XrdClXRootDMsgHandler.hh"
+#include "XrdCl/XrdClRedirectCache.hh"
+#include "XrdCl/XrdClFileHandleCache.hh"
+#include "XrdCl/XrdClReadHedger.hh"
+#include "Server.hh"
+#include "XRootDEmulator.hh"
+#include <sstream>
+#include <cstdlib>
+#include <unistd.h>
 
 using namespace XrdClTests;
 
@@ -42,11 +51,23 @@ class FileTest: public CppUnit::TestCase
       CPPUNIT_TEST( ReadTest );
       CPPUNIT_TEST( WriteTest );
       CPPUNIT_TEST( VectorReadTest );
+      CPPUNIT_TEST( VectorReadSplitTest );
+      CPPUNIT_TEST( RedirectCacheTest );
+      CPPUNIT_TEST( BatchOpenTest );
+      CPPUNIT_TEST( FileHandleCacheTest );
+      CPPUNIT_TEST( HedgedReadTest );
+      CPPUNIT_TEST( PrefetchProfileTest );
     CPPUNIT_TEST_SUITE_END();
     void RedirectReturnTest();
     void ReadTest();
     void WriteTest();
     void VectorReadTest();
+    void VectorReadSplitTest();
+    void RedirectCacheTest();
+    void BatchOpenTest();
+    void FileHandleCacheTest();
+    void HedgedReadTest();
+    void PrefetchProfileTest();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION( FileTest );
@@ -332,3 +353,483 @@ void FileTest::VectorReadTest()
 
   delete [] buffer;
 }
+
+//------------------------------------------------------------------------------
+// Vector read exceeding the single request limits
+//------------------------------------------------------------------------------
+void FileTest::VectorReadSplitTest()
+{
+  using namespace XrdCl;
+
+  //----------------------------------------------------------------------------
+  // Initialize
+  //----------------------------------------------------------------------------
+  Env *testEnv = TestEnv::GetEnv();
+
+  std::string address;
+  std::string dataPath;
+
+  CPPUNIT_ASSERT( testEnv->GetString( "MainServerURL", address ) );
+  CPPUNIT_ASSERT( testEnv->GetString( "DataPath", dataPath ) );
+
+  URL url( address );
+  CPPUNIT_ASSERT( url.IsValid() );
+
+  std::string filePath = dataPath + "/a048e67f-4397-4bb8-85eb-8d7e40d90763.dat";
+  std::string fileUrl = address + "/";
+  fileUrl += filePath;
+
+  //----------------------------------------------------------------------------
+  // Make the limits small enough for the request to be split both by
+  // the number of segments and by size
+  //----------------------------------------------------------------------------
+  const uint32_t MB = 1024*1024;
+  Env *env = DefaultEnv::GetEnv();
+  env->PutInt( "MaxReadVSegments", 7 );
+  env->PutInt( "MaxReadVSize",     3*MB );
+
+  char *buffer = new char[40*MB];
+  File f;
+
+  ChunkList chunkList;
+  for( int i = 0; i < 40; ++i )
+    chunkList.push_back( ChunkInfo( (i+1)*10*MB, 1*MB ) );
+
+  //----------------------------------------------------------------------------
+  // Read the data and check that the merged response is consistent
+  //----------------------------------------------------------------------------
+  CPPUNIT_ASSERT( f.Open( fileUrl, OpenFlags::Read ).IsOK() );
+  VectorReadInfo *info = 0;
+  CPPUNIT_ASSERT( f.VectorRead( chunkList, buffer, info ).IsOK() );
+  CPPUNIT_ASSERT( info->GetSize() == 40*MB );
+  CPPUNIT_ASSERT( info->GetChunks().size() == 40 );
+  for( int i = 0; i < 40; ++i )
+  {
+    CPPUNIT_ASSERT( info->GetChunks()[i].offset == (uint64_t)(i+1)*10*MB );
+    CPPUNIT_ASSERT( info->GetChunks()[i].buffer == buffer+i*MB );
+  }
+  delete info;
+  uint32_t crc = Utils::ComputeCRC32( buffer, 40*MB );
+  CPPUNIT_ASSERT( crc == 3695956670 );
+  CPPUNIT_ASSERT( f.Close().IsOK() );
+
+  env->PutInt( "MaxReadVSegments", DefaultMaxReadVSegments );
+  env->PutInt( "MaxReadVSize",     DefaultMaxReadVSize );
+  delete [] buffer;
+}
+
+//------------------------------------------------------------------------------
+// Open at the remembered data server
+//------------------------------------------------------------------------------
+void FileTest::RedirectCacheTest()
+{
+  using namespace XrdCl;
+
+  //----------------------------------------------------------------------------
+  // A redirector sending the opens to one of two data servers
+  //----------------------------------------------------------------------------
+  XRootDStorage storage[3];
+  Server        server[3];
+  for( int i = 0; i < 3; ++i )
+  {
+    XRootDHandlerFactory *factory = new XRootDHandlerFactory( &storage[i] );
+    CPPUNIT_ASSERT( server[i].Setup( 10221+i, 1, factory ) );
+    CPPUNIT_ASSERT( server[i].Start() );
+  }
+  XRootDStorage &redirector = storage[0];
+  XRootDStorage &serverA    = storage[1];
+  XRootDStorage &serverB    = storage[2];
+  redirector.SetRedirect( "127.0.0.1", 10222, "test.server=a" );
+  serverA.PutFile( "/data/file", std::string( 10, 'a' ) );
+
+  Env *env = DefaultEnv::GetEnv();
+  env->PutInt( "RedirectCacheTTL", 60 );
+  RedirectCache *cache = DefaultEnv::GetRedirectCache();
+  CPPUNIT_ASSERT( cache );
+  uint64_t hits = cache->GetHits();
+
+  std::string fileUrl = "root://127.0.0.1:10221//data/file";
+  char        buffer[10];
+  uint32_t    bytesRead;
+
+  //----------------------------------------------------------------------------
+  // The first open goes through the redirector, the next one does not
+  //----------------------------------------------------------------------------
+  for( int i = 0; i < 2; ++i )
+  {
+    File f;
+    CPPUNIT_ASSERT_XRDST( f.Open( fileUrl, OpenFlags::Read ) );
+    CPPUNIT_ASSERT_XRDST( f.Read( 0, 10, buffer, bytesRead ) );
+    CPPUNIT_ASSERT( bytesRead == 10 && buffer[0] == 'a' );
+    CPPUNIT_ASSERT_XRDST( f.Close() );
+  }
+  CPPUNIT_ASSERT( redirector.GetOpenCount() == 1 );
+  CPPUNIT_ASSERT( serverA.GetOpenCount() == 2 );
+  CPPUNIT_ASSERT( cache->GetHits() == hits+1 );
+
+  //----------------------------------------------------------------------------
+  // The file moves, the remembered server fails and the redirector is asked
+  //----------------------------------------------------------------------------
+  serverA.RemoveFile( "/data/file" );
+  serverB.PutFile( "/data/file", std::string( 10, 'b' ) );
+  redirector.SetRedirect( "127.0.0.1", 10223, "test.server=b" );
+  for( int i = 0; i < 2; ++i )
+  {
+    File f;
+    CPPUNIT_ASSERT_XRDST( f.Open( fileUrl, OpenFlags::Read ) );
+    CPPUNIT_ASSERT_XRDST( f.Read( 0, 10, buffer, bytesRead ) );
+    CPPUNIT_ASSERT( bytesRead == 10 && buffer[0] == 'b' );
+    CPPUNIT_ASSERT_XRDST( f.Close() );
+  }
+  CPPUNIT_ASSERT( serverA.GetOpenCount() == 3 );
+  CPPUNIT_ASSERT( redirector.GetOpenCount() == 2 );
+  CPPUNIT_ASSERT( serverB.GetOpenCount() == 2 );
+
+  env->PutInt( "RedirectCacheTTL", DefaultRedirectCacheTTL );
+  for( int i = 0; i < 3; ++i )
+  {
+    storage[i].Disconnect();
+    CPPUNIT_ASSERT( server[i].Stop() );
+  }
+}
+
+//------------------------------------------------------------------------------
+// Open many files at a time
+//------------------------------------------------------------------------------
+void FileTest::BatchOpenTest()
+{
+  using namespace XrdCl;
+
+  //----------------------------------------------------------------------------
+  // Two servers holding some of the files each
+  //----------------------------------------------------------------------------
+  XRootDStorage storage[2];
+  Server        server[2];
+  for( int i = 0; i < 2; ++i )
+  {
+    XRootDHandlerFactory *factory = new XRootDHandlerFactory( &storage[i] );
+    CPPUNIT_ASSERT( server[i].Setup( 10230+i, 1, factory ) );
+    CPPUNIT_ASSERT( server[i].Start() );
+  }
+
+  std::vector<std::string> urls;
+  for( int i = 0; i < 10; ++i )
+  {
+    std::ostringstream path, url;
+    path << "/data/file" << i;
+    url  << "root://127.0.0.1:" << 10230+i%2 << "/" << path.str();
+    storage[i%2].PutFile( path.str(), std::string( 10, 'a'+i ) );
+    urls.push_back( url.str() );
+  }
+  urls.push_back( "root://127.0.0.1:10230//data/missing" );
+
+  //----------------------------------------------------------------------------
+  // Open them a few at a time, the missing one fails alone
+  //----------------------------------------------------------------------------
+  Env *env = DefaultEnv::GetEnv();
+  env->PutInt( "BatchWindow", 3 );
+  std::vector<File*>        files;
+  std::vector<XRootDStatus> results;
+  XRootDStatus st = File::Open( urls, OpenFlags::Read, 0, files, results );
+  env->PutInt( "BatchWindow", DefaultBatchWindow );
+
+  CPPUNIT_ASSERT( st.IsOK() && st.code == suPartial );
+  CPPUNIT_ASSERT( files.size() == 11 && results.size() == 11 );
+  CPPUNIT_ASSERT( !results[10].IsOK() );
+  CPPUNIT_ASSERT( results[10].errNo == kXR_NotFound );
+  CPPUNIT_ASSERT( !files[10] );
+  CPPUNIT_ASSERT( storage[0].GetOpenCount() == 6 );
+  CPPUNIT_ASSERT( storage[1].GetOpenCount() == 5 );
+
+  char     buffer[10];
+  uint32_t bytesRead;
+  for( int i = 0; i < 10; ++i )
+  {
+    CPPUNIT_ASSERT_XRDST( results[i] );
+    CPPUNIT_ASSERT( files[i] && files[i]->IsOpen() );
+    CPPUNIT_ASSERT_XRDST( files[i]->Read( 0, 10, buffer, bytesRead ) );
+    CPPUNIT_ASSERT( bytesRead == 10 && buffer[0] == 'a'+i );
+    CPPUNIT_ASSERT_XRDST( files[i]->Close() );
+    delete files[i];
+  }
+
+  for( int i = 0; i < 2; ++i )
+  {
+    storage[i].Disconnect();
+    CPPUNIT_ASSERT( server[i].Stop() );
+  }
+}
+
+//------------------------------------------------------------------------------
+// Keep the handles of the closed files open for a while
+//------------------------------------------------------------------------------
+void FileTest::FileHandleCacheTest()
+{
+  using namespace XrdCl;
+
+  XRootDStorage storage;
+  Server        server;
+  CPPUNIT_ASSERT( server.Setup( 10232, 1,
+                                new XRootDHandlerFactory( &storage ) ) );
+  CPPUNIT_ASSERT( server.Start() );
+  storage.PutFile( "/data/file", std::string( 10, 'a' ) );
+
+  Env *env = DefaultEnv::GetEnv();
+  env->PutInt( "FileHandleLinger", 2 );
+  FileHandleCache *cache = DefaultEnv::GetFileHandleCache();
+  CPPUNIT_ASSERT( cache );
+  uint64_t hits = cache->GetHits();
+
+  std::string fileUrl = "root://127.0.0.1:10232//data/file";
+  char        buffer[10];
+  uint32_t    bytesRead;
+
+  //----------------------------------------------------------------------------
+  // Only the first open goes to the server
+  //----------------------------------------------------------------------------
+  for( int i = 0; i < 3; ++i )
+  {
+    File f;
+    CPPUNIT_ASSERT_XRDST( f.Open( fileUrl, OpenFlags::Read ) );
+    CPPUNIT_ASSERT_XRDST( f.Read( 0, 10, buffer, bytesRead ) );
+    CPPUNIT_ASSERT( bytesRead == 10 && buffer[0] == 'a' );
+    CPPUNIT_ASSERT_XRDST( f.Close() );
+    CPPUNIT_ASSERT( !f.IsOpen() );
+  }
+  CPPUNIT_ASSERT( storage.GetOpenCount() == 1 );
+  CPPUNIT_ASSERT( cache->GetHits() == hits+2 );
+  CPPUNIT_ASSERT( cache->GetSize() == 1 );
+
+  //----------------------------------------------------------------------------
+  // The files open for writing are closed right away
+  //----------------------------------------------------------------------------
+  File out;
+  CPPUNIT_ASSERT_XRDST( out.Open( "root://127.0.0.1:10232//data/out",
+                                  OpenFlags::Delete | OpenFlags::Update,
+                                  Access::UR | Access::UW ) );
+  CPPUNIT_ASSERT_XRDST( out.Write( 0, 10, buffer ) );
+  CPPUNIT_ASSERT_XRDST( out.Close() );
+  CPPUNIT_ASSERT( cache->GetSize() == 1 );
+
+  //----------------------------------------------------------------------------
+  // The handle is closed for real after the linger time
+  //----------------------------------------------------------------------------
+  ::sleep( 4 );
+  CPPUNIT_ASSERT( cache->GetSize() == 0 );
+  File f;
+  CPPUNIT_ASSERT_XRDST( f.Open( fileUrl, OpenFlags::Read ) );
+  CPPUNIT_ASSERT( storage.GetOpenCount() == 3 );
+
+  env->PutInt( "FileHandleLinger", DefaultFileHandleLinger );
+  CPPUNIT_ASSERT( !DefaultEnv::GetFileHandleCache() );
+  CPPUNIT_ASSERT_XRDST( f.Close() );
+  CPPUNIT_ASSERT( cache->GetSize() == 0 );
+
+  storage.Disconnect();
+  CPPUNIT_ASSERT( server.Stop() );
+}
+
+//------------------------------------------------------------------------------
+// Count the responses and keep the last one
+//------------------------------------------------------------------------------
+class ResponseCounter: public XrdCl::ResponseHandler
+{
+  public:
+    ResponseCounter(): pCount( 0 ), pLength( 0 ), pSem( 0 ) {}
+
+    virtual void HandleResponse( XrdCl::XRootDStatus *status,
+                                 XrdCl::AnyObject    *response )
+    {
+      XrdCl::ChunkInfo *chunk = 0;
+      if( response )
+        response->Get( chunk );
+
+      pMutex.Lock();
+      ++pCount;
+      pStatus = *status;
+      pLength = chunk ? chunk->length : 0;
+      pMutex.UnLock();
+
+      delete status;
+      delete response;
+      pSem.Post();
+    }
+
+    void Wait() { pSem.Wait(); }
+
+    uint32_t GetCount()
+    {
+      XrdSysMutexHelper scopedLock( pMutex );
+      return pCount;
+    }
+
+    uint32_t GetLength()
+    {
+      XrdSysMutexHelper scopedLock( pMutex );
+      return pLength;
+    }
+
+    XrdCl::XRootDStatus GetStatus()
+    {
+      XrdSysMutexHelper scopedLock( pMutex );
+      return pStatus;
+    }
+
+  private:
+    XrdSysMutex         pMutex;
+    uint32_t            pCount;
+    uint32_t            pLength;
+    XrdCl::XRootDStatus pStatus;
+    XrdSysSemaphore     pSem;
+};
+
+//------------------------------------------------------------------------------
+// Duplicate a slow read to another replica
+//------------------------------------------------------------------------------
+void FileTest::HedgedReadTest()
+{
+  using namespace XrdCl;
+
+  //----------------------------------------------------------------------------
+  // A manager sending the clients to a slow server and the ones that have
+  // tried it already to a fast one, the replicas differ so that we know
+  // which one has been read
+  //----------------------------------------------------------------------------
+  XRootDStorage storage[3];
+  Server        server[3];
+  for( int i = 0; i < 3; ++i )
+  {
+    XRootDHandlerFactory *factory = new XRootDHandlerFactory( &storage[i] );
+    CPPUNIT_ASSERT( server[i].Setup( 10233+i, 1, factory ) );
+    CPPUNIT_ASSERT( server[i].Start() );
+  }
+  storage[0].SetManager( true );
+  storage[0].SetRedirect( "127.0.0.1", 10234, "" );
+  storage[0].SetTriedRedirect( "127.0.0.1", 10235 );
+  storage[1].PutFile( "/data/file", std::string( 1000, 'a' ) );
+  storage[1].SetReadDelay( 3000 );
+  storage[2].PutFile( "/data/file", std::string( 1000, 'b' ) );
+
+  Env *env = DefaultEnv::GetEnv();
+  env->PutInt( "ReadHedging",       1 );
+  env->PutInt( "ReadHedgeMinDelay", 10 );
+  env->PutInt( "ReadHedgeMaxDelay", 100 );
+
+  File f;
+  CPPUNIT_ASSERT_XRDST( f.Open( "root://127.0.0.1:10233//data/file",
+                                OpenFlags::Read ) );
+
+  //----------------------------------------------------------------------------
+  // The first read is duplicated once the replica has been opened and the
+  // fast server answers first
+  //----------------------------------------------------------------------------
+  char buffer[1000];
+  memset( buffer, 0, 1000 );
+  ResponseCounter handler;
+  uint64_t start = ReadHedger::Now();
+  CPPUNIT_ASSERT_XRDST( f.Read( 0, 1000, buffer, &handler ) );
+  handler.Wait();
+  CPPUNIT_ASSERT( ReadHedger::Now() - start < 3000 );
+  CPPUNIT_ASSERT_XRDST( handler.GetStatus() );
+  CPPUNIT_ASSERT( handler.GetLength() == 1000 );
+  CPPUNIT_ASSERT( std::string( buffer, 1000 ) == std::string( 1000, 'b' ) );
+
+  //----------------------------------------------------------------------------
+  // The slow response is discarded when it arrives
+  //----------------------------------------------------------------------------
+  ::sleep( 4 );
+  CPPUNIT_ASSERT( handler.GetCount() == 1 );
+  CPPUNIT_ASSERT( std::string( buffer, 1000 ) == std::string( 1000, 'b' ) );
+
+  //----------------------------------------------------------------------------
+  // The file may be closed while the beaten read is still outstanding, the
+  // close waits for it
+  //----------------------------------------------------------------------------
+  ResponseCounter beaten;
+  start = ReadHedger::Now();
+  CPPUNIT_ASSERT_XRDST( f.Read( 0, 1000, buffer, &beaten ) );
+  beaten.Wait();
+  CPPUNIT_ASSERT( ReadHedger::Now() - start < 3000 );
+  CPPUNIT_ASSERT_XRDST( beaten.GetStatus() );
+  CPPUNIT_ASSERT_XRDST( f.Close() );
+  CPPUNIT_ASSERT( beaten.GetCount() == 1 );
+  CPPUNIT_ASSERT( std::string( buffer, 1000 ) == std::string( 1000, 'b' ) );
+
+  env->PutInt( "ReadHedging",       DefaultReadHedging );
+  env->PutInt( "ReadHedgeMinDelay", DefaultReadHedgeMinDelay );
+  env->PutInt( "ReadHedgeMaxDelay", DefaultReadHedgeMaxDelay );
+
+  for( int i = 0; i < 3; ++i )
+  {
+    storage[i].Disconnect();
+    CPPUNIT_ASSERT( server[i].Stop() );
+  }
+}
+
+//------------------------------------------------------------------------------
+// Record the reads of a file and prefetch them for the next one
+//------------------------------------------------------------------------------
+void FileTest::PrefetchProfileTest()
+{
+  using namespace XrdCl;
+
+  XRootDStorage storage;
+  Server        server;
+  CPPUNIT_ASSERT( server.Setup( 10236, 1,
+                                new XRootDHandlerFactory( &storage ) ) );
+  CPPUNIT_ASSERT( server.Start() );
+
+  std::string data( 1024*1024, 0 );
+  for( uint32_t i = 0; i < data.size(); ++i )
+    data[i] = i % 251;
+  storage.PutFile( "/data/run1/file", data );
+  storage.PutFile( "/data/run2/file", data );
+
+  char dir[] = "/tmp/xrdcl-prefetch-XXXXXX";
+  CPPUNIT_ASSERT( mkdtemp( dir ) );
+  Env *env = DefaultEnv::GetEnv();
+  env->PutString( "PrefetchProfileDir", dir );
+
+  //----------------------------------------------------------------------------
+  // The reads of the first file are recorded when it is closed
+  //----------------------------------------------------------------------------
+  char     buffer[2000];
+  uint32_t bytesRead;
+  File     first;
+  CPPUNIT_ASSERT_XRDST( first.Open( "root://127.0.0.1:10236//data/run1/file",
+                                    OpenFlags::Read ) );
+  CPPUNIT_ASSERT_XRDST( first.Read( 0, 1000, buffer, bytesRead ) );
+  CPPUNIT_ASSERT_XRDST( first.Read( 500000, 2000, buffer, bytesRead ) );
+  CPPUNIT_ASSERT_XRDST( first.Close() );
+
+  //----------------------------------------------------------------------------
+  // The second file of the same class is prefetched when it is opened,
+  // the same reads don't go to the server
+  //----------------------------------------------------------------------------
+  File second;
+  CPPUNIT_ASSERT_XRDST( second.Open( "root://127.0.0.1:10236//data/run2/file",
+                                     OpenFlags::Read ) );
+  ::sleep( 1 );
+  uint64_t serverBytes = storage.GetBytesRead();
+  CPPUNIT_ASSERT_XRDST( second.Read( 0, 1000, buffer, bytesRead ) );
+  CPPUNIT_ASSERT( bytesRead == 1000 );
+  CPPUNIT_ASSERT( std::string( buffer, 1000 ) == data.substr( 0, 1000 ) );
+  CPPUNIT_ASSERT_XRDST( second.Read( 500000, 2000, buffer, bytesRead ) );
+  CPPUNIT_ASSERT( bytesRead == 2000 );
+  CPPUNIT_ASSERT( std::string( buffer, 2000 ) == data.substr( 500000, 2000 ) );
+  CPPUNIT_ASSERT( storage.GetBytesRead() == serverBytes );
+
+  //----------------------------------------------------------------------------
+  // Anything else still goes to the server
+  //----------------------------------------------------------------------------
+  CPPUNIT_ASSERT_XRDST( second.Read( 900000, 100, buffer, bytesRead ) );
+  CPPUNIT_ASSERT( storage.GetBytesRead() == serverBytes+100 );
+  CPPUNIT_ASSERT_XRDST( second.Close() );
+
+  env->PutString( "PrefetchProfileDir", DefaultPrefetchProfileDir );
+  std::string cmd = "rm -rf "; cmd += dir;
+  CPPUNIT_ASSERT( system( cmd.c_str() ) == 0 );
+
+  storage.Disconnect();
+  CPPUNIT_ASSERT( server.Stop() );
+}
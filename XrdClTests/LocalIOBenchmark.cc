@@ -0,0 +1,145 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+
+#include "XrdCl/XrdClCopyProcess.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include "XrdCl/XrdClUtils.hh"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+//------------------------------------------------------------------------------
+// Create the source file
+//------------------------------------------------------------------------------
+bool CreateSource( const std::string &path, uint64_t size )
+{
+  int fd = open( path.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644 );
+  if( fd == -1 )
+    return false;
+
+  const uint32_t  bufferSize = 4*1024*1024;
+  char           *buffer     = new char[bufferSize];
+  for( uint32_t i = 0; i < bufferSize; ++i )
+    buffer[i] = random();
+
+  bool ok = true;
+  for( uint64_t written = 0; ok && written < size; )
+  {
+    uint32_t toWrite = size - written < bufferSize ? size - written :
+                                                     bufferSize;
+    ok       = write( fd, buffer, toWrite ) == (ssize_t)toWrite;
+    written += toWrite;
+  }
+  delete [] buffer;
+  close( fd );
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Copy the file using the given engine and measure the throughput in MB/s
+//------------------------------------------------------------------------------
+double Measure( const std::string &engine, const std::string &source,
+                const std::string &destination, uint64_t size,
+                const std::string &checkSum )
+{
+  using namespace XrdCl;
+  DefaultEnv::GetEnv()->PutString( "CPLocalIOEngine", engine );
+
+  CopyProcess process;
+  process.AddSource( "file://" + source );
+  process.SetDestination( "file://" + destination );
+  process.SetForce( true );
+  if( !checkSum.empty() )
+    process.EnableCheckSumVerification( checkSum );
+
+  timeval start, end;
+  gettimeofday( &start, 0 );
+  XRootDStatus st = process.Prepare();
+  if( st.IsOK() )
+    st = process.Run();
+  gettimeofday( &end, 0 );
+
+  struct stat buf;
+  if( !st.IsOK() || stat( destination.c_str(), &buf ) ||
+      (uint64_t)buf.st_size != size )
+  {
+    std::cerr << engine << ": copy failed: " << st.ToStr() << std::endl;
+    return -1;
+  }
+
+  uint64_t usecs = Utils::GetElapsedMicroSecs( start, end );
+  if( !usecs )
+    usecs = 1;
+  return (double)size / usecs;
+}
+
+//------------------------------------------------------------------------------
+// Start the show
+//------------------------------------------------------------------------------
+int main( int argc, char **argv )
+{
+  if( argc < 2 )
+  {
+    std::cerr << "Usage: " << argv[0] << " directory [size in MB] ";
+    std::cerr << "[checksum type]" << std::endl;
+    return 1;
+  }
+
+  std::string dir      = argv[1];
+  uint64_t    size     = 1024;
+  std::string checkSum;
+  if( argc > 2 ) size     = atoll( argv[2] );
+  if( argc > 3 ) checkSum = argv[3];
+  size *= 1024*1024;
+
+  std::string source      = dir + "/localio-benchmark.src";
+  std::string destination = dir + "/localio-benchmark.dst";
+  if( !CreateSource( source, size ) )
+  {
+    std::cerr << "Unable to create " << source << std::endl;
+    return 1;
+  }
+
+  //----------------------------------------------------------------------------
+  // The first run warms up the page cache, so that the engines that go
+  // around it don't get an advantage over the ones that use it
+  //----------------------------------------------------------------------------
+  const char *engines[] = { "posix", "posix", "auto", "fadvise", "direct",
+                            "mmap" };
+  std::cout << std::setw(10) << "engine" << std::setw(12) << "MB/s";
+  std::cout << std::endl;
+  for( int i = 0; i < 6; ++i )
+  {
+    double rate = Measure( engines[i], source, destination, size, checkSum );
+    if( i == 0 )
+      continue;
+    std::cout << std::setw(10) << engines[i] << std::fixed;
+    std::cout << std::setprecision(1) << std::setw(12) << rate << std::endl;
+  }
+
+  unlink( source.c_str() );
+  unlink( destination.c_str() );
+  return 0;
+}
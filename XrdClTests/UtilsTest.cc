@@ -22,6 +22,24 @@
 #include "XrdCl/XrdClAnyObject.hh"
 #include "XrdCl/XrdClTaskManager.hh"
 #include "XrdCl/XrdClSIDManager.hh"
+#include "XrdCl/XrdClPrefetchProfile.hh"
+#include "XrdCl/XrdClReadHedger.hh"
+#include "XrdCl/XrdClCopyProcess.hh"
+#include "XrdCl/XrdClCopyTuner.hh"
+#include "XrdCl/XrdClConstants.hh"
+#include "XrdCl/XrdClCheckSumCalc.hh"
+#include "XrdCl/XrdClDefaultEnv.hh"
+#include "XrdCl/XrdClUtils.hh"
+#include "XrdCks/XrdCks.hh"
+#include "XrdCks/XrdCksCalc.hh"
+#include "XrdCks/XrdCksData.hh"
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <unistd.h>
+#include <zlib.h>
 
 //------------------------------------------------------------------------------
 // Declaration
@@ -34,11 +52,23 @@ class UtilsTest: public CppUnit::TestCase
       CPPUNIT_TEST( AnyTest );
       CPPUNIT_TEST( TaskManagerTest );
       CPPUNIT_TEST( SIDManagerTest );
+      CPPUNIT_TEST( PrefetchProfileTest );
+      CPPUNIT_TEST( ReadHedgerTest );
+      CPPUNIT_TEST( CopyBudgetTest );
+      CPPUNIT_TEST( CopyTunerTest );
+      CPPUNIT_TEST( CheckSumCalcTest );
+      CPPUNIT_TEST( CheckSumCombineTest );
     CPPUNIT_TEST_SUITE_END();
     void URLTest();
     void AnyTest();
     void TaskManagerTest();
     void SIDManagerTest();
+    void PrefetchProfileTest();
+    void ReadHedgerTest();
+    void CopyBudgetTest();
+    void CopyTunerTest();
+    void CheckSumCalcTest();
+    void CheckSumCombineTest();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION( UtilsTest );
@@ -384,3 +414,408 @@ void UtilsTest::SIDManagerTest()
   manager.ReleaseAllTimedOut();
   CPPUNIT_ASSERT( manager.NumberOfTimedOutSIDs() == 0 );
 }
+
+//------------------------------------------------------------------------------
+// Prefetch profile test
+//------------------------------------------------------------------------------
+void UtilsTest::PrefetchProfileTest()
+{
+  using namespace XrdCl;
+
+  //----------------------------------------------------------------------------
+  // Files differing only by numbers and of similar size share the profile
+  //----------------------------------------------------------------------------
+  std::string fp1 = PrefetchProfileStore::GetFingerprint( "/data/run12/f_001.root", 3000000 );
+  std::string fp2 = PrefetchProfileStore::GetFingerprint( "/data/run345/f_7.root", 3500000 );
+  std::string fp3 = PrefetchProfileStore::GetFingerprint( "/data/run12/f_001.root", 300 );
+  CPPUNIT_ASSERT( fp1 == fp2 );
+  CPPUNIT_ASSERT( fp1 != fp3 );
+
+  //----------------------------------------------------------------------------
+  // Coalescing
+  //----------------------------------------------------------------------------
+  ChunkList ranges, result;
+  ranges.push_back( ChunkInfo( 1000, 100 ) );
+  ranges.push_back( ChunkInfo( 0,    100 ) );
+  ranges.push_back( ChunkInfo( 150,  100 ) );
+  ranges.push_back( ChunkInfo( 5000, 100 ) );
+  ranges.push_back( ChunkInfo( 9950, 100 ) );
+  PrefetchProfileStore::Coalesce( ranges, result, 10000, 100, 1000, 100000 );
+  CPPUNIT_ASSERT( result.size() == 4 );
+  CPPUNIT_ASSERT( result[0].offset == 0    && result[0].length == 250 );
+  CPPUNIT_ASSERT( result[1].offset == 1000 && result[1].length == 100 );
+  CPPUNIT_ASSERT( result[2].offset == 5000 && result[2].length == 100 );
+  CPPUNIT_ASSERT( result[3].offset == 9950 && result[3].length == 50 );
+
+  result.clear();
+  PrefetchProfileStore::Coalesce( ranges, result, 10000, 100, 1000, 300 );
+  CPPUNIT_ASSERT( result.size() == 2 );
+
+  //----------------------------------------------------------------------------
+  // Store and load
+  //----------------------------------------------------------------------------
+  char dir[] = "/tmp/xrdcl-prefetch-XXXXXX";
+  CPPUNIT_ASSERT( mkdtemp( dir ) );
+  PrefetchProfileStore store( dir );
+  ChunkList loaded;
+  CPPUNIT_ASSERT( !store.Load( fp1, loaded ) );
+  CPPUNIT_ASSERT_XRDST( store.Save( fp1, ranges ) );
+  CPPUNIT_ASSERT( store.Load( fp2, loaded ) );
+  CPPUNIT_ASSERT( loaded.size() == ranges.size() );
+  for( size_t i = 0; i < ranges.size(); ++i )
+  {
+    CPPUNIT_ASSERT( loaded[i].offset == ranges[i].offset );
+    CPPUNIT_ASSERT( loaded[i].length == ranges[i].length );
+  }
+  loaded.clear();
+  CPPUNIT_ASSERT( !store.Load( fp3, loaded ) );
+  std::string cmd = "rm -rf "; cmd += dir;
+  CPPUNIT_ASSERT( system( cmd.c_str() ) == 0 );
+
+  //----------------------------------------------------------------------------
+  // Prefetch cache
+  //----------------------------------------------------------------------------
+  PrefetchCache *cache = new PrefetchCache( result );
+  char buffer[100];
+  CPPUNIT_ASSERT( !cache->Read( 10, 10, buffer ) );
+  memset( cache->GetChunks()[0].buffer, 'a', result[0].length );
+  cache->SetReady( 0, 1 );
+  CPPUNIT_ASSERT( cache->Read( 10, 10, buffer ) );
+  CPPUNIT_ASSERT( buffer[0] == 'a' && buffer[9] == 'a' );
+  CPPUNIT_ASSERT( !cache->Read( 200, 100, buffer ) );
+
+  uint64_t bytes, wasted; uint32_t hits, misses;
+  cache->GetStats( bytes, wasted, hits, misses );
+  CPPUNIT_ASSERT( bytes  == result[0].length );
+  CPPUNIT_ASSERT( wasted == result[0].length - 10 );
+  CPPUNIT_ASSERT( hits == 1 && misses == 2 );
+
+  //----------------------------------------------------------------------------
+  // The bytes read more than once are used only once
+  //----------------------------------------------------------------------------
+  CPPUNIT_ASSERT( cache->Read( 10, 10, buffer ) );
+  CPPUNIT_ASSERT( cache->Read( 15, 10, buffer ) );
+  CPPUNIT_ASSERT( cache->Read( 30, 5, buffer ) );
+  cache->GetStats( bytes, wasted, hits, misses );
+  CPPUNIT_ASSERT( wasted == result[0].length - 20 );
+  CPPUNIT_ASSERT( cache->Read( 20, 12, buffer ) );
+  cache->GetStats( bytes, wasted, hits, misses );
+  CPPUNIT_ASSERT( wasted == result[0].length - 25 );
+  CPPUNIT_ASSERT( hits == 5 && misses == 2 );
+  cache->UnRef();
+}
+
+//------------------------------------------------------------------------------
+// Read hedger test
+//------------------------------------------------------------------------------
+void UtilsTest::ReadHedgerTest()
+{
+  using namespace XrdCl;
+  ReadHedger hedger;
+
+  //----------------------------------------------------------------------------
+  // Delays
+  //----------------------------------------------------------------------------
+  CPPUNIT_ASSERT( hedger.GetDelay( "srv1:1094" ) ==
+                  (uint32_t)DefaultReadHedgeMaxDelay );
+
+  for( uint32_t i = 1; i <= 10; ++i )
+    hedger.AddSample( "srv1:1094", 1000 );
+  CPPUNIT_ASSERT( hedger.GetDelay( "srv1:1094" ) ==
+                  (uint32_t)DefaultReadHedgeMaxDelay );
+
+  for( uint32_t i = 1; i <= 100; ++i )
+    hedger.AddSample( "srv2:1094", i*10 );
+  CPPUNIT_ASSERT( hedger.GetDelay( "srv2:1094" ) == 960 );
+
+  for( uint32_t i = 1; i <= 1000; ++i )
+    hedger.AddSample( "srv2:1094", 1 );
+  CPPUNIT_ASSERT( hedger.GetDelay( "srv2:1094" ) ==
+                  (uint32_t)DefaultReadHedgeMinDelay );
+
+  for( uint32_t i = 1; i <= 1000; ++i )
+    hedger.AddSample( "srv2:1094", 100000 );
+  CPPUNIT_ASSERT( hedger.GetDelay( "srv2:1094" ) ==
+                  (uint32_t)DefaultReadHedgeMaxDelay );
+
+  //----------------------------------------------------------------------------
+  // Slots
+  //----------------------------------------------------------------------------
+  for( int i = 0; i < DefaultReadHedgeMaxInFlight; ++i )
+    CPPUNIT_ASSERT( hedger.AcquireSlot() );
+  CPPUNIT_ASSERT( !hedger.AcquireSlot() );
+  hedger.ReleaseSlot();
+  CPPUNIT_ASSERT( hedger.AcquireSlot() );
+  for( int i = 0; i < DefaultReadHedgeMaxInFlight; ++i )
+    hedger.ReleaseSlot();
+}
+
+//------------------------------------------------------------------------------
+// Copy budget test
+//------------------------------------------------------------------------------
+void UtilsTest::CopyBudgetTest()
+{
+  using namespace XrdCl;
+  CopyBudget budget( 100 );
+
+  CPPUNIT_ASSERT( budget.Acquire( 60, false ) );
+  CPPUNIT_ASSERT( budget.Acquire( 40, false ) );
+  CPPUNIT_ASSERT( !budget.Acquire( 1, false ) );
+  budget.Release( 40 );
+  CPPUNIT_ASSERT( !budget.Acquire( 50, false ) );
+  CPPUNIT_ASSERT( budget.Acquire( 30, true ) );
+  budget.Release( 60 );
+  budget.Release( 30 );
+
+  //----------------------------------------------------------------------------
+  // Requests bigger than the limit go through when nothing is reserved
+  //----------------------------------------------------------------------------
+  CPPUNIT_ASSERT( budget.Acquire( 500, true ) );
+  CPPUNIT_ASSERT( !budget.Acquire( 1, false ) );
+  budget.Release( 500 );
+  CPPUNIT_ASSERT( budget.Acquire( 100, false ) );
+  budget.Release( 100 );
+}
+
+//------------------------------------------------------------------------------
+// Copy tuner test
+//------------------------------------------------------------------------------
+void UtilsTest::CopyTunerTest()
+{
+  using namespace XrdCl;
+
+  //----------------------------------------------------------------------------
+  // The initial parameters are aligned and kept within the bounds
+  //----------------------------------------------------------------------------
+  CopyTuner bounded( true, 1000, 40, 4096, 4*1024*1024, 1, 16 );
+  CPPUNIT_ASSERT( bounded.GetChunkSize() == 4096 );
+  CPPUNIT_ASSERT( bounded.GetParallelChunks() == 16 );
+
+  //----------------------------------------------------------------------------
+  // Fast chunks grow the chunk size and then the number of chunks
+  //----------------------------------------------------------------------------
+  CopyTuner tuner( true, 256*1024, 4, 4096, 4*1024*1024, 1, 16 );
+  CPPUNIT_ASSERT( tuner.GetChunkSize() == 256*1024 );
+  CPPUNIT_ASSERT( tuner.GetParallelChunks() == 4 );
+
+  uint32_t length = 64*1024*1024;
+  for( uint64_t i = 0; i < 50 && tuner.GetChunkSize() == 256*1024; ++i )
+  {
+    tuner.ChunkSent( i*length );
+    usleep( 20000 );
+    tuner.ChunkDone( i*length, length );
+  }
+  CPPUNIT_ASSERT( tuner.GetChunkSize() == 4*1024*1024 );
+  CPPUNIT_ASSERT( tuner.GetParallelChunks() == 16 );
+  CPPUNIT_ASSERT( tuner.GetMinRoundTrip() >= 20000 );
+  CPPUNIT_ASSERT( tuner.GetThroughput() > 0 );
+
+  //----------------------------------------------------------------------------
+  // Running out of the budget halves the bytes in the fly, but only once
+  // per adjustment interval
+  //----------------------------------------------------------------------------
+  tuner.BudgetExhausted();
+  CPPUNIT_ASSERT( tuner.GetChunkSize() == 4*1024*1024 );
+  CPPUNIT_ASSERT( tuner.GetParallelChunks() == 8 );
+  tuner.BudgetExhausted();
+  CPPUNIT_ASSERT( tuner.GetChunkSize() == 4*1024*1024 );
+  CPPUNIT_ASSERT( tuner.GetParallelChunks() == 8 );
+
+  //----------------------------------------------------------------------------
+  // Without adaptation the parameters stay as they are
+  //----------------------------------------------------------------------------
+  CopyTuner fixed( false, 1000, 3, 4096, 4*1024*1024, 1, 16 );
+  for( uint64_t i = 0; i < 5; ++i )
+  {
+    fixed.ChunkSent( i*length );
+    usleep( 20000 );
+    fixed.ChunkDone( i*length, length );
+  }
+  fixed.BudgetExhausted();
+  CPPUNIT_ASSERT( fixed.GetChunkSize() == 1000 );
+  CPPUNIT_ASSERT( fixed.GetParallelChunks() == 3 );
+}
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Compute a checksum feeding the buffer in two pieces
+  //----------------------------------------------------------------------------
+  std::string CheckSum( const std::string &type, bool accelerated,
+                        const char *buffer, uint32_t length, uint32_t split )
+  {
+    std::auto_ptr<XrdCl::CheckSumCalc> calc(
+      XrdCl::CheckSumCalc::Create( type, accelerated ) );
+    CPPUNIT_ASSERT( calc.get() );
+    calc->Update( buffer, split );
+    calc->Update( buffer+split, length-split );
+    return calc->GetCheckSum();
+  }
+
+  //----------------------------------------------------------------------------
+  // Format a 32 bit checksum
+  //----------------------------------------------------------------------------
+  std::string Format32( const std::string &type, uint32_t value )
+  {
+    char buff[16];
+    snprintf( buff, 16, "%08x", value );
+    return type + ":" + buff;
+  }
+}
+
+//------------------------------------------------------------------------------
+// Checksum calculator test
+//------------------------------------------------------------------------------
+void UtilsTest::CheckSumCalcTest()
+{
+  using namespace XrdCl;
+  const char *types[] = { "adler32", "crc32", "zcrc32", "crc32c" };
+
+  //----------------------------------------------------------------------------
+  // Check values
+  //----------------------------------------------------------------------------
+  const char *check = "123456789";
+  for( int acc = 0; acc < 2; ++acc )
+  {
+    CPPUNIT_ASSERT( CheckSum( "adler32", acc, check, 9, 4 ) ==
+                    "adler32:091e01de" );
+    CPPUNIT_ASSERT( CheckSum( "crc32",   acc, check, 9, 4 ) ==
+                    "crc32:377a6011" );
+    CPPUNIT_ASSERT( CheckSum( "zcrc32",  acc, check, 9, 4 ) ==
+                    "zcrc32:cbf43926" );
+    CPPUNIT_ASSERT( CheckSum( "crc32c",  acc, check, 9, 4 ) ==
+                    "crc32c:e3069283" );
+  }
+
+  //----------------------------------------------------------------------------
+  // Random data at various lengths, offsets and split points, including
+  // the all-ones blocks that stress the sum reduction
+  //----------------------------------------------------------------------------
+  const uint32_t  size   = 1024*1024;
+  char           *buffer = new char[size+64];
+  for( uint32_t i = 0; i < size+64; ++i )
+    buffer[i] = random();
+  memset( buffer+size/2, 0xff, size/4 );
+
+  uint32_t lengths[] = { 0, 1, 7, 15, 16, 31, 63, 64, 65, 127, 1000, 5552,
+                         5553, 65536, 100003, size };
+  for( size_t l = 0; l < sizeof(lengths)/sizeof(uint32_t); ++l )
+  {
+    for( uint32_t offset = 0; offset < 64; offset += 13 )
+    {
+      uint32_t    length = lengths[l];
+      uint32_t    split  = length ? random() % length : 0;
+      const char *data   = buffer + offset;
+
+      uint32_t adler = adler32( 1, (const Bytef*)data, length );
+      uint32_t crc   = crc32( 0, (const Bytef*)data, length );
+      CPPUNIT_ASSERT( CheckSum( "adler32", true, data, length, split ) ==
+                      Format32( "adler32", adler ) );
+      CPPUNIT_ASSERT( CheckSum( "adler32", false, data, length, split ) ==
+                      Format32( "adler32", adler ) );
+      CPPUNIT_ASSERT( CheckSum( "zcrc32", true, data, length, split ) ==
+                      Format32( "zcrc32", crc ) );
+      CPPUNIT_ASSERT( CheckSum( "zcrc32", false, data, length, split ) ==
+                      Format32( "zcrc32", crc ) );
+      CPPUNIT_ASSERT( CheckSum( "crc32c", true, data, length, split ) ==
+                      CheckSum( "crc32c", false, data, length, 0 ) );
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Cross check with the checksum manager
+  //----------------------------------------------------------------------------
+  XrdCks *cksMan = DefaultEnv::GetCheckSumManager();
+  for( int i = 0; cksMan && i < 4; ++i )
+  {
+    XrdCksCalc *calc = cksMan->Object( types[i] );
+    if( !calc )
+      continue;
+    calc->Update( buffer, size );
+    int cksSize = 0;
+    calc->Type( cksSize );
+    XrdCksData ckSum;
+    ckSum.Set( types[i] );
+    ckSum.Set( calc->Final(), cksSize );
+    char cksBuffer[265];
+    ckSum.Get( cksBuffer, 256 );
+    delete calc;
+
+    std::string expected = std::string( types[i] ) + ":" + cksBuffer;
+    CPPUNIT_ASSERT( CheckSum( types[i], true, buffer, size, 12345 ) ==
+                    expected );
+  }
+
+  delete [] buffer;
+}
+
+//------------------------------------------------------------------------------
+// Checksum combination test
+//------------------------------------------------------------------------------
+void UtilsTest::CheckSumCombineTest()
+{
+  using namespace XrdCl;
+  const char *types[] = { "adler32", "crc32", "zcrc32", "crc32c" };
+
+  const uint32_t  size   = 20*1024*1024+17;
+  char           *buffer = new char[size];
+  for( uint32_t i = 0; i < size; ++i )
+    buffer[i] = random();
+
+  //----------------------------------------------------------------------------
+  // Combine the checksums of random pieces of the buffer
+  //----------------------------------------------------------------------------
+  for( int i = 0; i < 4; ++i )
+  {
+    for( int iter = 0; iter < 20; ++iter )
+    {
+      uint32_t length = random() % (iter < 10 ? 100 : size);
+      std::auto_ptr<CheckSumCalc> whole( CheckSumCalc::Create( types[i] ) );
+      std::auto_ptr<CheckSumCalc> combined( CheckSumCalc::Create( types[i] ) );
+      CPPUNIT_ASSERT( combined->IsCombinable() );
+      whole->Update( buffer, length );
+
+      uint32_t start = random() % (length+1);
+      combined->Update( buffer, start );
+      while( start < length )
+      {
+        uint32_t end = start + random() % (length-start+1);
+        if( random() % 4 == 0 )
+          end = length;
+        std::auto_ptr<CheckSumCalc> part( CheckSumCalc::Create( types[i],
+                                                                iter % 2 ) );
+        part->Update( buffer+start, end-start );
+        CPPUNIT_ASSERT( combined->Combine( *part, end-start ) );
+        start = end;
+      }
+      CPPUNIT_ASSERT( combined->GetCheckSum() == whole->GetCheckSum() );
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Checksum a local file using different numbers of threads
+  //----------------------------------------------------------------------------
+  char path[] = "/tmp/xrdcl-cks-test-XXXXXX";
+  int  fd     = mkstemp( path );
+  CPPUNIT_ASSERT( fd != -1 );
+  CPPUNIT_ASSERT( write( fd, buffer, size ) == (ssize_t)size );
+  close( fd );
+
+  for( int i = 0; i < 4; ++i )
+  {
+    std::auto_ptr<CheckSumCalc> whole( CheckSumCalc::Create( types[i] ) );
+    whole->Update( buffer, size );
+    std::string expected = whole->GetCheckSum();
+
+    for( uint16_t threads = 1; threads <= 8; threads *= 2 )
+    {
+      std::auto_ptr<CheckSumCalc> calc( CheckSumCalc::Create( types[i] ) );
+      CPPUNIT_ASSERT_XRDST( Utils::ComputeCheckSum( calc.get(), path,
+                                                    threads ) );
+      CPPUNIT_ASSERT( calc->GetCheckSum() == expected );
+    }
+  }
+
+  unlink( path );
+  delete [] buffer;
+}
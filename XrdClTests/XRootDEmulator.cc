@@ -0,0 +1,1483 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+#include "XRootDEmulator.hh"
+#include "XRootDProtocolHelper.hh"
+#include "TestEnv.hh"
+#include "XrdCl/XrdClLog.hh"
+#include "XrdCl/XrdClFile.hh"
+#include "XrdCl/XrdClUtils.hh"
+#include "XrdCl/XrdClCheckSumCalc.hh"
+#include "XrdSys/XrdSysPlatform.hh"
+#include "XProtocol/XProtocol.hh"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Read exactly the given number of bytes
+  //----------------------------------------------------------------------------
+  bool ReadAll( int socket, char *buffer, uint32_t size )
+  {
+    while( size )
+    {
+      ssize_t ret = ::read( socket, buffer, size );
+      if( ret <= 0 )
+      {
+        if( ret < 0 && errno == EINTR )
+          continue;
+        return false;
+      }
+      buffer += ret;
+      size   -= ret;
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Write exactly the given number of bytes
+  //----------------------------------------------------------------------------
+  bool WriteAll( int socket, const char *buffer, uint32_t size )
+  {
+    while( size )
+    {
+      ssize_t ret = ::write( socket, buffer, size );
+      if( ret <= 0 )
+      {
+        if( ret < 0 && errno == EINTR )
+          continue;
+        return false;
+      }
+      buffer += ret;
+      size   -= ret;
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Split the path from the opaque data
+  //----------------------------------------------------------------------------
+  void ParsePath( const std::string                  &request,
+                  std::string                        &path,
+                  std::map<std::string, std::string> &params )
+  {
+    size_t pos = request.find( '?' );
+    path = request.substr( 0, pos );
+    if( pos == std::string::npos )
+      return;
+
+    std::vector<std::string> pairs;
+    XrdCl::Utils::splitString( pairs, request.substr( pos+1 ), "&" );
+    std::vector<std::string>::iterator it;
+    for( it = pairs.begin(); it != pairs.end(); ++it )
+    {
+      size_t eq = it->find( '=' );
+      if( eq == std::string::npos )
+        params[*it] = "";
+      else
+        params[it->substr( 0, eq )] = it->substr( eq+1 );
+    }
+  }
+}
+
+namespace XrdClTests {
+
+//------------------------------------------------------------------------------
+// Create or replace a file
+//------------------------------------------------------------------------------
+void XRootDStorage::PutFile( const std::string &path, const std::string &data )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  FileData &file = pFiles[path];
+  file.data  = data;
+  file.mtime = ::time( 0 );
+}
+
+//------------------------------------------------------------------------------
+// Remove a file
+//------------------------------------------------------------------------------
+void XRootDStorage::RemoveFile( const std::string &path )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  pFiles.erase( path );
+}
+
+//------------------------------------------------------------------------------
+// Get the content of a file
+//------------------------------------------------------------------------------
+bool XRootDStorage::GetFile( const std::string &path, std::string &data )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  FileMap::iterator it = pFiles.find( path );
+  if( it == pFiles.end() )
+    return false;
+  data = it->second.data;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Get the size and modification time of a file
+//------------------------------------------------------------------------------
+bool XRootDStorage::Stat( const std::string &path, uint64_t &size,
+                          time_t &mtime )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  FileMap::iterator it = pFiles.find( path );
+  if( it == pFiles.end() )
+    return false;
+  size  = it->second.data.size();
+  mtime = it->second.mtime;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Create a file if it does not exist
+//------------------------------------------------------------------------------
+bool XRootDStorage::Create( const std::string &path, bool exclusive,
+                            bool truncate )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  FileMap::iterator it = pFiles.find( path );
+  if( it != pFiles.end() )
+  {
+    if( exclusive )
+      return false;
+    if( truncate )
+    {
+      it->second.data.clear();
+      it->second.mtime = ::time( 0 );
+    }
+    return true;
+  }
+  pFiles[path].mtime = ::time( 0 );
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Read from a file
+//------------------------------------------------------------------------------
+uint32_t XRootDStorage::Read( const std::string &path, uint64_t offset,
+                              uint32_t length, char *buffer )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  FileMap::iterator it = pFiles.find( path );
+  if( it == pFiles.end() || offset >= it->second.data.size() )
+    return 0;
+
+  uint64_t left = it->second.data.size() - offset;
+  if( left < length )
+    length = left;
+  memcpy( buffer, it->second.data.data() + offset, length );
+  pBytesRead += length;
+  return length;
+}
+
+//------------------------------------------------------------------------------
+// Get the number of bytes read
+//------------------------------------------------------------------------------
+uint64_t XRootDStorage::GetBytesRead()
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  return pBytesRead;
+}
+
+//------------------------------------------------------------------------------
+// Make the reads fail
+//------------------------------------------------------------------------------
+void XRootDStorage::SetFailReads( bool fail )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  pFailReads = fail;
+}
+
+//------------------------------------------------------------------------------
+// Check if the reads should fail
+//------------------------------------------------------------------------------
+bool XRootDStorage::GetFailReads()
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  return pFailReads;
+}
+
+//------------------------------------------------------------------------------
+// Delay the read responses
+//------------------------------------------------------------------------------
+void XRootDStorage::SetReadDelay( uint32_t delay )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  pReadDelay = delay;
+}
+
+//------------------------------------------------------------------------------
+// Get the delay of the read responses
+//------------------------------------------------------------------------------
+uint32_t XRootDStorage::GetReadDelay()
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  return pReadDelay;
+}
+
+//------------------------------------------------------------------------------
+// Write to a file
+//------------------------------------------------------------------------------
+bool XRootDStorage::Write( const std::string &path, uint64_t offset,
+                           const char *buffer, uint32_t length )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  FileMap::iterator it = pFiles.find( path );
+  if( it == pFiles.end() )
+    return false;
+
+  std::string &data = it->second.data;
+  if( data.size() < offset + length )
+    data.resize( offset + length, 0 );
+  data.replace( offset, length, buffer, length );
+  it->second.mtime = ::time( 0 );
+  pBytesWritten += length;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Get the number of bytes written
+//------------------------------------------------------------------------------
+uint64_t XRootDStorage::GetBytesWritten()
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  return pBytesWritten;
+}
+
+//------------------------------------------------------------------------------
+// Truncate a file
+//------------------------------------------------------------------------------
+bool XRootDStorage::Truncate( const std::string &path, uint64_t size )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  FileMap::iterator it = pFiles.find( path );
+  if( it == pFiles.end() )
+    return false;
+
+  it->second.data.resize( size, 0 );
+  it->second.mtime = ::time( 0 );
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Create a directory and its parents
+//------------------------------------------------------------------------------
+void XRootDStorage::MakeDir( const std::string &path )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  std::string dir = path;
+  while( dir.length() > 1 && dir[dir.length()-1] == '/' )
+    dir.erase( dir.length()-1 );
+
+  while( !dir.empty() )
+  {
+    pDirs.insert( dir );
+    size_t pos = dir.rfind( '/' );
+    if( pos == std::string::npos || pos == 0 )
+      break;
+    dir.erase( pos );
+  }
+}
+
+//------------------------------------------------------------------------------
+// Remove a directory
+//------------------------------------------------------------------------------
+void XRootDStorage::RemoveDir( const std::string &path )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  std::string dir = path;
+  while( dir.length() > 1 && dir[dir.length()-1] == '/' )
+    dir.erase( dir.length()-1 );
+  pDirs.erase( dir );
+}
+
+//------------------------------------------------------------------------------
+// Check if the directory exists
+//------------------------------------------------------------------------------
+bool XRootDStorage::IsDirectory( const std::string &path )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  std::set<std::string> names;
+  return ListUnlocked( path, names );
+}
+
+//------------------------------------------------------------------------------
+// List a directory
+//------------------------------------------------------------------------------
+bool XRootDStorage::List( const std::string &path,
+                          std::set<std::string> &names )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  return ListUnlocked( path, names );
+}
+
+//------------------------------------------------------------------------------
+// List a directory, the caller holds the mutex
+//------------------------------------------------------------------------------
+bool XRootDStorage::ListUnlocked( const std::string     &path,
+                                  std::set<std::string> &names )
+{
+  std::string dir = path;
+  while( dir.length() > 1 && dir[dir.length()-1] == '/' )
+    dir.erase( dir.length()-1 );
+
+  bool        exists = pDirs.find( dir ) != pDirs.end() || dir == "/";
+  std::string prefix = dir == "/" ? dir : dir + "/";
+
+  //----------------------------------------------------------------------------
+  // Everything under the prefix contributes its first path component
+  //----------------------------------------------------------------------------
+  std::vector<std::string> paths;
+  FileMap::iterator itF;
+  for( itF = pFiles.lower_bound( prefix ); itF != pFiles.end(); ++itF )
+  {
+    if( itF->first.compare( 0, prefix.length(), prefix ) != 0 )
+      break;
+    paths.push_back( itF->first );
+  }
+
+  std::set<std::string>::iterator itD;
+  for( itD = pDirs.lower_bound( prefix ); itD != pDirs.end(); ++itD )
+  {
+    if( itD->compare( 0, prefix.length(), prefix ) != 0 )
+      break;
+    paths.push_back( *itD );
+  }
+
+  std::vector<std::string>::iterator it;
+  for( it = paths.begin(); it != paths.end(); ++it )
+  {
+    std::string name = it->substr( prefix.length() );
+    name = name.substr( 0, name.find( '/' ) );
+    if( !name.empty() )
+      names.insert( name );
+    exists = true;
+  }
+  return exists;
+}
+
+//------------------------------------------------------------------------------
+// Set the response to the locate requests
+//------------------------------------------------------------------------------
+void XRootDStorage::SetLocations( const std::string &locations )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  pLocations = locations;
+}
+
+//------------------------------------------------------------------------------
+// Get the response to the locate requests
+//------------------------------------------------------------------------------
+std::string XRootDStorage::GetLocations()
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  return pLocations;
+}
+
+//------------------------------------------------------------------------------
+// Authorize a third party copy of the given file
+//------------------------------------------------------------------------------
+void XRootDStorage::AddTPCKey( const std::string &key, const std::string &path )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  pTPCKeys[key] = path;
+}
+
+//------------------------------------------------------------------------------
+// Revoke the third party copy authorization
+//------------------------------------------------------------------------------
+void XRootDStorage::RemoveTPCKey( const std::string &key )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  pTPCKeys.erase( key );
+}
+
+//------------------------------------------------------------------------------
+// Check if the key authorizes a third party copy of the given file
+//------------------------------------------------------------------------------
+bool XRootDStorage::CheckTPCKey( const std::string &key,
+                                 const std::string &path )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  std::map<std::string, std::string>::iterator it = pTPCKeys.find( key );
+  return it != pTPCKeys.end() && it->second == path;
+}
+
+//------------------------------------------------------------------------------
+// Note that a third party copy has been completed
+//------------------------------------------------------------------------------
+void XRootDStorage::TPCDone()
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  ++pTPCCount;
+}
+
+//------------------------------------------------------------------------------
+// Get the number of third party copies
+//------------------------------------------------------------------------------
+uint32_t XRootDStorage::GetTPCCount()
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  return pTPCCount;
+}
+
+//------------------------------------------------------------------------------
+// Count a stat request
+//------------------------------------------------------------------------------
+void XRootDStorage::StatDone()
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  ++pStatCount;
+}
+
+//------------------------------------------------------------------------------
+// Get the number of stat requests
+//------------------------------------------------------------------------------
+uint32_t XRootDStorage::GetStatCount()
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  return pStatCount;
+}
+
+//------------------------------------------------------------------------------
+// Count an open request
+//------------------------------------------------------------------------------
+void XRootDStorage::OpenDone()
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  ++pOpenCount;
+}
+
+//------------------------------------------------------------------------------
+// Get the number of open requests
+//------------------------------------------------------------------------------
+uint32_t XRootDStorage::GetOpenCount()
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  return pOpenCount;
+}
+
+//------------------------------------------------------------------------------
+// Count a locate request
+//------------------------------------------------------------------------------
+void XRootDStorage::LocateDone()
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  ++pLocateCount;
+}
+
+//------------------------------------------------------------------------------
+// Get the number of locate requests
+//------------------------------------------------------------------------------
+uint32_t XRootDStorage::GetLocateCount()
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  return pLocateCount;
+}
+
+//------------------------------------------------------------------------------
+// Redirect the open requests
+//------------------------------------------------------------------------------
+void XRootDStorage::SetRedirect( const std::string &host, uint16_t port,
+                                 const std::string &cgi )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  pRedirectHost = host;
+  pRedirectPort = port;
+  pRedirectCgi  = cgi;
+}
+
+//------------------------------------------------------------------------------
+// Get the server the open requests are redirected to
+//------------------------------------------------------------------------------
+bool XRootDStorage::GetRedirect( std::string &host, uint16_t &port,
+                                 std::string &cgi )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  host = pRedirectHost;
+  port = pRedirectPort;
+  cgi  = pRedirectCgi;
+  return !host.empty();
+}
+
+//------------------------------------------------------------------------------
+// Redirect the open requests naming the servers already tried
+//------------------------------------------------------------------------------
+void XRootDStorage::SetTriedRedirect( const std::string &host, uint16_t port )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  pTriedHost = host;
+  pTriedPort = port;
+}
+
+//------------------------------------------------------------------------------
+// Get the server the open requests naming the tried servers go to
+//------------------------------------------------------------------------------
+bool XRootDStorage::GetTriedRedirect( std::string &host, uint16_t &port )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  host = pTriedHost;
+  port = pTriedPort;
+  return !host.empty();
+}
+
+//------------------------------------------------------------------------------
+// Introduce ourselves as a manager
+//------------------------------------------------------------------------------
+void XRootDStorage::SetManager( bool manager )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  pManager = manager;
+}
+
+//------------------------------------------------------------------------------
+// Check if we introduce ourselves as a manager
+//------------------------------------------------------------------------------
+bool XRootDStorage::IsManager()
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  return pManager;
+}
+
+//------------------------------------------------------------------------------
+// Honor the stat option of the dirlist requests
+//------------------------------------------------------------------------------
+void XRootDStorage::SetDirListStat( bool enable )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  pDirListStat = enable;
+}
+
+//------------------------------------------------------------------------------
+// Check if the stat option of the dirlist requests is honored
+//------------------------------------------------------------------------------
+bool XRootDStorage::GetDirListStat()
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  return pDirListStat;
+}
+
+//------------------------------------------------------------------------------
+// Send the dirlist responses in parts
+//------------------------------------------------------------------------------
+void XRootDStorage::SetDirListPartSize( uint32_t size )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  pDirListPartSize = size;
+}
+
+//------------------------------------------------------------------------------
+// Get the size of the parts of the dirlist responses
+//------------------------------------------------------------------------------
+uint32_t XRootDStorage::GetDirListPartSize()
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  return pDirListPartSize;
+}
+
+//------------------------------------------------------------------------------
+// Drop the connection in the middle of the next dirlist responses
+//------------------------------------------------------------------------------
+void XRootDStorage::SetDirListDrops( uint32_t count )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  pDirListDrops = count;
+}
+
+//------------------------------------------------------------------------------
+// Check if the connection should be dropped
+//------------------------------------------------------------------------------
+bool XRootDStorage::TakeDirListDrop()
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  if( !pDirListDrops )
+    return false;
+  --pDirListDrops;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Register a client connection
+//------------------------------------------------------------------------------
+void XRootDStorage::AddSocket( int socket )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  pSockets.insert( socket );
+}
+
+//------------------------------------------------------------------------------
+// Unregister a client connection
+//------------------------------------------------------------------------------
+void XRootDStorage::RemoveSocket( int socket )
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  pSockets.erase( socket );
+}
+
+//------------------------------------------------------------------------------
+// Shut down all the client connections
+//------------------------------------------------------------------------------
+void XRootDStorage::Disconnect()
+{
+  XrdSysMutexHelper scopedLock( pMutex );
+  std::set<int>::iterator it;
+  for( it = pSockets.begin(); it != pSockets.end(); ++it )
+    ::shutdown( *it, SHUT_RDWR );
+}
+
+//------------------------------------------------------------------------------
+//! Handler emulating an xrootd data server
+//------------------------------------------------------------------------------
+class XRootDClientHandler: public ClientHandler
+{
+  public:
+    //--------------------------------------------------------------------------
+    //! An open file
+    //--------------------------------------------------------------------------
+    struct OpenFile
+    {
+      OpenFile(): write( false ), authorizes( false ) {}
+      std::string path;
+      bool        write;
+      bool        authorizes;
+      std::string tpcKey;
+      std::string tpcSrc;
+      std::string tpcLfn;
+    };
+
+    //--------------------------------------------------------------------------
+    //! Third party copy in progress
+    //--------------------------------------------------------------------------
+    struct TPCPull
+    {
+      XRootDClientHandler *handler;
+      kXR_char             streamid[2];
+      OpenFile             file;
+    };
+
+    //--------------------------------------------------------------------------
+    //! Constructor
+    //--------------------------------------------------------------------------
+    XRootDClientHandler( XRootDStorage *storage ):
+      pStorage( storage ), pSocket( -1 ), pNextHandle( 0 ) {}
+
+    //--------------------------------------------------------------------------
+    //! Handle connection
+    //--------------------------------------------------------------------------
+    virtual void HandleConnection( int socket );
+
+    //--------------------------------------------------------------------------
+    //! Pull the data from the source server
+    //--------------------------------------------------------------------------
+    void Pull( TPCPull *pull );
+
+  private:
+    void HandleOpen( ClientRequest &req, const std::string &data );
+    void HandleClose( ClientRequest &req );
+    void HandleStat( ClientRequest &req, const std::string &data );
+    void HandleRead( ClientRequest &req );
+    void HandleReadV( ClientRequest &req, const std::string &data );
+    void HandleWrite( ClientRequest &req, const std::string &data );
+    void HandleSync( ClientRequest &req );
+    void HandleTruncate( ClientRequest &req, const std::string &data );
+    void HandleQuery( ClientRequest &req, const std::string &data );
+    void HandleDirList( ClientRequest &req, const std::string &data );
+    void HandleMkDir( ClientRequest &req, const std::string &data );
+    void HandleRmDir( ClientRequest &req, const std::string &data );
+    void HandleRm( ClientRequest &req, const std::string &data );
+    void HandleLocate( ClientRequest &req );
+    bool GetStatInfo( const std::string &path, std::string &info );
+    OpenFile *GetFile( const kXR_char *fhandle );
+    bool SendResponse( const kXR_char *streamid, uint16_t status,
+                       const char *data, uint32_t length );
+    bool SendError( const kXR_char *streamid, uint32_t errnum,
+                    const std::string &message );
+
+    XRootDStorage                *pStorage;
+    int                           pSocket;
+    uint32_t                      pNextHandle;
+    std::map<uint32_t, OpenFile>  pFiles;
+    std::vector<pthread_t>        pPulls;
+    XrdSysMutex                   pWriteMutex;
+};
+
+}
+
+//------------------------------------------------------------------------------
+// Stuff that needs C linkage
+//------------------------------------------------------------------------------
+extern "C"
+{
+  void *RunTPCPull( void *arg )
+  {
+    XrdClTests::XRootDClientHandler::TPCPull *pull =
+      (XrdClTests::XRootDClientHandler::TPCPull*)arg;
+    pull->handler->Pull( pull );
+    return 0;
+  }
+}
+
+namespace XrdClTests {
+
+//------------------------------------------------------------------------------
+// Handle connection
+//------------------------------------------------------------------------------
+void XRootDClientHandler::HandleConnection( int socket )
+{
+  XrdCl::Log          *log = TestEnv::GetLog();
+  XRootDProtocolHelper helper;
+  pSocket = socket;
+
+  if( !helper.HandleLogin( socket, log, pStorage->IsManager() ) )
+  {
+    ::close( socket );
+    return;
+  }
+
+  pStorage->AddSocket( socket );
+
+  //----------------------------------------------------------------------------
+  // Process the requests until the client goes away
+  //----------------------------------------------------------------------------
+  while( 1 )
+  {
+    ClientRequest req;
+    if( !ReadAll( socket, (char*)&req, 24 ) )
+      break;
+
+    req.header.requestid = ntohs( req.header.requestid );
+    req.header.dlen      = ntohl( req.header.dlen );
+
+    std::string data;
+    if( req.header.dlen > 0 )
+    {
+      data.resize( req.header.dlen );
+      if( !ReadAll( socket, &data[0], req.header.dlen ) )
+        break;
+    }
+
+    switch( req.header.requestid )
+    {
+      case kXR_open:  HandleOpen( req, data ); break;
+      case kXR_close: HandleClose( req ); break;
+      case kXR_stat:  HandleStat( req, data ); break;
+      case kXR_read:  HandleRead( req ); break;
+      case kXR_readv: HandleReadV( req, data ); break;
+      case kXR_write: HandleWrite( req, data ); break;
+      case kXR_sync:  HandleSync( req ); break;
+      case kXR_truncate: HandleTruncate( req, data ); break;
+      case kXR_query: HandleQuery( req, data ); break;
+      case kXR_dirlist: HandleDirList( req, data ); break;
+      case kXR_mkdir: HandleMkDir( req, data ); break;
+      case kXR_rmdir: HandleRmDir( req, data ); break;
+      case kXR_rm:    HandleRm( req, data ); break;
+      case kXR_locate: HandleLocate( req ); break;
+      case kXR_ping:
+        SendResponse( req.header.streamid, kXR_ok, 0, 0 );
+        break;
+      default:
+        SendError( req.header.streamid, kXR_Unsupported,
+                   "Request not supported by the emulator" );
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Wait for the transfers and clean up
+  //----------------------------------------------------------------------------
+  std::vector<pthread_t>::iterator it;
+  for( it = pPulls.begin(); it != pPulls.end(); ++it )
+    pthread_join( *it, 0 );
+
+  std::map<uint32_t, OpenFile>::iterator itF;
+  for( itF = pFiles.begin(); itF != pFiles.end(); ++itF )
+    if( itF->second.authorizes )
+      pStorage->RemoveTPCKey( itF->second.tpcKey );
+
+  pStorage->RemoveSocket( socket );
+  helper.HandleClose( socket, log );
+  ::close( socket );
+}
+
+//------------------------------------------------------------------------------
+// Handle open
+//------------------------------------------------------------------------------
+void XRootDClientHandler::HandleOpen( ClientRequest &req,
+                                      const std::string &data )
+{
+  uint16_t                           options = ntohs( req.open.options );
+  std::string                        path;
+  std::map<std::string, std::string> params;
+  ParsePath( data.c_str(), path, params );
+  pStorage->OpenDone();
+
+  //----------------------------------------------------------------------------
+  // Send the client to another server if we act as a redirector
+  //----------------------------------------------------------------------------
+  std::string redirectHost, redirectCgi;
+  uint16_t    redirectPort;
+  bool        redirect = false;
+  if( params.find( "tried" ) != params.end() )
+    redirect = pStorage->GetTriedRedirect( redirectHost, redirectPort );
+  if( !redirect )
+    redirect = pStorage->GetRedirect( redirectHost, redirectPort,
+                                      redirectCgi );
+  if( redirect )
+  {
+    std::string response( 4, 0 );
+    uint32_t port = htonl( redirectPort );
+    memcpy( &response[0], &port, 4 );
+    response += redirectHost;
+    if( !redirectCgi.empty() )
+      response += "?" + redirectCgi;
+    SendResponse( req.header.streamid, kXR_redirect, response.data(),
+                  response.size() );
+    return;
+  }
+
+  OpenFile file;
+  file.path  = path;
+  file.write = !(options & kXR_open_read);
+
+  //----------------------------------------------------------------------------
+  // Third party copy, the client authorizes the copy at the source,
+  // the destination server opens the source to pull the data, or
+  // the client opens the destination
+  //----------------------------------------------------------------------------
+  if( params.find( "tpc.key" ) != params.end() )
+  {
+    file.tpcKey = params["tpc.key"];
+    if( params.find( "tpc.dst" ) != params.end() )
+    {
+      file.authorizes = true;
+    }
+    else if( params.find( "tpc.src" ) != params.end() )
+    {
+      file.tpcSrc = params["tpc.src"];
+      file.tpcLfn = params["tpc.lfn"];
+      if( file.tpcLfn.empty() )
+      {
+        SendError( req.header.streamid, kXR_ArgMissing, "No tpc.lfn given" );
+        return;
+      }
+    }
+    else if( !pStorage->CheckTPCKey( file.tpcKey, path ) )
+    {
+      SendError( req.header.streamid, kXR_NotAuthorized,
+                 "Third party copy key does not match" );
+      return;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Create or check the file
+  //----------------------------------------------------------------------------
+  uint64_t size;
+  time_t   mtime;
+  if( file.write )
+  {
+    if( !pStorage->Create( path, options & kXR_new, options & kXR_delete ) )
+    {
+      SendError( req.header.streamid, kXR_FSError, "File exists" );
+      return;
+    }
+  }
+
+  if( !pStorage->Stat( path, size, mtime ) )
+  {
+    SendError( req.header.streamid, kXR_NotFound, "No such file" );
+    return;
+  }
+
+  if( file.authorizes )
+    pStorage->AddTPCKey( file.tpcKey, path );
+
+  uint32_t handle = pNextHandle++;
+  pFiles[handle] = file;
+
+  //----------------------------------------------------------------------------
+  // Respond with the file handle and the stat info if requested
+  //----------------------------------------------------------------------------
+  std::string response( 12, 0 );
+  memcpy( &response[0], &handle, 4 );
+  if( options & kXR_retstat )
+  {
+    std::ostringstream o;
+    o << handle << " " << size << " " << (kXR_readable|kXR_writable) << " ";
+    o << mtime;
+    response += o.str();
+    response += '\0';
+  }
+  SendResponse( req.header.streamid, kXR_ok, response.data(),
+                response.size() );
+}
+
+//------------------------------------------------------------------------------
+// Handle close
+//------------------------------------------------------------------------------
+void XRootDClientHandler::HandleClose( ClientRequest &req )
+{
+  uint32_t handle;
+  memcpy( &handle, req.close.fhandle, 4 );
+  std::map<uint32_t, OpenFile>::iterator it = pFiles.find( handle );
+  if( it == pFiles.end() )
+  {
+    SendError( req.header.streamid, kXR_FileNotOpen, "Invalid file handle" );
+    return;
+  }
+
+  if( it->second.authorizes )
+    pStorage->RemoveTPCKey( it->second.tpcKey );
+  pFiles.erase( it );
+  SendResponse( req.header.streamid, kXR_ok, 0, 0 );
+}
+
+//------------------------------------------------------------------------------
+// Handle stat
+//------------------------------------------------------------------------------
+void XRootDClientHandler::HandleStat( ClientRequest &req,
+                                      const std::string &data )
+{
+  if( req.stat.options & kXR_vfs )
+  {
+    SendError( req.header.streamid, kXR_Unsupported, "No vfs stat" );
+    return;
+  }
+
+  std::string                        path;
+  std::map<std::string, std::string> params;
+  ParsePath( data.c_str(), path, params );
+  pStorage->StatDone();
+
+  std::string response;
+  if( !GetStatInfo( path, response ) )
+  {
+    SendError( req.header.streamid, kXR_NotFound, "No such file" );
+    return;
+  }
+  SendResponse( req.header.streamid, kXR_ok, response.c_str(),
+                response.size()+1 );
+}
+
+//------------------------------------------------------------------------------
+// Build the stat response for a file or a directory
+//------------------------------------------------------------------------------
+bool XRootDClientHandler::GetStatInfo( const std::string &path,
+                                       std::string       &info )
+{
+  uint64_t size  = 0;
+  time_t   mtime = 0;
+  int      flags = kXR_readable|kXR_writable;
+  if( !pStorage->Stat( path, size, mtime ) )
+  {
+    if( !pStorage->IsDirectory( path ) )
+      return false;
+    flags |= kXR_isDir;
+  }
+
+  std::ostringstream o;
+  o << "0 " << size << " " << flags << " " << mtime;
+  info = o.str();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Handle dirlist
+//------------------------------------------------------------------------------
+void XRootDClientHandler::HandleDirList( ClientRequest &req,
+                                         const std::string &data )
+{
+  std::string                        path;
+  std::map<std::string, std::string> params;
+  ParsePath( data.c_str(), path, params );
+
+  std::set<std::string> names;
+  if( !pStorage->List( path, names ) )
+  {
+    SendError( req.header.streamid, kXR_NotFound, "No such directory" );
+    return;
+  }
+
+  //----------------------------------------------------------------------------
+  // With the stat option a dummy "." entry leads and each name is followed
+  // by its stat info
+  //----------------------------------------------------------------------------
+  bool withStat = (req.dirlist.options[0] & kXR_dstat) &&
+                  pStorage->GetDirListStat();
+  std::string response;
+  if( withStat )
+    response = ".\n0 0 0 0";
+
+  std::string dir = path;
+  if( dir.empty() || dir[dir.length()-1] != '/' )
+    dir += "/";
+
+  std::set<std::string>::iterator it;
+  for( it = names.begin(); it != names.end(); ++it )
+  {
+    if( !response.empty() )
+      response += "\n";
+    response += *it;
+    if( withStat )
+    {
+      std::string info;
+      if( !GetStatInfo( dir + *it, info ) )
+        info = "0 0 0 0";
+      response += "\n" + info;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Send the listing in parts if requested, the parts are cut at any byte
+  //----------------------------------------------------------------------------
+  uint32_t partSize = pStorage->GetDirListPartSize();
+  uint32_t offset   = 0;
+  if( partSize )
+  {
+    while( response.size() - offset > partSize )
+    {
+      if( !SendResponse( req.header.streamid, kXR_oksofar,
+                         response.c_str()+offset, partSize ) )
+        return;
+      if( !offset && pStorage->TakeDirListDrop() )
+      {
+        ::shutdown( pSocket, SHUT_RDWR );
+        return;
+      }
+      offset += partSize;
+    }
+  }
+
+  if( response.size() == offset )
+    SendResponse( req.header.streamid, kXR_ok, 0, 0 );
+  else
+    SendResponse( req.header.streamid, kXR_ok, response.c_str()+offset,
+                  response.size()-offset+1 );
+}
+
+//------------------------------------------------------------------------------
+// Handle locate
+//------------------------------------------------------------------------------
+void XRootDClientHandler::HandleLocate( ClientRequest &req )
+{
+  pStorage->LocateDone();
+  std::string locations = pStorage->GetLocations();
+  if( locations.empty() )
+  {
+    SendError( req.header.streamid, kXR_NotFound, "No locations known" );
+    return;
+  }
+  SendResponse( req.header.streamid, kXR_ok, locations.c_str(),
+                locations.size()+1 );
+}
+
+//------------------------------------------------------------------------------
+// Handle mkdir
+//------------------------------------------------------------------------------
+void XRootDClientHandler::HandleMkDir( ClientRequest &req,
+                                       const std::string &data )
+{
+  std::string                        path;
+  std::map<std::string, std::string> params;
+  ParsePath( data.c_str(), path, params );
+
+  if( !(req.mkdir.options[0] & kXR_mkdirpath) )
+  {
+    if( pStorage->IsDirectory( path ) )
+    {
+      SendError( req.header.streamid, kXR_FSError, "Directory exists" );
+      return;
+    }
+
+    std::string parent = path.substr( 0, path.rfind( '/' ) );
+    if( !parent.empty() && !pStorage->IsDirectory( parent ) )
+    {
+      SendError( req.header.streamid, kXR_NotFound, "No parent directory" );
+      return;
+    }
+  }
+
+  pStorage->MakeDir( path );
+  SendResponse( req.header.streamid, kXR_ok, 0, 0 );
+}
+
+//------------------------------------------------------------------------------
+// Handle rmdir
+//------------------------------------------------------------------------------
+void XRootDClientHandler::HandleRmDir( ClientRequest &req,
+                                       const std::string &data )
+{
+  std::string                        path;
+  std::map<std::string, std::string> params;
+  ParsePath( data.c_str(), path, params );
+
+  std::set<std::string> names;
+  if( !pStorage->List( path, names ) )
+  {
+    SendError( req.header.streamid, kXR_NotFound, "No such directory" );
+    return;
+  }
+
+  if( !names.empty() )
+  {
+    SendError( req.header.streamid, kXR_FSError, "Directory not empty" );
+    return;
+  }
+
+  pStorage->RemoveDir( path );
+  SendResponse( req.header.streamid, kXR_ok, 0, 0 );
+}
+
+//------------------------------------------------------------------------------
+// Handle rm
+//------------------------------------------------------------------------------
+void XRootDClientHandler::HandleRm( ClientRequest &req,
+                                    const std::string &data )
+{
+  std::string                        path;
+  std::map<std::string, std::string> params;
+  ParsePath( data.c_str(), path, params );
+
+  uint64_t size;
+  time_t   mtime;
+  if( !pStorage->Stat( path, size, mtime ) )
+  {
+    SendError( req.header.streamid, kXR_NotFound, "No such file" );
+    return;
+  }
+
+  pStorage->RemoveFile( path );
+  SendResponse( req.header.streamid, kXR_ok, 0, 0 );
+}
+
+//------------------------------------------------------------------------------
+// Handle read
+//------------------------------------------------------------------------------
+void XRootDClientHandler::HandleRead( ClientRequest &req )
+{
+  OpenFile *file = GetFile( req.read.fhandle );
+  if( !file )
+  {
+    SendError( req.header.streamid, kXR_FileNotOpen, "Invalid file handle" );
+    return;
+  }
+
+  if( pStorage->GetFailReads() )
+  {
+    SendError( req.header.streamid, kXR_IOError, "Read failed" );
+    return;
+  }
+
+  uint32_t delay = pStorage->GetReadDelay();
+  if( delay )
+    ::usleep( delay*1000 );
+
+  uint64_t offset = ntohll( req.read.offset );
+  uint32_t length = ntohl( req.read.rlen );
+  std::vector<char> buffer( length ? length : 1 );
+  length = pStorage->Read( file->path, offset, length, &buffer[0] );
+  SendResponse( req.header.streamid, kXR_ok, &buffer[0], length );
+}
+
+//------------------------------------------------------------------------------
+// Handle vector read, every chunk is sent back with its header
+//------------------------------------------------------------------------------
+void XRootDClientHandler::HandleReadV( ClientRequest     &req,
+                                       const std::string &data )
+{
+  if( pStorage->GetFailReads() )
+  {
+    SendError( req.header.streamid, kXR_IOError, "Read failed" );
+    return;
+  }
+
+  std::string response;
+  size_t      nChunks = data.size() / sizeof(readahead_list);
+  for( size_t i = 0; i < nChunks; ++i )
+  {
+    readahead_list chunk;
+    memcpy( &chunk, data.data() + i*sizeof(readahead_list),
+            sizeof(readahead_list) );
+    OpenFile *file = GetFile( chunk.fhandle );
+    if( !file )
+    {
+      SendError( req.header.streamid, kXR_FileNotOpen, "Invalid file handle" );
+      return;
+    }
+
+    uint32_t length = ntohl( chunk.rlen );
+    std::vector<char> buffer( length ? length : 1 );
+    length = pStorage->Read( file->path, ntohll( chunk.offset ), length,
+                             &buffer[0] );
+    chunk.rlen = htonl( length );
+    response.append( (char*)&chunk, sizeof(readahead_list) );
+    response.append( &buffer[0], length );
+  }
+  SendResponse( req.header.streamid, kXR_ok, response.data(),
+                response.size() );
+}
+
+//------------------------------------------------------------------------------
+// Handle write
+//------------------------------------------------------------------------------
+void XRootDClientHandler::HandleWrite( ClientRequest &req,
+                                       const std::string &data )
+{
+  OpenFile *file = GetFile( req.write.fhandle );
+  if( !file || !file->write )
+  {
+    SendError( req.header.streamid, kXR_FileNotOpen, "Invalid file handle" );
+    return;
+  }
+
+  UpdateReceivedData( (char*)data.data(), data.size() );
+  if( !pStorage->Write( file->path, ntohll( req.write.offset ), data.data(),
+                        data.size() ) )
+  {
+    SendError( req.header.streamid, kXR_IOError, "Write failed" );
+    return;
+  }
+  SendResponse( req.header.streamid, kXR_ok, 0, 0 );
+}
+
+//------------------------------------------------------------------------------
+// Handle truncate - only the open files, by handle
+//------------------------------------------------------------------------------
+void XRootDClientHandler::HandleTruncate( ClientRequest &req,
+                                          const std::string &data )
+{
+  //----------------------------------------------------------------------------
+  // Truncate by path
+  //----------------------------------------------------------------------------
+  if( !data.empty() )
+  {
+    std::string                        path;
+    std::map<std::string, std::string> params;
+    ParsePath( data.c_str(), path, params );
+    if( !pStorage->Truncate( path, ntohll( req.truncate.offset ) ) )
+    {
+      SendError( req.header.streamid, kXR_NotFound, "No such file" );
+      return;
+    }
+    SendResponse( req.header.streamid, kXR_ok, 0, 0 );
+    return;
+  }
+
+  OpenFile *file = GetFile( req.truncate.fhandle );
+  if( !file || !file->write )
+  {
+    SendError( req.header.streamid, kXR_FileNotOpen, "Invalid file handle" );
+    return;
+  }
+
+  if( !pStorage->Truncate( file->path, ntohll( req.truncate.offset ) ) )
+  {
+    SendError( req.header.streamid, kXR_IOError, "Truncate failed" );
+    return;
+  }
+  SendResponse( req.header.streamid, kXR_ok, 0, 0 );
+}
+
+//------------------------------------------------------------------------------
+// Handle sync - start the pull if this is a third party copy destination,
+// the response is sent when the data is in
+//------------------------------------------------------------------------------
+void XRootDClientHandler::HandleSync( ClientRequest &req )
+{
+  OpenFile *file = GetFile( req.sync.fhandle );
+  if( !file )
+  {
+    SendError( req.header.streamid, kXR_FileNotOpen, "Invalid file handle" );
+    return;
+  }
+
+  if( file->tpcSrc.empty() )
+  {
+    SendResponse( req.header.streamid, kXR_ok, 0, 0 );
+    return;
+  }
+
+  TPCPull *pull = new TPCPull();
+  pull->handler = this;
+  memcpy( pull->streamid, req.header.streamid, 2 );
+  pull->file    = *file;
+
+  pthread_t thread;
+  if( pthread_create( &thread, 0, ::RunTPCPull, pull ) != 0 )
+  {
+    delete pull;
+    SendError( req.header.streamid, kXR_ServerError,
+               "Unable to start the transfer" );
+    return;
+  }
+  pPulls.push_back( thread );
+}
+
+//------------------------------------------------------------------------------
+// Handle query - only checksums are supported
+//------------------------------------------------------------------------------
+void XRootDClientHandler::HandleQuery( ClientRequest &req,
+                                       const std::string &data )
+{
+  if( ntohs( req.query.infotype ) != kXR_Qcksum )
+  {
+    SendError( req.header.streamid, kXR_Unsupported, "Query not supported" );
+    return;
+  }
+
+  std::string                        path;
+  std::map<std::string, std::string> params;
+  ParsePath( data.c_str(), path, params );
+
+  std::string content;
+  if( !pStorage->GetFile( path, content ) )
+  {
+    SendError( req.header.streamid, kXR_NotFound, "No such file" );
+    return;
+  }
+
+  XrdCl::CheckSumCalc *calc = XrdCl::CheckSumCalc::Create( "adler32" );
+  calc->Update( content.data(), content.size() );
+  std::string checkSum = calc->GetCheckSum();
+  delete calc;
+
+  checkSum[checkSum.find( ':' )] = ' ';
+  SendResponse( req.header.streamid, kXR_ok, checkSum.c_str(),
+                checkSum.size()+1 );
+}
+
+//------------------------------------------------------------------------------
+// Pull the data from the source server
+//------------------------------------------------------------------------------
+void XRootDClientHandler::Pull( TPCPull *pull )
+{
+  using namespace XrdCl;
+  Log *log = TestEnv::GetLog();
+
+  std::string url = "root://" + pull->file.tpcSrc + "/" + pull->file.tpcLfn;
+  url += "?tpc.key=" + pull->file.tpcKey + "&tpc.stage=copy";
+  log->Debug( 1, "Pulling %s to %s", url.c_str(), pull->file.path.c_str() );
+
+  File         src;
+  XRootDStatus st = src.Open( url, OpenFlags::Read );
+  if( !st.IsOK() )
+  {
+    SendError( pull->streamid, kXR_ServerError,
+               "Unable to open the source: " + st.ToStr() );
+    delete pull;
+    return;
+  }
+
+  //----------------------------------------------------------------------------
+  // Copy the data in steps so that the progress can be observed
+  //----------------------------------------------------------------------------
+  const uint32_t    blockSize = 1024*1024;
+  std::vector<char> buffer( blockSize );
+  uint64_t          offset    = 0;
+  while( 1 )
+  {
+    uint32_t bytesRead = 0;
+    st = src.Read( offset, blockSize, &buffer[0], bytesRead );
+    if( !st.IsOK() || !bytesRead )
+      break;
+
+    pStorage->Write( pull->file.path, offset, &buffer[0], bytesRead );
+    offset += bytesRead;
+  }
+  src.Close();
+
+  if( !st.IsOK() )
+    SendError( pull->streamid, kXR_IOError,
+               "Unable to read the source: " + st.ToStr() );
+  else
+  {
+    pStorage->TPCDone();
+    SendResponse( pull->streamid, kXR_ok, 0, 0 );
+  }
+  delete pull;
+}
+
+//------------------------------------------------------------------------------
+// Find an open file
+//------------------------------------------------------------------------------
+XRootDClientHandler::OpenFile *XRootDClientHandler::GetFile(
+  const kXR_char *fhandle )
+{
+  uint32_t handle;
+  memcpy( &handle, fhandle, 4 );
+  std::map<uint32_t, OpenFile>::iterator it = pFiles.find( handle );
+  if( it == pFiles.end() )
+    return 0;
+  return &it->second;
+}
+
+//------------------------------------------------------------------------------
+// Send a response
+//------------------------------------------------------------------------------
+bool XRootDClientHandler::SendResponse( const kXR_char *streamid,
+                                        uint16_t        status,
+                                        const char     *data,
+                                        uint32_t        length )
+{
+  ServerResponseHeader hdr;
+  memcpy( hdr.streamid, streamid, 2 );
+  hdr.status = htons( status );
+  hdr.dlen   = htonl( length );
+
+  XrdSysMutexHelper scopedLock( pWriteMutex );
+  if( !WriteAll( pSocket, (char*)&hdr, 8 ) )
+    return false;
+  if( length && !WriteAll( pSocket, data, length ) )
+    return false;
+  if( length )
+    UpdateSentData( (char*)data, length );
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Send an error response
+//------------------------------------------------------------------------------
+bool XRootDClientHandler::SendError( const kXR_char    *streamid,
+                                     uint32_t           errnum,
+                                     const std::string &message )
+{
+  std::string body( 4, 0 );
+  uint32_t    err = htonl( errnum );
+  memcpy( &body[0], &err, 4 );
+  body += message;
+  body += '\0';
+  return SendResponse( streamid, kXR_error, body.data(), body.size() );
+}
+
+//------------------------------------------------------------------------------
+// Create a client handler
+//------------------------------------------------------------------------------
+ClientHandler *XRootDHandlerFactory::CreateHandler()
+{
+  return new XRootDClientHandler( pStorage );
+}
+
+}
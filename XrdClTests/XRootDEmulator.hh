@@ -0,0 +1,379 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2011-2012 by European Organization for Nuclear Research (CERN)
+// Author: Lukasz Janyst <ljanyst@cern.ch>
+//------------------------------------------------------------------------------
+// XRootD is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// XRootD is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with XRootD.  If not, see <http://www.gnu.org/licenses/>.
+//------------------------------------------------------------------------------
+
+#ifndef XROOTD_EMULATOR_HH
+#define XROOTD_EMULATOR_HH
+
+#include "Server.hh"
+#include "XrdSys/XrdSysPthread.hh"
+#include <map>
+#include <set>
+#include <string>
+#include <time.h>
+
+namespace XrdClTests {
+
+//------------------------------------------------------------------------------
+//! In-memory file store of an emulated xrootd data server
+//------------------------------------------------------------------------------
+class XRootDStorage
+{
+  public:
+    //--------------------------------------------------------------------------
+    //! Constructor
+    //--------------------------------------------------------------------------
+    XRootDStorage(): pTPCCount( 0 ), pStatCount( 0 ), pOpenCount( 0 ),
+      pLocateCount( 0 ), pDirListPartSize( 0 ), pDirListDrops( 0 ),
+      pRedirectPort( 0 ), pBytesRead( 0 ), pBytesWritten( 0 ),
+      pFailReads( false ), pDirListStat( true ), pTriedPort( 0 ),
+      pReadDelay( 0 ), pManager( false ) {}
+
+    //--------------------------------------------------------------------------
+    //! Create or replace a file
+    //--------------------------------------------------------------------------
+    void PutFile( const std::string &path, const std::string &data );
+
+    //--------------------------------------------------------------------------
+    //! Remove a file
+    //--------------------------------------------------------------------------
+    void RemoveFile( const std::string &path );
+
+    //--------------------------------------------------------------------------
+    //! Get the content of a file
+    //!
+    //! @return false if the file does not exist
+    //--------------------------------------------------------------------------
+    bool GetFile( const std::string &path, std::string &data );
+
+    //--------------------------------------------------------------------------
+    //! Get the size and modification time of a file
+    //!
+    //! @return false if the file does not exist
+    //--------------------------------------------------------------------------
+    bool Stat( const std::string &path, uint64_t &size, time_t &mtime );
+
+    //--------------------------------------------------------------------------
+    //! Create a file if it does not exist
+    //!
+    //! @param path      the file
+    //! @param exclusive fail if the file exists
+    //! @param truncate  remove the current content of the file
+    //! @return          false if the file exists and exclusive was requested
+    //--------------------------------------------------------------------------
+    bool Create( const std::string &path, bool exclusive, bool truncate );
+
+    //--------------------------------------------------------------------------
+    //! Read from a file
+    //!
+    //! @return number of bytes read
+    //--------------------------------------------------------------------------
+    uint32_t Read( const std::string &path, uint64_t offset, uint32_t length,
+                   char *buffer );
+
+    //--------------------------------------------------------------------------
+    //! Get the number of bytes read from the files so far
+    //--------------------------------------------------------------------------
+    uint64_t GetBytesRead();
+
+    //--------------------------------------------------------------------------
+    //! Make the read requests fail with an I/O error
+    //--------------------------------------------------------------------------
+    void SetFailReads( bool fail );
+
+    //--------------------------------------------------------------------------
+    //! Check if the read requests should fail
+    //--------------------------------------------------------------------------
+    bool GetFailReads();
+
+    //--------------------------------------------------------------------------
+    //! Answer the read requests after the given number of milliseconds
+    //--------------------------------------------------------------------------
+    void SetReadDelay( uint32_t delay );
+
+    //--------------------------------------------------------------------------
+    //! Get the delay of the read responses in milliseconds
+    //--------------------------------------------------------------------------
+    uint32_t GetReadDelay();
+
+    //--------------------------------------------------------------------------
+    //! Write to a file, the gap in front of the offset is filled with zeros
+    //!
+    //! @return false if the file does not exist
+    //--------------------------------------------------------------------------
+    bool Write( const std::string &path, uint64_t offset, const char *buffer,
+                uint32_t length );
+
+    //--------------------------------------------------------------------------
+    //! Get the number of bytes written to the files so far
+    //--------------------------------------------------------------------------
+    uint64_t GetBytesWritten();
+
+    //--------------------------------------------------------------------------
+    //! Cut or extend a file with zeros
+    //!
+    //! @return false if the file does not exist
+    //--------------------------------------------------------------------------
+    bool Truncate( const std::string &path, uint64_t size );
+
+    //--------------------------------------------------------------------------
+    //! Note that a stat request has been handled
+    //--------------------------------------------------------------------------
+    void StatDone();
+
+    //--------------------------------------------------------------------------
+    //! Get the number of stat requests handled so far
+    //--------------------------------------------------------------------------
+    uint32_t GetStatCount();
+
+    //--------------------------------------------------------------------------
+    //! Note that an open request has been handled
+    //--------------------------------------------------------------------------
+    void OpenDone();
+
+    //--------------------------------------------------------------------------
+    //! Get the number of open requests handled so far
+    //--------------------------------------------------------------------------
+    uint32_t GetOpenCount();
+
+    //--------------------------------------------------------------------------
+    //! Note that a locate request has been handled
+    //--------------------------------------------------------------------------
+    void LocateDone();
+
+    //--------------------------------------------------------------------------
+    //! Get the number of locate requests handled so far
+    //--------------------------------------------------------------------------
+    uint32_t GetLocateCount();
+
+    //--------------------------------------------------------------------------
+    //! Redirect the open requests to the given server with the given
+    //! opaque data, an empty host makes the server open the files itself
+    //--------------------------------------------------------------------------
+    void SetRedirect( const std::string &host, uint16_t port,
+                      const std::string &cgi );
+
+    //--------------------------------------------------------------------------
+    //! Get the server the open requests are redirected to
+    //!
+    //! @return false if the open requests are not redirected
+    //--------------------------------------------------------------------------
+    bool GetRedirect( std::string &host, uint16_t &port, std::string &cgi );
+
+    //--------------------------------------------------------------------------
+    //! Redirect the open requests naming the servers already tried to
+    //! the given server, an empty host disables it
+    //--------------------------------------------------------------------------
+    void SetTriedRedirect( const std::string &host, uint16_t port );
+
+    //--------------------------------------------------------------------------
+    //! Get the server the open requests naming the servers already tried
+    //! are redirected to
+    //!
+    //! @return false if these requests are not redirected
+    //--------------------------------------------------------------------------
+    bool GetTriedRedirect( std::string &host, uint16_t &port );
+
+    //--------------------------------------------------------------------------
+    //! Introduce ourselves as a manager to the clients connecting from now
+    //! on, ie. a load balancer
+    //--------------------------------------------------------------------------
+    void SetManager( bool manager );
+
+    //--------------------------------------------------------------------------
+    //! Check if we introduce ourselves as a manager
+    //--------------------------------------------------------------------------
+    bool IsManager();
+
+    //--------------------------------------------------------------------------
+    //! Honor the stat option of the dirlist requests, an older server
+    //! ignores it
+    //--------------------------------------------------------------------------
+    void SetDirListStat( bool enable );
+
+    //--------------------------------------------------------------------------
+    //! Check if the stat option of the dirlist requests is honored
+    //--------------------------------------------------------------------------
+    bool GetDirListStat();
+
+    //--------------------------------------------------------------------------
+    //! Send the dirlist responses in kXR_oksofar parts of the given number
+    //! of bytes, the parts may end in the middle of an entry, 0 sends
+    //! the response at once
+    //--------------------------------------------------------------------------
+    void SetDirListPartSize( uint32_t size );
+
+    //--------------------------------------------------------------------------
+    //! Get the size of the parts of the dirlist responses
+    //--------------------------------------------------------------------------
+    uint32_t GetDirListPartSize();
+
+    //--------------------------------------------------------------------------
+    //! Drop the connection after the first kXR_oksofar part of the given
+    //! number of the next dirlist responses
+    //--------------------------------------------------------------------------
+    void SetDirListDrops( uint32_t count );
+
+    //--------------------------------------------------------------------------
+    //! Check if the connection should be dropped, counts the drop
+    //--------------------------------------------------------------------------
+    bool TakeDirListDrop();
+
+    //--------------------------------------------------------------------------
+    //! Create a directory and all its parents, the directories holding
+    //! files exist implicitly
+    //--------------------------------------------------------------------------
+    void MakeDir( const std::string &path );
+
+    //--------------------------------------------------------------------------
+    //! Remove a directory created with MakeDir
+    //--------------------------------------------------------------------------
+    void RemoveDir( const std::string &path );
+
+    //--------------------------------------------------------------------------
+    //! Check if the directory exists
+    //--------------------------------------------------------------------------
+    bool IsDirectory( const std::string &path );
+
+    //--------------------------------------------------------------------------
+    //! List the names of the files and subdirectories of a directory
+    //!
+    //! @return false if the directory does not exist
+    //--------------------------------------------------------------------------
+    bool List( const std::string &path, std::set<std::string> &names );
+
+    //--------------------------------------------------------------------------
+    //! Set the response to the locate requests, space separated locations
+    //! as sent by the servers, ie. "Sr127.0.0.1:1094 Sr127.0.0.1:1095"
+    //--------------------------------------------------------------------------
+    void SetLocations( const std::string &locations );
+
+    //--------------------------------------------------------------------------
+    //! Get the response to the locate requests
+    //--------------------------------------------------------------------------
+    std::string GetLocations();
+
+    //--------------------------------------------------------------------------
+    //! Authorize a third party copy of the given file
+    //--------------------------------------------------------------------------
+    void AddTPCKey( const std::string &key, const std::string &path );
+
+    //--------------------------------------------------------------------------
+    //! Revoke the third party copy authorization
+    //--------------------------------------------------------------------------
+    void RemoveTPCKey( const std::string &key );
+
+    //--------------------------------------------------------------------------
+    //! Check if the key authorizes a third party copy of the given file
+    //--------------------------------------------------------------------------
+    bool CheckTPCKey( const std::string &key, const std::string &path );
+
+    //--------------------------------------------------------------------------
+    //! Note that a third party copy into this storage has been completed
+    //--------------------------------------------------------------------------
+    void TPCDone();
+
+    //--------------------------------------------------------------------------
+    //! Get the number of third party copies completed by this storage
+    //--------------------------------------------------------------------------
+    uint32_t GetTPCCount();
+
+    //--------------------------------------------------------------------------
+    //! Register a client connection
+    //--------------------------------------------------------------------------
+    void AddSocket( int socket );
+
+    //--------------------------------------------------------------------------
+    //! Unregister a client connection
+    //--------------------------------------------------------------------------
+    void RemoveSocket( int socket );
+
+    //--------------------------------------------------------------------------
+    //! Shut down all the client connections so that the handlers finish
+    //! and the server can be stopped
+    //--------------------------------------------------------------------------
+    void Disconnect();
+
+  private:
+    struct FileData
+    {
+      FileData(): mtime( 0 ) {}
+      std::string data;
+      time_t      mtime;
+    };
+    typedef std::map<std::string, FileData> FileMap;
+
+    bool ListUnlocked( const std::string &path, std::set<std::string> &names );
+
+    XrdSysMutex                        pMutex;
+    FileMap                            pFiles;
+    std::set<std::string>              pDirs;
+    std::map<std::string, std::string> pTPCKeys;
+    std::set<int>                      pSockets;
+    std::string                        pLocations;
+    std::string                        pRedirectHost;
+    std::string                        pRedirectCgi;
+    uint32_t                           pTPCCount;
+    uint32_t                           pStatCount;
+    uint32_t                           pOpenCount;
+    uint32_t                           pLocateCount;
+    uint32_t                           pDirListPartSize;
+    uint32_t                           pDirListDrops;
+    uint16_t                           pRedirectPort;
+    uint64_t                           pBytesRead;
+    uint64_t                           pBytesWritten;
+    bool                               pFailReads;
+    bool                               pDirListStat;
+    std::string                        pTriedHost;
+    uint16_t                           pTriedPort;
+    uint32_t                           pReadDelay;
+    bool                               pManager;
+};
+
+//------------------------------------------------------------------------------
+//! Factory of handlers emulating an xrootd data server on top of
+//! the given storage. It handles the open, close, stat, read, readv, write,
+//! sync, truncate, checksum query, dirlist (also with stat), mkdir, rmdir,
+//! rm, locate and ping requests and acts as both the source and the
+//! destination of third party copies: a sync of a file opened with the
+//! tpc.src and tpc.lfn parameters pulls the data from the source server.
+//! It may also act as a redirector (or a manager) sending the open
+//! requests to another server and the ones naming the servers already
+//! tried to yet another one.
+//------------------------------------------------------------------------------
+class XRootDHandlerFactory: public ClientHandlerFactory
+{
+  public:
+    //--------------------------------------------------------------------------
+    //! Constructor
+    //!
+    //! @param storage the file store, not owned by the factory
+    //--------------------------------------------------------------------------
+    XRootDHandlerFactory( XRootDStorage *storage ): pStorage( storage ) {}
+
+    //--------------------------------------------------------------------------
+    //! Create a client handler
+    //--------------------------------------------------------------------------
+    virtual ClientHandler *CreateHandler();
+
+  private:
+    XRootDStorage *pStorage;
+};
+
+}
+
+#endif // XROOTD_EMULATOR_HH
@@ -18,12 +18,16 @@
 
 #include "XrdClTests/XRootDProtocolHelper.hh"
 #include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
 #include <XProtocol/XProtocol.hh>
 
 //------------------------------------------------------------------------------
 // Handle XRootD Log-in
 //------------------------------------------------------------------------------
-bool XRootDProtocolHelper::HandleLogin( int socket, XrdCl::Log *log )
+bool XRootDProtocolHelper::HandleLogin( int socket, XrdCl::Log *log,
+                                        bool manager )
 {
   //----------------------------------------------------------------------------
   // Handle the handshake
@@ -42,7 +46,7 @@ bool XRootDProtocolHelper::HandleLogin( int socket, XrdCl::Log *log )
   ServerInitHandShake *hs = (ServerInitHandShake *)(serverHandShake+4);
   hs->msglen   = ::htonl(8);
   hs->protover = ::htonl( kXR_PROTOCOLVERSION );
-  hs->msgval   = ::htonl( kXR_DataServer );
+  hs->msgval   = ::htonl( manager ? kXR_LBalServer : kXR_DataServer );
   if( ::write( socket, serverHandShake, 16 ) != 16 )
   {
     log->Error( 1, "Unable to write the handshake response: %s",
@@ -66,7 +70,8 @@ bool XRootDProtocolHelper::HandleLogin( int socket, XrdCl::Log *log )
   ServerResponse serverProtocol; memset( &serverProtocol, 0, 16 );
   serverProtocol.hdr.dlen            = ::htonl( 8 );
   serverProtocol.body.protocol.pval  = ::htonl( kXR_PROTOCOLVERSION );
-  serverProtocol.body.protocol.flags = ::htonl( kXR_isServer );
+  serverProtocol.body.protocol.flags = ::htonl( manager ? kXR_isManager :
+                                                          kXR_isServer );
   if( ::write( socket, &serverProtocol, 16 ) != 16 )
   {
     log->Error( 1, "Unable to write the protocol response: %s",
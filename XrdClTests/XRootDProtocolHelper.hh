@@ -27,8 +27,11 @@ class XRootDProtocolHelper
   public:
     //--------------------------------------------------------------------------
     //! Handle XRootD Log-in
+    //!
+    //! @param manager introduce ourselves as a manager rather than a data
+    //!                server
     //--------------------------------------------------------------------------
-    bool HandleLogin( int socket, XrdCl::Log *log );
+    bool HandleLogin( int socket, XrdCl::Log *log, bool manager = false );
 
     //--------------------------------------------------------------------------
     //! Handle disconnection